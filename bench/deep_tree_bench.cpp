@@ -0,0 +1,165 @@
+/**
+ * Walking, comparing, typing, dumping and freeing very deep trees, like the ones generated
+ * code has: a chain of additions and a chain of nested ifs, each 100000 levels deep
+ * by default. The trees are built directly, since the parser's own stack is limited.
+ * Everything runs on a thread with a small stack, so this fails if any of it
+ * recurses once per level. Build and run with 'make bench_deep'. The first argument,
+ * if given, is the depth.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <fstream>
+
+#include "../src/ast.h"
+#include "../src/context.h"
+#include "../src/parseutils.h"
+
+// Far less than a tree this deep would need if anything recursed per level
+#define BENCH_STACK_SIZE (256 * 1024)
+
+static int depth;
+
+// Time for one call, in milliseconds
+template<typename F>
+static double time_ms(F func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count();
+}
+
+// ((1 + 1) + 1) + ... with 'depth' additions
+static Expr * sum_chain() {
+    Expr * out = new IntLiteral(x::NULL_LOC, 1);
+
+    for (int i = 0; i < depth; i++) {
+        out = new MathExpr(x::NULL_LOC, '+', out, new IntLiteral(x::NULL_LOC, 1));
+    }
+
+    return out;
+}
+
+// if (true) { if (true) { ... } } with 'depth' ifs
+static Statement * if_chain() {
+    Statement * out = new IfStmt(x::NULL_LOC, new BoolLiteral(x::NULL_LOC, true), new StatementList(x::NULL_LOC, {}),
+                                 nullptr);
+
+    for (int i = 1; i < depth; i++) {
+        out = new IfStmt(x::NULL_LOC, new BoolLiteral(x::NULL_LOC, true), new StatementList(x::NULL_LOC, {out}), nullptr);
+    }
+
+    return out;
+}
+
+class NodeCounter : public TreeVisitor {
+    public:
+        size_t count;
+
+        NodeCounter() : count(0) {}
+
+        virtual WalkAction pre(ASTNode * node) {
+            count++;
+            return WalkContinue;
+        }
+};
+
+static void bench(const char * name, ASTNode * (*build)(), bool typed) {
+    ASTNode * a = nullptr;
+    ASTNode * b = nullptr;
+    NodeCounter counter;
+    bool equal = false;
+
+    double build_time = time_ms([&]() {
+        a = build();
+        b = build();
+    });
+
+    double walk_time = time_ms([&]() {
+        x::walk(a, counter);
+    });
+
+    double find_time = time_ms([&]() {
+        // Every leaf is looked at, since nothing matches
+        a->find([](const ASTNode * node) {
+            return node->get_kind() == StringLiteral::kind;
+        });
+    });
+
+    double equals_time = time_ms([&]() {
+        equal = (*a == *b);
+    });
+
+    double dump_time = time_ms([&]() {
+        std::ofstream out("/dev/null");
+        x::dump_tree(out, a, TreeDot, -1);
+    });
+
+    double type_time = 0;
+
+    if (typed) {
+        CompilationContext ctx;
+        SymbolTable * symtable = ctx.default_symtable();
+
+        type_time = time_ms([&]() {
+            ((Expr *) a)->type_of(symtable);
+        });
+
+        delete symtable;
+    }
+
+    double free_time = time_ms([&]() {
+        delete a;
+        delete b;
+    });
+
+    fprintf(stderr, "%s: %zu nodes%s\n", name, counter.count, equal ? "" : " (trees differ!)");
+    fprintf(stderr, "  build x2: %8.2f ms\n", build_time);
+    fprintf(stderr, "  walk:     %8.2f ms\n", walk_time);
+    fprintf(stderr, "  find:     %8.2f ms\n", find_time);
+    fprintf(stderr, "  equals:   %8.2f ms\n", equals_time);
+    fprintf(stderr, "  dump:     %8.2f ms\n", dump_time);
+
+    if (typed) {
+        fprintf(stderr, "  type_of:  %8.2f ms\n", type_time);
+    }
+
+    fprintf(stderr, "  free x2:  %8.2f ms\n", free_time);
+}
+
+static void * run(void * arg) {
+    bench("sum chain", []() {
+        return (ASTNode *) sum_chain();
+    }, true);
+
+    bench("if chain", []() {
+        return (ASTNode *) if_chain();
+    }, false);
+
+    return nullptr;
+}
+
+int main(int argc, char ** argv) {
+    depth = argc > 1 ? atoi(argv[1]) : 100000;
+
+    x::setup_symtable();
+
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, BENCH_STACK_SIZE);
+
+    if (pthread_create(&thread, &attr, run, nullptr) != 0) {
+        perror("Error");
+        return 1;
+    }
+
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+
+    return 0;
+}
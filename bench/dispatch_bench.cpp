@@ -0,0 +1,267 @@
+/**
+ * Cost of reaching a node's code by kind. First a few thousand small nodes are
+ * visited many times through a virtual call and through x::dispatch, once grouped
+ * by kind and once shuffled, which is when indirect calls are hard to predict. Then a large
+ * generated program is typechecked and lowered to asm, the passes that dispatch on
+ * every node; run it on both sides of a change to compare. Branch misses are
+ * counted too where perf events are allowed. Build and run with 'make
+ * bench_dispatch'. The first argument, if given, is the number of functions to
+ * generate.
+ */
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/asm_utils.h"
+#include "../src/ast.h"
+#include "../src/parseutils.h"
+
+// Few enough that they stay in cache, so the time is mostly spent getting to the code
+#define BENCH_NODES 4096
+#define BENCH_PASSES 256
+
+static const char * FUNCTION = R"(
+int f_%d() {
+    mut int x = 1.
+    x = x * 2 + 3.
+    int y = x - 4 * x.
+    int z = y + x * y - 7.
+    return z.
+}.
+)";
+
+// Counts branch misses on this thread, if the kernel lets us
+class MissCounter {
+    public:
+        MissCounter() {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+
+            fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+
+        ~MissCounter() {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+
+        void start() {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+
+        // Misses since start(), or -1 if they can't be counted
+        long long stop() {
+            long long count = -1;
+
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+                if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+                    count = -1;
+                }
+            }
+
+            return count;
+        }
+
+    private:
+        int fd;
+};
+
+struct Timing {
+    double ms;
+    long long misses;
+};
+
+// Best of several runs
+template<typename F>
+static Timing time_best(MissCounter &counter, F func) {
+    Timing best = {1e9, -1};
+
+    for (int i = 0; i < 5; i++) {
+        counter.start();
+        auto start = std::chrono::steady_clock::now();
+        func();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        long long misses = counter.stop();
+
+        if (elapsed.count() < best.ms) {
+            best = {elapsed.count(), misses};
+        }
+    }
+
+    return best;
+}
+
+static void report(const char * name, Timing timing, size_t n) {
+    fprintf(stderr, "  %-16s %8.2f ms  %6.2f ns/node", name, timing.ms, timing.ms * 1e6 / n);
+
+    if (timing.misses >= 0) {
+        fprintf(stderr, "  %6.3f misses/node", (double) timing.misses / n);
+    }
+
+    fprintf(stderr, "\n");
+}
+
+static std::vector<ASTNode *> small_nodes() {
+    std::vector<ASTNode *> out;
+
+    for (int i = 0; out.size() < BENCH_NODES; i++) {
+        out.push_back(new IntLiteral(x::NULL_LOC, i));
+        out.push_back(new FloatLiteral(x::NULL_LOC, (float) i));
+        out.push_back(new BoolLiteral(x::NULL_LOC, i % 2 == 0));
+        out.push_back(new CharLiteral(x::NULL_LOC, (char) i));
+        out.push_back(new Ident(x::NULL_LOC, "n"));
+        out.push_back(new TypeIdent(x::NULL_LOC, "int"));
+    }
+
+    return out;
+}
+
+static void bench_nodes(MissCounter &counter, std::vector<ASTNode *> &nodes, const char * order) {
+    uint64_t sum = 0;
+
+    size_t visits = nodes.size() * BENCH_PASSES;
+
+    Timing virtual_time = time_best(counter, [&]() {
+        for (int i = 0; i < BENCH_PASSES; i++) {
+            for (auto &node : nodes) {
+                sum += node->hash_fields(0);
+            }
+        }
+    });
+
+    Timing switch_time = time_best(counter, [&]() {
+        for (int i = 0; i < BENCH_PASSES; i++) {
+            for (auto &node : nodes) {
+                sum += x::dispatch(node, [](auto * leaf) {
+                    using Leaf = std::remove_pointer_t<decltype(leaf)>;
+
+                    return leaf->Leaf::hash_fields(0);
+                });
+            }
+        }
+    });
+
+    fprintf(stderr, "%zu nodes x %d, %s (checksum %llu)\n", nodes.size(), BENCH_PASSES, order,
+            (unsigned long long) (sum & 0xff));
+    report("virtual call", virtual_time, visits);
+    report("kind switch", switch_time, visits);
+}
+
+class NodeCounter : public TreeVisitor {
+    public:
+        size_t count;
+
+        NodeCounter() : count(0) {}
+
+        virtual WalkAction pre(ASTNode * node) {
+            count++;
+            return WalkContinue;
+        }
+};
+
+static void bench_program(MissCounter &counter, int functions) {
+    std::string code;
+    char buf[1024];
+
+    for (int i = 0; i < functions; i++) {
+        snprintf(buf, sizeof(buf), FUNCTION, i);
+        code += buf;
+    }
+
+    code += "int main() {\n    return 0.\n}.\n";
+
+    CompilationContext ctx;
+    size_t nodes = 0;
+    size_t errors = 0;
+
+    Timing typecheck_time = {1e9, -1};
+    Timing codegen_time = {1e9, -1};
+
+    // Types are kept on the nodes, so each run starts from a fresh parse
+    for (int i = 0; i < 3; i++) {
+        ParseResult result = x::parse_str(ctx, code.c_str());
+        ProgramSource * top = result.parser_state->top;
+        SymbolTable * symtable = result.parser_state->symtable;
+        SourceErrors source_errors;
+        std::ostringstream out;
+
+        NodeCounter walker;
+        x::walk(top, walker);
+        nodes = walker.count;
+
+        counter.start();
+        auto start = std::chrono::steady_clock::now();
+        top->typecheck(symtable, source_errors);
+        std::chrono::duration<double, std::milli> typecheck = std::chrono::steady_clock::now() - start;
+        long long typecheck_misses = counter.stop();
+
+        counter.start();
+        start = std::chrono::steady_clock::now();
+        x::generate_assembly(ctx, top, symtable, out, source_errors);
+        std::chrono::duration<double, std::milli> codegen = std::chrono::steady_clock::now() - start;
+        long long codegen_misses = counter.stop();
+
+        errors = source_errors.type_errors.size();
+
+        if (typecheck.count() < typecheck_time.ms) {
+            typecheck_time = {typecheck.count(), typecheck_misses};
+        }
+
+        if (codegen.count() < codegen_time.ms) {
+            codegen_time = {codegen.count(), codegen_misses};
+        }
+    }
+
+    fprintf(stderr, "%d functions, %zu nodes%s\n", functions, nodes, errors == 0 ? "" : " (type errors!)");
+    report("typecheck", typecheck_time, nodes);
+    report("gen asm", codegen_time, nodes);
+}
+
+int main(int argc, char ** argv) {
+    int functions = argc > 1 ? atoi(argv[1]) : 20000;
+
+    x::setup_symtable();
+
+    MissCounter counter;
+    std::vector<ASTNode *> nodes = small_nodes();
+
+    std::stable_sort(nodes.begin(), nodes.end(), [](ASTNode * a, ASTNode * b) {
+        return a->get_kind() < b->get_kind();
+    });
+    bench_nodes(counter, nodes, "grouped by kind");
+
+    std::mt19937 rng(1);
+    std::shuffle(nodes.begin(), nodes.end(), rng);
+    bench_nodes(counter, nodes, "shuffled");
+
+    for (auto &node : nodes) {
+        delete node;
+    }
+
+    bench_program(counter, functions);
+
+    return 0;
+}
@@ -0,0 +1,160 @@
+/**
+ * Times the flex scanner against FastLexer on a large generated source, and checks
+ * that both return the same tokens. Build and run with 'make bench_lexer'. The
+ * first argument, if given, is the number of functions to generate.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../src/fast_lexer.h"
+#include "../src/parsedecls.h"
+#include "../src/parser.h"
+#include "../src/parseutils.h"
+
+int yylex(YYSTYPE * yylvalp, YYLTYPE * yylocp, yyscan_t scanner);
+
+struct Token {
+    int kind;
+    uint32_t begin;
+    uint32_t end;
+
+    bool operator==(const Token &t) const {
+        return kind == t.kind && begin == t.begin && (kind == END || end == t.end);
+    }
+};
+
+static const char * FUNCTION = R"(
+// Sums the squares of the multiples of 'step'
+int sum_squares_%d(int limit, int step) {
+    mut int total = 0.
+    mut int i = 0.
+    mut float scale = 1.5f.
+
+    while (i < limit and not (i == 17)) {
+        if (i %% step == 0 && i >= -1) {
+            total = total + i * i.  // Keep going
+        } else {
+            print("skipping a value that isn't a multiple").
+        }
+
+        i++.
+    }
+
+    char c = '\n'.
+    return total.
+}.
+)";
+
+static std::string generate(int functions) {
+    std::string out;
+    char buf[1024];
+
+    for (int i = 0; i < functions; i++) {
+        snprintf(buf, sizeof(buf), FUNCTION, i);
+        out += buf;
+    }
+
+    return out;
+}
+
+// Frees the node a token carries, if any
+static void free_value(int kind, YYSTYPE &value) {
+    switch (kind) {
+        case IDENT: case DECLARED_VAR: case DECLARED_FUNC: case DECLARED_TYPE:
+        case DYNAMIC_ARR_IDENT: case INT: case FLOAT: case BOOL: case STR: case CHAR:
+            delete value.ast;
+            break;
+    }
+}
+
+static std::vector<Token> scan_flex(CompilationContext &ctx, const std::string &code) {
+    ParserState state(&ctx, "<bench>");
+    state.source = SourceBuffer::from_str(code.c_str());
+
+    yyscan_t scanner;
+    yylex_init_extra(&state, &scanner);
+    yy_scan_buffer(state.source->data, state.source->size + 2, scanner);
+
+    std::vector<Token> out;
+    YYSTYPE value;
+    Location loc;
+    int kind;
+
+    do {
+        kind = yylex(&value, &loc, scanner);
+        free_value(kind, value);
+        out.push_back({kind, loc.begin, loc.end});
+    } while (kind != END);
+
+    yylex_destroy(scanner);
+
+    return out;
+}
+
+static std::vector<Token> scan_fast(CompilationContext &ctx, const std::string &code) {
+    ParserState state(&ctx, "<bench>");
+    state.source = SourceBuffer::from_str(code.c_str());
+
+    FastLexer lexer(&state);
+    std::vector<Token> out;
+    YYSTYPE value;
+    Location loc;
+    int kind;
+
+    do {
+        kind = lexer.next(&value, &loc);
+        free_value(kind, value);
+        out.push_back({kind, loc.begin, loc.end});
+    } while (kind != END);
+
+    return out;
+}
+
+// Best of several runs, in seconds
+template<typename F>
+static double time_best(F func) {
+    double best = 1e9;
+
+    for (int i = 0; i < 5; i++) {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+
+    return best;
+}
+
+int main(int argc, char ** argv) {
+    int functions = argc > 1 ? atoi(argv[1]) : 50000;
+
+    // Both lexers echo newlines that don't end a statement, like flex's default rule
+    if (freopen("/dev/null", "w", stdout) == nullptr) {
+        return 1;
+    }
+    std::string code = generate(functions);
+    CompilationContext ctx;
+
+    std::vector<Token> flex_tokens = scan_flex(ctx, code);
+    std::vector<Token> fast_tokens = scan_fast(ctx, code);
+
+    if (flex_tokens != fast_tokens) {
+        fprintf(stderr, "Error: the lexers returned different tokens\n");
+        return 1;
+    }
+
+    double flex_time = time_best([&]() { scan_flex(ctx, code); });
+    double fast_time = time_best([&]() { scan_fast(ctx, code); });
+    double mb = code.size() / 1e6;
+
+    fprintf(stderr, "%zu tokens, %.1f MB\n", flex_tokens.size(), mb);
+    fprintf(stderr, "flex:      %8.2f ms  %8.1f MB/s\n", flex_time * 1e3, mb / flex_time);
+    fprintf(stderr, "FastLexer: %8.2f ms  %8.1f MB/s\n", fast_time * 1e3, mb / fast_time);
+    fprintf(stderr, "speedup:   %8.2fx\n", flex_time / fast_time);
+
+    return 0;
+}
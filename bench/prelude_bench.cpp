@@ -0,0 +1,70 @@
+/**
+ * Cold-start cost of the prelude: parsing BUILTIN_DECLS against loading the symbol
+ * table from PRELUDE_BLOB. Build and run with 'make bench_prelude'. The first
+ * argument, if given, is the number of times to load each.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include "../src/parseutils.h"
+#include "../src/serialize.h"
+
+// Average time per call, in microseconds
+template<typename F>
+static double time_each(int runs, F func) {
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < runs; i++) {
+        func();
+    }
+
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / runs;
+}
+
+int main(int argc, char ** argv) {
+    int runs = argc > 1 ? atoi(argv[1]) : 2000;
+
+    if (PRELUDE_BLOB == nullptr) {
+        fprintf(stderr, "Error: built without PRELUDE_BLOB\n");
+        return 1;
+    }
+
+    // The parser echoes the newlines in BUILTIN_DECLS, like it does for any source
+    if (freopen("/dev/null", "w", stdout) == nullptr) {
+        return 1;
+    }
+
+    double parse_time = time_each(runs, []() {
+        CompilationContext ctx(x::bare_symtable());
+        ParseResult result = x::parse_builtins(ctx);
+        delete ctx.prelude;
+    });
+
+    double load_time = time_each(runs, []() {
+        std::vector<ASTNode *> decls;
+        SymbolTable * symtable = x::deserialize_symtable(PRELUDE_BLOB, PRELUDE_BLOB_SIZE, x::builtins_hash(), decls);
+
+        if (symtable == nullptr) {
+            fprintf(stderr, "Error: PRELUDE_BLOB is stale\n");
+            exit(1);
+        }
+
+        for (auto &decl : decls) {
+            delete decl;
+        }
+
+        delete symtable;
+    });
+
+    fprintf(stderr, "prelude blob: %zu bytes\n", PRELUDE_BLOB_SIZE);
+    fprintf(stderr, "parse: %8.2f us\n", parse_time);
+    fprintf(stderr, "load:  %8.2f us\n", load_time);
+    fprintf(stderr, "speedup: %6.1fx\n", parse_time / load_time);
+
+    return 0;
+}
@@ -1,10 +1,11 @@
 #include "asm.h"
+#include "errors.h"
 
-RegisterState::RegisterState() : var("") {}
+RegisterState::RegisterState() : var(TAC_NONE), used(false) {}
 
-AsmState::AsmState() : stack({}), offsets({}), regs{}, stack_offset(0), reg_roulette(0) {}
+AsmState::AsmState(const TacBuffer * tac) : stack(), offsets(), regs{}, stack_offset(0), reg_roulette(0), tac(tac) {}
 
-std::optional<VarLoc> AsmState::find_var(std::string id) {
+std::optional<VarLoc> AsmState::find_var(TacId id) {
     for (int i = 0; i < GeneralReg::Count; i++) {
         if (regs[i].used && regs[i].var == id) {
             VarLoc loc = {
@@ -59,7 +60,7 @@ GeneralReg AsmState::free_reg(std::ostream &code) {
     RegisterState * state = regs + reg_roulette;
 
     stack_offset += 8;
-    code << "push %" << REG_NAMES[reg_roulette] << "# save register on stack, variable: " << state->var << "\n";
+    code << "push %" << REG_NAMES[reg_roulette] << "# save register on stack, variable: " << tac->name(state->var) << "\n";
     state->used = false;
     StackVar stack_var = {
         .size = 8,
@@ -72,12 +73,11 @@ GeneralReg AsmState::free_reg(std::ostream &code) {
     return (GeneralReg) (reg_roulette - 1);
 }
 
-GeneralReg AsmState::move_into_reg(std::string id, std::ostream &code, int offset) {
+GeneralReg AsmState::move_into_reg(TacId id, std::ostream &code, int offset) {
     std::optional<VarLoc> var_loc_opt = find_var(id);
 
     if (!var_loc_opt) {
-        fprintf(stderr, "variable not in register file or stack\n");
-        exit(1);
+        throw CompilerError(x::NULL_LOC, "Variable not in register file or stack", Error);
     }
 
     VarLoc loc = *var_loc_opt;
@@ -110,7 +110,7 @@ GeneralReg AsmState::move_into_reg(std::string id, std::ostream &code, int offse
     return (GeneralReg) reg;
 }
 
-void AsmState::clear_var(std::string id) {
+void AsmState::clear_var(TacId id) {
     for (size_t i = 0; i < GeneralReg::Count; i++) {
         if (regs[i].used && regs[i].var == id) {
             regs[i].used = false;
@@ -124,7 +124,7 @@ void AsmState::clear_reg(GeneralReg reg, std::ostream &code) {
         return;
     }
 
-    code << "push %" << REG_NAMES[reg] << "# force clear register: " << regs[reg].var << "\n";
+    code << "push %" << REG_NAMES[reg] << "# force clear register: " << tac->name(regs[reg].var) << "\n";
     regs[reg].used = false;
     stack_offset += 8;
     StackVar stack_var = {
@@ -6,6 +6,8 @@
 #include <optional>
 #include <vector>
 
+#include "tac.h"
+
 #define NELEM(a) (sizeof(a) / sizeof(*a))
 
 // Registers for general purpose use
@@ -50,7 +52,7 @@ static_assert(GeneralReg::Count == NELEM(REG_NAMES));
 
 typedef struct {
     int size;
-    std::string id;
+    TacId id;
 } StackVar;
 
 typedef enum {
@@ -76,7 +78,7 @@ typedef struct {
 
 typedef struct RegisterState {
     // id of variable in this register
-    std::string var;
+    TacId var;
     // If true, this register is in use and cannot be cleaned up
     bool used;
 
@@ -92,13 +94,15 @@ typedef struct AsmState {
     // Index of next register to move if all registers are in use
     // and we need one
     int reg_roulette;
+    // TAC being translated, used to look up variable names. Not owned
+    const TacBuffer * tac;
 
-    AsmState();
+    AsmState(const TacBuffer * tac);
 
     /**
      * Looks in the register file first. Then looks in the stack
      */
-    std::optional<VarLoc> find_var(std::string id);
+    std::optional<VarLoc> find_var(TacId id);
 
     std::optional<GeneralReg> get_unused_reg();
 
@@ -109,9 +113,9 @@ typedef struct AsmState {
      */
     GeneralReg free_reg(std::ostream &code);
 
-    GeneralReg move_into_reg(std::string id, std::ostream &code, int offset);
+    GeneralReg move_into_reg(TacId id, std::ostream &code, int offset);
 
-    void clear_var(std::string id);
+    void clear_var(TacId id);
 
     void clear_reg(GeneralReg reg, std::ostream &code);
 
@@ -1,23 +1,25 @@
 #include "asm_utils.h"
 
+#include <sstream>
+
 TypeTable::TypeTable() : types({}) {}
 
 TypeTable::~TypeTable() {
-    for (std::pair<const std::string, Typename *> &item : types) {
+    for (std::pair<const TacId, Typename *> &item : types) {
         delete item.second;
     }
 }
 
-void TypeTable::put(std::string name, Typename * typ) {
-    types[name] = typ;
+void TypeTable::put(TacId id, Typename * typ) {
+    types[id] = typ;
 }
 
 /**
  * Look up the symbol and get its type, then insert it into the type table with
- * a new name
+ * a new id
  */
-void TypeTable::put_from_symbol(std::string name, std::string new_name, SymbolTable * symtable) {
-    if (get(new_name) != nullptr) {
+void TypeTable::put_from_symbol(std::string name, TacId new_id, SymbolTable * symtable) {
+    if (get(new_id) != nullptr) {
         return;
     }
     Symbol * sym = symtable->get(name);
@@ -32,48 +34,114 @@ void TypeTable::put_from_symbol(std::string name, std::string new_name, SymbolTa
     if (sym->kind == Var) {
         VarDecl * decl = sym->decl.var;
         Typename * typ = decl->type_name->clone();
-        types[new_name] = typ;
+        types[new_id] = typ;
         return;
     }
     FuncDecl * decl = sym->decl.func;
     Typename * typ = decl->type_of(symtable);
-    types[new_name] = typ;
+    types[new_id] = typ;
 }
 
-Typename * TypeTable::get(std::string name) {
-    if (types.count(name)) {
-        return types[name];
+Typename * TypeTable::get(TacId id) {
+    auto item = types.find(id);
+
+    if (item != types.end()) {
+        return item->second;
     }
+
     return nullptr;
 }
 
-int TypeTable::arg_offset(const ArgTAC * tac) {
-    Typename * typ = this->get(tac->func);
+int TypeTable::arg_offset(TacId func, int arg) {
+    Typename * typ = this->get(func);
     if (typ == nullptr) {
-        fprintf(stderr, "type of func can't be null\n");
-        exit(1);
+        throw CompilerError(x::NULL_LOC, "Type of func can't be null", Error);
     }
     if (typ->get_kind() != FuncTypename::kind) {
-        fprintf(stderr, "type of func must be func\n");
-        exit(1);
+        throw CompilerError(x::NULL_LOC, "Type of func must be func", Error);
     }
     FuncTypename * func_type = (FuncTypename *) typ;
-    return func_type->offsets[tac->arg];
+    return func_type->offsets[arg];
 }
 
-void x::generate_assembly(const ProgramSource * src, SymbolTable * symtable, std::ostream &code) {
-    std::vector<Quad *> instrs = {};
+std::string x::node_to_asm(CompilationContext &ctx, const ASTNode * node, SymbolTable * symtable,
+                           NamesToNames &names) {
+    TacBuffer tac(&ctx);
     TypeTable type_table;
-    NamesToNames names = x::symtable_to_names(nullptr, symtable);
-    src->gen_tac(symtable, &type_table, names, instrs);
+    std::ostringstream code;
+
+    try {
+        node->gen_tac(symtable, &type_table, names, tac);
+
+        AsmState asm_state(&tac);
+        x::tac_to_asm(code, tac, &type_table, asm_state);
+    } catch (CompilerError &error) {
+        if (error.loc.begin == 0 && error.loc.end == 0) {
+            error.loc = node->loc;
+        }
+
+        throw;
+    }
 
-    AsmState asm_state;
+    return code.str();
+}
+
+void x::asm_preamble(std::ostream &code) {
     code << ".text\n";
     code << ".globl main\n";
-    
-    for (auto &tac : instrs) {
-        tac->to_asm(code, &type_table, names, asm_state);
+}
+
+CompilationContext x::unit_context(const CompilationContext &ctx, size_t index) {
+    return ctx.fork(std::to_string(index) + "_");
+}
+
+bool x::generate_assembly(CompilationContext &ctx, const ProgramSource * src, SymbolTable * symtable, std::ostream &code,
+                          SourceErrors &errors, ThreadPool * pool) {
+    // Global names have to be known before any function is generated, because any
+    // function can refer to them
+    NamesToNames names = x::global_names(&ctx, src);
+    std::vector<CompilationContext> forks;
+    std::vector<std::string> units(src->nodes.size());
+
+    // Kept per node so errors come out in source order however the pool ran them
+    std::vector<std::optional<CompilerError>> failures(src->nodes.size());
+
+    for (size_t i = 0; i < src->nodes.size(); i++) {
+        forks.push_back(x::unit_context(ctx, i));
+    }
+
+    auto gen_unit = [&](size_t i) {
+        try {
+            units[i] = x::node_to_asm(forks[i], src->nodes[i], symtable, names);
+        } catch (CompilerError &error) {
+            failures[i] = error;
+        }
+    };
+
+    if (pool != nullptr) {
+        pool->parallel_for(units.size(), gen_unit);
+    } else {
+        for (size_t i = 0; i < units.size(); i++) {
+            gen_unit(i);
+        }
+    }
+
+    x::asm_preamble(code);
+
+    for (auto &unit : units) {
+        code << unit;
     }
 
     code << std::flush;
-}
\ No newline at end of file
+
+    bool ok = true;
+
+    for (auto &failure : failures) {
+        if (failure) {
+            errors.codegen_errors.push_back(*failure);
+            ok = false;
+        }
+    }
+
+    return ok;
+}
@@ -1,8 +1,13 @@
 #ifndef SRC_ASM_UTILS_H
 #define SRC_ASM_UTILS_H
 
+#include <unordered_map>
+
+#include "asm.h"
 #include "ast.h"
+#include "errors.h"
 #include "tac.h"
+#include "thread_pool.h"
 
 /**
  * This class owns all Typename ptrs, so be sure to call clone() before inserting
@@ -10,27 +15,48 @@
  */
 class TypeTable {
     public:
-        std::map<std::string, Typename *> types;
+        std::unordered_map<TacId, Typename *> types;
 
         TypeTable();
 
         ~TypeTable();
 
-        void put(std::string name, Typename * typ);
+        void put(TacId id, Typename * typ);
 
         /**
          * Look up the symbol and get its type, then insert it into the type table with
-         * a new name
+         * a new id
          */
-        void put_from_symbol(std::string name, std::string new_name, SymbolTable * symtable);
+        void put_from_symbol(std::string name, TacId new_id, SymbolTable * symtable);
 
-        Typename * get(std::string name);
+        Typename * get(TacId id);
 
-        int arg_offset(const ArgTAC * tac);
+        // Offset of argument number 'arg' in the frame of function 'func'
+        int arg_offset(TacId func, int arg);
 };
 
 namespace x {
-    void generate_assembly(const ProgramSource * src, SymbolTable * symtable, std::ostream &code);
+    // Writes what goes before the first unit of every asm file
+    void asm_preamble(std::ostream &code);
+
+    // Context to generate the top-level node at 'index' with. Its names start with the
+    // index, so they come out the same whether nodes are generated together or not
+    CompilationContext unit_context(const CompilationContext &ctx, size_t index);
+
+    // Lowers one top-level node all the way to asm. Throws a CompilerError for code
+    // the backend can't handle, located at the node if nothing more precise is known
+    std::string node_to_asm(CompilationContext &ctx, const ASTNode * node, SymbolTable * symtable, NamesToNames &names);
+
+    /**
+     * Each top-level node is lowered to TAC and asm on its own, with its own AsmState
+     * and output buffer, and the buffers are written out in source order. If a pool
+     * is given the nodes are generated in parallel on it.
+     *
+     * A node that can't be lowered adds a codegen error to 'errors' instead of asm, and
+     * the rest are still generated. Returns false if any node failed.
+     */
+    bool generate_assembly(CompilationContext &ctx, const ProgramSource * src, SymbolTable * symtable, std::ostream &code,
+                           SourceErrors &errors, ThreadPool * pool = nullptr);
 }
 
 #endif
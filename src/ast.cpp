@@ -6,210 +6,373 @@
 #include <algorithm>
 #include <cstdint>
 #include <iostream>
-#include <iterator>
 
 #include "asm_utils.h"
+#include "errors.h"
+#include "hash.h"
 #include "parser.h"
 #include "tac.h"
 
-std::string next_label();
-
-std::vector<std::string> x::kind_map;
-
-void add_string(const char* str);
-
-const int ProgramSource::kind = x::next_kind("program_source");
-const int IntLiteral::kind = x::next_kind("int_literal");
-const int FloatLiteral::kind = x::next_kind("float_literal");
-const int TernaryExpr::kind = x::next_kind("ternary_expr");
-const int BoolLiteral::kind = x::next_kind("bool_literal");
-const int CharLiteral::kind = x::next_kind("char_literal");
-const int StringLiteral::kind = x::next_kind("str_literal");
-const int TypeIdent::kind = x::next_kind("type_ident");
-const int Ident::kind = x::next_kind("ident");
-const int ParensExpr::kind = x::next_kind("parens_expr");
-const int MathExpr::kind = x::next_kind("math_expr");
-const int BoolExpr::kind = x::next_kind("bool_expr");
-const int ParensTypename::kind = x::next_kind("parens_typename");
-const int PtrTypename::kind = x::next_kind("ptr_typename");
-const int MutTypename::kind = x::next_kind("mut_typename");
-const int TypenameList::kind = x::next_kind("typename_list");
-const int VarDeclList::kind = x::next_kind("var_decl_list");
-const int ExprList::kind = x::next_kind("expr_list");
-const int TupleTypename::kind = x::next_kind("tuple_typename");
-const int FuncTypename::kind = x::next_kind("func_typename");
-const int StaticArrayTypename::kind = x::next_kind("static_array_typename");
-const int DynamicArrayTypename::kind = x::next_kind("dynamic_array_typename");
-const int TypeAlias::kind = x::next_kind("type_alias");
-const int StructTypename::kind = x::next_kind("struct_typename");
-const int StructDecl::kind = x::next_kind("struct_decl");
-const int VarDecl::kind = x::next_kind("var_decl");
-const int VarDeclInit::kind = x::next_kind("var_decl_init");
-const int ArrayLiteral::kind = x::next_kind("array_literal");
-const int IfStmt::kind = x::next_kind("if");
-const int IfElseStmt::kind = x::next_kind("if_else");
-const int WhileStmt::kind = x::next_kind("while");
-const int ForStmt::kind = x::next_kind("for");
-const int AddrOf::kind = x::next_kind("addr_of");
-const int Deref::kind = x::next_kind("deref");
-const int CastExpr::kind = x::next_kind("cast_expr");
-const int LogicalExpr::kind = x::next_kind("logical_expr");
-const int TupleExpr::kind = x::next_kind("tuple_expr");
-const int FunctionCallExpr::kind = x::next_kind("function_call_expr");
-const int FunctionCallStmt::kind = x::next_kind("function_call_stmt");
-const int StatementList::kind = x::next_kind("statement_list");
-const int ParamsList::kind = x::next_kind("params_list");
-const int FuncDecl::kind = x::next_kind("func_decl");
-const int ReturnStatement::kind = x::next_kind("return_statement");
-const int Assignment::kind = x::next_kind("assignment");
-const int BangExpr::kind = x::next_kind("bang_expr");
-const int NotExpr::kind = x::next_kind("not_expr");
-const int PreExpr::kind = x::next_kind("pre_expr");
-const int PostExpr::kind = x::next_kind("post_expr");
-const int StructDeref::kind = x::next_kind("struct_deref");
-const int MemberInitializer::kind = x::next_kind("member_initializer");
-const int InitializerList::kind = x::next_kind("initializer_list");
-const int StructLiteral::kind = x::next_kind("struct_literal");
-const int ArrayIndexExpr::kind = x::next_kind("array_index_expr");
-const int VoidReturnStmt::kind = x::next_kind("void_return_stmt");
-const int PleaseReturnStmt::kind = x::next_kind("Please_return_stmt");
-const int ContinueStmt::kind = x::next_kind("continue_stmt");
-const int BreakStmt::kind = x::next_kind("break_stmt");
-
-int x::next_kind(const char * const name) {
-    static int kind = 0;
-    x::kind_map.push_back(std::string(name));
-
-    return kind++;
-}
+#define AST_KIND_DEF(cls, name) const int cls::kind = cls##Kind;
+#define AST_KIND_NAME(cls, name) name,
+
+AST_NODE_KINDS(AST_KIND_DEF)
+
+const char * const x::kind_map[NUM_NODE_KINDS] = {
+    AST_NODE_KINDS(AST_KIND_NAME)
+};
+
+#undef AST_KIND_DEF
+#undef AST_KIND_NAME
 
 template <typename T>
-static std::vector<ASTNode *> cast_nodes(std::vector<T> &vec) {
+static bool each_node(const std::vector<T> &vec, ChildFunc f) {
+    for (auto &item : vec) {
+        if (!f((ASTNode *) item)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+Location::Location() : begin(0), end(0) {}
+
+Location::Location(uint32_t begin, uint32_t end) : begin(begin), end(end) {}
+
+Location::Location(const Location &start, const Location &end) : begin(start.begin), end(end.end) {}
+
+void Location::set_end(const Location &end) {
+    this->end = end.end;
+}
+
+std::vector<ASTNode *> ASTNode::children() {
     std::vector<ASTNode *> out;
 
-    std::transform(vec.begin(), vec.end(), std::back_inserter(out),
-    [](auto &item) {
-        return (ASTNode *)item;
+    each_child([&out](ASTNode * child) {
+        out.push_back(child);
+        return true;
     });
 
     return out;
 }
 
-template <typename T>
-static bool cmp_vectors(const std::vector<T *> &v1, const std::vector<T *> &v2) {
-    if (v1.size() != v2.size()) {
-        return false;
+TacId ASTNode::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    throw CompilerError(loc, std::string("Can't generate code for ") + x::kind_map[get_kind()], Error);
+}
+
+// Stops at the first node that passes 'cond'
+class Finder : public TreeVisitor {
+    public:
+        FindFunc cond;
+        ASTNode * found;
+
+        Finder(FindFunc cond) : cond(cond), found(nullptr) {}
+
+        virtual WalkAction pre(ASTNode * node) {
+            if (cond(node)) {
+                found = node;
+                return WalkStop;
+            }
+
+            return WalkContinue;
+        }
+};
+
+ASTNode * ASTNode::find(FindFunc cond) {
+    Finder finder(cond);
+    x::walk(this, finder);
+
+    return finder.found;
+}
+
+bool ASTNode::operator==(const ASTNode &node) const {
+    return x::tree_equals(this, &node);
+}
+
+bool ASTNode::operator!=(const ASTNode &node) const {
+    return !x::tree_equals(this, &node);
+}
+
+bool ASTNode::same_fields(const ASTNode &node) const {
+    return node.get_kind() == get_kind();
+}
+
+uint64_t ASTNode::hash_fields(uint64_t seed) const {
+    int kind = get_kind();
+
+    return x::hash_bytes(&kind, sizeof(kind), seed);
+}
+
+// Stands in for a null child, and for a hash that hasn't been worked out
+#define NO_HASH 0
+
+uint64_t ASTNode::hash() const {
+    uint64_t cached = structural_hash.load(std::memory_order_relaxed);
+
+    if (cached != NO_HASH) {
+        return cached;
     }
 
-    for (size_t i = 0; i < v1.size(); i++) {
-        if (*(v1[i]) != *(v2[i])) {
+    // Post order, so every child has been hashed by the time its parent is
+    std::vector<std::pair<const ASTNode *, bool>> stack = {{this, false}};
+
+    while (!stack.empty()) {
+        auto &[node, expanded] = stack.back();
+
+        if (node->structural_hash.load(std::memory_order_relaxed) != NO_HASH) {
+            stack.pop_back();
+            continue;
+        }
+
+        if (!expanded) {
+            expanded = true;
+
+            // Copied out, since pushing can move the frame
+            const ASTNode * parent = node;
+
+            ((ASTNode *) parent)->each_child([&stack](ASTNode * child) {
+                if (child != nullptr) {
+                    stack.push_back({child, false});
+                }
+
+                return true;
+            });
+
+            continue;
+        }
+
+        uint64_t out = node->hash_fields(0);
+
+        ((ASTNode *) node)->each_child([&out](ASTNode * child) {
+            uint64_t part = child == nullptr ? NO_HASH : child->structural_hash.load(std::memory_order_relaxed);
+            out = x::hash_bytes(&part, sizeof(part), out);
+
+            return true;
+        });
+
+        node->structural_hash.store(out == NO_HASH ? 1 : out, std::memory_order_relaxed);
+        stack.pop_back();
+    }
+
+    return structural_hash.load(std::memory_order_relaxed);
+}
+
+struct WalkFrame {
+    ASTNode * node;
+    // Set once the node's children have been pushed, so post() is next
+    bool expanded;
+};
+
+bool x::walk(ASTNode * node, TreeVisitor &visitor) {
+    std::vector<WalkFrame> stack = {{node, false}};
+
+    while (!stack.empty()) {
+        WalkFrame &frame = stack.back();
+        ASTNode * top = frame.node;
+
+        if (frame.expanded) {
+            stack.pop_back();
+
+            if (visitor.post(top) == WalkStop) {
+                return false;
+            }
+
+            continue;
+        }
+
+        WalkAction action = visitor.pre(top);
+
+        if (action == WalkStop) {
             return false;
         }
+
+        frame.expanded = true;
+
+        if (action == WalkSkip) {
+            continue;
+        }
+
+        // Pushed in order and then reversed, so the first child comes off first
+        size_t first = stack.size();
+
+        top->each_child([&stack](ASTNode * child) {
+            if (child != nullptr) {
+                stack.push_back({child, false});
+            }
+
+            return true;
+        });
+
+        std::reverse(stack.begin() + first, stack.end());
     }
 
     return true;
 }
 
-Location::Location(int first_line, int first_col, int last_line, int last_col) :
-    first_line(first_line), first_col(first_col), last_line(last_line), last_col(last_col) {};
+const Ident * x::declared_name(const ASTNode * node) {
+    if (node->get_kind() == FuncDecl::kind) {
+        return ((FuncDecl *) node)->name;
+    } else if (node->get_kind() == VarDecl::kind) {
+        return ((VarDecl *) node)->var_name;
+    } else if (node->get_kind() == VarDeclInit::kind) {
+        return ((VarDeclInit *) node)->decl->var_name;
+    } else if (node->get_kind() == TypeAlias::kind) {
+        return ((TypeAlias *) node)->name;
+    } else if (node->get_kind() == StructDecl::kind) {
+        return ((StructDecl *) node)->name;
+    }
+
+    return nullptr;
+}
+
+bool x::tree_equals(const ASTNode * a, const ASTNode * b) {
+    std::vector<std::pair<ASTNode *, ASTNode *>> stack = {{(ASTNode *) a, (ASTNode *) b}};
+    std::vector<ASTNode *> left;
+
+    while (!stack.empty()) {
+        auto [l, r] = stack.back();
+        stack.pop_back();
+
+        if (l == r) {
+            continue;
+        }
+
+        if (l == nullptr || r == nullptr || !l->same_fields(*r)) {
+            return false;
+        }
+
+        uint64_t l_hash = l->structural_hash.load(std::memory_order_relaxed);
+        uint64_t r_hash = r->structural_hash.load(std::memory_order_relaxed);
+
+        if (l_hash != NO_HASH && r_hash != NO_HASH && l_hash != r_hash) {
+            return false;
+        }
+
+        left.clear();
+
+        l->each_child([&left](ASTNode * child) {
+            left.push_back(child);
+            return true;
+        });
 
-Location::Location(YYLTYPE &start, YYLTYPE &end) :
-    first_line(start.first_line), first_col(start.first_column), last_line(end.last_line), last_col(end.last_column) {}
+        size_t i = 0;
+        bool same_count = r->each_child([&](ASTNode * child) {
+            if (i == left.size()) {
+                return false;
+            }
 
-Location::Location(const Location &start, const Location &end) :
-    first_line(start.first_line), first_col(start.first_col), last_line(end.last_line), last_col(end.last_col) {}
+            stack.push_back({left[i++], child});
+            return true;
+        });
 
-void Location::set_end(YYLTYPE &end) {
-    last_line = end.last_line;
-    last_col = end.last_column;
+        if (!same_count || i != left.size()) {
+            return false;
+        }
+    }
+
+    return true;
 }
 
-ASTNode * ASTNode::find(FindFunc cond) {
-    if (cond(this)) {
-        return this;
+// Nodes waiting to be deleted by the outermost x::release on this thread, or null
+// if there is none
+static thread_local std::vector<const ASTNode *> * release_queue = nullptr;
+
+void x::release(const ASTNode * node) {
+    if (node == nullptr || node->is_shared()) {
+        return;
     }
 
-    for (auto &child : children()) {
-        ASTNode * result = child->find(cond);
+    if (release_queue != nullptr) {
+        release_queue->push_back(node);
+        return;
+    }
 
-        if (result != nullptr) {
-            return result;
-        }
+    std::vector<const ASTNode *> queue = {node};
+    release_queue = &queue;
+
+    while (!queue.empty()) {
+        const ASTNode * next = queue.back();
+        queue.pop_back();
+        delete next;
     }
 
-    return nullptr;
+    release_queue = nullptr;
 }
 
 IntLiteral::IntLiteral(const Location loc, const char * int_str) :
-    NumLiteral(loc), value(atoi(int_str)) {}
+    NumLiteral(loc, kind), value(atoi(int_str)) {}
 
 IntLiteral::IntLiteral(const Location loc, const int value) :
-    NumLiteral(loc), value(value) {}
+    NumLiteral(loc, kind), value(value) {}
 
 void IntLiteral::print() const {
     printf("%d", value);
 }
 
-std::string IntLiteral::gen_tac(SymbolTable * old_symtable,
-    TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const {
-        std::string t_name = next_t();
-        Value<int> * tac = new Value<int>(t_name, value);
+TacId IntLiteral::gen_tac(SymbolTable * old_symtable,
+    TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+        TacId t = tac.value(tac.ctx->next_t());
 
-        type_table->put(t_name, new TypeIdent(x::NULL_LOC, "int"));
-        instrs.push_back(tac);
-        return t_name;
+        type_table->put(t, new TypeIdent(x::NULL_LOC, "int"));
+        tac.emit_int(t, value);
+        return t;
 }
 
-std::vector<ASTNode *> IntLiteral::children() {
-    return {};
+bool IntLiteral::each_child(ChildFunc f) {
+    return true;
 }
 
-bool IntLiteral::operator==(const ASTNode &node) const {
-    if (node.get_kind() != IntLiteral::kind) {
-        return false;
-    }
+bool IntLiteral::same_fields(const ASTNode &node) const {
+    return node.get_kind() == IntLiteral::kind && value == ((IntLiteral &) node).value;
+}
 
-    return value == ((IntLiteral &) node).value;
+uint64_t IntLiteral::hash_fields(uint64_t seed) const {
+    seed = ASTNode::hash_fields(seed);
+
+    return x::hash_bytes(&value, sizeof(value), seed);
 }
 
 FloatLiteral::FloatLiteral(const Location loc, const char * float_str) :
-    NumLiteral(loc), value(atof(float_str)) {}
+    NumLiteral(loc, kind), value(atof(float_str)) {}
 
 FloatLiteral::FloatLiteral(const Location loc, const float value) :
-    NumLiteral(loc), value(value) {}
+    NumLiteral(loc, kind), value(value) {}
 
 void FloatLiteral::print() const {
     printf("%f", value);
 }
 
-std::string FloatLiteral::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> instrs) const {
-    std::string p = next_t();
-    Value<float> * v = new Value<float>(p, value);
-    x::bblock->add_instruction(v);
+TacId FloatLiteral::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    TacId p = tac.value(tac.ctx->next_t());
+    tac.emit_float(p, value);
     return p;
 }
 
-std::vector<ASTNode *> FloatLiteral::children() {
-    return {};
+bool FloatLiteral::each_child(ChildFunc f) {
+    return true;
 }
 
-bool FloatLiteral::operator==(const ASTNode &node) const {
-    if (node.get_kind() != FloatLiteral::kind) {
-        return false;
-    }
+bool FloatLiteral::same_fields(const ASTNode &node) const {
+    return node.get_kind() == FloatLiteral::kind && value == ((FloatLiteral &) node).value;
+}
+
+uint64_t FloatLiteral::hash_fields(uint64_t seed) const {
+    // 0.0 and -0.0 compare equal, so they have to hash the same
+    double bits = value == 0 ? 0 : value;
+    seed = ASTNode::hash_fields(seed);
 
-    return value == ((FloatLiteral &) node).value;
+    return x::hash_bytes(&bits, sizeof(bits), seed);
 }
 
-BoolLiteral::BoolLiteral(const Location loc, const bool value) : Expr(loc), value(value) {}
+BoolLiteral::BoolLiteral(const Location loc, const bool value) : Expr(loc, kind), value(value) {}
 
-std::string BoolLiteral::gen_tac(SymbolTable *old_symtable, TypeTable *type_table, NamesToNames &names, std::vector<Quad *> instrs) const
-{
-    std::string p = next_t();
-    Value<bool> *v = new Value<bool>(p, value);
-    x::bblock->add_instruction(v);
+TacId BoolLiteral::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    TacId p = tac.value(tac.ctx->next_t());
+    tac.emit_bool(p, value);
     return p;
 }
+
 void BoolLiteral::print() const {
     if (value) {
         printf("true");
@@ -218,24 +381,25 @@ void BoolLiteral::print() const {
     }
 }
 
-std::vector<ASTNode *> BoolLiteral::children() {
-    return {};
+bool BoolLiteral::each_child(ChildFunc f) {
+    return true;
 }
 
-bool BoolLiteral::operator==(const ASTNode &node) const {
-    if (node.get_kind() != BoolLiteral::kind) {
-        return false;
-    }
+bool BoolLiteral::same_fields(const ASTNode &node) const {
+    return node.get_kind() == BoolLiteral::kind && value == ((BoolLiteral &) node).value;
+}
 
-    return value == ((BoolLiteral &) node).value;
+uint64_t BoolLiteral::hash_fields(uint64_t seed) const {
+    seed = ASTNode::hash_fields(seed);
+
+    return x::hash_bytes(&value, sizeof(value), seed);
 }
 
-CharLiteral::CharLiteral(const Location loc, const char value) : Expr(loc), value(value) {}
+CharLiteral::CharLiteral(const Location loc, const char value) : Expr(loc, kind), value(value) {}
 
-std::string CharLiteral::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> instrs) const {
-    std::string p = next_t();
-    Value<char> * v = new Value<char>(p, value);
-    x::bblock->add_instruction(v);
+TacId CharLiteral::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    TacId p = tac.value(tac.ctx->next_t());
+    tac.emit_char(p, value);
     return p;
 }
 
@@ -266,26 +430,31 @@ void CharLiteral::print() const {
     }
 }
 
-std::vector<ASTNode *> CharLiteral::children() {
-    return {};
+bool CharLiteral::each_child(ChildFunc f) {
+    return true;
 }
 
-bool CharLiteral::operator==(const ASTNode &node) const {
-    if (node.get_kind() != CharLiteral::kind) {
-        return false;
-    }
+bool CharLiteral::same_fields(const ASTNode &node) const {
+    return node.get_kind() == CharLiteral::kind && value == ((CharLiteral &) node).value;
+}
+
+uint64_t CharLiteral::hash_fields(uint64_t seed) const {
+    seed = ASTNode::hash_fields(seed);
 
-    return value == ((CharLiteral &) node).value;
+    return x::hash_bytes(&value, sizeof(value), seed);
 }
 
 StringLiteral::StringLiteral(const Location loc, const char * const value)
-    : Expr(loc), value(std::string(value)) {
-    }
+    : Expr(loc, kind), owned(value) {
+    this->value = owned;
+}
+
+StringLiteral::StringLiteral(const Location loc, std::string_view value)
+    : Expr(loc, kind), value(value), owned() {}
 
-std::string StringLiteral::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> instrs) const {
-    std::string p = next_t();
-    Value<std::string> *v = new Value<std::string>(p, value);
-    x::bblock->add_instruction(v);
+TacId StringLiteral::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    TacId p = tac.value(tac.ctx->next_t());
+    tac.emit_str(p, std::string(value));
     return p;
 }
 
@@ -295,25 +464,27 @@ void StringLiteral::print() const {
     putchar('"');
 }
 
-std::vector<ASTNode *> StringLiteral::children() {
-    return {};
+bool StringLiteral::each_child(ChildFunc f) {
+    return true;
+}
+
+bool StringLiteral::same_fields(const ASTNode &node) const {
+    return node.get_kind() == StringLiteral::kind && value == ((StringLiteral &) node).value;
 }
 
-bool StringLiteral::operator==(const ASTNode &node) const {
-    if (node.get_kind() != StringLiteral::kind) {
-        return false;
-    }
+uint64_t StringLiteral::hash_fields(uint64_t seed) const {
+    seed = ASTNode::hash_fields(seed);
 
-    return value == ((StringLiteral &) node).value;
+    return x::hash_bytes(value.data(), value.size(), seed);
 }
 
 TernaryExpr::TernaryExpr(const Location loc, const Expr * cond, const Expr * tru, const Expr * fals)
-    : Expr(loc), cond(cond), tru(tru), fals(fals) {}
+    : Expr(loc, kind), cond(cond), tru(tru), fals(fals) {}
 
 TernaryExpr::~TernaryExpr() {
-    delete cond;
-    delete tru;
-    delete fals;
+    x::release(cond);
+    x::release(tru);
+    x::release(fals);
 }
 
 void TernaryExpr::print() const {
@@ -324,22 +495,15 @@ void TernaryExpr::print() const {
     fals->print();
 }
 
-std::vector<ASTNode *> TernaryExpr::children() {
-    return {(ASTNode *)cond, (ASTNode *)tru, (ASTNode *)fals};
-}
-
-bool TernaryExpr::operator==(const ASTNode &node) const {
-    if (node.get_kind() != TernaryExpr::kind) {
-        return false;
-    }
-
-    const TernaryExpr &n = (TernaryExpr &) node;
-
-    return (*cond == *(n.cond) && *tru == *(n.tru) && *fals == *(n.fals));
+bool TernaryExpr::each_child(ChildFunc f) {
+    return f((ASTNode *)cond) && f((ASTNode *)tru) && f((ASTNode *)fals);
 }
 
 TypeIdent::TypeIdent(const Location loc, const char * const _id) :
-    Typename(loc), id(std::string(_id)) {}
+    Typename(loc, kind), id(std::string(_id)) {}
+
+TypeIdent::TypeIdent(const Location loc, std::string_view _id) :
+    Typename(loc, kind), id(std::string(_id)) {}
 
 Typename * TypeIdent::clone() const {
     return new TypeIdent(loc, id.c_str());
@@ -349,64 +513,66 @@ void TypeIdent::print() const {
     std::cout << id;
 }
 
-std::vector<ASTNode *> TypeIdent::children() {
-    return {};
+bool TypeIdent::each_child(ChildFunc f) {
+    return true;
 }
 
-bool TypeIdent::operator==(const ASTNode &node) const {
-    if (node.get_kind() != TypeIdent::kind) {
-        return false;
-    }
+bool TypeIdent::same_fields(const ASTNode &node) const {
+    return node.get_kind() == TypeIdent::kind && id == ((TypeIdent &) node).id;
+}
 
-    const TypeIdent &n = (TypeIdent &) node;
+uint64_t TypeIdent::hash_fields(uint64_t seed) const {
+    seed = ASTNode::hash_fields(seed);
 
-    return (id == n.id);
+    return x::hash_bytes(id.c_str(), id.size(), seed);
 }
 
 Ident::Ident(const Location loc, const char * const _id) :
-    CallingExpr(loc), id(std::string(_id)) {}
+    CallingExpr(loc, kind), id(std::string(_id)) {}
+
+Ident::Ident(const Location loc, std::string_view _id) :
+    CallingExpr(loc, kind), id(std::string(_id)) {}
 
 void Ident::print() const {
     std::cout << id;
 }
-std::string Ident::gen_tac(SymbolTable * old_symtable,
-TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const {
-    std::string p_name = *names.get(id);
-    type_table->put_from_symbol(id, p_name, old_symtable);
-    return p_name;
+TacId Ident::gen_tac(SymbolTable * old_symtable,
+TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    TacId p = tac.value(*names.get(id));
+    type_table->put_from_symbol(id, p, old_symtable);
+    return p;
 }
 
-std::vector<ASTNode *> Ident::children() {
-    return {};
+bool Ident::each_child(ChildFunc f) {
+    return true;
 }
 
-bool Ident::operator==(const ASTNode &node) const {
-    if (node.get_kind() != Ident::kind) {
-        return false;
-    }
+bool Ident::same_fields(const ASTNode &node) const {
+    return node.get_kind() == Ident::kind && id == ((Ident &) node).id;
+}
 
-    const Ident &n = (Ident &) node;
+uint64_t Ident::hash_fields(uint64_t seed) const {
+    seed = ASTNode::hash_fields(seed);
 
-    return (id == n.id);
+    return x::hash_bytes(id.c_str(), id.size(), seed);
 }
 
 MathExpr::MathExpr(const Location loc, const char op, const Expr * left, const Expr * right)
-    : Expr(loc), op(op), left(left), right(right) {}
+    : Expr(loc, kind), op(op), left(left), right(right) {}
 
 MathExpr::~MathExpr() {
-    delete left;
-    delete right;
+    x::release(left);
+    x::release(right);
 }
 
-std::string MathExpr::gen_tac(SymbolTable * old_symtable,
-TypeTable * global_symtable, NamesToNames &names, std::vector<Quad *> &instrs) const {
-    std::string l = left->gen_tac(old_symtable, global_symtable, names, instrs);
-    std::string r = right->gen_tac(old_symtable, global_symtable, names, instrs);
-    std::string temp_name = next_t();
-    MathTAC * tac = new MathTAC(temp_name, op, l, r);
-    instrs.push_back(tac);
+TacId MathExpr::gen_tac(SymbolTable * old_symtable,
+TypeTable * global_symtable, NamesToNames &names, TacBuffer &tac) const {
+    TacId l = left->gen_tac(old_symtable, global_symtable, names, tac);
+    TacId r = right->gen_tac(old_symtable, global_symtable, names, tac);
+    TacId temp = tac.value(tac.ctx->next_t());
+    tac.emit_math(temp, op, l, r);
 
-    return temp_name;
+    return temp;
 }
 
 void MathExpr::print() const {
@@ -415,26 +581,26 @@ void MathExpr::print() const {
     right->print();
 }
 
-std::vector<ASTNode *> MathExpr::children() {
-    return {(ASTNode *)left, (ASTNode *)right};
+bool MathExpr::each_child(ChildFunc f) {
+    return f((ASTNode *)left) && f((ASTNode *)right);
 }
 
-bool MathExpr::operator==(const ASTNode &node) const {
-    if (node.get_kind() != MathExpr::kind) {
-        return false;
-    }
+bool MathExpr::same_fields(const ASTNode &node) const {
+    return node.get_kind() == MathExpr::kind && op == ((MathExpr &) node).op;
+}
 
-    const MathExpr &n = (MathExpr &) node;
+uint64_t MathExpr::hash_fields(uint64_t seed) const {
+    seed = ASTNode::hash_fields(seed);
 
-    return (op == n.op && *left == *(n.left) && *right == *(n.right));
+    return x::hash_bytes(&op, sizeof(op), seed);
 }
 
 BoolExpr::BoolExpr(const Location loc, const char * const op, const Expr * left, const Expr * right)
-    : Expr(loc), op(std::string(op)), left(left), right(right) {}
+    : Expr(loc, kind), op(std::string(op)), left(left), right(right) {}
 
 BoolExpr::~BoolExpr() {
-    delete left;
-    delete right;
+    x::release(left);
+    x::release(right);
 }
 
 void BoolExpr::print() const {
@@ -443,25 +609,25 @@ void BoolExpr::print() const {
     right->print();
 }
 
-std::vector<ASTNode *> BoolExpr::children() {
-    return {(ASTNode *)left, (ASTNode *)right};
+bool BoolExpr::each_child(ChildFunc f) {
+    return f((ASTNode *)left) && f((ASTNode *)right);
 }
 
-bool BoolExpr::operator==(const ASTNode &node) const {
-    if (node.get_kind() != BoolExpr::kind) {
-        return false;
-    }
+bool BoolExpr::same_fields(const ASTNode &node) const {
+    return node.get_kind() == BoolExpr::kind && op == ((BoolExpr &) node).op;
+}
 
-    const BoolExpr &n = (BoolExpr &) node;
+uint64_t BoolExpr::hash_fields(uint64_t seed) const {
+    seed = ASTNode::hash_fields(seed);
 
-    return (op == n.op && *left == *(n.left) && *right == *(n.right));
+    return x::hash_bytes(op.c_str(), op.size(), seed);
 }
 
 ParensExpr::ParensExpr(const Location loc, const Expr * expr) :
-    CallingExpr(loc), expr(expr) {}
+    CallingExpr(loc, kind), expr(expr) {}
 
 ParensExpr::~ParensExpr() {
-    delete expr;
+    x::release(expr);
 }
 
 void ParensExpr::print() const {
@@ -470,29 +636,19 @@ void ParensExpr::print() const {
     putchar(')');
 }
 
-std::vector<ASTNode *> ParensExpr::children() {
-    return {(ASTNode *)expr};
-}
-
-bool ParensExpr::operator==(const ASTNode &node) const {
-    if (node.get_kind() != ParensExpr::kind) {
-        return false;
-    }
-
-    const ParensExpr &n = (ParensExpr &) node;
-
-    return (*expr == *(n.expr));
+bool ParensExpr::each_child(ChildFunc f) {
+    return f((ASTNode *)expr);
 }
 
 ParensTypename::ParensTypename(const Location loc, const Typename * name) :
-    Typename(loc), name(name) {}
+    Typename(loc, kind), name(name) {}
 
 Typename * ParensTypename::clone() const {
     return new ParensTypename(loc, name->clone());
 }
 
 ParensTypename::~ParensTypename() {
-    delete name;
+    x::release(name);
 }
 
 void ParensTypename::print() const {
@@ -501,29 +657,19 @@ void ParensTypename::print() const {
     putchar(')');
 }
 
-std::vector<ASTNode *> ParensTypename::children() {
-    return {(ASTNode *)name};
-}
-
-bool ParensTypename::operator==(const ASTNode &node) const {
-    if (node.get_kind() != ParensTypename::kind) {
-        return false;
-    }
-
-    const ParensTypename &n = (ParensTypename &) node;
-
-    return (*name == *(n.name));
+bool ParensTypename::each_child(ChildFunc f) {
+    return f((ASTNode *)name);
 }
 
 PtrTypename::PtrTypename(const Location loc, const Typename * name) :
-    Typename(loc), name(name) {}
+    Typename(loc, kind), name(name) {}
 
 Typename * PtrTypename::clone() const {
     return new PtrTypename(loc, name->clone());
 }
 
 PtrTypename::~PtrTypename() {
-    delete name;
+    x::release(name);
 }
 
 void PtrTypename::print() const {
@@ -531,29 +677,19 @@ void PtrTypename::print() const {
     putchar('*');
 }
 
-std::vector<ASTNode *> PtrTypename::children() {
-    return {(ASTNode *)name};
-}
-
-bool PtrTypename::operator==(const ASTNode &node) const {
-    if (node.get_kind() != PtrTypename::kind) {
-        return false;
-    }
-
-    const PtrTypename &n = (PtrTypename &) node;
-
-    return (*name == *(n.name));
+bool PtrTypename::each_child(ChildFunc f) {
+    return f((ASTNode *)name);
 }
 
 MutTypename::MutTypename(const Location loc, const Typename * name) :
-    Typename(loc), name(name) {}
+    Typename(loc, kind), name(name) {}
 
 Typename * MutTypename::clone() const {
     return new MutTypename(loc, name->clone());
 }
 
 MutTypename::~MutTypename() {
-    delete name;
+    x::release(name);
 }
 
 void MutTypename::print() const {
@@ -561,26 +697,16 @@ void MutTypename::print() const {
     name->print();
 }
 
-std::vector<ASTNode *> MutTypename::children() {
-    return {(ASTNode *)name};
-}
-
-bool MutTypename::operator==(const ASTNode &node) const {
-    if (node.get_kind() != MutTypename::kind) {
-        return false;
-    }
-
-    const MutTypename &n = (MutTypename &) node;
-
-    return (*name == *(n.name));
+bool MutTypename::each_child(ChildFunc f) {
+    return f((ASTNode *)name);
 }
 
 TypenameList::TypenameList(const Location loc, std::vector<Typename *> types) :
-    ASTNode(loc), types(types) {}
+    ASTNode(loc, kind), types(types) {}
 
 TypenameList::~TypenameList() {
     for (auto &type_name : types) {
-        delete type_name;
+        x::release(type_name);
     }
 }
 
@@ -601,26 +727,16 @@ void TypenameList::push_type(Typename * type_name) {
     types.push_back(type_name);
 }
 
-std::vector<ASTNode *> TypenameList::children() {
-    return cast_nodes(types);
-}
-
-bool TypenameList::operator==(const ASTNode &node) const {
-    if (node.get_kind() != TypenameList::kind) {
-        return false;
-    }
-
-    const TypenameList &n = (TypenameList &) node;
-
-    return cmp_vectors(types, n.types);
+bool TypenameList::each_child(ChildFunc f) {
+    return each_node(types, f);
 }
 
 VarDeclList::VarDeclList(const Location loc, std::vector<VarDecl *> decls) :
-    ASTNode(loc), decls(decls) {}
+    ASTNode(loc, kind), decls(decls) {}
 
 VarDeclList::~VarDeclList() {
     for (auto &decl : decls) {
-        delete decl;
+        x::release(decl);
     }
 }
 
@@ -635,22 +751,12 @@ void VarDeclList::push_decl(VarDecl * decl) {
     decls.push_back(decl);
 }
 
-std::vector<ASTNode *> VarDeclList::children() {
-    return cast_nodes(decls);
-}
-
-bool VarDeclList::operator==(const ASTNode &node) const {
-    if (node.get_kind() != VarDeclList::kind) {
-        return false;
-    }
-
-    const VarDeclList &n = (VarDeclList &) node;
-
-    return cmp_vectors(decls, n.decls);
+bool VarDeclList::each_child(ChildFunc f) {
+    return each_node(decls, f);
 }
 
 ExprList::ExprList(const Location loc, std::vector<Expr *> exprs) :
-    ASTNode(loc), exprs(exprs) {}
+    ASTNode(loc, kind), exprs(exprs) {}
 
 ExprList::~ExprList() {
     exprs.clear();
@@ -673,26 +779,16 @@ void ExprList::push_expr(Expr * expr) {
     exprs.push_back(expr);
 }
 
-std::vector<ASTNode *> ExprList::children() {
-    return cast_nodes(exprs);
-}
-
-bool ExprList::operator==(const ASTNode &node) const {
-    if (node.get_kind() != ExprList::kind) {
-        return false;
-    }
-
-    const ExprList &n = (ExprList &) node;
-
-    return cmp_vectors(exprs, n.exprs);
+bool ExprList::each_child(ChildFunc f) {
+    return each_node(exprs, f);
 }
 
 StatementList::StatementList(const Location loc, std::vector<Statement *> statements)
-    : ASTNode(loc), statements(statements) {}
+    : ASTNode(loc, kind), statements(statements) {}
 
 StatementList::~StatementList() {
     for (auto &statement : statements) {
-        delete statement;
+        x::release(statement);
     }
 }
 
@@ -707,54 +803,34 @@ void StatementList::push_statement(Statement * statement) {
     statements.push_back(statement);
 }
 
-std::vector<ASTNode *> StatementList::children() {
-    return cast_nodes(statements);
+bool StatementList::each_child(ChildFunc f) {
+    return each_node(statements, f);
 }
 
-std::string StatementList::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const {
-    std::vector<std::string> local_vars = {};
-    
+TacId StatementList::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    std::vector<TacId> local_vars = {};
+
     for (auto &stmt : statements) {
         if (stmt->get_kind() == VarDecl::kind) {
             const VarDecl * decl = (VarDecl *) stmt;
-            local_vars.push_back(*names.get(decl->var_name->id));
+            local_vars.push_back(tac.value(*names.get(decl->var_name->id)));
         } else if (stmt->get_kind() == VarDeclInit::kind) {
             const VarDeclInit * decl = (VarDeclInit *) stmt;
-            local_vars.push_back(*names.get(decl->decl->var_name->id));
+            local_vars.push_back(tac.value(*names.get(decl->decl->var_name->id)));
         }
 
-        stmt->gen_tac(old_symtable, type_table, names, instrs);
+        stmt->gen_tac(old_symtable, type_table, names, tac);
     }
 
     for (auto &id : local_vars) {
-        instrs.push_back(new DeleteTAC(id));
+        tac.emit_delete(id);
     }
 
-    return "";
+    return TAC_NONE;
 }
 
-bool StatementList::operator==(const ASTNode &node) const {
-    if (node.get_kind() != StatementList::kind) {
-        return false;
-    }
-
-    const StatementList &n = (StatementList &) node;
-
-    return cmp_vectors(statements, n.statements);
-}
-
-TupleTypename::TupleTypename(const Location loc, const TypenameList * type_list, SymbolTable * scope)
-    : Typename(loc), type_list(type_list), offsets({}) {
-        int size = 0;
-        for (size_t i = 0; i < type_list->types.size(); i++) {
-            offsets.push_back(size);
-
-            size += type_list->types[i]->type_size(scope);
-        }
-    }
-
-TupleTypename::TupleTypename(const Location loc, const TypenameList * type_list, const std::vector<int> offsets)
-    : Typename(loc), type_list(type_list), offsets(offsets) {}
+TupleTypename::TupleTypename(const Location loc, const TypenameList * type_list)
+    : Typename(loc, kind), type_list(type_list) {}
 
 Typename * TupleTypename::clone() const {
     std::vector<Typename *> types = {};
@@ -763,11 +839,11 @@ Typename * TupleTypename::clone() const {
         types.push_back(type_name->clone());
     }
 
-    return new TupleTypename(loc, new TypenameList(x::NULL_LOC, types), offsets);
+    return new TupleTypename(loc, new TypenameList(x::NULL_LOC, types));
 }
 
 TupleTypename::~TupleTypename() {
-    delete type_list;
+    x::release(type_list);
 }
 
 void TupleTypename::print() const {
@@ -776,25 +852,15 @@ void TupleTypename::print() const {
     putchar(']');
 }
 
-std::vector<ASTNode *> TupleTypename::children() {
-    return {(ASTNode *)type_list};
-}
-
-bool TupleTypename::operator==(const ASTNode &node) const {
-    if (node.get_kind() != TupleTypename::kind) {
-        return false;
-    }
-
-    const TupleTypename &n = (TupleTypename &) node;
-
-    return (*type_list == *(n.type_list));
+bool TupleTypename::each_child(ChildFunc f) {
+    return f((ASTNode *)type_list);
 }
 
 TupleExpr::TupleExpr(const Location loc, const ExprList * expr_list) :
-    Expr(loc), expr_list(expr_list) {}
+    Expr(loc, kind), expr_list(expr_list) {}
 
 TupleExpr::~TupleExpr() {
-    delete expr_list;
+    x::release(expr_list);
 }
 
 void TupleExpr::print() const {
@@ -803,31 +869,21 @@ void TupleExpr::print() const {
     putchar(']');
 }
 
-std::vector<ASTNode *> TupleExpr::children() {
-    return {(ASTNode *)expr_list};
-}
-
-bool TupleExpr::operator==(const ASTNode &node) const {
-    if (node.get_kind() != TupleExpr::kind) {
-        return false;
-    }
-
-    const TupleExpr &n = (TupleExpr &) node;
-
-    return (*expr_list == *(n.expr_list));
+bool TupleExpr::each_child(ChildFunc f) {
+    return f((ASTNode *)expr_list);
 }
 
 FuncTypename::FuncTypename(const Location loc, const TypenameList * params, const Typename * ret_type, SymbolTable * symtable)
-    : Typename(loc), params(params), offsets({}), ret_type(ret_type) {
+    : Typename(loc, kind), params(params), offsets({}), ret_type(ret_type) {
         int size = 0;
         for (size_t i = 0; i < params->types.size(); i++) {
-            offsets[i] = size;
-            size += params->types[i]->type_size(symtable);
+            offsets.push_back(size);
+            size += (params->types[i]->type_size(symtable) + ADDRESS_WIDTH - 1) / ADDRESS_WIDTH * ADDRESS_WIDTH;
         }
     }
 
 FuncTypename::FuncTypename(const Location loc, const TypenameList * params, const Typename * ret_type, const std::vector<int> offsets) 
-    : Typename(loc), params(params), offsets(offsets), ret_type(ret_type) {};
+    : Typename(loc, kind), params(params), offsets(offsets), ret_type(ret_type) {};
 
 Typename * FuncTypename::clone() const {
     const Typename * ret_clone = ret_type->clone();
@@ -841,8 +897,8 @@ Typename * FuncTypename::clone() const {
 }
 
 FuncTypename::~FuncTypename() {
-    delete params;
-    delete ret_type;
+    x::release(params);
+    x::release(ret_type);
 }
 
 void FuncTypename::print() const {
@@ -852,31 +908,21 @@ void FuncTypename::print() const {
     ret_type->print();
 }
 
-std::vector<ASTNode *> FuncTypename::children() {
-    return {(ASTNode *)params, (ASTNode *)ret_type};
-}
-
-bool FuncTypename::operator==(const ASTNode &node) const {
-    if (node.get_kind() != FuncTypename::kind) {
-        return false;
-    }
-
-    const FuncTypename &n = (FuncTypename &) node;
-
-    return (*params == *(n.params) && *ret_type == *(n.ret_type));
+bool FuncTypename::each_child(ChildFunc f) {
+    return f((ASTNode *)params) && f((ASTNode *)ret_type);
 }
 
 StaticArrayTypename::StaticArrayTypename(const Location loc, const Typename * element_type,
         const IntLiteral * size)
-    : Typename(loc), element_type(element_type), size(size) {}
+    : Typename(loc, kind), element_type(element_type), size(size) {}
 
 Typename * StaticArrayTypename::clone() const {
     return new StaticArrayTypename(loc, element_type->clone(), new IntLiteral(size->loc, size->value));
 }
 
 StaticArrayTypename::~StaticArrayTypename() {
-    delete element_type;
-    delete size;
+    x::release(element_type);
+    x::release(size);
 }
 
 void StaticArrayTypename::print() const {
@@ -886,26 +932,16 @@ void StaticArrayTypename::print() const {
     putchar(']');
 }
 
-std::vector<ASTNode *> StaticArrayTypename::children() {
-    return {(ASTNode *)element_type, (ASTNode *)size};
-}
-
-bool StaticArrayTypename::operator==(const ASTNode &node) const {
-    if (node.get_kind() != StaticArrayTypename::kind) {
-        return false;
-    }
-
-    const StaticArrayTypename &n = (StaticArrayTypename &) node;
-
-    return (*element_type == *(n.element_type) && *size == *(n.size));
+bool StaticArrayTypename::each_child(ChildFunc f) {
+    return f((ASTNode *)element_type) && f((ASTNode *)size);
 }
 
 TypeAlias::TypeAlias(const Location loc, const Ident * name, const Typename * type_expr)
-    : TypeDecl(loc), name(name), type_expr(type_expr) {}
+    : TypeDecl(loc, kind), name(name), type_expr(type_expr) {}
 
 TypeAlias::~TypeAlias() {
-    delete name;
-    delete type_expr;
+    x::release(name);
+    x::release(type_expr);
 }
 
 void TypeAlias::print() const {
@@ -915,28 +951,12 @@ void TypeAlias::print() const {
     type_expr->print();
 }
 
-std::vector<ASTNode *> TypeAlias::children() {
-    return {(Typename *)name, (ASTNode *)type_expr};
-}
-
-bool TypeAlias::operator==(const ASTNode &node) const {
-    if (node.get_kind() != TypeAlias::kind) {
-        return false;
-    }
-
-    const TypeAlias &n = (TypeAlias &) node;
-
-    return (*name == *(n.name) && *type_expr == *(n.type_expr));
+bool TypeAlias::each_child(ChildFunc f) {
+    return f((Typename *)name) && f((ASTNode *)type_expr);
 }
 
 StructTypename::StructTypename(const Location loc, const VarDeclList * members, SymbolTable * scope)
-    : Typename(loc), members(members), offsets({}), scope(scope) {
-        size_t size = 0;
-        for (size_t i = 0; i < members->decls.size(); i++) {
-            offsets.push_back(size);
-            size += members->decls[i]->type_name->type_size(scope);
-        }
-    }
+    : Typename(loc, kind), members(members), scope(scope), packed(false) {}
 
 Typename * StructTypename::clone() const {
     std::vector<VarDecl *> members_clone = {};
@@ -948,39 +968,42 @@ Typename * StructTypename::clone() const {
         members_clone.push_back(new VarDecl(member->loc, type_name_clone, var_name_clone));
     }
 
-    return new StructTypename(loc, new VarDeclList(members->loc, members_clone), scope);
+    StructTypename * out = new StructTypename(loc, new VarDeclList(members->loc, members_clone), scope);
+    out->packed = packed;
+
+    return out;
 }
 
 StructTypename::~StructTypename() {
-    delete members;
+    x::release(members);
 }
 
 void StructTypename::print() const {
-    printf("{\n");
+    printf(packed ? "packed {\n" : "{\n");
     members->print();
     printf("};\n");
 }
 
-std::vector<ASTNode *> StructTypename::children() {
-    return {(ASTNode *)members};
+bool StructTypename::each_child(ChildFunc f) {
+    return f((ASTNode *)members);
 }
 
-bool StructTypename::operator==(const ASTNode &node) const {
-    if (node.get_kind() != StructTypename::kind) {
-        return false;
-    }
+bool StructTypename::same_fields(const ASTNode &node) const {
+    return node.get_kind() == StructTypename::kind && packed == ((StructTypename &) node).packed;
+}
 
-    const StructTypename &n = (StructTypename &) node;
+uint64_t StructTypename::hash_fields(uint64_t seed) const {
+    seed = ASTNode::hash_fields(seed);
 
-    return (*members == *(n.members));
+    return x::hash_bytes(&packed, sizeof(packed), seed);
 }
 
 StructDecl::StructDecl(const Location loc, const Ident * name, const StructTypename * defn)
-    : TypeDecl(loc), name(name), defn(defn) {}
+    : TypeDecl(loc, kind), name(name), defn(defn) {}
 
 StructDecl::~StructDecl() {
-    delete name;
-    delete defn;
+    x::release(name);
+    x::release(defn);
 }
 
 void StructDecl::print() const {
@@ -990,26 +1013,16 @@ void StructDecl::print() const {
     defn->print();
 }
 
-std::vector<ASTNode *> StructDecl::children() {
-    return {(Expr *)name, (ASTNode *)defn};
-}
-
-bool StructDecl::operator==(const ASTNode &node) const {
-    if (node.get_kind() != StructDecl::kind) {
-        return false;
-    }
-
-    const StructDecl &n = (StructDecl &) node;
-
-    return (*name == *(n.name) && *defn == *(n.defn));
+bool StructDecl::each_child(ChildFunc f) {
+    return f((Expr *)name) && f((ASTNode *)defn);
 }
 
 VarDecl::VarDecl(const Location loc, const Typename * type_name, const Ident * var_name)
-    : Statement(loc), type_name(type_name), var_name(var_name) {}
+    : Statement(loc, kind), type_name(type_name), var_name(var_name) {}
 
 VarDecl::~VarDecl() {
-    delete type_name;
-    delete var_name;
+    x::release(type_name);
+    x::release(var_name);
 }
 
 void VarDecl::print() const {
@@ -1024,31 +1037,16 @@ void VarDecl::add_to_scope(SymbolTable * symtable) {
     }));
 }
 
-std::vector<ASTNode *> VarDecl::children() {
-    return {(ASTNode *)type_name, (Expr *)var_name};
-}
-
-bool VarDecl::operator==(const ASTNode &node) const {
-    if (node.get_kind() != VarDecl::kind) {
-        return false;
-    }
-
-    const VarDecl &n = (VarDecl &) node;
-
-    return (*type_name == *(n.type_name) && *var_name == *(n.var_name));
+bool VarDecl::each_child(ChildFunc f) {
+    return f((ASTNode *)type_name) && f((Expr *)var_name);
 }
 
 VarDeclInit::VarDeclInit(const Location loc, const VarDecl * decl, const Expr * init)
-    : Statement(loc), decl(decl), init(init) {}
+    : Statement(loc, kind), decl(decl), init(init) {}
 
 VarDeclInit::~VarDeclInit() {
-    delete decl;
-    delete init;
-}
-
-
-std::string VarDeclInit::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> instrs) const {
-    return "";
+    x::release(decl);
+    x::release(init);
 }
 
 void VarDeclInit::print() const {
@@ -1057,41 +1055,31 @@ void VarDeclInit::print() const {
     init->print();
 }
 
-std::vector<ASTNode *> VarDeclInit::children() {
-    return {(ASTNode *)decl, (ASTNode *)init};
+bool VarDeclInit::each_child(ChildFunc f) {
+    return f((ASTNode *)decl) && f((ASTNode *)init);
 }
 
-std::string VarDeclInit::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const {
-    std::string init_name = init->gen_tac(old_symtable, type_table, names, instrs);
-    std::string var_name = decl->var_name->gen_tac(old_symtable, type_table, names, instrs);
+TacId VarDeclInit::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    TacId init_id = init->gen_tac(old_symtable, type_table, names, tac);
+    TacId var_id = decl->var_name->gen_tac(old_symtable, type_table, names, tac);
 
-    instrs.push_back(new AssignTAC(var_name, init_name));
+    tac.emit_assign(var_id, init_id);
 
-    return "";
-}
-
-bool VarDeclInit::operator==(const ASTNode &node) const {
-    if (node.get_kind() != VarDeclInit::kind) {
-        return false;
-    }
-
-    const VarDeclInit &n = (VarDeclInit &) node;
-
-    return (*decl == *(n.decl) && *init == *(n.init));
+    return TAC_NONE;
 }
 
 ArrayLiteral::ArrayLiteral(const Location loc, const ExprList * items) :
-    Expr(loc), items(items) {}
+    Expr(loc, kind), items(items) {}
 
 ArrayLiteral::~ArrayLiteral() {
-    delete items;
+    x::release(items);
 }
 
-std::string ArrayLiteral::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> instrs) const {
+TacId ArrayLiteral::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
     for (auto & expr : items->exprs) {
-        expr->gen_tac(old_symtable, type_table, names, instrs);
+        expr->gen_tac(old_symtable, type_table, names, tac);
     }
-    return "";
+    return TAC_NONE;
 }
 
 void ArrayLiteral::print() const {
@@ -1100,43 +1088,30 @@ void ArrayLiteral::print() const {
     putchar('}');
 }
 
-std::vector<ASTNode *> ArrayLiteral::children() {
-    return {(ASTNode *)items};
-}
-
-bool ArrayLiteral::operator==(const ASTNode &node) const {
-    if (node.get_kind() != ArrayLiteral::kind) {
-        return false;
-    }
-
-    const ArrayLiteral &n = (ArrayLiteral &) node;
-
-    return (*items == *(n.items));
+bool ArrayLiteral::each_child(ChildFunc f) {
+    return f((ASTNode *)items);
 }
 
-std::string IfStmt::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const {
-    std::string cond_var = cond->gen_tac(old_symtable, type_table, names, instrs);
-    std::string label = next_l();
-    CmpLiteralTAC * cmp = new CmpLiteralTAC(cond_var, 1);
-    JneTAC * jne = new JneTAC(label);
-    instrs.push_back(cmp);
-    instrs.push_back(jne);
+TacId IfStmt::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    TacId cond_var = cond->gen_tac(old_symtable, type_table, names, tac);
+    TacLabel label = tac.label(tac.ctx->next_l());
+    tac.emit_cmp_literal(cond_var, 1);
+    tac.emit_jne(label);
 
-    NamesToNames block_names = x::symtable_to_names(&names, scope);
+    NamesToNames block_names = x::symtable_to_names(tac.ctx, &names, scope);
 
-    then->gen_tac(scope, type_table, block_names, instrs);
-    LabelTAC * label_tac = new LabelTAC(label);
-    instrs.push_back(label_tac);
+    then->gen_tac(scope, type_table, block_names, tac);
+    tac.emit_label(label);
 
-    return "";
+    return TAC_NONE;
 }
 
 IfStmt::IfStmt(const Location loc, const Expr * cond, const StatementList * then, SymbolTable * scope)
-    : Statement(loc), cond(cond), then(then), scope(scope) {}
+    : Statement(loc, kind), cond(cond), then(then), scope(scope) {}
 
 IfStmt::~IfStmt() {
-    delete cond;
-    delete then;
+    x::release(cond);
+    x::release(then);
     delete scope;
 }
 
@@ -1148,26 +1123,16 @@ void IfStmt::print() const {
     printf("}");
 }
 
-std::vector<ASTNode *> IfStmt::children() {
-    return {(ASTNode *)cond, (ASTNode *)then};
-}
-
-bool IfStmt::operator==(const ASTNode &node) const {
-    if (node.get_kind() != IfStmt::kind) {
-        return false;
-    }
-
-    const IfStmt &n = (IfStmt &) node;
-
-    return (*cond == *(n.cond) && *then == *(n.then));
+bool IfStmt::each_child(ChildFunc f) {
+    return f((ASTNode *)cond) && f((ASTNode *)then);
 }
 
 IfElseStmt::IfElseStmt(const Location loc, const IfStmt * if_stmt, const StatementList * els, SymbolTable * scope)
-    : Statement(loc), if_stmt(if_stmt), els(els), scope(scope) {}
+    : Statement(loc, kind), if_stmt(if_stmt), els(els), scope(scope) {}
 
 IfElseStmt::~IfElseStmt() {
-    delete if_stmt;
-    delete els;
+    x::release(if_stmt);
+    x::release(els);
     delete scope;
 }
 
@@ -1178,30 +1143,19 @@ void IfElseStmt::print() const {
     printf("}");
 }
 
-std::vector<ASTNode *> IfElseStmt::children() {
-    return {(ASTNode *)if_stmt, (ASTNode *)els};
-}
-
-bool IfElseStmt::operator==(const ASTNode &node) const {
-    if (node.get_kind() != IfElseStmt::kind) {
-        return false;
-    }
-
-    const IfElseStmt &n = (IfElseStmt &) node;
-
-    return (*if_stmt == *(n.if_stmt) && *els == *(n.els));
+bool IfElseStmt::each_child(ChildFunc f) {
+    return f((ASTNode *)if_stmt) && f((ASTNode *)els);
 }
 
 WhileStmt::WhileStmt(const Location loc, const Expr * cond, const StatementList * body, SymbolTable * scope)
-    : Statement(loc), cond(cond), body(body), scope(scope) {}
+    : Statement(loc, kind), cond(cond), body(body), scope(scope) {}
 
 WhileStmt::~WhileStmt() {
-    delete cond;
-    delete body;
+    x::release(cond);
+    x::release(body);
     delete scope;
 }
 
-
 void WhileStmt::print() const {
     printf("while (");
     cond->print();
@@ -1210,50 +1164,36 @@ void WhileStmt::print() const {
     printf("};\n");
 }
 
-std::string WhileStmt::gen_tac(SymbolTable * old_symtable,
-TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const {
-    std::string cond_var = cond->gen_tac(old_symtable, type_table, names, instrs);
-    std::string true_label = next_l();
-    std::string false_label = next_l();
-    LabelTAC * true_label_tac = new LabelTAC(true_label);
-    CmpLiteralTAC * cmp = new CmpLiteralTAC(cond_var, 1);
-    JneTAC * jne = new JneTAC(false_label);
-    instrs.push_back(true_label_tac);
-    instrs.push_back(cmp);
-    instrs.push_back(jne);
+TacId WhileStmt::gen_tac(SymbolTable * old_symtable,
+TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    TacId cond_var = cond->gen_tac(old_symtable, type_table, names, tac);
+    TacLabel true_label = tac.label(tac.ctx->next_l());
+    TacLabel false_label = tac.label(tac.ctx->next_l());
+    tac.emit_label(true_label);
+    tac.emit_cmp_literal(cond_var, 1);
+    tac.emit_jne(false_label);
 
-    NamesToNames block_names = x::symtable_to_names(&names, scope);
-    body->gen_tac(scope, type_table, block_names, instrs);
+    NamesToNames block_names = x::symtable_to_names(tac.ctx, &names, scope);
+    body->gen_tac(scope, type_table, block_names, tac);
 
-    LabelTAC * false_label_tac = new LabelTAC(false_label);
-    instrs.push_back(false_label_tac);
+    tac.emit_label(false_label);
 
-    return "";
+    return TAC_NONE;
 }
 
-std::vector<ASTNode *> WhileStmt::children() {
-    return {(ASTNode *)cond, (ASTNode *)body};
-}
-
-bool WhileStmt::operator==(const ASTNode &node) const {
-    if (node.get_kind() != WhileStmt::kind) {
-        return false;
-    }
-
-    const WhileStmt &n = (WhileStmt &) node;
-
-    return (*cond == *(n.cond) && *body == *(n.body));
+bool WhileStmt::each_child(ChildFunc f) {
+    return f((ASTNode *)cond) && f((ASTNode *)body);
 }
 
 ForStmt::ForStmt(const Location loc, const Statement * init, const Expr * cond,
                  const Statement * update, const StatementList * body, SymbolTable * scope)
-    : Statement(loc), init(init), condition(cond), update(update), body(body), scope(scope) {}
+    : Statement(loc, kind), init(init), condition(cond), update(update), body(body), scope(scope) {}
 
 ForStmt::~ForStmt() {
-    delete init;
-    delete condition;
-    delete update;
-    delete body;
+    x::release(init);
+    x::release(condition);
+    x::release(update);
+    x::release(body);
     delete scope;
 }
 
@@ -1269,50 +1209,37 @@ void ForStmt::print() const {
     printf("}");
 }
 
-std::string ForStmt::gen_tac(SymbolTable * old_symtable,
-TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const {
-    NamesToNames block_names = x::symtable_to_names(&names, scope);
-
-    std::string cond_label = next_l();
-    LabelTAC * cond_label_tac = new LabelTAC(cond_label);
-    std::string exit_label = next_l();
-    LabelTAC * exit_label_tac = new LabelTAC(exit_label);
+TacId ForStmt::gen_tac(SymbolTable * old_symtable,
+TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    NamesToNames block_names = x::symtable_to_names(tac.ctx, &names, scope);
 
-    init->gen_tac(scope, type_table, block_names, instrs);
+    TacLabel cond_label = tac.label(tac.ctx->next_l());
+    TacLabel exit_label = tac.label(tac.ctx->next_l());
 
-    instrs.push_back(cond_label_tac);
-    std::string cond_var = condition->gen_tac(scope, type_table, block_names, instrs);
+    init->gen_tac(scope, type_table, block_names, tac);
 
-    instrs.push_back(new CmpLiteralTAC(cond_var, 1));
-    instrs.push_back(new JneTAC(exit_label));
+    tac.emit_label(cond_label);
+    TacId cond_var = condition->gen_tac(scope, type_table, block_names, tac);
 
-    body->gen_tac(scope, type_table, block_names, instrs);
-    update->gen_tac(scope, type_table, block_names, instrs);
+    tac.emit_cmp_literal(cond_var, 1);
+    tac.emit_jne(exit_label);
 
-    instrs.push_back(exit_label_tac);
-    return "";
-}
+    body->gen_tac(scope, type_table, block_names, tac);
+    update->gen_tac(scope, type_table, block_names, tac);
 
-std::vector<ASTNode *> ForStmt::children() {
-    return {(ASTNode *)init, (ASTNode *)condition, (ASTNode *)update,
-            (ASTNode *)body};
+    tac.emit_label(exit_label);
+    return TAC_NONE;
 }
 
-bool ForStmt::operator==(const ASTNode &node) const {
-    if (node.get_kind() != ForStmt::kind) {
-        return false;
-    }
-
-    const ForStmt &n = (ForStmt &) node;
-
-    return (*init == *(n.init) && *condition == *(n.condition) && *update == *(n.update) && *body == *(n.body));
+bool ForStmt::each_child(ChildFunc f) {
+    return f((ASTNode *)init) && f((ASTNode *)condition) && f((ASTNode *)update) && f((ASTNode *)body);
 }
 
 AddrOf::AddrOf(const Location loc, const Expr * expr) :
-    Expr(loc), expr(expr) {}
+    Expr(loc, kind), expr(expr) {}
 
 AddrOf::~AddrOf() {
-    delete expr;
+    x::release(expr);
 }
 
 void AddrOf::print() const {
@@ -1320,25 +1247,15 @@ void AddrOf::print() const {
     expr->print();
 }
 
-std::vector<ASTNode *> AddrOf::children() {
-    return {(ASTNode *)expr};
-}
-
-bool AddrOf::operator==(const ASTNode &node) const {
-    if (node.get_kind() != AddrOf::kind) {
-        return false;
-    }
-
-    const AddrOf &n = (AddrOf &) node;
-
-    return (*expr == *(n.expr));
+bool AddrOf::each_child(ChildFunc f) {
+    return f((ASTNode *)expr);
 }
 
 Deref::Deref(const Location loc, const Expr * expr) :
-    Expr(loc), expr(expr) {}
+    Expr(loc, kind), expr(expr) {}
 
 Deref::~Deref() {
-    delete expr;
+    x::release(expr);
 }
 
 void Deref::print() const {
@@ -1346,26 +1263,16 @@ void Deref::print() const {
     expr->print();
 }
 
-std::vector<ASTNode *> Deref::children() {
-    return {(ASTNode *)expr};
-}
-
-bool Deref::operator==(const ASTNode &node) const {
-    if (node.get_kind() != Deref::kind) {
-        return false;
-    }
-
-    const Deref &n = (Deref &) node;
-
-    return (*expr == *(n.expr));
+bool Deref::each_child(ChildFunc f) {
+    return f((ASTNode *)expr);
 }
 
 CastExpr::CastExpr(const Location loc, const Typename * dest_type, const Expr * expr)
-    : Expr(loc), dest_type(dest_type), expr(expr) {}
+    : Expr(loc, kind), dest_type(dest_type), expr(expr) {}
 
 CastExpr::~CastExpr() {
-    delete dest_type;
-    delete expr;
+    x::release(dest_type);
+    x::release(expr);
 }
 
 void CastExpr::print() const {
@@ -1374,26 +1281,16 @@ void CastExpr::print() const {
     dest_type->print();
 }
 
-std::vector<ASTNode *> CastExpr::children() {
-    return {(ASTNode *)dest_type, (ASTNode *)expr};
-}
-
-bool CastExpr::operator==(const ASTNode &node) const {
-    if (node.get_kind() != CastExpr::kind) {
-        return false;
-    }
-
-    const CastExpr &n = (CastExpr &) node;
-
-    return (*dest_type == *(n.dest_type) && *expr == *(n.expr));
+bool CastExpr::each_child(ChildFunc f) {
+    return f((ASTNode *)dest_type) && f((ASTNode *)expr);
 }
 
 LogicalExpr::LogicalExpr(const Location loc, const char * const op, const Expr * l, const Expr * r)
-    : Expr(loc), op(std::string(op)), left(l), right(r) {}
+    : Expr(loc, kind), op(std::string(op)), left(l), right(r) {}
 
 LogicalExpr::~LogicalExpr() {
-    delete left;
-    delete right;
+    x::release(left);
+    x::release(right);
 }
 
 void LogicalExpr::print() const {
@@ -1402,37 +1299,36 @@ void LogicalExpr::print() const {
     right->print();
 }
 
-std::string LogicalExpr::gen_tac(SymbolTable * old_symtable,
-TypeTable * global_symtable, NamesToNames &names, std::vector<Quad *> &instrs) const {
-    std::string l = left->gen_tac(old_symtable, global_symtable, names, instrs);
-    std::string r = right->gen_tac(old_symtable, global_symtable, names, instrs);
-    std::string temp_name = next_t();
-    LogicalTAC * tac = new LogicalTAC(temp_name, op, l, r);
-    instrs.push_back(tac);
+TacId LogicalExpr::gen_tac(SymbolTable * old_symtable,
+TypeTable * global_symtable, NamesToNames &names, TacBuffer &tac) const {
+    TacId l = left->gen_tac(old_symtable, global_symtable, names, tac);
+    TacId r = right->gen_tac(old_symtable, global_symtable, names, tac);
+    TacId temp = tac.value(tac.ctx->next_t());
+    tac.emit_logical(temp, x::logical_op(op), l, r);
 
-    return temp_name;
+    return temp;
 }
 
-std::vector<ASTNode *> LogicalExpr::children() {
-    return {(ASTNode *)left, (ASTNode *)right};
+bool LogicalExpr::each_child(ChildFunc f) {
+    return f((ASTNode *)left) && f((ASTNode *)right);
 }
 
-bool LogicalExpr::operator==(const ASTNode &node) const {
-    if (node.get_kind() != LogicalExpr::kind) {
-        return false;
-    }
+bool LogicalExpr::same_fields(const ASTNode &node) const {
+    return node.get_kind() == LogicalExpr::kind && op == ((LogicalExpr &) node).op;
+}
 
-    const LogicalExpr &n = (LogicalExpr &) node;
+uint64_t LogicalExpr::hash_fields(uint64_t seed) const {
+    seed = ASTNode::hash_fields(seed);
 
-    return (op == n.op && *left == *(n.left) && *right == *(n.right));
+    return x::hash_bytes(op.c_str(), op.size(), seed);
 }
 
 FunctionCallExpr::FunctionCallExpr(const Location loc, const CallingExpr * func, const ExprList * args)
-    : CallingExpr(loc), func(func), args(args) {}
+    : CallingExpr(loc, kind), func(func), args(args) {}
 
 FunctionCallExpr::~FunctionCallExpr() {
-    delete func;
-    delete args;
+    x::release(func);
+    x::release(args);
 }
 
 void FunctionCallExpr::print() const {
@@ -1442,44 +1338,32 @@ void FunctionCallExpr::print() const {
     putchar(')');
 }
 
-std::vector<ASTNode *> FunctionCallExpr::children() {
-    return {(ASTNode *)func, (ASTNode *)args};
+bool FunctionCallExpr::each_child(ChildFunc f) {
+    return f((ASTNode *)func) && f((ASTNode *)args);
 }
 
-std::string FunctionCallExpr::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const {
-    std::string func_var = func->gen_tac(old_symtable, type_table, names, instrs);
+TacId FunctionCallExpr::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    TacId func_var = func->gen_tac(old_symtable, type_table, names, tac);
 
     for (auto &arg : args->exprs) {
-        std::string temp_var = arg->gen_tac(old_symtable, type_table, names, instrs);
-        instrs.push_back(new PushTAC(temp_var));
+        TacId temp_var = arg->gen_tac(old_symtable, type_table, names, tac);
+        tac.emit_push(temp_var);
     }
 
-    CallTAC * call = new CallTAC(func_var);
-    std::string id = next_t();
-    RetvalTAC * retval = new RetvalTAC(id);
+    TacId id = tac.value(tac.ctx->next_t());
 
-    instrs.push_back(call);
-    instrs.push_back(retval);
+    tac.emit_call(func_var);
+    tac.emit_retval(id);
 
     return id;
 }
 
-bool FunctionCallExpr::operator==(const ASTNode &node) const {
-    if (node.get_kind() != FunctionCallExpr::kind) {
-        return false;
-    }
-
-    const FunctionCallExpr &n = (FunctionCallExpr &) node;
-
-    return (*func == *(n.func) && *args == *(n.args));
-}
-
 FunctionCallStmt::FunctionCallStmt(const Location loc, const CallingExpr * func, const ExprList * args)
-    : Statement(loc), func(func), args(args) {}
+    : Statement(loc, kind), func(func), args(args) {}
 
 FunctionCallStmt::~FunctionCallStmt() {
-    delete func;
-    delete args;
+    x::release(func);
+    x::release(args);
 }
 
 void FunctionCallStmt::print() const {
@@ -1489,36 +1373,25 @@ void FunctionCallStmt::print() const {
     putchar(')');
 }
 
-std::vector<ASTNode *> FunctionCallStmt::children() {
-    return {(ASTNode *)func, (ASTNode *)args};
+bool FunctionCallStmt::each_child(ChildFunc f) {
+    return f((ASTNode *)func) && f((ASTNode *)args);
 }
 
-std::string FunctionCallStmt::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const {
-    std::string func_var = func->gen_tac(old_symtable, type_table, names, instrs);
+TacId FunctionCallStmt::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    TacId func_var = func->gen_tac(old_symtable, type_table, names, tac);
 
     for (auto &arg : args->exprs) {
-        std::string temp_var = arg->gen_tac(old_symtable, type_table, names, instrs);
-        instrs.push_back(new PushTAC(temp_var));
-    }
-
-    CallTAC * call = new CallTAC(func_var);
-    instrs.push_back(call);
-
-    return "";
-}
-
-bool FunctionCallStmt::operator==(const ASTNode &node) const {
-    if (node.get_kind() != FunctionCallStmt::kind) {
-        return false;
+        TacId temp_var = arg->gen_tac(old_symtable, type_table, names, tac);
+        tac.emit_push(temp_var);
     }
 
-    const FunctionCallStmt &n = (FunctionCallStmt &) node;
+    tac.emit_call(func_var);
 
-    return (*func == *(n.func) && *args == *(n.args));
+    return TAC_NONE;
 }
 
 ParamsList::ParamsList(const Location loc, std::vector<VarDecl *> params) :
-    ASTNode(loc), params(params) {}
+    ASTNode(loc, kind), params(params) {}
 
 ParamsList::~ParamsList() {
     params.clear();
@@ -1547,58 +1420,55 @@ void ParamsList::add_to_scope(SymbolTable * symtable) {
     }
 }
 
-std::vector<ASTNode *> ParamsList::children() {
-    return cast_nodes(params);
-}
-
-bool ParamsList::operator==(const ASTNode &node) const {
-    if (node.get_kind() != ParamsList::kind) {
-        return false;
-    }
-
-    const ParamsList &n = (ParamsList &) node;
-
-    return cmp_vectors(params, n.params);
+bool ParamsList::each_child(ChildFunc f) {
+    return each_node(params, f);
 }
 
 FuncDecl::FuncDecl(const Location loc, const Ident * name, const ParamsList * params,
                    const Typename * ret_type, const StatementList * body, SymbolTable * scope)
-    : ASTNode(loc), name(name), params(params), ret_type(ret_type), body(body), scope(scope), forward_decl(nullptr) {}
+    : ASTNode(loc, kind), name(name), params(params), ret_type(ret_type), body(body), scope(scope), forward_decl(nullptr) {}
 
 FuncDecl::~FuncDecl() {
-    delete name;
-    delete params;
-    delete ret_type;
-    delete body;
+    x::release(name);
+    x::release(params);
+    x::release(ret_type);
+    x::release(body);
     delete scope;
 }
 
-std::string FuncDecl::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const {
-    NamesToNames block_names = x::symtable_to_names(&names, scope);
+void FuncDecl::release_body() {
+    x::release(body);
+    delete scope;
+    body = nullptr;
+    scope = nullptr;
+}
+
+TacId FuncDecl::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    NamesToNames block_names = x::symtable_to_names(tac.ctx, &names, scope);
 
     std::string this_name = *names.get(name->id);
+    TacId this_id = tac.value(this_name);
 
-    type_table->put(this_name, this->type_of(old_symtable));
+    type_table->put(this_id, this->type_of(old_symtable));
 
-    instrs.push_back(new LabelTAC(this_name));
-    instrs.push_back(new SetupStackTAC());
+    tac.emit_label(tac.label(this_name));
+    tac.emit_setup_stack();
 
     for (size_t i = 0; i < params->params.size(); i++) {
         VarDecl * decl = params->params[i];
-        std::string param_name = decl->var_name->gen_tac(scope, type_table, block_names, instrs);
-        ArgTAC * tac = new ArgTAC(param_name, i, this_name);
-        instrs.push_back(tac);
+        TacId param_id = decl->var_name->gen_tac(scope, type_table, block_names, tac);
+        tac.emit_arg(param_id, i, this_id);
     }
 
-    body->gen_tac(scope, type_table, block_names, instrs);
+    body->gen_tac(scope, type_table, block_names, tac);
 
     const int last_stmt_kind = body->statements[body->statements.size() - 1]->get_kind();
 
     if (last_stmt_kind != ReturnStatement::kind && (last_stmt_kind != VoidReturnStmt::kind || last_stmt_kind != PleaseReturnStmt::kind)) {
-        instrs.push_back(new VoidReturnTAC());
+        tac.emit_void_return();
     }
 
-    return "";
+    return TAC_NONE;
 };
 
 void FuncDecl::print() const {
@@ -1612,23 +1482,12 @@ void FuncDecl::print() const {
     printf("}\n");
 }
 
-std::vector<ASTNode *> FuncDecl::children() {
-    return {(Expr *)name, (ASTNode *)params, (ASTNode *)ret_type,
-            (ASTNode *)body};
-}
-
-bool FuncDecl::operator==(const ASTNode &node) const {
-    if (node.get_kind() != FuncDecl::kind) {
-        return false;
-    }
-
-    const FuncDecl &n = (FuncDecl &) node;
-
-    return (*name == *(n.name) && *params == *(n.params) && *ret_type == *(n.ret_type) && *body == *(n.body));
+bool FuncDecl::each_child(ChildFunc f) {
+    return f((Expr *)name) && f((ASTNode *)params) && f((ASTNode *)ret_type) && f((ASTNode *)body);
 }
 
 ProgramSource::ProgramSource(const Location loc, std::string name, std::vector<ASTNode *> nodes) :
-    ASTNode(loc), name(name), nodes(nodes) {}
+    ASTNode(loc, kind), name(name), nodes(nodes) {}
 
 ProgramSource::~ProgramSource() {
     nodes.clear();
@@ -1645,25 +1504,15 @@ void ProgramSource::add_node(ASTNode * node) {
     nodes.push_back(node);
 }
 
-std::vector<ASTNode *> ProgramSource::children() {
-    return nodes;
-}
-
-bool ProgramSource::operator==(const ASTNode &node) const {
-    if (node.get_kind() != ProgramSource::kind) {
-        return false;
-    }
-
-    const ProgramSource &n = (ProgramSource &) node;
-
-    return cmp_vectors(nodes, n.nodes);
+bool ProgramSource::each_child(ChildFunc f) {
+    return each_node(nodes, f);
 }
 
 ReturnStatement::ReturnStatement(const Location loc, const Expr * val) :
-    Statement(loc), val(val) {}
+    Statement(loc, kind), val(val) {}
 
 ReturnStatement::~ReturnStatement() {
-    delete val;
+    x::release(val);
 }
 
 void ReturnStatement::print() const {
@@ -1671,33 +1520,23 @@ void ReturnStatement::print() const {
     val->print();
 }
 
-std::vector<ASTNode *> ReturnStatement::children() {
-    return {(ASTNode *)val};
+bool ReturnStatement::each_child(ChildFunc f) {
+    return f((ASTNode *)val);
 }
 
-std::string ReturnStatement::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const {
-    std::string name = val->gen_tac(old_symtable, type_table, names, instrs);
-    instrs.push_back(new ReturnTAC(name));
+TacId ReturnStatement::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    TacId id = val->gen_tac(old_symtable, type_table, names, tac);
+    tac.emit_return(id);
 
-    return "";
-}
-
-bool ReturnStatement::operator==(const ASTNode &node) const {
-    if (node.get_kind() != ReturnStatement::kind) {
-        return false;
-    }
-
-    const ReturnStatement &n = (ReturnStatement &) node;
-
-    return (*val == *(n.val));
+    return TAC_NONE;
 }
 
 Assignment::Assignment(const Location loc, const Expr * lhs, const Expr * rhs) :
-    Statement(loc), lhs(lhs), rhs(rhs) {}
+    Statement(loc, kind), lhs(lhs), rhs(rhs) {}
 
 Assignment::~Assignment() {
-    delete lhs;
-    delete rhs;
+    x::release(lhs);
+    x::release(rhs);
 }
 
 void Assignment::print() const {
@@ -1706,34 +1545,24 @@ void Assignment::print() const {
     rhs->print();
 }
 
-std::vector<ASTNode *> Assignment::children() {
-    return {(ASTNode *)lhs, (ASTNode *)rhs};
-}
-
-std::string Assignment::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const {
-    std::string lhs_name = lhs->gen_tac(old_symtable, type_table, names, instrs);
-    std::string rhs_name = rhs->gen_tac(old_symtable, type_table, names, instrs);
-
-    instrs.push_back(new AssignTAC(lhs_name, rhs_name));
-    
-    return "";
+bool Assignment::each_child(ChildFunc f) {
+    return f((ASTNode *)lhs) && f((ASTNode *)rhs);
 }
 
-bool Assignment::operator==(const ASTNode &node) const {
-    if (node.get_kind() != Assignment::kind) {
-        return false;
-    }
+TacId Assignment::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    TacId lhs_id = lhs->gen_tac(old_symtable, type_table, names, tac);
+    TacId rhs_id = rhs->gen_tac(old_symtable, type_table, names, tac);
 
-    const Assignment &n = (Assignment &) node;
+    tac.emit_assign(lhs_id, rhs_id);
 
-    return (*lhs == *(n.lhs) && *rhs == *(n.rhs));
+    return TAC_NONE;
 }
 
 BangExpr::BangExpr(const Location loc, const Expr * expr) :
-    Expr(loc), expr(expr) {}
+    Expr(loc, kind), expr(expr) {}
 
 BangExpr::~BangExpr() {
-    delete expr;
+    x::release(expr);
 }
 
 void BangExpr::print() const {
@@ -1741,25 +1570,15 @@ void BangExpr::print() const {
     expr->print();
 }
 
-std::vector<ASTNode *> BangExpr::children() {
-    return {(ASTNode *)expr};
-}
-
-bool BangExpr::operator==(const ASTNode &node) const {
-    if (node.get_kind() != BangExpr::kind) {
-        return false;
-    }
-
-    const BangExpr &n = (BangExpr &) node;
-
-    return (*expr == *(n.expr));
+bool BangExpr::each_child(ChildFunc f) {
+    return f((ASTNode *)expr);
 }
 
 NotExpr::NotExpr(const Location loc, const Expr * expr) :
-    Expr(loc), expr(expr) {}
+    Expr(loc, kind), expr(expr) {}
 
 NotExpr::~NotExpr() {
-    delete expr;
+    x::release(expr);
 }
 
 void NotExpr::print() const {
@@ -1767,25 +1586,15 @@ void NotExpr::print() const {
     expr->print();
 }
 
-std::vector<ASTNode *> NotExpr::children() {
-    return {(ASTNode *)expr};
-}
-
-bool NotExpr::operator==(const ASTNode &node) const {
-    if (node.get_kind() != NotExpr::kind) {
-        return false;
-    }
-
-    const NotExpr &n = (NotExpr &) node;
-
-    return (*expr == *(n.expr));
+bool NotExpr::each_child(ChildFunc f) {
+    return f((ASTNode *)expr);
 }
 
 PreExpr::PreExpr(const Location loc, const char * const op, const Expr * expr)
-    : Expr(loc), op(std::string(op)), expr(expr) {}
+    : Expr(loc, kind), op(std::string(op)), expr(expr) {}
 
 PreExpr::~PreExpr() {
-    delete expr;
+    x::release(expr);
 }
 
 void PreExpr::print() const {
@@ -1793,25 +1602,25 @@ void PreExpr::print() const {
     expr->print();
 }
 
-std::vector<ASTNode *> PreExpr::children() {
-    return {(ASTNode *)expr};
+bool PreExpr::each_child(ChildFunc f) {
+    return f((ASTNode *)expr);
 }
 
-bool PreExpr::operator==(const ASTNode &node) const {
-    if (node.get_kind() != PreExpr::kind) {
-        return false;
-    }
+bool PreExpr::same_fields(const ASTNode &node) const {
+    return node.get_kind() == PreExpr::kind && op == ((PreExpr &) node).op;
+}
 
-    const PreExpr &n = (PreExpr &) node;
+uint64_t PreExpr::hash_fields(uint64_t seed) const {
+    seed = ASTNode::hash_fields(seed);
 
-    return (op == n.op && *expr == *(n.expr));
+    return x::hash_bytes(op.c_str(), op.size(), seed);
 }
 
 PostExpr::PostExpr(const Location loc, const char * const op, const Expr * expr)
-    : Expr(loc), op(std::string(op)), expr(expr) {}
+    : Expr(loc, kind), op(std::string(op)), expr(expr) {}
 
 PostExpr::~PostExpr() {
-    delete expr;
+    x::release(expr);
 }
 
 void PostExpr::print() const {
@@ -1819,26 +1628,26 @@ void PostExpr::print() const {
     expr->print();
 }
 
-std::vector<ASTNode *> PostExpr::children() {
-    return {(ASTNode *)expr};
+bool PostExpr::each_child(ChildFunc f) {
+    return f((ASTNode *)expr);
 }
 
-bool PostExpr::operator==(const ASTNode &node) const {
-    if (node.get_kind() != PostExpr::kind) {
-        return false;
-    }
+bool PostExpr::same_fields(const ASTNode &node) const {
+    return node.get_kind() == PostExpr::kind && op == ((PostExpr &) node).op;
+}
 
-    const PostExpr &n = (PostExpr &) node;
+uint64_t PostExpr::hash_fields(uint64_t seed) const {
+    seed = ASTNode::hash_fields(seed);
 
-    return (op == n.op && *expr == *(n.expr));
+    return x::hash_bytes(op.c_str(), op.size(), seed);
 }
 
 StructDeref::StructDeref(const Location loc, const CallingExpr * strukt, const Ident * member)
-    : CallingExpr(loc), strukt(strukt), member(member) {}
+    : CallingExpr(loc, kind), strukt(strukt), member(member) {}
 
 StructDeref::~StructDeref() {
-    delete strukt;
-    delete member;
+    x::release(strukt);
+    x::release(member);
 }
 
 void StructDeref::print() const {
@@ -1847,26 +1656,16 @@ void StructDeref::print() const {
     member->print();
 }
 
-std::vector<ASTNode *> StructDeref::children() {
-    return {(ASTNode *) strukt, (ASTNode *) member};
-}
-
-bool StructDeref::operator==(const ASTNode &node) const {
-    if (node.get_kind() != StructDeref::kind) {
-        return false;
-    }
-
-    const StructDeref &n = (StructDeref &) node;
-
-    return (*strukt == *(n.strukt) && *member == *(n.member));
+bool StructDeref::each_child(ChildFunc f) {
+    return f((ASTNode *) strukt) && f((ASTNode *) member);
 }
 
 MemberInitializer::MemberInitializer(const Location loc, const Ident * member, const Expr * expr)
-    : ASTNode(loc), member(member), expr(expr) {}
+    : ASTNode(loc, kind), member(member), expr(expr) {}
 
 MemberInitializer::~MemberInitializer() {
-    delete member;
-    delete expr;
+    x::release(member);
+    x::release(expr);
 }
 
 void MemberInitializer::print() const {
@@ -1875,22 +1674,12 @@ void MemberInitializer::print() const {
     expr->print();
 }
 
-std::vector<ASTNode *> MemberInitializer::children() {
-    return {(ASTNode *) member, (ASTNode *) expr};
-}
-
-bool MemberInitializer::operator==(const ASTNode &node) const {
-    if (node.get_kind() != MemberInitializer::kind) {
-        return false;
-    }
-
-    const MemberInitializer &n = (MemberInitializer &) node;
-
-    return (*member == *(n.member) && *expr == *(n.expr));
+bool MemberInitializer::each_child(ChildFunc f) {
+    return f((ASTNode *) member) && f((ASTNode *) expr);
 }
 
 InitializerList::InitializerList(const Location loc, std::vector<MemberInitializer *> members)
-    : ASTNode(loc), members(members) {}
+    : ASTNode(loc, kind), members(members) {}
 
 InitializerList::~InitializerList() {
     members.clear();
@@ -1906,35 +1695,15 @@ void InitializerList::print() const {
     putchar('\n');
 }
 
-std::vector<ASTNode *> InitializerList::children() {
-    return cast_nodes(members);
-}
-
-bool InitializerList::operator==(const ASTNode &node) const {
-    if (node.get_kind() != InitializerList::kind) {
-        return false;
-    }
-
-    const InitializerList &n = (InitializerList &) node;
-
-    if (members.size() != n.members.size()) {
-        return false;
-    }
-
-    for (size_t i = 0; i < members.size(); i++) {
-        if (*(members[i]) != *(n.members[i])) {
-            return false;
-        }
-    }
-
-    return true;
+bool InitializerList::each_child(ChildFunc f) {
+    return each_node(members, f);
 }
 
 StructLiteral::StructLiteral(const Location loc, const InitializerList * members)
-    : CallingExpr(loc), members(members) {}
+    : CallingExpr(loc, kind), members(members) {}
 
 StructLiteral::~StructLiteral() {
-    delete members;
+    x::release(members);
 }
 
 void StructLiteral::print() const {
@@ -1943,30 +1712,20 @@ void StructLiteral::print() const {
     putchar('}');
 }
 
-std::string StructLiteral::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const {
-    return "";
+TacId StructLiteral::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
+    return TAC_NONE;
 }
 
-std::vector<ASTNode *> StructLiteral::children() {
-    return {(ASTNode *) members};
-}
-
-bool StructLiteral::operator==(const ASTNode &node) const {
-    if (node.get_kind() != StructLiteral::kind) {
-        return false;
-    }
-
-    const StructLiteral &n = (StructLiteral &) node;
-
-    return (*members == *(n.members));
+bool StructLiteral::each_child(ChildFunc f) {
+    return f((ASTNode *) members);
 }
 
 ArrayIndexExpr::ArrayIndexExpr(const Location loc, const CallingExpr * arr, const Expr * index)
-    : CallingExpr(loc), arr(arr), index(index) {}
+    : CallingExpr(loc, kind), arr(arr), index(index) {}
 
 ArrayIndexExpr::~ArrayIndexExpr() {
-    delete arr;
-    delete index;
+    x::release(arr);
+    x::release(index);
 }
 
 void ArrayIndexExpr::print() const {
@@ -1976,29 +1735,19 @@ void ArrayIndexExpr::print() const {
     putchar(']');
 }
 
-std::vector<ASTNode *> ArrayIndexExpr::children() {
-    return {(ASTNode *) arr, (ASTNode *) index};
-}
-
-bool ArrayIndexExpr::operator==(const ASTNode &node) const {
-    if (node.get_kind() != ArrayIndexExpr::kind) {
-        return false;
-    }
-
-    const ArrayIndexExpr &n = (ArrayIndexExpr &) node;
-
-    return (*arr == *(n.arr) && *index == *(n.index));
+bool ArrayIndexExpr::each_child(ChildFunc f) {
+    return f((ASTNode *) arr) && f((ASTNode *) index);
 }
 
 DynamicArrayTypename::DynamicArrayTypename(const Location loc, const Typename * arr)
-    : Typename(loc), element_type(arr) {}
+    : Typename(loc, kind), element_type(arr) {}
 
 Typename * DynamicArrayTypename::clone() const {
     return new DynamicArrayTypename(loc, element_type->clone());
 }
 
 DynamicArrayTypename::~DynamicArrayTypename() {
-    delete element_type;
+    x::release(element_type);
 }
 
 void DynamicArrayTypename::print() const {
@@ -2006,80 +1755,54 @@ void DynamicArrayTypename::print() const {
     putchar('s');
 }
 
-std::vector<ASTNode *> DynamicArrayTypename::children() {
-    return {(ASTNode *) element_type};
-}
-
-bool DynamicArrayTypename::operator==(const ASTNode &node) const {
-    if (node.get_kind() != DynamicArrayTypename::kind) {
-        return false;
-    }
-
-    const DynamicArrayTypename &n = (DynamicArrayTypename &) node;
-
-    return *element_type == *(n.element_type);
+bool DynamicArrayTypename::each_child(ChildFunc f) {
+    return f((ASTNode *) element_type);
 }
 
-VoidReturnStmt::VoidReturnStmt(const Location loc) : Statement(loc) {}
+VoidReturnStmt::VoidReturnStmt(const Location loc) : Statement(loc, kind) {}
 
 void VoidReturnStmt::print() const {
     printf("return");
 }
 
-std::vector<ASTNode *> VoidReturnStmt::children() {
-    return {};
-}
-
-bool VoidReturnStmt::operator==(const ASTNode &node) const {
-    return (node.get_kind() == VoidReturnStmt::kind);
+bool VoidReturnStmt::each_child(ChildFunc f) {
+    return true;
 }
 
-PleaseReturnStmt::PleaseReturnStmt(const Location loc) : Statement(loc) {}
+PleaseReturnStmt::PleaseReturnStmt(const Location loc) : Statement(loc, kind) {}
 
 void PleaseReturnStmt::print() const {
     printf("return");
 }
 
-std::vector<ASTNode *> PleaseReturnStmt::children() {
-    return {};
-}
-
-bool PleaseReturnStmt::operator==(const ASTNode &node) const {
-    return (node.get_kind() == PleaseReturnStmt::kind);
+bool PleaseReturnStmt::each_child(ChildFunc f) {
+    return true;
 }
 
-ContinueStmt::ContinueStmt(const Location loc) : Statement(loc) {}
+ContinueStmt::ContinueStmt(const Location loc) : Statement(loc, kind) {}
 
 void ContinueStmt::print() const {
     printf("continue");
 }
 
-std::vector<ASTNode *> ContinueStmt::children() {
-    return {};
-}
-
-bool ContinueStmt::operator==(const ASTNode &node) const {
-    return (node.get_kind() == ContinueStmt::kind);
+bool ContinueStmt::each_child(ChildFunc f) {
+    return true;
 }
 
-BreakStmt::BreakStmt(const Location loc) : Statement(loc) {}
+BreakStmt::BreakStmt(const Location loc) : Statement(loc, kind) {}
 
 void BreakStmt::print() const {
     printf("break");
 }
 
-std::vector<ASTNode *> BreakStmt::children() {
-    return {};
-}
-
-bool BreakStmt::operator==(const ASTNode &node) const {
-    return (node.get_kind() == BreakStmt::kind);
+bool BreakStmt::each_child(ChildFunc f) {
+    return true;
 }
 
-std::string ProgramSource::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const {
+TacId ProgramSource::gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const {
     for (auto &node : nodes) {
-        node->gen_tac(old_symtable, type_table, names, instrs);
+        node->gen_tac(old_symtable, type_table, names, tac);
     }
 
-    return "";
+    return TAC_NONE;
 }
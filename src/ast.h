@@ -14,9 +14,11 @@
  * static member called 'kind' which is used at runtime to narrow the abstract
  * type. You can call get_kind() on the object in question and compare it to
  * Class::kind to see if you can make a narrowing cast. The KIND_CLASS macro
- * copies some of the boilerplate to add the static kind member and implement
- * the abstract function. The kinds are initialized in ast.cpp with names; you
- * can use x::kind_map to look up the name for a given kind.
+ * adds the static kind member, and every leaf constructor passes it up to
+ * ASTNode, which keeps it on the node, so get_kind() is a plain load rather than
+ * a virtual call. x::dispatch switches on it to reach a leaf class. The kinds and
+ * their names are listed in AST_NODE_KINDS; you can use x::kind_map to look up
+ * the name for a given kind.
  *
  * Many of these node classes have a similar structure; e.g., 'left' and 'right'
  * Expr nodes as members, or similar class members with different types in
@@ -31,14 +33,19 @@
  * Many of these classes accept pointers to nodes in their constructors. In
  * general, the class takes ownership of the node passed in and is responsible
  * for destroying it. If you add a node that owns other nodes, please implement
- * the destructor.
+ * the destructor. The exception is shared nodes, such as the type names the parser
+ * makes, which belong to a TypeInterner and can have several parents.
  */
 #ifndef SRC_AST_H
 #define SRC_AST_H
 
+#include <atomic>
+#include <cstdint>
 #include <iostream>
 #include <map>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 #include "codegen.h"
@@ -50,70 +57,262 @@
 #define ADDRESS_WIDTH   8
 
 #define KIND_CLASS()     \
-  const static int kind; \
-                         \
-  virtual int get_kind() const { return this->kind; }
+  const static int kind;
 
-#define NEQ_OPERATOR()  \
-  virtual bool operator!=(const ASTNode &node) const {  \
-    return !(*this == node);  \
-  }
+/**
+ * Every leaf node class with the name used for it in x::kind_map. Kinds are numbered
+ * in this order at compile time, so they are constants that don't depend on static
+ * initialization order and can be used from any translation unit.
+ */
+#define AST_NODE_KINDS(X) \
+    X(ProgramSource, "program_source") \
+    X(IntLiteral, "int_literal") \
+    X(FloatLiteral, "float_literal") \
+    X(TernaryExpr, "ternary_expr") \
+    X(BoolLiteral, "bool_literal") \
+    X(CharLiteral, "char_literal") \
+    X(StringLiteral, "str_literal") \
+    X(TypeIdent, "type_ident") \
+    X(Ident, "ident") \
+    X(ParensExpr, "parens_expr") \
+    X(MathExpr, "math_expr") \
+    X(BoolExpr, "bool_expr") \
+    X(ParensTypename, "parens_typename") \
+    X(PtrTypename, "ptr_typename") \
+    X(MutTypename, "mut_typename") \
+    X(TypenameList, "typename_list") \
+    X(VarDeclList, "var_decl_list") \
+    X(ExprList, "expr_list") \
+    X(TupleTypename, "tuple_typename") \
+    X(FuncTypename, "func_typename") \
+    X(StaticArrayTypename, "static_array_typename") \
+    X(DynamicArrayTypename, "dynamic_array_typename") \
+    X(TypeAlias, "type_alias") \
+    X(StructTypename, "struct_typename") \
+    X(StructDecl, "struct_decl") \
+    X(VarDecl, "var_decl") \
+    X(VarDeclInit, "var_decl_init") \
+    X(ArrayLiteral, "array_literal") \
+    X(IfStmt, "if") \
+    X(IfElseStmt, "if_else") \
+    X(WhileStmt, "while") \
+    X(ForStmt, "for") \
+    X(AddrOf, "addr_of") \
+    X(Deref, "deref") \
+    X(CastExpr, "cast_expr") \
+    X(LogicalExpr, "logical_expr") \
+    X(TupleExpr, "tuple_expr") \
+    X(FunctionCallExpr, "function_call_expr") \
+    X(FunctionCallStmt, "function_call_stmt") \
+    X(StatementList, "statement_list") \
+    X(ParamsList, "params_list") \
+    X(FuncDecl, "func_decl") \
+    X(ReturnStatement, "return_statement") \
+    X(Assignment, "assignment") \
+    X(BangExpr, "bang_expr") \
+    X(NotExpr, "not_expr") \
+    X(PreExpr, "pre_expr") \
+    X(PostExpr, "post_expr") \
+    X(StructDeref, "struct_deref") \
+    X(MemberInitializer, "member_initializer") \
+    X(InitializerList, "initializer_list") \
+    X(StructLiteral, "struct_literal") \
+    X(ArrayIndexExpr, "array_index_expr") \
+    X(VoidReturnStmt, "void_return_stmt") \
+    X(PleaseReturnStmt, "Please_return_stmt") \
+    X(ContinueStmt, "continue_stmt") \
+    X(BreakStmt, "break_stmt")
+
+#define AST_KIND_ENUM(cls, name) cls##Kind,
+
+enum NodeKind {
+    AST_NODE_KINDS(AST_KIND_ENUM)
+    NUM_NODE_KINDS
+};
+
+#undef AST_KIND_ENUM
 
-struct YYLTYPE;
 struct SourceErrors;
+class ThreadPool;
 
+/**
+ * Span of source text as byte offsets into the file, end exclusive. Line and column
+ * numbers are only worked out when an error is printed, using the file's LineTable.
+ * This is also the parser's location type (YYLTYPE).
+ */
 struct Location {
-    int first_line;
-    int first_col;
-    int last_line;
-    int last_col;
+    uint32_t begin;
+    uint32_t end;
 
-    Location(int first_line, int first_col, int last_line, int last_col);
-    Location(YYLTYPE &start, YYLTYPE &end);
+    Location();
+    Location(uint32_t begin, uint32_t end);
     Location(const Location &start, const Location &end);
 
-    void set_end(YYLTYPE &end);
+    void set_end(const Location &end);
 };
 
 typedef struct Location Location;
 
 class ProgramSource;
 class ASTNode;
+class Ident;
 class Typename;
 
 typedef bool (*FindFunc)(const ASTNode *);
 
-namespace x {
-    const Location NULL_LOC = Location(0, 0, 0, 0);
+/**
+ * Reference to a callable taking a child node and returning false to stop, used by
+ * ASTNode::each_child. It only points at the callable, so passing a lambda never
+ * allocates, but it must not outlive the callable.
+ */
+class ChildFunc {
+    public:
+        template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, ChildFunc>>>
+        ChildFunc(F &&func) : func((void *) &func), call(&invoke<std::remove_reference_t<F>>) {}
+
+        bool operator()(ASTNode * child) const {
+            return call(func, child);
+        }
+
+    private:
+        void * func;
+        bool (*call)(void *, ASTNode *);
+
+        template <typename F>
+        static bool invoke(void * func, ASTNode * child) {
+            return (*(F *) func)(child);
+        }
+};
+
+// Output of x::dump_tree
+enum TreeFormat {
+    TreeDot,
+    TreeJson,
+};
+
+// What x::walk does after calling a hook
+enum WalkAction {
+    WalkContinue,
+    // Leave out the node's children. Only means something from pre()
+    WalkSkip,
+    WalkStop,
+};
+
+/**
+ * Hooks for x::walk, which goes through a tree depth first. pre() sees a node before
+ * its children and post() after them. Null children are passed over.
+ */
+class TreeVisitor {
+    public:
+        virtual ~TreeVisitor() {}
+
+        virtual WalkAction pre(ASTNode * node) {
+            return WalkContinue;
+        }
 
-    extern std::vector<std::string> kind_map;
+        virtual WalkAction post(ASTNode * node) {
+            return WalkContinue;
+        }
+};
 
-    int next_kind(const char * const name);
+namespace x {
+    const Location NULL_LOC = Location(0, 0);
 
+    // Name of each node kind, indexed by kind
+    extern const char * const kind_map[NUM_NODE_KINDS];
+
+    // Writes the whole tree as a dot graph
     void tree_dotfile(std::ostream &out, ProgramSource * prog);
+
+    /**
+     * Writes the tree under 'root' as a dot graph or as nested JSON objects. Goes
+     * depth first with x::walk and writes through a large buffer, so memory doesn't
+     * grow with the size of the tree. Nodes more than 'max_depth' levels below
+     * 'root' are left out, unless it's negative.
+     */
+    void dump_tree(std::ostream &out, ASTNode * root, TreeFormat format, int max_depth);
+
+    // Name a top-level node puts in the global scope, if any
+    const Ident * declared_name(const ASTNode * node);
+
+    // Calls the visitor's hooks on every node under 'node'. Uses a stack on the heap,
+    // so it works on trees of any depth. Returns false if a hook stopped the walk
+    bool walk(ASTNode * node, TreeVisitor &visitor);
+
+    // Whether two trees have the same kinds, fields and shape. Either can be null.
+    // Subtrees that are the same node are equal, and ones that have already been
+    // hashed to different values aren't, so neither is looked into
+    bool tree_equals(const ASTNode * a, const ASTNode * b);
+
+    /**
+     * Deletes 'node'. Destructors release their children with this instead of
+     * deleting them, so the outermost call deletes the whole tree in a loop rather
+     * than recursing once per level. Shared nodes (see ASTNode::is_shared) are
+     * left to their TypeInterner.
+     */
+    void release(const ASTNode * node);
 }  // namespace x
 
 class ASTNode {
     public:
         Location loc;
 
-        virtual int get_kind() const = 0;
+        int get_kind() const {
+            return node_kind;
+        }
 
         virtual void print() const = 0;
-        virtual std::vector<ASTNode *> children() = 0;
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const { 
-            fprintf(stderr, "gen_tac called on unsupported node of kind %s\n", x::kind_map[get_kind()].c_str());
-            return "";
-        };
+
+        // Calls 'f' with each child in order. Returns false as soon as 'f' does
+        virtual bool each_child(ChildFunc f) = 0;
+
+        // The children as a vector, for code that wants to index them
+        std::vector<ASTNode *> children();
+        // Throws a CompilerError for nodes that can't be lowered yet
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
         virtual ASTNode * find(FindFunc cond);
 
-        virtual bool operator==(const ASTNode &node) const = 0;
-        virtual bool operator!=(const ASTNode &node) const = 0;
+        // Same kind, fields and children, locations ignored (see x::tree_equals)
+        bool operator==(const ASTNode &node) const;
+        bool operator!=(const ASTNode &node) const;
+
+        // Compares the fields that aren't children, such as an operator or a name.
+        // Only checks the kind unless a class has such fields
+        virtual bool same_fields(const ASTNode &node) const;
+
+        /**
+         * Hash of the kind, fields and children, locations ignored, so trees that are
+         * equal hash the same. Worked out bottom up the first time it's asked for and
+         * kept on every node it covers, so a tree must not change after that.
+         */
+        uint64_t hash() const;
+
+        // Mixes the fields same_fields compares into 'seed'
+        virtual uint64_t hash_fields(uint64_t seed) const;
+
+        // Whether the node belongs to a TypeInterner, and so can be a child of any
+        // number of trees. x::release leaves shared nodes alone
+        bool is_shared() const {
+            return shared;
+        }
 
         virtual ~ASTNode() {}
 
     protected:
-        ASTNode(const Location loc) : loc(loc) {}
+        // 'kind' is the leaf class's, passed up by every constructor in between
+        ASTNode(const Location loc, int kind) : loc(loc), node_kind(kind), shared(false), structural_hash(0) {}
+
+    private:
+        friend class TypeInterner;
+        friend bool x::tree_equals(const ASTNode * a, const ASTNode * b);
+
+        // Kept on the node, so finding the kind doesn't need a virtual call
+        uint16_t node_kind;
+
+        bool shared;
+
+        // Zero until hash() is called
+        mutable std::atomic<uint64_t> structural_hash;
 };
 
 class ProgramSource : public ASTNode {
@@ -126,14 +325,25 @@ class ProgramSource : public ASTNode {
         virtual ~ProgramSource();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
-        void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
+        // With a pool, function bodies are typechecked in parallel. Errors come out in
+        // the same order either way
+        void typecheck(SymbolTable * symtable, SourceErrors &errors, ThreadPool * pool = nullptr) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        // Typechecks a single top-level declaration
+        static void typecheck_decl(const ASTNode * node, SymbolTable * symtable, SourceErrors &errors);
+
+        /**
+         * Typechecks decls[i] into errors[i], which must be the same size. Everything
+         * but functions goes first, in order; then the functions, on 'pool' if there
+         * is one. A function only writes to its own scopes and nodes, so any number of
+         * them can be checked at once.
+         */
+        static void typecheck_decls(const std::vector<ASTNode *> &decls, SymbolTable * symtable,
+                                    std::vector<SourceErrors> &errors, ThreadPool * pool);
 
         void add_node(ASTNode * node);
 
@@ -144,10 +354,30 @@ class Expr : public ASTNode {
     public:
         virtual ~Expr() {}
 
-        virtual Typename * type_of(SymbolTable * symtable) const = 0;
+        /**
+         * Works out the type the first time it's called and keeps it on the node, so
+         * 'symtable' has to be the scope the expression is in. The type is interned
+         * in symtable->types and must not be freed.
+         */
+        const Typename * type_of(SymbolTable * symtable) const;
+
+        // The type kept by type_of, or null if it hasn't worked one out yet
+        const Typename * known_type() const {
+            return cached_type;
+        }
 
     protected:
-        Expr(const Location loc) : ASTNode(loc) {}
+        Expr(const Location loc, int kind) : ASTNode(loc, kind), cached_type(nullptr) {}
+
+        // Returns an interned type. Throws a CompilerError if the expression is ill-typed
+        virtual const Typename * compute_type(SymbolTable * symtable) const = 0;
+
+    private:
+        mutable const Typename * cached_type;
+
+        // Types everything under this expression bottom up, from a stack on the heap.
+        // Used once type_of calls are nested too deep
+        void type_subexprs(SymbolTable * symtable) const;
 };
 
 class ExprList : public ASTNode {
@@ -160,10 +390,7 @@ class ExprList : public ASTNode {
 
         virtual void print() const;
 
-        virtual std::vector<ASTNode *> children();
-
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual bool each_child(ChildFunc f);
 
         void push_expr(Expr * expr);
 
@@ -181,7 +408,7 @@ class CallingExpr : public Expr {
         virtual ~CallingExpr() {}
 
     protected:
-        CallingExpr(const Location loc) : Expr(loc) {}
+        CallingExpr(const Location loc, int kind) : Expr(loc, kind) {}
 };
 
 class Statement : public ASTNode {
@@ -191,7 +418,7 @@ class Statement : public ASTNode {
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const = 0;
 
     protected:
-        Statement(const Location loc) : ASTNode(loc) {}
+        Statement(const Location loc, int kind) : ASTNode(loc, kind) {}
 };
 
 class StatementList : public ASTNode {
@@ -202,16 +429,12 @@ class StatementList : public ASTNode {
 
         virtual ~StatementList();
 
-
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
+        virtual bool each_child(ChildFunc f);
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
         void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         void push_statement(Statement * statement);
 
         KIND_CLASS()
@@ -225,14 +448,10 @@ class ParensExpr : public CallingExpr {
 
         virtual ~ParensExpr();
 
-
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
-        virtual Typename * type_of(SymbolTable * symtable) const;
-
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -242,7 +461,7 @@ class TypeDecl : public Statement {
         virtual ~TypeDecl() {}
 
     protected:
-        TypeDecl(const Location loc) : Statement(loc) {}
+        TypeDecl(const Location loc, int kind) : Statement(loc, kind) {}
 };
 
 class Typename : public ASTNode {
@@ -251,12 +470,27 @@ class Typename : public ASTNode {
 
         virtual Typename * clone() const = 0;
 
-        virtual bool type_equals(const Typename * t, SymbolTable * symtable) const = 0;
-        virtual bool can_cast_to(const Typename * t, SymbolTable * symtable) const = 0;
-        virtual int type_size(SymbolTable * symtable) const = 0;
+        // Compares canonical IDs (see TypeInterner), so it's an integer compare once
+        // both types have been seen in the scope
+        bool type_equals(const Typename * t, SymbolTable * symtable) const;
+
+        // Looked up by canonical IDs, and checked with compute_cast the first time
+        bool can_cast_to(const Typename * t, SymbolTable * symtable) const;
+
+        // From the type's layout (see TypeInterner::layout)
+        int type_size(SymbolTable * symtable) const;
 
     protected:
-        Typename(const Location loc) : ASTNode(loc) {}
+        Typename(const Location loc, int kind) : ASTNode(loc, kind), type_id(0) {}
+
+        virtual bool compute_cast(const Typename * t, SymbolTable * symtable) const = 0;
+
+    private:
+        friend class TypeInterner;
+
+        // Kept by TypeInterner::id: the scope's type version in the high half and the
+        // ID in the low half
+        mutable std::atomic<uint64_t> type_id;
 };
 
 class ParensTypename : public Typename {
@@ -270,14 +504,9 @@ class ParensTypename : public Typename {
         virtual ~ParensTypename();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual bool type_equals(const Typename * t, SymbolTable * symtable) const;
-        virtual bool can_cast_to(const Typename * t, SymbolTable * symtable) const;
-        virtual int type_size(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual bool compute_cast(const Typename * t, SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -287,7 +516,7 @@ class NumLiteral : public Expr {
         virtual ~NumLiteral() {}
 
     protected:
-        NumLiteral(const Location loc) : Expr(loc) {}
+        NumLiteral(const Location loc, int kind) : Expr(loc, kind) {}
 };
 
 class IntLiteral : public NumLiteral {
@@ -300,13 +529,12 @@ class IntLiteral : public NumLiteral {
 
         virtual void print() const;
         
-        virtual std::vector<ASTNode *> children();
-        virtual std::string gen_tac(SymbolTable *old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
+        virtual bool each_child(ChildFunc f);
+        virtual bool same_fields(const ASTNode &node) const;
+        virtual uint64_t hash_fields(uint64_t seed) const;
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
-        virtual Typename * type_of(SymbolTable * symtable) const;
-
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -319,13 +547,12 @@ class FloatLiteral : public NumLiteral {
         FloatLiteral(const Location loc, const float value);
 
         virtual void print() const;
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> instrs) const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual Typename * type_of(SymbolTable * symtable) const;
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
+        virtual bool each_child(ChildFunc f);
+        virtual bool same_fields(const ASTNode &node) const;
+        virtual uint64_t hash_fields(uint64_t seed) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -341,12 +568,9 @@ class TernaryExpr : public Expr {
         virtual ~TernaryExpr();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
-        virtual Typename * type_of(SymbolTable * symtable) const;
-
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -358,14 +582,13 @@ class BoolLiteral : public Expr {
         BoolLiteral(const Location loc, const bool value);
 
         virtual void print() const;
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> instrs) const;
-
-        virtual std::vector<ASTNode *> children();
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
-        virtual Typename * type_of(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
+        virtual bool same_fields(const ASTNode &node) const;
+        virtual uint64_t hash_fields(uint64_t seed) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -377,35 +600,46 @@ class CharLiteral : public Expr {
         CharLiteral(const Location loc, const char value);
 
         virtual void print() const;
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> instrs) const;
-        virtual std::vector<ASTNode *> children();
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
+        virtual bool each_child(ChildFunc f);
+        virtual bool same_fields(const ASTNode &node) const;
+        virtual uint64_t hash_fields(uint64_t seed) const;
 
-        virtual Typename * type_of(SymbolTable * symtable) const;
-
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
 
 class StringLiteral : public Expr {
     public:
-        const std::string value;
+        // Points into the source buffer when the literal was scanned from a file, so
+        // the buffer has to outlive the node (ParserState takes care of this)
+        std::string_view value;
 
+        // Keeps a copy of 'value'
         StringLiteral(const Location loc, const char * const value);
 
-        virtual void print() const;
+        // Doesn't copy 'value'
+        StringLiteral(const Location loc, std::string_view value);
+
+        StringLiteral(const StringLiteral &) = delete;
+        StringLiteral &operator=(const StringLiteral &) = delete;
 
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> instrs) const;
+        virtual void print() const;
 
-        virtual std::vector<ASTNode *> children();
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
-        virtual Typename * type_of(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
+        virtual bool same_fields(const ASTNode &node) const;
+        virtual uint64_t hash_fields(uint64_t seed) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
+
+    private:
+        // Backing storage for 'value' if the node owns it
+        std::string owned;
 };
 
 class TypeIdent : public Typename {
@@ -413,18 +647,16 @@ class TypeIdent : public Typename {
         const std::string id;
 
         TypeIdent(const Location loc, const char * const _id);
+        TypeIdent(const Location loc, std::string_view _id);
 
         virtual Typename * clone() const;
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
+        virtual bool same_fields(const ASTNode &node) const;
+        virtual uint64_t hash_fields(uint64_t seed) const;
 
-        virtual bool type_equals(const Typename * t, SymbolTable * symtable) const;
-        virtual bool can_cast_to(const Typename * t, SymbolTable * symtable) const;
-        virtual int type_size(SymbolTable * symtable) const;
-
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual bool compute_cast(const Typename * t, SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -434,17 +666,17 @@ class Ident : public CallingExpr {
         const std::string id;
 
         Ident(const Location loc, const char * const _id);
+        Ident(const Location loc, std::string_view _id);
 
         virtual void print() const;
 
-        virtual std::vector<ASTNode *> children();
-
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
+        virtual bool each_child(ChildFunc f);
+        virtual bool same_fields(const ASTNode &node) const;
+        virtual uint64_t hash_fields(uint64_t seed) const;
 
-        virtual Typename * type_of(SymbolTable * symtable) const;
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -460,13 +692,12 @@ class MathExpr : public Expr {
         virtual ~MathExpr();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
+        virtual bool each_child(ChildFunc f);
+        virtual bool same_fields(const ASTNode &node) const;
+        virtual uint64_t hash_fields(uint64_t seed) const;
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
-        virtual Typename * type_of(SymbolTable * symtable) const;
-
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -484,12 +715,11 @@ class BoolExpr : public Expr {
 
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual Typename * type_of(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
+        virtual bool same_fields(const ASTNode &node) const;
+        virtual uint64_t hash_fields(uint64_t seed) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -505,14 +735,9 @@ class PtrTypename : public Typename {
         virtual ~PtrTypename();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool type_equals(const Typename * t, SymbolTable * symtable) const;
-        virtual bool can_cast_to(const Typename * t, SymbolTable * symtable) const;
-        virtual int type_size(SymbolTable * symtable) const;
-
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual bool compute_cast(const Typename * t, SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -528,14 +753,9 @@ class MutTypename : public Typename {
         virtual ~MutTypename();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual bool type_equals(const Typename * t, SymbolTable * symtable) const;
-        virtual bool can_cast_to(const Typename * t, SymbolTable * symtable) const;
-        virtual int type_size(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual bool compute_cast(const Typename * t, SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -549,10 +769,8 @@ class TypenameList : public ASTNode {
         virtual ~TypenameList();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
 
         // Pushes the typename onto the back of the type list
         void push_type(Typename * type_name);
@@ -570,13 +788,10 @@ class VarDecl : public Statement {
         virtual ~VarDecl();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         void add_to_scope(SymbolTable * symtable);
 
         KIND_CLASS()
@@ -591,10 +806,7 @@ class ParamsList : public ASTNode {
         virtual ~ParamsList();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual bool each_child(ChildFunc f);
 
         void push_param(VarDecl * param);
 
@@ -613,13 +825,10 @@ class FunctionCallExpr : public CallingExpr {
         virtual ~FunctionCallExpr();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
+        virtual bool each_child(ChildFunc f);
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
-        virtual Typename * type_of(SymbolTable * symtable) const;
-
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -637,14 +846,11 @@ class FunctionCallStmt : public Statement {
         virtual ~FunctionCallStmt();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
+        virtual bool each_child(ChildFunc f);
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         KIND_CLASS()
 };
 
@@ -658,14 +864,11 @@ class PreStmt : public Statement {
         virtual ~PreStmt();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
+        virtual bool each_child(ChildFunc f);
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         KIND_CLASS()
 };
 
@@ -678,10 +881,8 @@ class VarDeclList : public ASTNode {
         virtual ~VarDeclList();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
 
         // Pushes the var decl onto the back of the type list
         void push_decl(VarDecl * decl);
@@ -692,24 +893,17 @@ class VarDeclList : public ASTNode {
 class TupleTypename : public Typename {
     public:
         const TypenameList * type_list;
-        std::vector<int> offsets;
 
-        TupleTypename(const Location loc, const TypenameList * type_list, SymbolTable * scope);
-        TupleTypename(const Location loc, const TypenameList * type_list, const std::vector<int> offsets);
+        TupleTypename(const Location loc, const TypenameList * type_list);
 
         virtual Typename * clone() const;
 
         virtual ~TupleTypename();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual bool type_equals(const Typename * t, SymbolTable * symtable) const;
-        virtual bool can_cast_to(const Typename * t, SymbolTable * symtable) const;
-        virtual int type_size(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual bool compute_cast(const Typename * t, SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -725,12 +919,9 @@ class TupleExpr : public Expr {
 
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
-        virtual Typename * type_of(SymbolTable * symtable) const;
-
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -738,6 +929,7 @@ class TupleExpr : public Expr {
 class FuncTypename : public Typename {
     public:
         const TypenameList * params;
+        // Where each argument is on the stack. Every argument starts on a word
         std::vector<int> offsets;
         const Typename * ret_type;
 
@@ -749,14 +941,9 @@ class FuncTypename : public Typename {
         virtual ~FuncTypename();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual bool type_equals(const Typename * t, SymbolTable * symtable) const;
-        virtual bool can_cast_to(const Typename * t, SymbolTable * symtable) const;
-        virtual int type_size(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual bool compute_cast(const Typename * t, SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -772,14 +959,9 @@ class DynamicArrayTypename : public Typename{
         virtual ~DynamicArrayTypename();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool type_equals(const Typename * t, SymbolTable * symtable) const;
-        virtual bool can_cast_to(const Typename * t, SymbolTable * symtable) const;
-        virtual int type_size(SymbolTable * symtable) const;
-
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual bool compute_cast(const Typename * t, SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -796,14 +978,9 @@ class StaticArrayTypename : public Typename {
         virtual ~StaticArrayTypename();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual bool type_equals(const Typename * t, SymbolTable * symtable) const;
-        virtual bool can_cast_to(const Typename * t, SymbolTable * symtable) const;
-        virtual int type_size(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual bool compute_cast(const Typename * t, SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -818,13 +995,10 @@ class TypeAlias : public TypeDecl {
         virtual ~TypeAlias();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         KIND_CLASS()
 };
 
@@ -835,10 +1009,9 @@ class TypeAlias : public TypeDecl {
 class StructTypename : public Typename {
     public:
         const VarDeclList * members;
-        // Struct member offsets. As of right now structs are packed because it's simpler
-        // and all of our data types at the moment are 8-byte aligned anyway
-        std::vector<int> offsets;
         SymbolTable * scope;
+        // Members have no padding between them (see TypeInterner::layout)
+        bool packed;
 
         StructTypename(const Location loc, const VarDeclList * members, SymbolTable * scope);
 
@@ -847,14 +1020,11 @@ class StructTypename : public Typename {
         virtual ~StructTypename();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
+        virtual bool same_fields(const ASTNode &node) const;
+        virtual uint64_t hash_fields(uint64_t seed) const;
 
-        virtual bool type_equals(const Typename * t, SymbolTable * symtable) const;
-        virtual bool can_cast_to(const Typename * t, SymbolTable * symtable) const;
-        virtual int type_size(SymbolTable * symtable) const;
-
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual bool compute_cast(const Typename * t, SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -869,13 +1039,10 @@ class StructDecl : public TypeDecl {
         virtual ~StructDecl();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         KIND_CLASS()
 };
 
@@ -890,15 +1057,11 @@ class VarDeclInit : public Statement {
         virtual ~VarDeclInit();
         
         virtual void print() const;
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> instrs) const;
-        virtual std::vector<ASTNode *> children();
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
+        virtual bool each_child(ChildFunc f);
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         KIND_CLASS()
 };
 
@@ -912,14 +1075,11 @@ class ArrayLiteral : public Expr {
 
         virtual void print() const;
 
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> instrs) const;
-
-        virtual std::vector<ASTNode *> children();
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
-        virtual Typename * type_of(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -936,15 +1096,12 @@ class IfStmt : public Statement {
 
         virtual void print() const;
 
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
         
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         KIND_CLASS()
 };
 
@@ -960,13 +1117,10 @@ class IfElseStmt : public Statement {
 
         virtual void print() const;
 
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         KIND_CLASS()
 };
 
@@ -982,15 +1136,12 @@ class WhileStmt : public Statement {
 
         virtual void print() const;
 
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
         
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         KIND_CLASS()
 };
 
@@ -1007,18 +1158,14 @@ class ForStmt : public Statement {
 
         virtual ~ForStmt();
 
-
         virtual void print() const;
 
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         KIND_CLASS()
 };
 
@@ -1030,14 +1177,10 @@ class AddrOf : public Expr {
 
         virtual ~AddrOf();
 
-
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual Typename * type_of(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -1050,14 +1193,10 @@ class Deref : public Expr {
 
         virtual ~Deref();
 
-
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual Typename * type_of(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -1071,14 +1210,10 @@ class CastExpr : public Expr {
 
         virtual ~CastExpr();
 
-
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual Typename * type_of(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -1093,15 +1228,13 @@ class LogicalExpr : public Expr {
 
         virtual ~LogicalExpr();
 
-
         virtual void print() const;
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual Typename * type_of(SymbolTable * symtable) const;
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
+        virtual bool each_child(ChildFunc f);
+        virtual bool same_fields(const ASTNode &node) const;
+        virtual uint64_t hash_fields(uint64_t seed) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -1121,15 +1254,19 @@ class FuncDecl : public ASTNode {
         virtual ~FuncDecl();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
+        virtual bool each_child(ChildFunc f);
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
         void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
         Typename * type_of(SymbolTable * symtable) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        /**
+         * Frees the body and its scope once the function has been compiled. Only the
+         * signature (name, params, return type) can be used after this, which is all
+         * that other functions need to call it.
+         */
+        void release_body();
 
         KIND_CLASS()
 };
@@ -1144,14 +1281,11 @@ class ReturnStatement : public Statement {
 
         virtual void print() const;
 
-        virtual std::vector<ASTNode *> children();
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
+        virtual bool each_child(ChildFunc f);
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         KIND_CLASS()
 };
 
@@ -1166,14 +1300,11 @@ class Assignment : public Statement {
         virtual ~Assignment();
         
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
+        virtual bool each_child(ChildFunc f);
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         KIND_CLASS()
 };
 
@@ -1185,14 +1316,10 @@ class BangExpr : public Expr {
 
         virtual ~BangExpr();
 
-
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual Typename * type_of(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -1205,14 +1332,10 @@ class NotExpr : public Expr {
 
         virtual ~NotExpr();
 
-
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual Typename * type_of(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -1226,14 +1349,12 @@ class PreExpr : public Expr {
 
         virtual ~PreExpr();
 
-
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
+        virtual bool same_fields(const ASTNode &node) const;
+        virtual uint64_t hash_fields(uint64_t seed) const;
 
-        virtual Typename * type_of(SymbolTable * symtable) const;
-
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -1247,14 +1368,12 @@ class PostExpr : public Expr {
 
         virtual ~PostExpr();
 
-
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
+        virtual bool same_fields(const ASTNode &node) const;
+        virtual uint64_t hash_fields(uint64_t seed) const;
 
-        virtual Typename * type_of(SymbolTable * symtable) const;
-
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -1269,12 +1388,9 @@ class StructDeref : public CallingExpr {
         virtual ~StructDeref();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual Typename * type_of(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -1289,10 +1405,7 @@ class MemberInitializer : public ASTNode {
         virtual ~MemberInitializer();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual bool each_child(ChildFunc f);
 
         KIND_CLASS()
 };
@@ -1306,13 +1419,11 @@ class InitializerList : public ASTNode {
         virtual ~InitializerList();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
         // The order of members matters in determing equality of initializer lists.
         // This is because an expr in the initializer list could have side effects that
         // change the resulting struct literal if it's in a different spot
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
 
         KIND_CLASS()
 };
@@ -1327,14 +1438,11 @@ class StructLiteral : public CallingExpr {
 
         virtual void print() const;
 
-        virtual std::string gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, std::vector<Quad *> &instrs) const;
-
-        virtual std::vector<ASTNode *> children();
+        virtual TacId gen_tac(SymbolTable * old_symtable, TypeTable * type_table, NamesToNames &names, TacBuffer &tac) const;
 
-        virtual Typename * type_of(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -1349,12 +1457,9 @@ class ArrayIndexExpr : public CallingExpr {
         virtual ~ArrayIndexExpr();
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
-
-        virtual Typename * type_of(SymbolTable * symtable) const;
+        virtual bool each_child(ChildFunc f);
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
+        virtual const Typename * compute_type(SymbolTable * symtable) const;
 
         KIND_CLASS()
 };
@@ -1364,13 +1469,10 @@ class VoidReturnStmt : public Statement {
         VoidReturnStmt(const Location loc);
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         KIND_CLASS()
 };
 
@@ -1379,13 +1481,10 @@ class PleaseReturnStmt : public Statement {
         PleaseReturnStmt(const Location loc);
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         KIND_CLASS()
 };
 
@@ -1394,13 +1493,10 @@ class ContinueStmt : public Statement {
         ContinueStmt(const Location loc);
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         KIND_CLASS()
 };
 
@@ -1409,14 +1505,33 @@ class BreakStmt : public Statement {
         BreakStmt(const Location loc);
 
         virtual void print() const;
-        virtual std::vector<ASTNode *> children();
+        virtual bool each_child(ChildFunc f);
 
         virtual void typecheck(SymbolTable * symtable, SourceErrors &errors) const;
 
-        virtual bool operator==(const ASTNode &node) const;
-        NEQ_OPERATOR()
-
         KIND_CLASS()
 };
 
+#define AST_KIND_DISPATCH(cls, name) \
+    case cls##Kind:                  \
+        return func((cls *) node);
+
+namespace x {
+    /**
+     * Calls 'func' with 'node' cast to its leaf class, picked with a switch on the
+     * kind instead of a virtual call. 'func' must return the same type for every
+     * class, usually by taking 'auto *'.
+     */
+    template <typename F>
+    decltype(auto) dispatch(ASTNode * node, F &&func) {
+        switch (node->get_kind()) {
+            AST_NODE_KINDS(AST_KIND_DISPATCH)
+        }
+
+        __builtin_unreachable();
+    }
+}
+
+#undef AST_KIND_DISPATCH
+
 #endif
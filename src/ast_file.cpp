@@ -0,0 +1,344 @@
+#include "ast_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+static const char AST_FILE_MAGIC[4] = {'X', 'A', 'S', 'T'};
+
+bool AstFile::has_text(int kind) {
+    switch (kind) {
+        case ProgramSourceKind:
+        case StringLiteralKind:
+        case TypeIdentKind:
+        case IdentKind:
+        case BoolExprKind:
+        case LogicalExprKind:
+        case PreExprKind:
+        case PostExprKind:
+            return true;
+    }
+
+    return false;
+}
+
+// Strings in the order they were first seen, each kept once
+class StringTable {
+    public:
+        std::vector<AstFileString> strings;
+        std::string bytes;
+
+        StringTable() : strings({}), bytes(""), ids({}) {}
+
+        uint32_t add(std::string_view str) {
+            auto item = ids.find(std::string(str));
+
+            if (item != ids.end()) {
+                return item->second;
+            }
+
+            uint32_t id = strings.size();
+            strings.push_back({ (uint32_t) bytes.size(), (uint32_t) str.size() });
+            bytes.append(str);
+            ids.emplace(std::string(str), id);
+
+            return id;
+        }
+
+    private:
+        std::unordered_map<std::string, uint32_t> ids;
+};
+
+static std::string_view node_text(const ASTNode * node) {
+    switch (node->get_kind()) {
+        case ProgramSourceKind:
+            return ((ProgramSource *) node)->name;
+        case StringLiteralKind:
+            return ((StringLiteral *) node)->value;
+        case TypeIdentKind:
+            return ((TypeIdent *) node)->id;
+        case IdentKind:
+            return ((Ident *) node)->id;
+        case BoolExprKind:
+            return ((BoolExpr *) node)->op;
+        case LogicalExprKind:
+            return ((LogicalExpr *) node)->op;
+        case PreExprKind:
+            return ((PreExpr *) node)->op;
+        case PostExprKind:
+            return ((PostExpr *) node)->op;
+    }
+
+    return "";
+}
+
+static int64_t node_value(const ASTNode * node, StringTable &strings) {
+    if (AstFile::has_text(node->get_kind())) {
+        return strings.add(node_text(node));
+    }
+
+    switch (node->get_kind()) {
+        case IntLiteralKind:
+            return ((IntLiteral *) node)->value;
+        case FloatLiteralKind: {
+            int64_t bits;
+            memcpy(&bits, &((FloatLiteral *) node)->value, sizeof(bits));
+            return bits;
+        }
+        case BoolLiteralKind:
+            return ((BoolLiteral *) node)->value;
+        case CharLiteralKind:
+            return ((CharLiteral *) node)->value;
+        case MathExprKind:
+            return ((MathExpr *) node)->op;
+        case StructTypenameKind:
+            return ((StructTypename *) node)->packed;
+    }
+
+    return 0;
+}
+
+static const Typename * known_type(ASTNode * node) {
+    return x::dispatch(node, [](auto * leaf) -> const Typename * {
+        if constexpr (std::is_base_of_v<Expr, std::remove_pointer_t<decltype(leaf)>>) {
+            return leaf->known_type();
+        } else {
+            return nullptr;
+        }
+    });
+}
+
+void x::write_ast(const ASTNode * root, uint64_t source_hash, std::string &out) {
+    std::vector<AstFileNode> nodes;
+    std::vector<uint32_t> children;
+    StringTable strings;
+
+    // Node index of everything written so far. A node whose children are still being
+    // written is in here as AST_FILE_NONE
+    std::unordered_map<const ASTNode *, uint32_t> ids;
+
+    // Depth first, with each node written after its children and its type
+    std::vector<std::pair<ASTNode *, bool>> stack = {{(ASTNode *) root, false}};
+
+    auto index = [&ids](const ASTNode * node) {
+        return node == nullptr ? AST_FILE_NONE : ids.at(node);
+    };
+
+    while (!stack.empty()) {
+        auto [node, expanded] = stack.back();
+        const Typename * type = known_type(node);
+
+        if (!expanded) {
+            if (ids.count(node) > 0) {
+                stack.pop_back();
+                continue;
+            }
+
+            ids[node] = AST_FILE_NONE;
+            stack.back().second = true;
+
+            if (type != nullptr) {
+                stack.push_back({(ASTNode *) type, false});
+            }
+
+            node->each_child([&stack](ASTNode * child) {
+                if (child != nullptr) {
+                    stack.push_back({child, false});
+                }
+
+                return true;
+            });
+
+            continue;
+        }
+
+        stack.pop_back();
+
+        AstFileNode record = {};
+        record.kind = node->get_kind();
+        record.first_child = children.size();
+        record.begin = node->loc.begin;
+        record.end = node->loc.end;
+        record.type = index(type);
+        record.value = node_value(node, strings);
+
+        node->each_child([&](ASTNode * child) {
+            children.push_back(index(child));
+            return true;
+        });
+
+        record.child_count = children.size() - record.first_child;
+        ids[node] = nodes.size();
+        nodes.push_back(record);
+    }
+
+    AstFileHeader header = {};
+    memcpy(header.magic, AST_FILE_MAGIC, sizeof(AST_FILE_MAGIC));
+    header.version = AST_FILE_VERSION;
+    header.kind_count = NUM_NODE_KINDS;
+    header.root = nodes.size() - 1;
+    header.node_count = nodes.size();
+    header.child_count = children.size();
+    header.string_count = strings.strings.size();
+    header.string_bytes = strings.bytes.size();
+    header.source_hash = source_hash;
+
+    out.append((const char *) &header, sizeof(header));
+    out.append((const char *) nodes.data(), nodes.size() * sizeof(AstFileNode));
+    out.append((const char *) children.data(), children.size() * sizeof(uint32_t));
+    out.append((const char *) strings.strings.data(), strings.strings.size() * sizeof(AstFileString));
+    out.append(strings.bytes);
+}
+
+AstFile::AstFile()
+    :   head(nullptr),
+        nodes(nullptr),
+        child_ids(nullptr),
+        strings(nullptr),
+        string_bytes(nullptr),
+        mapped_size(0)
+{}
+
+AstFile::~AstFile() {
+    if (mapped_size > 0) {
+        munmap((void *) head, mapped_size);
+    }
+}
+
+std::string_view AstFile::text(uint32_t index) const {
+    if (!has_text(nodes[index].kind)) {
+        return "";
+    }
+
+    const AstFileString &str = strings[nodes[index].value];
+
+    return std::string_view(string_bytes + str.offset, str.size);
+}
+
+// Everything that later reads trust: sizes add up, and every index is in range and
+// points back toward the start of the file
+static bool valid(const unsigned char * data, size_t size) {
+    const AstFileHeader * head = (const AstFileHeader *) data;
+
+    if ((uintptr_t) data % alignof(AstFileNode) != 0 || size < sizeof(AstFileHeader)) {
+        return false;
+    }
+
+    if (memcmp(head->magic, AST_FILE_MAGIC, sizeof(AST_FILE_MAGIC)) != 0 || head->version != AST_FILE_VERSION ||
+            head->kind_count != NUM_NODE_KINDS || head->node_count == 0 || head->root != head->node_count - 1) {
+        return false;
+    }
+
+    uint64_t expected = sizeof(AstFileHeader)
+        + (uint64_t) head->node_count * sizeof(AstFileNode)
+        + (uint64_t) head->child_count * sizeof(uint32_t)
+        + (uint64_t) head->string_count * sizeof(AstFileString)
+        + head->string_bytes;
+
+    if (expected != size) {
+        return false;
+    }
+
+    const AstFileNode * nodes = (const AstFileNode *) (head + 1);
+    const uint32_t * children = (const uint32_t *) (nodes + head->node_count);
+    const AstFileString * strings = (const AstFileString *) (children + head->child_count);
+
+    for (uint32_t i = 0; i < head->node_count; i++) {
+        const AstFileNode &node = nodes[i];
+
+        if (node.kind >= NUM_NODE_KINDS || (uint64_t) node.first_child + node.child_count > head->child_count) {
+            return false;
+        }
+
+        if (node.type != AST_FILE_NONE && node.type >= i) {
+            return false;
+        }
+
+        if (AstFile::has_text(node.kind) && (node.value < 0 || node.value >= head->string_count)) {
+            return false;
+        }
+
+        for (uint32_t j = 0; j < node.child_count; j++) {
+            uint32_t child = children[node.first_child + j];
+
+            if (child != AST_FILE_NONE && child >= i) {
+                return false;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < head->string_count; i++) {
+        if ((uint64_t) strings[i].offset + strings[i].size > head->string_bytes) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+AstFile * AstFile::from_bytes(const unsigned char * data, size_t size, int * error) {
+    if (!valid(data, size)) {
+        *error = EINVAL;
+        return nullptr;
+    }
+
+    AstFile * out = new AstFile();
+    out->head = (const AstFileHeader *) data;
+    out->nodes = (const AstFileNode *) (out->head + 1);
+    out->child_ids = (const uint32_t *) (out->nodes + out->head->node_count);
+    out->strings = (const AstFileString *) (out->child_ids + out->head->child_count);
+    out->string_bytes = (const char *) (out->strings + out->head->string_count);
+
+    return out;
+}
+
+AstFile * AstFile::open(const char * path, int * error) {
+    int fd = ::open(path, O_RDONLY);
+
+    if (fd < 0) {
+        *error = errno;
+        return nullptr;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0) {
+        *error = errno;
+        close(fd);
+        return nullptr;
+    }
+
+    if (st.st_size < (off_t) sizeof(AstFileHeader)) {
+        *error = EINVAL;
+        close(fd);
+        return nullptr;
+    }
+
+    size_t size = st.st_size;
+    void * data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        *error = errno;
+        return nullptr;
+    }
+
+    AstFile * out = AstFile::from_bytes((const unsigned char *) data, size, error);
+
+    if (out == nullptr) {
+        munmap(data, size);
+        return nullptr;
+    }
+
+    out->mapped_size = size;
+
+    return out;
+}
@@ -0,0 +1,152 @@
+/**
+ * Binary form of a parsed and typechecked AST, for caching a tree or handing it to
+ * another stage without parsing it again. The file is laid out so it can be used
+ * straight from a read-only mapping: AstFile checks it once when it's opened, then
+ * hands out pointers into it, and nothing is copied or rebuilt.
+ *
+ * In order, a file has:
+ *   - an AstFileHeader
+ *   - the nodes, an array of AstFileNode. Every node comes after its children and
+ *     its type, so the root is last and a file can't hold a cycle
+ *   - the children, an array of node indices. Each node's children are a run of it
+ *   - the strings, an array of AstFileString, each pointing into...
+ *   - the string bytes, with every distinct string kept once
+ *
+ * A node's kind is its index in x::kind_map. Names, operators and literal values
+ * are in the node's 'value' field (see AstFile::text for the ones that are
+ * strings), and an expression that has been typed points at the node for its
+ * type. Shared nodes (see ASTNode::is_shared) are stored once and referred to from
+ * every parent. Scopes and anything else worked out from the tree are left out.
+ *
+ * Integers are in host byte order, so a file is only meant to be read on the kind
+ * of machine that wrote it. The header has a version and the number of node kinds,
+ * and a file is refused if either doesn't match this build.
+ */
+#ifndef SRC_AST_FILE_H
+#define SRC_AST_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <string_view>
+
+#include "ast.h"
+
+#define AST_FILE_VERSION 1
+
+// In place of a node index: a null child, or an expression with no type
+#define AST_FILE_NONE UINT32_MAX
+
+struct AstFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t kind_count;
+    uint32_t root;
+    uint32_t node_count;
+    uint32_t child_count;
+    uint32_t string_count;
+    uint32_t string_bytes;
+
+    // Whatever the writer was given, normally a hash of the source text, so a cache
+    // can tell whether a file is stale
+    uint64_t source_hash;
+};
+
+typedef struct AstFileHeader AstFileHeader;
+
+struct AstFileNode {
+    uint16_t kind;
+    uint16_t unused;
+    uint32_t first_child;
+    uint32_t child_count;
+    uint32_t begin;
+    uint32_t end;
+
+    // Node index of an expression's type
+    uint32_t type;
+
+    // A literal's value, an operator character, a string index or a flag, depending
+    // on the kind
+    int64_t value;
+};
+
+typedef struct AstFileNode AstFileNode;
+
+struct AstFileString {
+    uint32_t offset;
+    uint32_t size;
+};
+
+typedef struct AstFileString AstFileString;
+
+class AstFile {
+    public:
+        /**
+         * Maps the file at 'path' and checks it. Returns nullptr and sets 'error' to
+         * an errno value if it can't be read, or to EINVAL if it isn't a valid file
+         * for this build.
+         */
+        static AstFile * open(const char * path, int * error);
+
+        // Checks a file already in memory. 'data' isn't copied, so it has to outlive
+        // the AstFile, and it has to be 8 byte aligned
+        static AstFile * from_bytes(const unsigned char * data, size_t size, int * error);
+
+        ~AstFile();
+
+        const AstFileHeader &header() const {
+            return *head;
+        }
+
+        uint32_t root() const {
+            return head->root;
+        }
+
+        uint32_t size() const {
+            return head->node_count;
+        }
+
+        const AstFileNode &node(uint32_t index) const {
+            return nodes[index];
+        }
+
+        // Indices of a node's children, some of which can be AST_FILE_NONE
+        const uint32_t * children(uint32_t index) const {
+            return child_ids + nodes[index].first_child;
+        }
+
+        Location loc(uint32_t index) const {
+            return Location(nodes[index].begin, nodes[index].end);
+        }
+
+        // The name, operator or string literal of a node, or an empty string for
+        // kinds that don't have one
+        std::string_view text(uint32_t index) const;
+
+        // Whether the value of nodes of this kind is a string index
+        static bool has_text(int kind);
+
+    private:
+        const AstFileHeader * head;
+        const AstFileNode * nodes;
+        const uint32_t * child_ids;
+        const AstFileString * strings;
+        const char * string_bytes;
+
+        // Length of the mapping, or 0 if the caller owns the data
+        size_t mapped_size;
+
+        AstFile();
+};
+
+namespace x {
+    /**
+     * Appends the tree under 'root' to 'out'. Every expression that has been typed
+     * keeps its type, so this is best done after typechecking. Uses no recursion,
+     * so trees of any depth can be written.
+     */
+    void write_ast(const ASTNode * root, uint64_t source_hash, std::string &out);
+}
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * Blocking FIFO queue with a fixed capacity, used to connect the stages of the
+ * streaming pipeline. push() blocks while the queue is full, so a fast stage can't
+ * get more than 'capacity' items ahead of a slow one. pop() blocks while the queue
+ * is empty and returns false once the queue has been closed and drained.
+ */
+#ifndef SRC_BOUNDED_QUEUE_H
+#define SRC_BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+template <typename T>
+class BoundedQueue {
+    public:
+        BoundedQueue(size_t capacity) : capacity(capacity), closed(false) {}
+
+        void push(T item) {
+            std::unique_lock<std::mutex> guard(lock);
+            not_full.wait(guard, [this]() {
+                return items.size() < capacity;
+            });
+
+            items.push_back(std::move(item));
+            not_empty.notify_one();
+        }
+
+        bool pop(T &item) {
+            std::unique_lock<std::mutex> guard(lock);
+            not_empty.wait(guard, [this]() {
+                return closed || !items.empty();
+            });
+
+            if (items.empty()) {
+                return false;
+            }
+
+            item = std::move(items.front());
+            items.pop_front();
+            not_full.notify_one();
+
+            return true;
+        }
+
+        // No more items will be pushed
+        void close() {
+            std::lock_guard<std::mutex> guard(lock);
+            closed = true;
+            not_empty.notify_all();
+        }
+
+    private:
+        size_t capacity;
+        bool closed;
+        std::deque<T> items;
+        std::mutex lock;
+        std::condition_variable not_full;
+        std::condition_variable not_empty;
+};
+
+#endif
@@ -2,16 +2,11 @@
 
 #include "parser.h"
 
-NamesToNames x::symtable_to_names(NamesToNames * parent, SymbolTable * symtable) {
+NamesToNames x::symtable_to_names(CompilationContext * ctx, NamesToNames * parent, const SymbolTable * symtable) {
     NamesToNames out;
 
     for (auto &item : symtable->table) {
-        if (item.first == "main") {
-            out.name_map[item.first] = item.first;
-            continue;
-        }
-
-        out.name_map[item.first] = next_p();
+        x::add_name(ctx, out, item.first);
     }
 
     out.parent = parent;
@@ -19,18 +14,39 @@ NamesToNames x::symtable_to_names(NamesToNames * parent, SymbolTable * symtable)
     return out;
 }
 
-std::optional<std::string> NamesToNames::get(std::string name) {
-    if (name_map.count(name)) {
-        return std::optional<std::string>(name_map[name]);
-    } else if (parent != nullptr) {
-        return parent->get(name);
+void x::add_name(CompilationContext * ctx, NamesToNames &names, const std::string &name) {
+    if (name == "main") {
+        names.name_map[name] = name;
+        return;
     }
 
-    return std::nullopt;
+    names.name_map[name] = ctx->next_p();
+}
+
+NamesToNames x::global_names(CompilationContext * ctx, const ProgramSource * src) {
+    NamesToNames out = x::symtable_to_names(ctx, nullptr, ctx->prelude);
+
+    for (auto &node : src->nodes) {
+        const Ident * ident = x::declared_name(node);
+
+        if (ident != nullptr) {
+            x::add_name(ctx, out, ident->id);
+        }
+    }
+
+    return out;
 }
 
-CodeGenerator::CodeGenerator(const BasicBlock * b) : blocks(b) {}
+std::optional<std::string> NamesToNames::get(std::string name) const {
+    auto item = name_map.find(name);
 
-CodeGenerator::~CodeGenerator() {
-    delete blocks;
+    // Generating functions in parallel shares the global names, so this must not
+    // insert into the map
+    if (item != name_map.end()) {
+        return std::optional<std::string>(item->second);
+    } else if (parent != nullptr) {
+        return parent->get(name);
+    }
+
+    return std::nullopt;
 }
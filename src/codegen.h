@@ -3,28 +3,29 @@
 
 #include <optional>
 
-#include "tac.h"
+#include "context.h"
+#include "symtable.h"
 #include "map"
 
+class ProgramSource;
+
 class NamesToNames {
     public:
     NamesToNames * parent = nullptr; 
     std::map<std::string, std::string> name_map;
 
-    std::optional<std::string> get(std::string name);
+    std::optional<std::string> get(std::string name) const;
 };
 
 namespace x {
-    NamesToNames symtable_to_names(NamesToNames * parent, SymbolTable * symtable);
-}
-
-class CodeGenerator {
+    NamesToNames symtable_to_names(CompilationContext * ctx, NamesToNames * parent, const SymbolTable * symtable);
 
-    void generate_code(const BasicBlock * b);
+    // Gives a single source name a generated name
+    void add_name(CompilationContext * ctx, NamesToNames &names, const std::string &name);
 
-    public:
-        const BasicBlock * blocks;
-        CodeGenerator(const BasicBlock * b);
-        ~CodeGenerator();
-};
+    // Names for the global scope: the prelude's, then each top-level declaration's in
+    // source order. --stream hands them out the same way as declarations are parsed,
+    // so both give the same asm
+    NamesToNames global_names(CompilationContext * ctx, const ProgramSource * src);
+}
 #endif
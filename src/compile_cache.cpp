@@ -0,0 +1,112 @@
+#include "compile_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash.h"
+
+static const char ENTRY_MAGIC[4] = {'X', 'C', 'C', 'E'};
+
+// Followed by the inputs, the diagnostics and the assembly
+struct EntryHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t inputs_size;
+    int32_t error;
+    uint32_t diagnostics_size;
+    uint64_t assembly_size;
+};
+
+static std::string entry_path(const std::string &dir, const std::string &inputs) {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.xcc", (unsigned long long) x::hash_bytes(inputs.data(), inputs.size()));
+
+    return dir + name;
+}
+
+bool x::cache_load(const std::string &dir, const std::string &inputs, CacheEntry &entry) {
+    FILE * file = fopen(entry_path(dir, inputs).c_str(), "rb");
+
+    if (file == nullptr) {
+        return false;
+    }
+
+    struct stat st;
+    EntryHeader header;
+    bool ok = fstat(fileno(file), &st) == 0
+        && fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC)) == 0
+        && header.version == CACHE_ENTRY_VERSION
+        && header.inputs_size == inputs.size();
+
+    // The sizes have to add up to the file's, so a damaged header can't make us
+    // allocate more than is there
+    uint64_t body_size = (uint64_t) st.st_size - sizeof(header);
+
+    ok = ok && header.diagnostics_size <= body_size && header.assembly_size <= body_size
+        && header.inputs_size + header.diagnostics_size + header.assembly_size == body_size;
+
+    if (ok) {
+        std::string stored(header.inputs_size, '\0');
+
+        ok = fread(&stored[0], 1, stored.size(), file) == stored.size() && stored == inputs;
+    }
+
+    if (ok) {
+        entry.error = header.error;
+        entry.diagnostics.resize(header.diagnostics_size);
+        entry.assembly.resize(header.assembly_size);
+
+        ok = fread(&entry.diagnostics[0], 1, header.diagnostics_size, file) == header.diagnostics_size
+            && fread(&entry.assembly[0], 1, header.assembly_size, file) == header.assembly_size;
+    }
+
+    fclose(file);
+
+    return ok;
+}
+
+bool x::cache_store(const std::string &dir, const std::string &inputs, const CacheEntry &entry) {
+    std::string path = entry_path(dir, inputs);
+    std::string tmp_path = path + ".XXXXXX";
+    int fd = mkstemp(&tmp_path[0]);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    FILE * file = fdopen(fd, "wb");
+
+    if (file == nullptr) {
+        close(fd);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    EntryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+    header.version = CACHE_ENTRY_VERSION;
+    header.inputs_size = inputs.size();
+    header.error = entry.error;
+    header.diagnostics_size = entry.diagnostics.size();
+    header.assembly_size = entry.assembly.size();
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(inputs.data(), 1, inputs.size(), file) == inputs.size()
+        && fwrite(entry.diagnostics.data(), 1, entry.diagnostics.size(), file) == entry.diagnostics.size()
+        && fwrite(entry.assembly.data(), 1, entry.assembly.size(), file) == entry.assembly.size();
+
+    ok = fclose(file) == 0 && ok;
+
+    // Rename is atomic, so readers see either the whole entry or none of it
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
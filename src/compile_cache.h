@@ -0,0 +1,33 @@
+/**
+ * On-disk cache of compiler output. An entry is looked up by its inputs: a string
+ * holding everything the output depends on (see x::compile). Each entry is one file
+ * in the cache directory named after a hash of its inputs, and keeps a copy of the
+ * inputs, so a hash collision or a damaged file reads as a miss rather than someone
+ * else's output. Entries are written to a temporary file and renamed into place, so
+ * several compilers can share a directory and a reader never sees half an entry.
+ */
+#ifndef SRC_COMPILE_CACHE_H
+#define SRC_COMPILE_CACHE_H
+
+#include <string>
+
+#define CACHE_ENTRY_VERSION 2
+
+struct CacheEntry {
+    int error;
+    std::string diagnostics;
+    std::string assembly;
+};
+
+typedef struct CacheEntry CacheEntry;
+
+namespace x {
+    // Returns false if there is no entry for 'inputs' or it can't be read
+    bool cache_load(const std::string &dir, const std::string &inputs, CacheEntry &entry);
+
+    // Returns false if the entry couldn't be written. The cache is only an
+    // optimization, so callers can ignore this
+    bool cache_store(const std::string &dir, const std::string &inputs, const CacheEntry &entry);
+}
+
+#endif
@@ -0,0 +1,105 @@
+#include "compiler.h"
+
+#include <string.h>
+
+#include <sstream>
+
+#include "asm_utils.h"
+#include "parseutils.h"
+#include "source_buffer.h"
+
+static Diagnostic to_diagnostic(const CompilerError &error, const LineTable &lines) {
+    Diagnostic out = { error.level, error.message, error.loc, 0, 0, 0, 0 };
+
+    lines.resolve(error.loc.begin, &out.line, &out.col);
+    lines.resolve(error.loc.end, &out.end_line, &out.end_col);
+
+    return out;
+}
+
+// A problem that isn't tied to a location in the source
+static Diagnostic whole_source(const std::string &message) {
+    return { Error, message, x::NULL_LOC, 0, 0, 0, 0 };
+}
+
+static void add_errors(const SourceErrors &errors, SourceBuffer * source, std::vector<Diagnostic> &out) {
+    if (!errors.has_errors()) {
+        return;
+    }
+
+    const LineTable &lines = source->lines();
+
+    for (auto &error : errors.parse_errors) {
+        out.push_back(to_diagnostic(error, lines));
+    }
+
+    for (auto &error : errors.type_errors) {
+        out.push_back(to_diagnostic(error, lines));
+    }
+
+    for (auto &error : errors.codegen_errors) {
+        out.push_back(to_diagnostic(error, lines));
+    }
+}
+
+CompileOutput x::compile_bytes(CompilationContext &ctx, const char * data, size_t size,
+                               const CompileOptions &options, ThreadPool * pool) {
+    CompileOutput output = { 0, "", {} };
+    int error = 0;
+    SourceBuffer * source = SourceBuffer::from_bytes(data, size, &error);
+
+    if (source == nullptr) {
+        output.error = 1;
+        output.diagnostics.push_back(whole_source(strerror(error)));
+        return output;
+    }
+
+    ctx.reset();
+    ctx.use_fast_lexer = options.fast_lexer;
+    ctx.set_reorder_fields(options.reorder_fields);
+
+    ParseResult result = x::parse_buffer(ctx, source, options.name);
+
+    if (result.parser_state == nullptr) {
+        output.error = 1;
+        output.diagnostics.push_back(whole_source(strerror(result.error)));
+        return output;
+    }
+
+    ParserState * state = result.parser_state;
+
+    if (result.error) {
+        for (auto &item : state->errors.sources) {
+            add_errors(item.second, state->source, output.diagnostics);
+        }
+
+        output.error = 1;
+
+        // Syntax errors have been added already, so this is for running out of memory
+        if (output.diagnostics.empty()) {
+            output.diagnostics.push_back(whole_source("Could not parse " + options.name));
+        }
+
+        return output;
+    }
+
+    SourceErrors &errors = state->errors.sources[state->top];
+    state->top->typecheck(state->symtable, errors, pool);
+
+    std::ostringstream assembly;
+
+    if (x::generate_assembly(ctx, state->top, state->symtable, assembly, errors, pool)) {
+        output.assembly = assembly.str();
+    } else {
+        output.error = 1;
+    }
+
+    add_errors(errors, state->source, output.diagnostics);
+
+    return output;
+}
+
+CompileOutput x::compile_string(CompilationContext &ctx, const std::string &code,
+                                const CompileOptions &options, ThreadPool * pool) {
+    return x::compile_bytes(ctx, code.data(), code.size(), options, pool);
+}
@@ -0,0 +1,74 @@
+/**
+ * Compiles a program held in memory, for embedding the compiler in another process
+ * (this is what libxc.a is for). Nothing is read from or written to files: the
+ * source comes in as bytes, and the assembly and diagnostics come back as values.
+ *
+ * The caller owns the CompilationContext and can reuse it for any number of
+ * compiles; it is reset at the start of each one. Like any context it must not be
+ * used by two threads at once, but separate contexts can compile in parallel.
+ */
+#ifndef SRC_COMPILER_H
+#define SRC_COMPILER_H
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "context.h"
+#include "errors.h"
+#include "thread_pool.h"
+
+struct Diagnostic {
+    ErrorLevel level;
+    std::string message;
+
+    // Byte offsets into the source
+    Location loc;
+
+    // 1 based, or 0 for problems with the whole source rather than a part of it
+    int line;
+    int col;
+    int end_line;
+    int end_col;
+};
+
+typedef struct Diagnostic Diagnostic;
+
+struct CompileOptions {
+    // Name of the source, as in "Could not parse <name>"
+    std::string name;
+
+    // Scan with FastLexer instead of flex
+    bool fast_lexer;
+
+    // Lay struct members out by alignment instead of in declaration order
+    bool reorder_fields;
+};
+
+typedef struct CompileOptions CompileOptions;
+
+struct CompileOutput {
+    // 0 if assembly was generated. Type errors are reported in 'diagnostics' but,
+    // as with the command line compiler, don't stop code generation
+    int error;
+
+    std::string assembly;
+
+    // Parse errors, then type errors, then code that couldn't be generated, each in
+    // the order they were found
+    std::vector<Diagnostic> diagnostics;
+};
+
+typedef struct CompileOutput CompileOutput;
+
+namespace x {
+    // If a pool is given, functions are generated in parallel on it
+    CompileOutput compile_bytes(CompilationContext &ctx, const char * data, size_t size,
+                                const CompileOptions &options, ThreadPool * pool = nullptr);
+
+    CompileOutput compile_string(CompilationContext &ctx, const std::string &code,
+                                 const CompileOptions &options, ThreadPool * pool = nullptr);
+}
+
+#endif
@@ -0,0 +1,62 @@
+#include "context.h"
+
+#include <utility>
+
+#include "type_interner.h"
+
+CompilationContext::CompilationContext() : CompilationContext(x::prelude_symtable()) {}
+
+CompilationContext::CompilationContext(const SymbolTable * prelude)
+    :   CompilationContext(prelude, std::make_shared<TypeInterner>())
+{}
+
+CompilationContext::CompilationContext(const SymbolTable * prelude, std::shared_ptr<TypeInterner> types)
+    :   prelude(prelude),
+        use_fast_lexer(false),
+        types(std::move(types)),
+        name_prefix(""),
+        temp_count(0),
+        label_count(0),
+        param_count(0)
+{}
+
+CompilationContext CompilationContext::fork(const std::string &prefix) const {
+    CompilationContext out(prelude, types);
+    out.use_fast_lexer = use_fast_lexer;
+    out.name_prefix = name_prefix + prefix;
+
+    return out;
+}
+
+void CompilationContext::reset() {
+    bool reorder = types->reorder_fields;
+
+    types = std::make_shared<TypeInterner>();
+    types->reorder_fields = reorder;
+    temp_count = 0;
+    label_count = 0;
+    param_count = 0;
+}
+
+void CompilationContext::set_reorder_fields(bool reorder) {
+    types->reorder_fields = reorder;
+}
+
+std::string CompilationContext::next_t() {
+    return "_t" + name_prefix + std::to_string(temp_count++);
+}
+
+std::string CompilationContext::next_l() {
+    return ".L" + name_prefix + std::to_string(label_count++);
+}
+
+std::string CompilationContext::next_p() {
+    return "_p" + name_prefix + std::to_string(param_count++);
+}
+
+SymbolTable * CompilationContext::default_symtable() const {
+    SymbolTable * out = prelude->clone();
+    out->types = types.get();
+
+    return out;
+}
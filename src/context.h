@@ -0,0 +1,78 @@
+/**
+ * State that belongs to a single compilation. Everything that used to be a global
+ * (the temporary/label/parameter name counters, the prelude symbol table) lives in
+ * a CompilationContext so that several compilations can run at the same time in
+ * one process, each with its own context. The context
+ * is passed through parsing (via ParserState), codegen and asm generation.
+ *
+ * A context is not thread safe itself; don't share one between threads. The prelude
+ * symbol table it points to is built once and only ever read, so it can be shared.
+ */
+#ifndef SRC_CONTEXT_H
+#define SRC_CONTEXT_H
+
+#include <memory>
+#include <string>
+
+#include "symtable.h"
+
+class TypeInterner;
+
+class CompilationContext {
+    public:
+        // Symbol table with primitive types and builtin functions. Not owned
+        const SymbolTable * prelude;
+
+        // Scan sources with FastLexer instead of the flex scanner
+        bool use_fast_lexer;
+
+        // Types of expressions, shared with forks. Symbol tables made by
+        // default_symtable() point to it
+        std::shared_ptr<TypeInterner> types;
+
+        // Uses the shared prelude from x::prelude_symtable()
+        CompilationContext();
+
+        CompilationContext(const SymbolTable * prelude);
+
+        // Shares 'types' instead of making a new interner
+        CompilationContext(const SymbolTable * prelude, std::shared_ptr<TypeInterner> types);
+
+        /**
+         * Returns a context that shares the prelude but generates its own names, all
+         * starting with 'prefix'. Parts of a program can be generated in parallel on
+         * forks without names clashing, and the names don't depend on scheduling.
+         */
+        CompilationContext fork(const std::string &prefix) const;
+
+        // Forgets the names and types handed out so far, so the context can be
+        // used for another compilation. Keeps the prelude and options
+        void reset();
+
+        // Lay struct members out by alignment (see TypeInterner::reorder_fields). The
+        // flag is kept on the interner, so forks sharing it lay them out the same way
+        void set_reorder_fields(bool reorder);
+
+        std::string next_t();
+        std::string next_l();
+        std::string next_p();
+
+        // Returns a new copy of the prelude for a source file. The caller owns it
+        SymbolTable * default_symtable() const;
+
+    private:
+        // Put after the leading '_t', '.L' or '_p' in every generated name
+        std::string name_prefix;
+
+        int temp_count;
+        int label_count;
+        int param_count;
+};
+
+namespace x {
+    // Parses the builtin declarations the first time it's called. Safe to call from
+    // several threads
+    const SymbolTable * prelude_symtable();
+}
+
+#endif
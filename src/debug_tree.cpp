@@ -1,79 +1,187 @@
-#include <queue>
+#include <stdio.h>
 
-#include "ast.h"
+#include <vector>
 
-struct UniqueNode {
-    ASTNode * node;
-    int id;
-};
+#include "ast.h"
 
-static struct UniqueNode with_id(ASTNode * node, int * id) {
-    struct UniqueNode out = {.node = node, .id = *id};
+// Output is written to the stream in pieces about this big
+#define TREE_BUFFER_SIZE (64 * 1024)
 
-    (*id)++;
+// Appends the name, type name or value of a node, or the name of its kind
+static void append_label(std::string &out, ASTNode * node) {
+    char num[64];
 
-    return out;
+    if (node->get_kind() == Ident::kind) {
+        out += ((Ident *) node)->id;
+    } else if (node->get_kind() == TypeIdent::kind) {
+        out += ((TypeIdent *) node)->id;
+    } else if (node->get_kind() == IntLiteral::kind) {
+        snprintf(num, sizeof(num), "%d", ((IntLiteral *) node)->value);
+        out += num;
+    } else if (node->get_kind() == FloatLiteral::kind) {
+        snprintf(num, sizeof(num), "%f", ((FloatLiteral *) node)->value);
+        out += num;
+    } else if (node->get_kind() == BoolLiteral::kind) {
+        out += ((BoolLiteral *) node)->value ? "true" : "false";
+    } else {
+        out += x::kind_map[node->get_kind()];
+    }
 }
 
-static std::string label(ASTNode * node) {
-    if (node->get_kind() == Ident::kind) {
-        Ident * ident = (Ident *)node;
+// Escapes what was added to 'out' since 'start', for a quoted dot or JSON string.
+// Labels almost never need it, so they're only copied when one does
+static void escape_from(std::string &out, size_t start) {
+    size_t i = start;
 
-        return ident->id;
+    while (i < out.size() && out[i] != '"' && out[i] != '\\' && (unsigned char) out[i] >= 0x20) {
+        i++;
     }
 
-    if (node->get_kind() == TypeIdent::kind) {
-        TypeIdent * ident = (TypeIdent *)node;
+    if (i == out.size()) {
+        return;
+    }
 
-        return ident->id;
+    std::string rest = out.substr(i);
+    out.resize(i);
+
+    for (char c : rest) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char) c < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            out += code;
+        } else {
+            out += c;
+        }
     }
+}
 
-    if (node->get_kind() == IntLiteral::kind) {
-        IntLiteral * lit = (IntLiteral *)node;
+class TreeWriter : public TreeVisitor {
+    public:
+        TreeWriter(std::ostream &out, TreeFormat format, int max_depth)
+            :   out(out),
+                format(format),
+                max_depth(max_depth),
+                buf(""),
+                parents({}),
+                next_id(0),
+                first(true)
+        {
+            buf.reserve(TREE_BUFFER_SIZE + 256);
+        }
 
-        return std::to_string(lit->value);
-    }
+        void begin() {
+            if (format == TreeDot) {
+                buf += "digraph ExpressionTree {\n";
+            }
+        }
 
-    if (node->get_kind() == FloatLiteral::kind) {
-        FloatLiteral * lit = (FloatLiteral *)node;
+        void end() {
+            buf += format == TreeDot ? "}\n" : "\n";
+            out.write(buf.data(), buf.size());
+            out.flush();
+        }
 
-        return std::to_string(lit->value);
-    }
+        virtual WalkAction pre(ASTNode * node) {
+            if (format == TreeDot) {
+                write_dot(node);
+            } else {
+                write_json(node);
+            }
 
-    if (node->get_kind() == BoolLiteral::kind) {
-        BoolLiteral * lit = (BoolLiteral *)node;
+            maybe_flush();
 
-        return std::string(lit->value ? "true" : "false");
-    }
+            // The node is written, but not its children
+            if (max_depth >= 0 && parents.size() > (size_t) max_depth) {
+                return WalkSkip;
+            }
 
-    return x::kind_map[node->get_kind()];
-}
+            return WalkContinue;
+        }
 
-void x::tree_dotfile(std::ostream &out, ProgramSource * prog) {
-    std::queue<struct UniqueNode> nodes;
-    int id = 0;
+        virtual WalkAction post(ASTNode * node) {
+            parents.pop_back();
 
-    out << "digraph ExpressionTree {\n";
+            if (format == TreeJson) {
+                buf += "]}";
+                first = false;
+            }
 
-    nodes.push(with_id(prog, &id));
+            return WalkContinue;
+        }
+
+    private:
+        std::ostream &out;
+        TreeFormat format;
+        int max_depth;
+        std::string buf;
 
-    while (!nodes.empty()) {
-        struct UniqueNode node = nodes.front();
-        nodes.pop();
+        // Ids of the nodes being written, outermost first
+        std::vector<int> parents;
+        int next_id;
 
-        out << "    node" << node.id << " [label=\"" << label(node.node);
-        out << "\"]" << std::endl;
+        // No sibling has been written yet, so a JSON object needs no comma
+        bool first;
 
-        std::vector<ASTNode *> children = node.node->children();
+        void maybe_flush() {
+            if (buf.size() >= TREE_BUFFER_SIZE) {
+                out.write(buf.data(), buf.size());
+                buf.clear();
+            }
+        }
 
-        for (auto &item : children) {
-            struct UniqueNode child = with_id(item, &id);
+        void write_dot(ASTNode * node) {
+            int id = next_id++;
+            char num[64];
 
-            out << "    node" << node.id << " -> node" << child.id << std::endl;
+            snprintf(num, sizeof(num), "    node%d [label=\"", id);
+            buf += num;
+            append_label_escaped(node);
+            buf += "\"]\n";
 
-            nodes.push(child);
+            if (!parents.empty()) {
+                snprintf(num, sizeof(num), "    node%d -> node%d\n", parents.back(), id);
+                buf += num;
+            }
+
+            parents.push_back(id);
         }
-    }
 
-    out << "}" << std::endl;
+        void write_json(ASTNode * node) {
+            char num[64];
+
+            if (!first) {
+                buf += ',';
+            }
+
+            buf += "{\"kind\":\"";
+            buf += x::kind_map[node->get_kind()];
+            buf += "\",\"label\":\"";
+            append_label_escaped(node);
+            snprintf(num, sizeof(num), "\",\"begin\":%u,\"end\":%u,\"children\":[", node->loc.begin, node->loc.end);
+            buf += num;
+
+            parents.push_back(next_id++);
+            first = true;
+        }
+
+        void append_label_escaped(ASTNode * node) {
+            size_t start = buf.size();
+            append_label(buf, node);
+            escape_from(buf, start);
+        }
+};
+
+void x::dump_tree(std::ostream &out, ASTNode * root, TreeFormat format, int max_depth) {
+    TreeWriter writer(out, format, max_depth);
+
+    writer.begin();
+    x::walk(root, writer);
+    writer.end();
+}
+
+void x::tree_dotfile(std::ostream &out, ProgramSource * prog) {
+    x::dump_tree(out, prog, TreeDot, -1);
 }
@@ -0,0 +1,337 @@
+#include "driver.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include "asm_utils.h"
+#include "ast_file.h"
+#include "bounded_queue.h"
+#include "codegen.h"
+#include "compile_cache.h"
+#include "context.h"
+#include "errors.h"
+#include "hash.h"
+#include "parseutils.h"
+#include "source_buffer.h"
+
+// Diagnostics go through a FILE * so that CompilerError::print and friends can be
+// reused, but into memory instead of stderr
+static std::string flush_diagnostics(FILE * diag, char ** buf, size_t * len) {
+    fclose(diag);
+    std::string out(*buf, *len);
+    free(*buf);
+
+    return out;
+}
+
+// Max number of declarations waiting between two pipeline stages
+#define STREAM_QUEUE_SIZE 16
+
+// Reads the job's input. Returns nullptr and sets 'diagnostics' if it can't be read
+static SourceBuffer * read_input(const CompileJob &job, std::string &diagnostics) {
+    const char * name = job.input.empty() ? "<stdin>" : job.input.c_str();
+    int error = 0;
+    SourceBuffer * source = job.input.empty()
+        ? SourceBuffer::read_file(stdin, &error)
+        : SourceBuffer::open_file(name, &error);
+
+    if (source == nullptr) {
+        diagnostics = std::string("Error: ") + name + ": " + strerror(error) + "\n";
+    }
+
+    return source;
+}
+
+static CompileResult compile_source(const CompileJob &job, SourceBuffer * source, std::ostream &out, ThreadPool * pool) {
+    char * buf = nullptr;
+    size_t len = 0;
+    FILE * diag = open_memstream(&buf, &len);
+    const char * name = job.input.empty() ? "<stdin>" : job.input.c_str();
+
+    CompilationContext ctx;
+    ctx.use_fast_lexer = job.fast_lexer;
+    ctx.set_reorder_fields(job.reorder_fields);
+
+    ParseResult result = x::parse_buffer(ctx, source, name);
+
+    if (result.parser_state == nullptr) {
+        fprintf(diag, "Error: %s: %s\n", name, strerror(result.error));
+        return { 1, flush_diagnostics(diag, &buf, &len) };
+    }
+
+    if (result.error) {
+        result.parser_state->errors.print(diag);
+        fprintf(diag, "Error: %s: %s\n", name, strerror(result.error));
+        return { 1, flush_diagnostics(diag, &buf, &len) };
+    }
+
+    SymbolTable * symtable = result.parser_state->symtable;
+    ProgramSource * top = result.parser_state->top;
+
+    SourceErrors &errors = result.parser_state->errors.sources[top];
+    top->typecheck(symtable, errors, pool);
+
+    if (!job.ast_path.empty()) {
+        std::string ast;
+        x::write_ast(top, x::hash_bytes(source->data, source->size), ast);
+
+        std::ofstream astfile(job.ast_path, std::ios::binary);
+        astfile << ast;
+    }
+
+    bool generated = x::generate_assembly(ctx, top, symtable, out, errors, pool);
+    result.parser_state->errors.print(diag);
+
+    if (!generated) {
+        return { 1, flush_diagnostics(diag, &buf, &len) };
+    }
+
+    if (!job.dot_path.empty()) {
+        ASTNode * root = top;
+
+        if (!job.graph_root.empty()) {
+            root = nullptr;
+
+            for (auto &node : top->nodes) {
+                const Ident * ident = x::declared_name(node);
+
+                if (ident != nullptr && ident->id == job.graph_root) {
+                    root = node;
+                    break;
+                }
+            }
+        }
+
+        if (root == nullptr) {
+            fprintf(diag, "Error: %s: no declaration named '%s' to graph\n", name, job.graph_root.c_str());
+            return { 1, flush_diagnostics(diag, &buf, &len) };
+        }
+
+        std::ofstream dotfile(job.dot_path);
+        x::dump_tree(dotfile, root, job.graph_format, job.graph_depth > 0 ? job.graph_depth : -1);
+    }
+
+    return { 0, flush_diagnostics(diag, &buf, &len) };
+}
+
+static CompileResult stream_source(const CompileJob &job, SourceBuffer * source, std::ostream &fs) {
+    char * buf = nullptr;
+    size_t len = 0;
+    FILE * diag = open_memstream(&buf, &len);
+    const char * name = job.input.empty() ? "<stdin>" : job.input.c_str();
+
+    typedef std::pair<ASTNode *, SymbolTable *> Decl;
+
+    CompilationContext ctx;
+    ctx.use_fast_lexer = job.fast_lexer;
+    ctx.set_reorder_fields(job.reorder_fields);
+
+    DeclSink sink;
+    BoundedQueue<Decl> to_check(STREAM_QUEUE_SIZE);
+    BoundedQueue<Decl> to_gen(STREAM_QUEUE_SIZE);
+    SourceErrors type_errors;
+    std::vector<CompilerError> codegen_errors;
+
+    sink.on_decl = [&to_check](ASTNode * node, SymbolTable * symtable) {
+        to_check.push(Decl(node, symtable));
+    };
+
+    std::thread checker([&sink, &to_check, &to_gen, &type_errors]() {
+        Decl decl;
+
+        while (to_check.pop(decl)) {
+            {
+                std::shared_lock<std::shared_mutex> guard(sink.symtable_lock);
+                ProgramSource::typecheck_decl(decl.first, decl.second, type_errors);
+            }
+
+            to_gen.push(decl);
+        }
+
+        to_gen.close();
+    });
+
+    std::thread generator([&ctx, &sink, &to_gen, &fs, &codegen_errors]() {
+        // Later declarations can't be referred to before they are parsed, so global
+        // names can be handed out as declarations arrive. Names are given out as in
+        // x::global_names, and each declaration gets a fork from x::unit_context
+        // as in x::generate_assembly, so the asm is the same as without --stream
+        NamesToNames names = x::symtable_to_names(&ctx, nullptr, ctx.prelude);
+        Decl decl;
+
+        x::asm_preamble(fs);
+
+        for (size_t i = 0; to_gen.pop(decl); i++) {
+            std::shared_lock<std::shared_mutex> guard(sink.symtable_lock);
+            const Ident * ident = x::declared_name(decl.first);
+
+            if (ident != nullptr) {
+                x::add_name(&ctx, names, ident->id);
+            }
+
+            CompilationContext fork = x::unit_context(ctx, i);
+
+            try {
+                fs << x::node_to_asm(fork, decl.first, decl.second, names);
+            } catch (CompilerError &error) {
+                codegen_errors.push_back(error);
+            }
+
+            if (decl.first->get_kind() == FuncDecl::kind) {
+                ((FuncDecl *) decl.first)->release_body();
+            }
+        }
+
+        fs << std::flush;
+    });
+
+    ParseResult result = x::parse_buffer(ctx, source, name, &sink);
+
+    to_check.close();
+    checker.join();
+    generator.join();
+
+    if (result.parser_state == nullptr) {
+        fprintf(diag, "Error: %s: %s\n", name, strerror(result.error));
+        return { 1, flush_diagnostics(diag, &buf, &len) };
+    }
+
+    if (result.parser_state->top != nullptr) {
+        SourceErrors &errors = result.parser_state->errors.sources[result.parser_state->top];
+        errors.type_errors = type_errors.type_errors;
+        errors.codegen_errors = codegen_errors;
+    }
+
+    result.parser_state->errors.print(diag);
+
+    if (result.error) {
+        fprintf(diag, "Error: %s: %s\n", name, strerror(result.error));
+        return { 1, flush_diagnostics(diag, &buf, &len) };
+    }
+
+    return { codegen_errors.empty() ? 0 : 1, flush_diagnostics(diag, &buf, &len) };
+}
+
+CompileResult x::compile_buffer(const CompileJob &job, SourceBuffer * source, std::ostream &out, ThreadPool * pool) {
+    if (job.streaming) {
+        return stream_source(job, source, out);
+    }
+
+    return compile_source(job, source, out, pool);
+}
+
+// Compiles into the job's asm file
+static CompileResult compile_to_file(const CompileJob &job, SourceBuffer * source, ThreadPool * pool) {
+    std::ofstream fs(job.asm_path);
+
+    if (!fs) {
+        delete source;
+        return { 1, "Error: " + job.asm_path + ": " + strerror(errno) + "\n" };
+    }
+
+    return x::compile_buffer(job, source, fs, pool);
+}
+
+CompileResult x::compile_streaming(const CompileJob &job) {
+    std::string diagnostics;
+    SourceBuffer * source = read_input(job, diagnostics);
+
+    if (source == nullptr) {
+        return { 1, diagnostics };
+    }
+
+    CompileJob streaming = job;
+    streaming.streaming = true;
+
+    return compile_to_file(streaming, source, nullptr);
+}
+
+// Writes 'text' to 'path'. Returns an errno value, or 0 on success
+static int write_file(const std::string &path, const std::string &text) {
+    std::ofstream fs(path);
+    fs << text;
+    fs.close();
+
+    return fs ? 0 : errno;
+}
+
+// Everything a job's output depends on, for looking it up in the cache. The input's
+// name is included because it appears in diagnostics
+static std::string cache_inputs(const CompileJob &job, const SourceBuffer * source) {
+    uint64_t prelude = x::builtins_hash();
+    uint8_t options = (job.streaming ? 1 : 0) | (job.fast_lexer ? 2 : 0) | (job.reorder_fields ? 4 : 0);
+
+    std::string inputs(COMPILER_VERSION, strlen(COMPILER_VERSION) + 1);
+    inputs.append((const char *) &prelude, sizeof(prelude));
+    inputs.append((const char *) &options, sizeof(options));
+    inputs.append(job.input.c_str(), job.input.size() + 1);
+    inputs.append(source->data, source->size);
+
+    return inputs;
+}
+
+CompileResult x::compile(const CompileJob &job, ThreadPool * pool) {
+    std::string diagnostics;
+    SourceBuffer * source = read_input(job, diagnostics);
+
+    if (source == nullptr) {
+        return { 1, diagnostics };
+    }
+
+    // The AST isn't cached, so a dot or AST file always needs a real compile
+    if (job.cache_dir.empty() || !job.dot_path.empty() || !job.ast_path.empty()) {
+        return compile_to_file(job, source, pool);
+    }
+
+    std::string inputs = cache_inputs(job, source);
+    CacheEntry entry;
+
+    if (x::cache_load(job.cache_dir, inputs, entry)) {
+        delete source;
+
+        int error = write_file(job.asm_path, entry.assembly);
+
+        if (error) {
+            return { 1, "Error: " + job.asm_path + ": " + strerror(error) + "\n" };
+        }
+
+        return { entry.error, entry.diagnostics, true };
+    }
+
+    std::ostringstream assembly;
+    CompileResult result = x::compile_buffer(job, source, assembly, pool);
+
+    if (result.error) {
+        return result;
+    }
+
+    int error = write_file(job.asm_path, assembly.str());
+
+    if (error) {
+        return { 1, result.diagnostics + "Error: " + job.asm_path + ": " + strerror(error) + "\n" };
+    }
+
+    // Failures can come from the environment (such as an unwritable output), so only
+    // successful compiles are worth keeping
+    entry = { result.error, result.diagnostics, assembly.str() };
+    x::cache_store(job.cache_dir, inputs, entry);
+
+    return result;
+}
+
+std::vector<CompileResult> x::compile_all(ThreadPool &pool, const std::vector<CompileJob> &jobs) {
+    std::vector<CompileResult> results(jobs.size());
+
+    pool.parallel_for(jobs.size(), [&pool, &jobs, &results](size_t i) {
+        results[i] = x::compile(jobs[i], &pool);
+    });
+
+    return results;
+}
@@ -0,0 +1,102 @@
+/**
+ * Compiles whole source files. Each file gets its own CompilationContext, so many
+ * files can be compiled at once on a ThreadPool. Diagnostics for a file are written
+ * into its CompileResult rather than straight to stderr; the caller prints them in
+ * input order so the output doesn't depend on scheduling.
+ *
+ * If a job has a cache directory, x::compile looks its output up by the source, the
+ * options, the prelude and COMPILER_VERSION before doing any work.
+ */
+#ifndef SRC_DRIVER_H
+#define SRC_DRIVER_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+#include "source_buffer.h"
+#include "thread_pool.h"
+
+// Part of every cache key. Change it whenever the generated code or diagnostics
+// change, so that entries made by an older compiler aren't used
+#define COMPILER_VERSION "xc 0.4"
+
+struct CompileJob {
+    // Path of the source file, or empty for stdin
+    std::string input;
+
+    // Where to write the assembly
+    std::string asm_path;
+
+    // Where to write the AST as a dot or JSON file, or empty for none
+    std::string dot_path;
+
+    // Where to write the typechecked AST as an AstFile, or empty for none
+    std::string ast_path;
+
+    // Compile with x::compile_streaming
+    bool streaming;
+
+    // Scan with FastLexer instead of flex
+    bool fast_lexer;
+
+    // Lay struct members out by alignment instead of in declaration order
+    bool reorder_fields;
+
+    // Directory of cached outputs, or empty to always compile. Not used for jobs
+    // that write a dot or AST file
+    std::string cache_dir;
+
+    // Format of the file at dot_path
+    TreeFormat graph_format;
+
+    // Top-level declaration to write instead of the whole program, or empty
+    std::string graph_root;
+
+    // Levels below the root to write, or 0 for all of them
+    int graph_depth;
+};
+
+typedef struct CompileJob CompileJob;
+
+struct CompileResult {
+    // 0 on success
+    int error;
+
+    // Everything that would have been printed to stderr
+    std::string diagnostics;
+
+    // The output came from the cache
+    bool cached;
+};
+
+typedef struct CompileResult CompileResult;
+
+namespace x {
+    // If a pool is given, functions in the file are generated in parallel on it
+    CompileResult compile(const CompileJob &job, ThreadPool * pool = nullptr);
+
+    /**
+     * Parses, typechecks and generates code at the same time. Each top-level
+     * declaration goes to a typecheck thread as soon as it has been parsed, then to a
+     * codegen thread, with bounded queues in between. A function's body is freed as
+     * soon as its asm has been written, so only a few function bodies are in memory
+     * at a time. Can't write a dot or AST file, because the bodies are gone by the
+     * end.
+     */
+    CompileResult compile_streaming(const CompileJob &job);
+
+    /**
+     * Compiles a source that has already been read, writing the assembly to 'out'.
+     * The job's input is only used as the source's name, and its asm path and cache
+     * are ignored. Takes ownership of 'source'.
+     */
+    CompileResult compile_buffer(const CompileJob &job, SourceBuffer * source, std::ostream &out,
+                                 ThreadPool * pool = nullptr);
+
+    // Compiles every job on the pool. Results are in the same order as the jobs
+    std::vector<CompileResult> compile_all(ThreadPool &pool, const std::vector<CompileJob> &jobs);
+}
+
+#endif
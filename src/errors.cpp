@@ -6,38 +6,57 @@ CompilerError::CompilerError(Location loc, const char * const message, ErrorLeve
 CompilerError::CompilerError(Location loc, std::string message, ErrorLevel level)
     : loc(loc), message(message), level(level) {}
 
-void CompilerError::print(FILE * output) {
+void CompilerError::print(FILE * output, const LineTable * lines) {
     const char * const lvl = level == Warn ? "Warning" : "Error";
-    fprintf(output, "%s (%d:%d to %d:%d): %s\n", lvl, loc.first_line, loc.first_col, loc.last_line, loc.last_col,
-            message.c_str());
+
+    if (lines == nullptr) {
+        fprintf(output, "%s (bytes %u to %u): %s\n", lvl, loc.begin, loc.end, message.c_str());
+        return;
+    }
+
+    int first_line, first_col, last_line, last_col;
+    lines->resolve(loc.begin, &first_line, &first_col);
+    lines->resolve(loc.end, &last_line, &last_col);
+
+    fprintf(output, "%s (%d:%d to %d:%d): %s\n", lvl, first_line, first_col, last_line, last_col, message.c_str());
 }
 
-SourceErrors::SourceErrors() : parse_errors({}), type_errors({}) {}
+SourceErrors::SourceErrors() : parse_errors({}), type_errors({}), codegen_errors({}), source(nullptr) {}
 
 bool SourceErrors::has_errors() const {
-    return (parse_errors.size() > 0 || type_errors.size() > 0);
+    return (parse_errors.size() > 0 || type_errors.size() > 0 || codegen_errors.size() > 0);
 }
 
 int SourceErrors::error_count() const {
-    return parse_errors.size() + type_errors.size();
+    return parse_errors.size() + type_errors.size() + codegen_errors.size();
 }
 
 ErrorReport::ErrorReport() : sources(std::map<ProgramSource *, SourceErrors>()) {}
 
 void ErrorReport::print(FILE * output) {
     for (auto &item : sources) {
-        if (item.second.has_errors()) {
-            fprintf(output, "%s:\n", item.first->name.c_str());
+        if (!item.second.has_errors()) {
+            continue;
         }
 
+        fprintf(output, "%s:\n", item.first->name.c_str());
+
+        // Only files with errors ever need their lines counted
+        const LineTable * lines = item.second.source == nullptr ? nullptr : &item.second.source->lines();
+
         for (auto &error : item.second.parse_errors) {
             fprintf(output, "\t");
-            error.print(output);
+            error.print(output, lines);
         }
 
         for (auto &error : item.second.type_errors) {
             fprintf(output, "\t");
-            error.print(output);
+            error.print(output, lines);
+        }
+
+        for (auto &error : item.second.codegen_errors) {
+            fprintf(output, "\t");
+            error.print(output, lines);
         }
     }
 }
@@ -7,6 +7,8 @@
 #include <vector>
 
 #include "ast.h"
+#include "line_table.h"
+#include "source_buffer.h"
 
 enum ErrorLevel {
     Warn,
@@ -21,14 +23,19 @@ struct CompilerError {
     CompilerError(Location loc, const char * const message, ErrorLevel level);
     CompilerError(Location loc, std::string message, ErrorLevel level);
 
-    void print(FILE * output);
+    // Prints lines and columns if a line table is given, otherwise byte offsets
+    void print(FILE * output, const LineTable * lines = nullptr);
 };
 
 typedef struct CompilerError CompilerError;
 
 struct SourceErrors {
-        std::vector<CompilerError> parse_errors;
+    std::vector<CompilerError> parse_errors;
     std::vector<CompilerError> type_errors;
+    std::vector<CompilerError> codegen_errors;
+
+    // Text the locations are offsets into, used to find lines and columns. Not owned
+    SourceBuffer * source;
 
     SourceErrors();
 
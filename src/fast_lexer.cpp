@@ -0,0 +1,416 @@
+#include "fast_lexer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <string_view>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static inline bool is_letter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool is_ident_char(char c) {
+    return is_letter(c) || is_digit(c) || c == '_';
+}
+
+#ifdef __SSE2__
+// Bit i is set if lo <= chunk[i] <= hi. Bytes over 127 compare as negative, so they
+// are never in an ASCII range
+static inline unsigned int in_range(__m128i chunk, char lo, char hi) {
+    __m128i above = _mm_cmpgt_epi8(chunk, _mm_set1_epi8(lo - 1));
+    __m128i below = _mm_cmplt_epi8(chunk, _mm_set1_epi8(hi + 1));
+
+    return _mm_movemask_epi8(_mm_and_si128(above, below));
+}
+
+static inline unsigned int equal_to(__m128i chunk, char c) {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(c)));
+}
+#endif
+
+// Returns the end of the run of [ \t] starting at 'i'
+static inline uint32_t skip_blanks(const char * data, uint32_t i) {
+#ifdef __SSE2__
+    while (true) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (data + i));
+        unsigned int blank = equal_to(chunk, ' ') | equal_to(chunk, '\t');
+
+        if (blank != 0xFFFF) {
+            return i + __builtin_ctz(~blank);
+        }
+
+        i += 16;
+    }
+#else
+    while (data[i] == ' ' || data[i] == '\t') {
+        i++;
+    }
+
+    return i;
+#endif
+}
+
+// Returns the end of the run of [a-zA-Z0-9_] starting at 'i'
+static inline uint32_t skip_ident(const char * data, uint32_t i) {
+#ifdef __SSE2__
+    while (true) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (data + i));
+        // Setting bit 5 maps upper case letters onto lower case ones
+        __m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+        unsigned int ident = in_range(lower, 'a', 'z') | in_range(chunk, '0', '9') | equal_to(chunk, '_');
+
+        if (ident != 0xFFFF) {
+            return i + __builtin_ctz(~ident);
+        }
+
+        i += 16;
+    }
+#else
+    while (is_ident_char(data[i])) {
+        i++;
+    }
+
+    return i;
+#endif
+}
+
+// Returns the index of the first 'a' or 'b' at or after 'i'. The padding guarantees
+// a NUL is found at the end, so 'b' can be '\0' to stop there
+static inline uint32_t find_either(const char * data, uint32_t i, char a, char b) {
+#ifdef __SSE2__
+    while (true) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (data + i));
+        unsigned int found = equal_to(chunk, a) | equal_to(chunk, b) | equal_to(chunk, '\0');
+
+        if (found != 0) {
+            return i + __builtin_ctz(found);
+        }
+
+        i += 16;
+    }
+#else
+    while (data[i] != a && data[i] != b && data[i] != '\0') {
+        i++;
+    }
+
+    return i;
+#endif
+}
+
+FastLexer::FastLexer(ParserState * state)
+    : state(state), data(state->source->data), size(state->source->size), pos(0) {}
+
+// Matches (\.[ \t]*(\/\/.*)?[ \t]*\n) at pos
+bool FastLexer::match_newline(uint32_t * len) const {
+    uint32_t i = skip_blanks(data, pos + 1);
+
+    if (data[i] == '/' && data[i + 1] == '/') {
+        i = find_either(data, i, '\n', '\0');
+    }
+
+    if (i < size && data[i] == '\n') {
+        *len = i + 1 - pos;
+        return true;
+    }
+
+    return false;
+}
+
+int FastLexer::number(YYSTYPE * lval, Location * loc, uint32_t len, bool is_float) {
+    // atoi and atof need a terminated string; numbers are short enough for the stack
+    char small[64];
+    std::string large;
+    const char * str = small;
+
+    if (len < sizeof(small)) {
+        memcpy(small, data + pos, len);
+        small[len] = '\0';
+    } else {
+        large.assign(data + pos, len);
+        str = large.c_str();
+    }
+
+    if (is_float) {
+        lval->float_literal = new FloatLiteral(*loc, str);
+        return FLOAT;
+    }
+
+    lval->int_literal = new IntLiteral(*loc, str);
+    return INT;
+}
+
+struct Keyword {
+    const char * text;
+    int token;
+};
+
+static const Keyword KEYWORDS[] = {
+    {"type", TYPE_ALIAS_KW},
+    {"struct", STRUCT_KW},
+    {"as", CAST_KW},
+    {"return", RETURN_KW},
+    {"continue", CONTINUE_KW},
+    {"break", BREAK_KW},
+    {"if", IF_KW},
+    {"else", ELSE_KW},
+    {"while", WHILE_KW},
+    {"for", FOR_KW},
+    {"mut", MUT},
+    {"not", NOT_KW},
+    {"in", IN_KW},
+    {"and", AND_KW},
+    {"or", OR_KW},
+};
+
+int FastLexer::ident(YYSTYPE * lval, Location * loc) {
+    uint32_t end = skip_ident(data, pos);
+    std::string_view text(data + pos, end - pos);
+
+    if (text == "true" || text == "false") {
+        loc->end = end;
+        lval->bool_literal = new BoolLiteral(*loc, text == "true");
+        pos = end;
+        return BOOL;
+    }
+
+    if (text == "not") {
+        uint32_t i = skip_blanks(data, end);
+
+        if (i > end && data[i] == 'i' && data[i + 1] == 'n') {
+            loc->end = i + 2;
+            pos = i + 2;
+            return NOT_IN_KW;
+        }
+    }
+
+    loc->end = end;
+    pos = end;
+
+    for (auto &keyword : KEYWORDS) {
+        if (text == keyword.text) {
+            return keyword.token;
+        }
+    }
+
+    // Same as the {ident} rule in scanner.lex, but only the node that is returned gets
+    // allocated
+    const Symbol * sym = nullptr;
+
+    switch (state->idents.classify(text, state->symtable, &sym)) {
+        case IdentType:
+            lval->type_ident = new TypeIdent(*loc, text);
+            return DECLARED_TYPE;
+
+        case IdentVar:
+            lval->ident = new Ident(*loc, text);
+            return DECLARED_VAR;
+
+        case IdentFunc:
+            lval->ident = new Ident(*loc, text);
+            return DECLARED_FUNC;
+
+        case IdentArray: {
+            TypeDecl * decl = sym->decl.typ;
+
+            if (decl->get_kind() == TypeAlias::kind) {
+                TypeAlias * alias = (TypeAlias *) decl;
+                lval->dynamic_arr_type_name = new DynamicArrayTypename(*loc, alias->type_expr->clone());
+            } else {
+                StructDecl * strukt = (StructDecl *) decl;
+                lval->dynamic_arr_type_name = new DynamicArrayTypename(*loc, strukt->defn->clone());
+            }
+
+            return DYNAMIC_ARR_IDENT;
+        }
+
+        default:
+            break;
+    }
+
+    lval->ident = new Ident(*loc, text);
+    return IDENT;
+}
+
+int FastLexer::next(YYSTYPE * lval, Location * loc) {
+    while (true) {
+        char c = data[pos];
+        uint32_t len = 1;
+
+        loc->begin = pos;
+        loc->end = pos + 1;
+
+        if (pos >= size) {
+            loc->end = pos;
+            return END;
+        }
+
+        if (c == ' ' || c == '\t') {
+            pos = skip_blanks(data, pos);
+            continue;
+        }
+
+        if (is_letter(c) || c == '_') {
+            return ident(lval, loc);
+        }
+
+        if (is_digit(c) || (c == '-' && is_digit(data[pos + 1]))) {
+            uint32_t i = c == '-' ? pos + 1 : pos;
+
+            while (is_digit(data[i])) {
+                i++;
+            }
+
+            // {float} is (\-)?[0-9]+\.[0-9]+f? and {int} has no sign, so a '-' that
+            // doesn't start a float is just '-'
+            if (data[i] == '.' && is_digit(data[i + 1])) {
+                i++;
+
+                while (is_digit(data[i])) {
+                    i++;
+                }
+
+                if (data[i] == 'f') {
+                    i++;
+                }
+
+                len = i - pos;
+                loc->end = pos + len;
+                int token = number(lval, loc, len, true);
+                pos += len;
+                return token;
+            }
+
+            if (c != '-') {
+                len = i - pos;
+                loc->end = pos + len;
+                int token = number(lval, loc, len, false);
+                pos += len;
+                return token;
+            }
+        }
+
+        if (c == '"') {
+            uint32_t end = find_either(data, pos + 1, '"', '\n');
+
+            if (end < size && data[end] == '"') {
+                loc->end = end + 1;
+                lval->str_literal = new StringLiteral(*loc, std::string_view(data + pos + 1, end - pos - 1));
+                pos = end + 1;
+                return STR;
+            }
+        }
+
+        if (c == '\'') {
+            char value = 0;
+            bool matched = false;
+
+            if (pos + 3 < size && data[pos + 1] == '\\' && data[pos + 3] == '\'') {
+                const char * escape = strchr("nt0er", data[pos + 2]);
+
+                if (data[pos + 2] != '\0' && escape != nullptr) {
+                    const char values[] = {'\n', '\t', '\0', '\e', '\r'};
+                    value = values[escape - "nt0er"];
+                    len = 4;
+                    matched = true;
+                }
+            }
+
+            if (!matched && pos + 2 < size && data[pos + 1] != '\n' && data[pos + 2] == '\'') {
+                value = data[pos + 1];
+                len = 3;
+                matched = true;
+            }
+
+            if (matched) {
+                loc->end = pos + len;
+                lval->char_literal = new CharLiteral(*loc, value);
+                pos += len;
+                return CHAR;
+            }
+        }
+
+        if (c == '/' && data[pos + 1] == '/') {
+            uint32_t end = find_either(data, pos, '\n', '\0');
+
+            // {comment} has to end in a newline; otherwise it's two '/' tokens
+            if (end < size) {
+                pos = end + 1;
+                continue;
+            }
+        }
+
+        if (c == '.' && match_newline(&len)) {
+            loc->end = pos + len;
+            pos += len;
+            return NEWLINE;
+        }
+
+        char next = data[pos + 1];
+        int token = 0;
+        len = 1;
+
+        switch (c) {
+            case '-':
+                token = next == '>' ? FUNC_TYPE_OP : next == '-' ? DEC : '-';
+                len = token == '-' ? 1 : 2;
+                break;
+            case '&':
+                token = next == '&' ? BOOL_AND : '&';
+                len = token == '&' ? 1 : 2;
+                break;
+            case '|':
+                token = next == '|' ? BOOL_OR : 0;
+                len = 2;
+                break;
+            case '=':
+                token = next == '=' ? EQU : '=';
+                len = token == '=' ? 1 : 2;
+                break;
+            case '!':
+                token = next == '=' ? NEQ : '!';
+                len = token == '!' ? 1 : 2;
+                break;
+            case '>':
+                token = next == '=' ? GEQ : GTR;
+                len = token == GTR ? 1 : 2;
+                break;
+            case '<':
+                token = next == '=' ? LEQ : LES;
+                len = token == LES ? 1 : 2;
+                break;
+            case '+':
+                token = next == '+' ? INC : '+';
+                len = token == '+' ? 1 : 2;
+                break;
+            case '/': case '*': case '(': case ')': case ',': case '[': case ']':
+            case ';': case '{': case '}': case '%': case '.': case ':':
+                token = c;
+                break;
+#ifdef DEBUG_TOKENS
+            case '@':
+                token = DEBUG_TOKEN;
+                break;
+#endif
+        }
+
+        if (token != 0) {
+            loc->end = pos + len;
+            pos += len;
+            return token;
+        }
+
+        // Flex's default rule echoes anything that doesn't match
+        fputc(c, stdout);
+        pos++;
+    }
+}
@@ -0,0 +1,41 @@
+/**
+ * Hand-written scanner that can be used instead of the flex one (see
+ * CompilationContext::use_fast_lexer). It accepts exactly the same language and
+ * returns the same tokens, values and locations as scanner.lex, including its
+ * quirks: a bare newline or unknown character is echoed to stdout, '-1.5' is one
+ * float token, and 'not in' is one token even if more letters follow.
+ *
+ * Runs of whitespace, identifiers, comments and string literals are scanned 16
+ * bytes at a time with SSE2. This relies on the SOURCE_PADDING zero bytes after
+ * the source, so it must be given a SourceBuffer. Keywords are recognised without
+ * allocating, and only tokens that carry a value allocate their AST node.
+ */
+#ifndef SRC_FAST_LEXER_H
+#define SRC_FAST_LEXER_H
+
+#include <stdint.h>
+
+#include "parsedecls.h"
+#include "parser.h"
+#include "source_buffer.h"
+
+class FastLexer {
+    public:
+        // Scans state->source. Identifiers are classified with state->symtable
+        FastLexer(ParserState * state);
+
+        // Same interface as yylex
+        int next(YYSTYPE * lval, Location * loc);
+
+    private:
+        ParserState * state;
+        const char * data;
+        uint32_t size;
+        uint32_t pos;
+
+        int ident(YYSTYPE * lval, Location * loc);
+        int number(YYSTYPE * lval, Location * loc, uint32_t len, bool is_float);
+        bool match_newline(uint32_t * len) const;
+};
+
+#endif
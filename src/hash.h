@@ -0,0 +1,27 @@
+/**
+ * Hashing of raw bytes, used for symbol lookups, structural hashes of the AST and
+ * the keys of the compile cache and incremental compiles.
+ */
+#ifndef SRC_HASH_H
+#define SRC_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace x {
+    // 64-bit FNV-1a. Pass a previous result as 'seed' to hash several buffers as one.
+    // Inline, since the lexer hashes every identifier with it
+    inline uint64_t hash_bytes(const void * data, size_t size, uint64_t seed = 0xcbf29ce484222325) {
+        const unsigned char * bytes = (const unsigned char *) data;
+        uint64_t hash = seed;
+
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3;
+        }
+
+        return hash;
+    }
+}
+
+#endif
@@ -0,0 +1,360 @@
+#include "incremental.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <set>
+#include <thread>
+
+#include "asm_utils.h"
+#include "codegen.h"
+#include "context.h"
+#include "hash.h"
+#include "parseutils.h"
+#include "source_buffer.h"
+
+// Collects every identifier and type name in a subtree. Locals are included too,
+// which only means a few more names go into a key than needed
+class NameCollector : public TreeVisitor {
+    public:
+        std::set<std::string> &names;
+
+        NameCollector(std::set<std::string> &names) : names(names) {}
+
+        virtual WalkAction pre(ASTNode * node) {
+            if (node->get_kind() == Ident::kind) {
+                names.insert(((Ident *) node)->id);
+            } else if (node->get_kind() == TypeIdent::kind) {
+                names.insert(((TypeIdent *) node)->id);
+            }
+
+            return WalkContinue;
+        }
+};
+
+static void mentioned_names(ASTNode * node, std::set<std::string> &names) {
+    if (node == nullptr) {
+        return;
+    }
+
+    NameCollector collector(names);
+    x::walk(node, collector);
+}
+
+static uint64_t hash_str(const std::string &str, uint64_t seed) {
+    return x::hash_bytes(str.c_str(), str.size() + 1, seed);
+}
+
+IncrementalCompiler::IncrementalCompiler(const CompileJob &job) : units(0), reused(0), job(job), cache({}) {}
+
+CompileResult IncrementalCompiler::compile(ThreadPool * pool) {
+    units = 0;
+    reused = 0;
+
+    const char * name = job.input.c_str();
+    int error = 0;
+    SourceBuffer * source = SourceBuffer::read_path(name, &error);
+
+    if (source == nullptr) {
+        return { 1, std::string("Error: ") + name + ": " + strerror(error) + "\n" };
+    }
+
+    char * buf = nullptr;
+    size_t len = 0;
+    FILE * diag = open_memstream(&buf, &len);
+
+    auto diagnostics = [&]() {
+        fclose(diag);
+        std::string out(buf, len);
+        free(buf);
+
+        return out;
+    };
+
+    CompilationContext ctx;
+    ctx.use_fast_lexer = job.fast_lexer;
+    ctx.set_reorder_fields(job.reorder_fields);
+
+    ParseResult result = x::parse_buffer(ctx, source, name);
+
+    if (result.parser_state == nullptr || result.error) {
+        if (result.parser_state != nullptr) {
+            result.parser_state->errors.print(diag);
+        }
+
+        fprintf(diag, "Error: %s: %s\n", name, strerror(result.error));
+        return { 1, diagnostics() };
+    }
+
+    ParserState * state = result.parser_state;
+    ProgramSource * top = state->top;
+    SymbolTable * symtable = state->symtable;
+    const char * text = state->source->data;
+    size_t n = top->nodes.size();
+
+    // A declaration's text runs up to the start of the next one, so it takes in
+    // everything that could change its AST
+    std::vector<uint32_t> begins(n + 1);
+    std::unordered_map<std::string, std::vector<size_t>> declared;
+
+    for (size_t i = 0; i < n; i++) {
+        begins[i] = top->nodes[i]->loc.begin;
+
+        const Ident * ident = x::declared_name(top->nodes[i]);
+
+        if (ident != nullptr) {
+            declared[ident->id].push_back(i);
+        }
+    }
+
+    begins[n] = state->source->size;
+
+    // Signatures can refer to each other (a struct with a pointer to itself), so a
+    // signature that is still being worked out counts as unchanged
+    std::vector<uint64_t> sigs(n, 0);
+    std::vector<int> sig_state(n, 0);
+
+    std::function<uint64_t(size_t)> signature = [&](size_t i) -> uint64_t {
+        if (sig_state[i] != 0) {
+            return sigs[i];
+        }
+
+        sig_state[i] = 1;
+
+        ASTNode * node = top->nodes[i];
+        uint32_t end = begins[i + 1];
+        std::set<std::string> names;
+
+        if (node->get_kind() == FuncDecl::kind) {
+            FuncDecl * func = (FuncDecl *) node;
+
+            if (func->body != nullptr) {
+                end = func->body->loc.begin;
+            }
+
+            mentioned_names((ASTNode *) func->params, names);
+            mentioned_names((ASTNode *) func->ret_type, names);
+        } else {
+            mentioned_names(node, names);
+        }
+
+        uint64_t sig = x::hash_bytes(text + begins[i], end - begins[i]);
+
+        for (auto &name : names) {
+            auto item = declared.find(name);
+
+            if (item == declared.end()) {
+                continue;
+            }
+
+            for (size_t j : item->second) {
+                if (j != i) {
+                    uint64_t dep = signature(j);
+                    sig = x::hash_bytes(&dep, sizeof(dep), sig);
+                }
+            }
+        }
+
+        sigs[i] = sig;
+        sig_state[i] = 2;
+
+        return sig;
+    };
+
+    NamesToNames globals = x::global_names(&ctx, top);
+    std::vector<uint64_t> keys(n);
+
+    for (size_t i = 0; i < n; i++) {
+        std::set<std::string> names;
+        mentioned_names(top->nodes[i], names);
+
+        uint64_t key = x::hash_bytes(text + begins[i], begins[i + 1] - begins[i]);
+        key = x::hash_bytes(&i, sizeof(i), key);
+
+        for (auto &name : names) {
+            std::optional<std::string> global = globals.get(name);
+            auto item = declared.find(name);
+
+            key = hash_str(name, key);
+
+            if (global) {
+                key = hash_str(*global, key);
+            }
+
+            if (item == declared.end()) {
+                continue;
+            }
+
+            for (size_t j : item->second) {
+                if (j != i) {
+                    uint64_t dep = signature(j);
+                    key = x::hash_bytes(&dep, sizeof(dep), key);
+                }
+            }
+        }
+
+        keys[i] = key;
+    }
+
+    std::unordered_map<uint64_t, Unit> next;
+    std::vector<Unit> out(n);
+    std::vector<size_t> changed;
+
+    for (size_t i = 0; i < n; i++) {
+        auto item = cache.find(keys[i]);
+
+        if (item == cache.end()) {
+            changed.push_back(i);
+            continue;
+        }
+
+        // Same text, so every error moved as far as the declaration did. Errors
+        // without a location stay that way
+        Unit &unit = out[i] = item->second;
+        int64_t shift = (int64_t) begins[i] - unit.begin;
+
+        for (auto *list : { &unit.type_errors, &unit.codegen_errors }) {
+            for (auto &error : *list) {
+                if (error.loc.begin != 0 || error.loc.end != 0) {
+                    error.loc.begin += shift;
+                    error.loc.end += shift;
+                }
+            }
+        }
+
+        unit.begin = begins[i];
+    }
+
+    // Each declaration's errors are kept apart, so they come out in the same order as
+    // in a full compile
+    std::vector<ASTNode *> changed_nodes;
+    std::vector<SourceErrors> changed_errors(changed.size());
+
+    for (size_t i : changed) {
+        changed_nodes.push_back(top->nodes[i]);
+    }
+
+    ProgramSource::typecheck_decls(changed_nodes, symtable, changed_errors, pool);
+
+    for (size_t k = 0; k < changed.size(); k++) {
+        out[changed[k]].begin = begins[changed[k]];
+        out[changed[k]].type_errors = changed_errors[k].type_errors;
+    }
+
+    std::vector<CompilationContext> forks;
+
+    for (size_t i : changed) {
+        forks.push_back(x::unit_context(ctx, i));
+    }
+
+    auto gen_unit = [&](size_t k) {
+        size_t i = changed[k];
+
+        try {
+            out[i].assembly = x::node_to_asm(forks[k], top->nodes[i], symtable, globals);
+        } catch (CompilerError &error) {
+            out[i].codegen_errors.push_back(error);
+        }
+    };
+
+    if (pool != nullptr) {
+        pool->parallel_for(changed.size(), gen_unit);
+    } else {
+        for (size_t k = 0; k < changed.size(); k++) {
+            gen_unit(k);
+        }
+    }
+
+    std::ofstream fs(job.asm_path);
+
+    if (!fs) {
+        fclose(diag);
+        free(buf);
+        return { 1, "Error: " + job.asm_path + ": " + strerror(errno) + "\n" };
+    }
+
+    SourceErrors &errors = state->errors.sources[top];
+    bool generated = true;
+
+    x::asm_preamble(fs);
+
+    for (size_t i = 0; i < n; i++) {
+        errors.type_errors.insert(errors.type_errors.end(), out[i].type_errors.begin(), out[i].type_errors.end());
+        errors.codegen_errors.insert(errors.codegen_errors.end(), out[i].codegen_errors.begin(), out[i].codegen_errors.end());
+        generated = generated && out[i].codegen_errors.empty();
+        fs << out[i].assembly;
+        next[keys[i]] = std::move(out[i]);
+    }
+
+    fs << std::flush;
+    state->errors.print(diag);
+
+    // Only the last compile is kept, so memory doesn't grow with every edit
+    cache = std::move(next);
+    units = n;
+    reused = n - changed.size();
+
+    return { generated ? 0 : 1, diagnostics() };
+}
+
+// Identifies a version of a file well enough to notice it has been saved
+static bool file_stamp(const std::string &path, struct timespec * mtime, off_t * size) {
+    struct stat st;
+
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+
+    *mtime = st.st_mtim;
+    *size = st.st_size;
+
+    return true;
+}
+
+int x::watch(ThreadPool &pool, const std::vector<CompileJob> &jobs) {
+    std::vector<IncrementalCompiler> compilers;
+    std::vector<struct timespec> mtimes(jobs.size(), { 0, 0 });
+    std::vector<off_t> sizes(jobs.size(), -1);
+
+    for (auto &job : jobs) {
+        compilers.emplace_back(job);
+    }
+
+    while (true) {
+        for (size_t i = 0; i < jobs.size(); i++) {
+            struct timespec mtime;
+            off_t size;
+
+            if (!file_stamp(jobs[i].input, &mtime, &size)) {
+                fprintf(stderr, "Error: %s: %s\n", jobs[i].input.c_str(), strerror(errno));
+                return 1;
+            }
+
+            if (mtime.tv_sec == mtimes[i].tv_sec && mtime.tv_nsec == mtimes[i].tv_nsec && size == sizes[i]) {
+                continue;
+            }
+
+            mtimes[i] = mtime;
+            sizes[i] = size;
+
+            CompileResult result = compilers[i].compile(&pool);
+
+            fputs(result.diagnostics.c_str(), stderr);
+
+            if (result.error) {
+                continue;
+            }
+
+            fprintf(stderr, "watch: %s: reused %zu of %zu declarations\n", jobs[i].input.c_str(),
+                    compilers[i].reused, compilers[i].units);
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_INTERVAL_MS));
+    }
+}
@@ -0,0 +1,69 @@
+/**
+ * Recompiles a file over and over, redoing only the top-level declarations that
+ * changed since the last compile, or that use a declaration whose signature changed.
+ * Used by --watch, which keeps one IncrementalCompiler per input in memory.
+ *
+ * The whole file is always parsed again. Each top-level declaration then gets a key
+ * made of:
+ *  - its source text, from its first byte up to the next declaration
+ *  - its position in the file, which goes into the names of its temporaries
+ *  - for every name it mentions, the global asm name it was given and the
+ *    signature of each declaration in the file with that name
+ * A function's signature is its text up to the body plus the signatures of the types
+ * it mentions, so changing a body only redoes that function. If the key was seen in
+ * the last compile, the declaration's errors and asm are reused; otherwise it
+ * is typechecked and lowered again.
+ */
+#ifndef SRC_INCREMENTAL_H
+#define SRC_INCREMENTAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "driver.h"
+#include "errors.h"
+#include "thread_pool.h"
+
+// How often --watch checks its inputs for changes
+#define WATCH_INTERVAL_MS 200
+
+class IncrementalCompiler {
+    public:
+        // Declarations in the last compile, and how many of them were reused
+        size_t units;
+        size_t reused;
+
+        // Streaming, dot files and the cache aren't supported, and the input can't
+        // be stdin
+        IncrementalCompiler(const CompileJob &job);
+
+        // Compiles the job's input and writes its asm file
+        CompileResult compile(ThreadPool * pool = nullptr);
+
+    private:
+        struct Unit {
+            // Where the declaration started, for moving its errors if it moves
+            uint32_t begin;
+
+            std::vector<CompilerError> type_errors;
+            std::vector<CompilerError> codegen_errors;
+            std::string assembly;
+        };
+
+        CompileJob job;
+
+        // Everything from the last compile, by key
+        std::unordered_map<uint64_t, Unit> cache;
+};
+
+namespace x {
+    // Compiles every job, then again each time its input changes. Only returns if an
+    // input can't be watched
+    int watch(ThreadPool &pool, const std::vector<CompileJob> &jobs);
+}
+
+#endif
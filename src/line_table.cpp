@@ -0,0 +1,41 @@
+#include "line_table.h"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+LineTable::LineTable(const char * data, size_t size) : line_starts({0}) {
+    size_t i = 0;
+
+#ifdef __SSE2__
+    // Compare 16 bytes at a time and only look at the bytes that matched
+    const __m128i newlines = _mm_set1_epi8('\n');
+
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (data + i));
+        unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newlines));
+
+        while (mask != 0) {
+            line_starts.push_back(i + __builtin_ctz(mask) + 1);
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i < size; i++) {
+        if (data[i] == '\n') {
+            line_starts.push_back(i + 1);
+        }
+    }
+}
+
+void LineTable::resolve(uint32_t offset, int * line, int * col) const {
+    // First line that starts after the offset; the one before it contains the offset
+    auto next = std::upper_bound(line_starts.begin(), line_starts.end(), offset);
+    size_t index = next - line_starts.begin() - 1;
+
+    *line = index + 1;
+    *col = offset - line_starts[index] + 1;
+}
@@ -0,0 +1,24 @@
+/**
+ * Offsets of the start of every line in a source file, used to turn the byte offsets
+ * in a Location into line and column numbers. It is built in one pass over the file
+ * the first time an error needs printing.
+ */
+#ifndef SRC_LINE_TABLE_H
+#define SRC_LINE_TABLE_H
+
+#include <cstdint>
+#include <stddef.h>
+#include <vector>
+
+class LineTable {
+    public:
+        // line_starts[i] is the offset of the first byte of line i + 1
+        std::vector<uint32_t> line_starts;
+
+        LineTable(const char * data, size_t size);
+
+        // Both 1 based
+        void resolve(uint32_t offset, int * line, int * col) const;
+};
+
+#endif
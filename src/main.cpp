@@ -4,81 +4,222 @@
 #include <unistd.h>
 
 #include <algorithm>
-#include <fstream>
+#include <filesystem>
 #include <iostream>
+#include <set>
+#include <string>
+#include <vector>
 
-#include "asm.h"
-#include "asm_utils.h"
-#include "parsedecls.h"
+#include "driver.h"
+#include "incremental.h"
 #include "parseutils.h"
 #include "parser.h"
-#include "symtable.h"
-#include "tac.h"
+#include "server.h"
+#include "thread_pool.h"
 
 extern int yydebug;
 
-#define MAX_STR_NUM 100
-
-const char* str_literals[MAX_STR_NUM];
-
-// Used to store string literals in read only text segment of assembly file.
-void add_string(const char* str) {
-  static int i = 0;
-  str_literals[i++] = str;
-}
-
-char* get_option(char** begin, char** end, const std::string& option) {
-  char** itr = std::find(begin, end, option);
-  if (itr != end && ++itr != end) {
-    return *itr;
-  }
-  return 0;
-}
-
-bool option_exists(char** begin, char** end, const std::string& option) {
-  return std::find(begin, end, option) != end;
+static void usage(const char* prog) {
+  fprintf(stderr, "usage: %s [--graph] [--graph-json] [--graph-root name] [--graph-depth n] [--emit-ast] [--stream] [--fast-lexer] [--reorder-fields] [--cache-dir dir] [-j threads] [-o dir] [file...]\n"
+                  "       %s --watch [--fast-lexer] [--reorder-fields] [-j threads] [-o dir] file...\n"
+                  "       %s --server socket [-j threads]\n"
+                  "       %s --client socket [--stream] [--fast-lexer] [--reorder-fields] [-o dir] [file...]\n", prog, prog, prog, prog);
 }
 
-extern SymbolTable* symtable;
-
 int main(int argc, char** argv) {
   x::setup_symtable();
   if (YYDEBUG) {
     yydebug = 1;
   } /* Enable tracing */
 
-  // Keeps track of the number of command line arguments.
-  int options = 1;
   bool graph = false;
+  bool graph_json = false;
+  const char* graph_root = nullptr;
+  int graph_depth = 0;
+  bool emit_ast = false;
+  bool stream = false;
+  bool fast_lexer = false;
+  bool reorder_fields = false;
+  bool watch = false;
+  size_t num_threads = x::num_cores();
+  const char* out_dir = nullptr;
+  const char* cache_dir = nullptr;
+  const char* server_path = nullptr;
+  const char* client_path = nullptr;
+  std::vector<std::string> inputs;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--graph") == 0) {
+      graph = true;
+    } else if (strcmp(argv[i], "--graph-json") == 0) {
+      graph = true;
+      graph_json = true;
+    } else if (strcmp(argv[i], "--graph-root") == 0 && i + 1 < argc) {
+      graph = true;
+      graph_root = argv[++i];
+    } else if (strcmp(argv[i], "--graph-depth") == 0 && i + 1 < argc) {
+      graph = true;
+      graph_depth = std::max(atoi(argv[++i]), 0);
+    } else if (strcmp(argv[i], "--emit-ast") == 0) {
+      emit_ast = true;
+    } else if (strcmp(argv[i], "--stream") == 0) {
+      stream = true;
+    } else if (strcmp(argv[i], "--fast-lexer") == 0) {
+      fast_lexer = true;
+    } else if (strcmp(argv[i], "--reorder-fields") == 0) {
+      reorder_fields = true;
+    } else if (strcmp(argv[i], "--watch") == 0) {
+      watch = true;
+    } else if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) {
+      cache_dir = argv[++i];
+    } else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+      server_path = argv[++i];
+    } else if (strcmp(argv[i], "--client") == 0 && i + 1 < argc) {
+      client_path = argv[++i];
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      out_dir = argv[++i];
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      num_threads = std::max(atoi(argv[++i]), 1);
+    } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+      usage(argv[0]);
+      return 1;
+    } else {
+      inputs.push_back(argv[i]);
+    }
+  }
 
-  if (option_exists(argv, argv + argc, "--graph")) {
-    ++options;
-    graph = true;
+  // Streaming frees function bodies as it goes, so there is no AST left to graph
+  // or write out
+  if ((graph || emit_ast) && stream) {
+    usage(argv[0]);
+    return 1;
   }
 
-  ParseResult result = (argc == options + 1) ? x::parse_file(argv[options]) : x::parse_stdin();
-  SymbolTable * symtable = result.parser_state->symtable;
-  ProgramSource * top = result.parser_state->top;
-  result.parser_state->errors.print(stderr);
+  // The server only produces assembly, and caching is left to whoever runs it
+  if (client_path != nullptr && (graph || emit_ast || cache_dir != nullptr || server_path != nullptr)) {
+    usage(argv[0]);
+    return 1;
+  }
 
-  if (result.error) {
-    perror("Error: ");
+  // Watching rereads each input whenever it changes, so stdin can't be one
+  if (watch && (inputs.empty() || graph || emit_ast || stream || cache_dir != nullptr || client_path != nullptr ||
+                server_path != nullptr)) {
+    usage(argv[0]);
     return 1;
   }
 
-  top->typecheck(symtable, result.parser_state->errors.sources[top]);
-  result.parser_state->errors.print(stderr);
+  if (server_path != nullptr) {
+    if (!inputs.empty()) {
+      usage(argv[0]);
+      return 1;
+    }
+
+    ThreadPool pool(num_threads);
+    return x::run_server(server_path, pool);
+  }
+
+  std::vector<CompileJob> jobs;
+  std::string graph_ext = graph_json ? ".json" : ".dot";
+
+  // With one input (or stdin) and no output directory, keep writing a.s and
+  // prog.dot like before. Otherwise every input gets <dir>/<name>.s
+  if (out_dir == nullptr && inputs.size() <= 1) {
+    CompileJob job = { inputs.empty() ? "" : inputs[0], "a.s", graph ? "prog" + graph_ext : "", emit_ast ? "prog.ast" : "" };
+    jobs.push_back(job);
+  } else {
+    std::filesystem::path dir(out_dir == nullptr ? "." : out_dir);
+    std::set<std::string> names;
+    std::error_code error;
+
+    std::filesystem::create_directories(dir, error);
+
+    if (error) {
+      fprintf(stderr, "Error: %s: %s\n", dir.c_str(), error.message().c_str());
+      return 1;
+    }
+
+    if (inputs.empty()) {
+      CompileJob job = {
+        "",
+        (dir / "a.s").string(),
+        graph ? (dir / ("prog" + graph_ext)).string() : "",
+        emit_ast ? (dir / "prog.ast").string() : ""
+      };
+      jobs.push_back(job);
+    }
+
+    for (auto& input : inputs) {
+      std::string name = std::filesystem::path(input).stem();
+
+      if (!names.insert(name).second) {
+        fprintf(stderr, "Error: more than one input is named %s\n", name.c_str());
+        return 1;
+      }
+
+      CompileJob job = {
+        input,
+        (dir / (name + ".s")).string(),
+        graph ? (dir / (name + graph_ext)).string() : "",
+        emit_ast ? (dir / (name + ".ast")).string() : ""
+      };
+      jobs.push_back(job);
+    }
+  }
+
+  if (cache_dir != nullptr) {
+    std::error_code error;
+    std::filesystem::create_directories(cache_dir, error);
+
+    if (error) {
+      fprintf(stderr, "Error: %s: %s\n", cache_dir, error.message().c_str());
+      return 1;
+    }
+  }
+
+  for (auto& job : jobs) {
+    job.streaming = stream;
+    job.fast_lexer = fast_lexer;
+    job.reorder_fields = reorder_fields;
+    job.graph_format = graph_json ? TreeJson : TreeDot;
+    job.graph_root = graph_root == nullptr ? "" : graph_root;
+    job.graph_depth = graph_depth;
+    job.cache_dir = cache_dir == nullptr ? "" : cache_dir;
+  }
+
+  // Files and the functions in them share the pool, so even a single file uses
+  // every thread
+  ThreadPool pool(num_threads);
+
+  if (watch) {
+    return x::watch(pool, jobs);
+  }
 
-  std::fstream fs;
-  fs.open("a.s", std::fstream::out);
-  x::generate_assembly(result.parser_state->top, result.parser_state->symtable, fs);
-  fs.close();
+  std::vector<CompileResult> results;
 
-  if (graph) {
-    std::ofstream dotfile;
-    dotfile.open("prog.dot");
-    x::tree_dotfile(dotfile, result.parser_state->top);
-    dotfile.close();
+  if (client_path != nullptr) {
+    // The work happens in the server, so these threads just wait on it
+    results.resize(jobs.size());
+    pool.parallel_for(jobs.size(), [&](size_t i) {
+      results[i] = x::compile_remote(client_path, jobs[i]);
+    });
+  } else {
+    results = x::compile_all(pool, jobs);
+  }
+  int status = 0;
+  size_t hits = 0;
+
+  // Printed in input order, so the output is the same however the jobs were scheduled
+  for (auto& result : results) {
+    fputs(result.diagnostics.c_str(), stderr);
+    status |= result.error;
+    hits += result.cached;
   }
-  return 0;
+
+  // Jobs that write a dot or AST file never use the cache, so they don't count as
+  // lookups
+  if (cache_dir != nullptr && !graph && !emit_ast) {
+    fprintf(stderr, "cache: %zu of %zu hit (%.0f%%)\n", hits, jobs.size(), 100.0 * hits / jobs.size());
+  }
+
+  return status ? 1 : 0;
 }
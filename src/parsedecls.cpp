@@ -1,17 +1,62 @@
 #include "parsedecls.h"
 
+#include "fast_lexer.h"
+
 #include <vector>
 
-ParserState::ParserState(std::string current_source)
-    :   top(nullptr),
-        symtable(x::default_symtable()),
+ParserState::ParserState(CompilationContext * ctx, std::string current_source)
+    :   ctx(ctx),
+        top(nullptr),
+        symtable(ctx->default_symtable()),
+        idents(IdentCache()),
         errors(ErrorReport()),
         current_errors(SourceErrors()),
         current_source(current_source),
-        debug_stmts(std::map<int, Statement *>())
-{}
+        debug_stmts(std::map<int, Statement *>()),
+        sink(nullptr),
+        source(nullptr),
+        lexer(nullptr),
+        at_end(false),
+        recent_tokens{0, 0},
+        types(ctx->types)
+{
+    symtable->idents = &idents;
+}
+
+void ParserState::add_decl(ProgramSource * program, ASTNode * decl) {
+    program->add_node(decl);
+
+    // After a syntax error the scopes can point at nodes that were thrown away, so
+    // nothing more is checked or compiled
+    if (sink != nullptr && current_errors.parse_errors.empty()) {
+        sink->on_decl(decl, symtable);
+    }
+}
+
+std::unique_lock<std::shared_mutex> ParserState::write_guard() {
+    if (sink == nullptr) {
+        return std::unique_lock<std::shared_mutex>();
+    }
+
+    return std::unique_lock<std::shared_mutex>(sink->symtable_lock);
+}
+
+void ParserState::add_parse_error(const Location &loc, const std::string &message) {
+    current_errors.parse_errors.push_back(CompilerError(loc, message, Error));
+}
+
+void ParserState::leave_scopes() {
+    auto guard = write_guard();
+
+    // Scopes still open here never got as far as belonging to a node
+    while (symtable->enclosing != nullptr) {
+        delete x::pop_scope(&symtable);
+    }
+}
 
 ParserState::~ParserState() {
+    delete lexer;
     delete top;
     delete symtable;
+    delete source;
 }
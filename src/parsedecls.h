@@ -1,11 +1,17 @@
 #ifndef SRC_PARSEDECLS_H
 #define SRC_PARSEDECLS_H
 
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
 
 #include "ast.h"
+#include "context.h"
 #include "errors.h"
+#include "source_buffer.h"
 #include "symtable.h"
 
 #define MAX_STR_LEN 2048
@@ -14,16 +20,32 @@ struct yy_buffer_state;
 typedef struct yy_buffer_state * YY_BUFFER_STATE;
 typedef void * yyscan_t;
 
-namespace x {
-    SymbolTable * default_symtable();
-}
+class FastLexer;
+
+// Receives top-level declarations while the rest of the file is still being parsed
+struct DeclSink {
+    // Called with each declaration and the global scope it was declared in
+    std::function<void(ASTNode *, SymbolTable *)> on_decl;
+
+    // The parser holds this exclusively whenever it changes the global scope. Other
+    // threads must hold it shared while they read global symbols
+    std::shared_mutex symtable_lock;
+};
+
+typedef struct DeclSink DeclSink;
 
 struct ParserState {
+    // Compilation this source belongs to. Not owned
+    CompilationContext * ctx;
+
     // Top level node of AST
     ProgramSource * top;
 
     SymbolTable * symtable;
 
+    // What the lexers have decided identifiers are, for the scopes the parser has open
+    IdentCache idents;
+
     // Error report for all source files
     ErrorReport errors;
 
@@ -35,17 +57,52 @@ struct ParserState {
 
     std::map<int, Statement *> debug_stmts;
 
-    ParserState(std::string current_source);
+    // Where to stream declarations to, if anywhere. Not owned
+    DeclSink * sink;
+
+    // Text being parsed. Nodes such as StringLiteral point into it, so it is freed
+    // after the AST
+    SourceBuffer * source;
+
+    // Used instead of the flex scanner if set (see CompilationContext::use_fast_lexer)
+    FastLexer * lexer;
+
+    // The lexer has returned END. It keeps doing so, but after the first the parser
+    // sees the end of input, so recovering from a syntax error can't loop forever
+    bool at_end;
+
+    // Last two tokens given to the parser, newest first. Some words are only keywords
+    // after certain tokens (see next_token in parser.ypp)
+    int recent_tokens[2];
+
+    // Holds the type names in the AST, which are shared (see TypeInterner::share).
+    // The context's, kept here so it outlives the AST even if the context is reset
+    std::shared_ptr<TypeInterner> types;
+
+    ParserState(CompilationContext * ctx, std::string current_source);
+
+    // Adds a top-level declaration to the program and passes it on to the sink
+    void add_decl(ProgramSource * program, ASTNode * decl);
+
+    // Locks the global scope for writing if declarations are being streamed
+    std::unique_lock<std::shared_mutex> write_guard();
+
+    // Records a syntax error in current_errors, for yyerror and the grammar
+    void add_parse_error(const Location &loc, const std::string &message);
+
+    // Drops the scopes left open by a declaration that had a syntax error in it, so
+    // parsing carries on in the global scope
+    void leave_scopes();
 
     ~ParserState();
 };
 
-// TODO: Use Bison locations for error reporting from lexer and parser
-void yyerror(YYLTYPE * loc, yyscan_t scanner, ParserState * state, char const * format, ...);
+void yyerror(Location * loc, yyscan_t scanner, ParserState * state, char const * format, ...);
 int yylex_init_extra(ParserState * state, yyscan_t * scanner);
 int yylex_destroy(yyscan_t scanner);
 int yyparse(yyscan_t scanner, ParserState * state);
 YY_BUFFER_STATE yy_scan_string(const char * yy_str, yyscan_t scanner);
+YY_BUFFER_STATE yy_scan_buffer(char * base, size_t size, yyscan_t scanner);
 void yy_delete_buffer(YY_BUFFER_STATE b, yyscan_t scanner);
 extern void yyset_in(FILE * file, yyscan_t scanner);
 
@@ -1,8 +1,15 @@
 #include "parseutils.h"
 
-#include "parsedecls.h"
+#include <errno.h>
+#include <string.h>
+
+#include <mutex>
+#include <vector>
 
-static SymbolTable * the_default_symtable = nullptr;
+#include "fast_lexer.h"
+#include "hash.h"
+#include "parsedecls.h"
+#include "serialize.h"
 
 const char * BUILTIN_DECLS = R"(
     // These functions need stub definitions because a statement list cannot
@@ -24,94 +31,119 @@ ParseResult::~ParseResult() {
     delete parser_state;
 }
 
-ParseResult x::parse_file(const char * const path) {
-    FILE * yyin = fopen(path, "r");
-
-    if (! yyin) {
-        return ParseResult(errno, nullptr);
-    }
-
-    ParserState * state = new ParserState(std::string(path));
+// Scans the state's source buffer in place
+static ParseResult parse_source(ParserState * state) {
     yyscan_t scanner;
     int error = yylex_init_extra(state, &scanner);
 
-    yyset_in(yyin, scanner);
-
     if (error) {
+        delete state;
         return ParseResult(error, nullptr);
     }
 
-    error = yyparse(scanner, state);
+    // The size passed to flex includes the two NULs that end the buffer
+    yy_scan_buffer(state->source->data, state->source->size + 2, scanner);
 
-    if (error) {
-        return ParseResult(error, state);
+    if (state->ctx->use_fast_lexer) {
+        state->lexer = new FastLexer(state);
     }
 
+    // Syntax errors are recovered from where possible, so one parse reports as many
+    // as it can. yyparse only fails if it couldn't recover or ran out of memory
+    int parse_error = yyparse(scanner, state);
     error = yylex_destroy(scanner);
 
-    if (error) {
-        return ParseResult(error, state);
+    // Parsing can be abandoned with a declaration still open
+    state->leave_scopes();
+
+    if (state->top == nullptr) {
+        state->top = new ProgramSource(Location(0, 0), state->current_source, {});
     }
 
-    error = fclose(yyin) ? errno : 0;
+    if (parse_error != 0 || !state->current_errors.parse_errors.empty()) {
+        state->current_errors.source = state->source;
+        state->errors.sources[state->top] = state->current_errors;
+
+        return ParseResult(parse_error == 2 ? ENOMEM : EINVAL, state);
+    }
 
     return ParseResult(error, state);
 }
 
-ParseResult x::parse_stdin() {
-    ParserState * state = new ParserState(std::string("<stdin>"));
-    yyscan_t scanner;
-    int error = yylex_init_extra(state, &scanner);
+ParseResult x::parse_buffer(CompilationContext &ctx, SourceBuffer * source, const std::string &name, DeclSink * sink) {
+    ParserState * state = new ParserState(&ctx, name);
+    state->source = source;
+    state->sink = sink;
 
-    if (error) {
-        return ParseResult(error, nullptr);
-    }
+    return parse_source(state);
+}
 
-    error = yyparse(scanner, state);
+ParseResult x::parse_file(CompilationContext &ctx, const char * const path, DeclSink * sink) {
+    int error = 0;
+    SourceBuffer * source = SourceBuffer::open_file(path, &error);
 
-    if (error) {
-        return ParseResult(error, state);
+    if (source == nullptr) {
+        return ParseResult(error, nullptr);
     }
 
-    error = yylex_destroy(scanner);
-
-    return ParseResult(error, state);
+    return x::parse_buffer(ctx, source, std::string(path), sink);
 }
 
-ParseResult x::parse_str(const char * code) {
-    ParserState * state = new ParserState(std::string("<str>"));
-    yyscan_t scanner;
-    int error = yylex_init_extra(state, &scanner);
+ParseResult x::parse_stdin(CompilationContext &ctx, DeclSink * sink) {
+    int error = 0;
+    SourceBuffer * source = SourceBuffer::read_file(stdin, &error);
 
-    if (error) {
+    if (source == nullptr) {
         return ParseResult(error, nullptr);
     }
 
-    YY_BUFFER_STATE buf = yy_scan_string(code, scanner);
+    return x::parse_buffer(ctx, source, std::string("<stdin>"), sink);
+}
 
-    error = yyparse(scanner, state);
+ParseResult x::parse_str(CompilationContext &ctx, const char * code) {
+    int error = 0;
+    SourceBuffer * source = SourceBuffer::from_str(code, &error);
 
-    if (error) {
-        return ParseResult(error, state);
+    if (source == nullptr) {
+        return ParseResult(error, nullptr);
     }
 
-    yy_delete_buffer(buf, scanner);
-
-    error = yylex_destroy(scanner);
+    return x::parse_buffer(ctx, source, std::string("<str>"));
+}
 
-    return ParseResult(error, state);
+ParseResult x::parse_builtins(CompilationContext &ctx) {
+    return x::parse_str(ctx, BUILTIN_DECLS);
 }
 
-SymbolTable * x::default_symtable() {
-    if (the_default_symtable == nullptr) {
-        the_default_symtable = x::bare_symtable();
-        return the_default_symtable;
-    }
+uint64_t x::builtins_hash() {
+    return x::hash_bytes(BUILTIN_DECLS, strlen(BUILTIN_DECLS));
+}
 
-    return the_default_symtable->clone();
+const SymbolTable * x::prelude_symtable() {
+    static std::once_flag once;
+    static const SymbolTable * prelude = nullptr;
+
+    std::call_once(once, []() {
+        // Symbols in the prelude point into its declarations, so they have to live as
+        // long as any symbol table cloned from it
+        if (PRELUDE_BLOB != nullptr) {
+            static std::vector<ASTNode *> decls;
+            prelude = x::deserialize_symtable(PRELUDE_BLOB, PRELUDE_BLOB_SIZE, x::builtins_hash(), decls);
+
+            if (prelude != nullptr) {
+                return;
+            }
+        }
+
+        static SymbolTable * bare = x::bare_symtable();
+        static CompilationContext ctx(bare);
+        static ParseResult result = x::parse_builtins(ctx);
+        prelude = result.parser_state->symtable;
+    });
+
+    return prelude;
 }
 
 void x::setup_symtable() {
-    ParseResult result = x::parse_str(BUILTIN_DECLS);
-    the_default_symtable = result.parser_state->symtable->clone();
+    x::prelude_symtable();
 }
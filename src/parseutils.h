@@ -1,11 +1,17 @@
 #ifndef SRC_PARSEUTILS_H
 #define SRC_PARSEUTILS_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "ast.h"
+#include "context.h"
 #include "parsedecls.h"
 #include "symtable.h"
 
 struct ParseResult {
+    // An errno value, or EINVAL if there were syntax errors. They are recorded in the
+    // parser state, which then always has a top node, if only an empty one
     int error;
     ParserState * parser_state;
 
@@ -16,15 +22,36 @@ struct ParseResult {
 
 typedef struct ParseResult ParseResult;
 
+// Source of the builtin functions every program can call
+extern const char * BUILTIN_DECLS;
+
+// The prelude's symbol table in binary form (see serialize.h), generated from
+// BUILTIN_DECLS at build time. Weak, so that a binary built without it (such as the
+// tool that generates it) links and parses the prelude instead
+extern const unsigned char PRELUDE_BLOB[] __attribute__((weak));
+extern const size_t PRELUDE_BLOB_SIZE __attribute__((weak));
+
 namespace x {
-    ParseResult parse_file(const char * const path);
+    // If a sink is given, each top-level declaration is passed to it as soon as it
+    // has been parsed
+    ParseResult parse_file(CompilationContext &ctx, const char * const path, DeclSink * sink = nullptr);
+
+    ParseResult parse_stdin(CompilationContext &ctx, DeclSink * sink = nullptr);
+
+    // Parses a source that has already been read. Takes ownership of 'source'
+    ParseResult parse_buffer(CompilationContext &ctx, SourceBuffer * source, const std::string &name,
+                             DeclSink * sink = nullptr);
 
-    ParseResult parse_stdin();
+    ParseResult parse_str(CompilationContext &ctx, const char * code);
 
-    ParseResult parse_str(const char * code);
+    // Parses BUILTIN_DECLS on top of the primitive types. The result's symbols point
+    // into its AST, and 'ctx' has to outlive it
+    ParseResult parse_builtins(CompilationContext &ctx);
 
-    SymbolTable * default_symtable();
+    // Hash of BUILTIN_DECLS, stored in PRELUDE_BLOB so a stale blob isn't used
+    uint64_t builtins_hash();
 
+    // Builds the shared prelude up front so the first compile doesn't pay for it
     void setup_symtable();
 }
 
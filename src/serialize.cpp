@@ -0,0 +1,432 @@
+#include "serialize.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+
+static const char BLOB_MAGIC[4] = {'X', 'S', 'Y', 'M'};
+
+enum TypenameTag : uint8_t {
+    TagTypeIdent,
+    TagParens,
+    TagPtr,
+    TagMut,
+    TagTuple,
+    TagFunc,
+    TagDynamicArray,
+    TagStaticArray,
+};
+
+// Integers are stored in host byte order; a blob is only ever read by the binary that
+// embeds it
+template<typename T>
+static void put(std::string &out, T value) {
+    out.append((const char *) &value, sizeof(T));
+}
+
+static void put_str(std::string &out, const std::string &str) {
+    put<uint32_t>(out, str.size());
+    out += str;
+}
+
+static void put_loc(std::string &out, const Location &loc) {
+    put<uint32_t>(out, loc.begin);
+    put<uint32_t>(out, loc.end);
+}
+
+static bool put_typename(std::string &out, const Typename * type);
+
+static bool put_typename_list(std::string &out, const TypenameList * list) {
+    put_loc(out, list->loc);
+    put<uint32_t>(out, list->types.size());
+
+    for (auto &type : list->types) {
+        if (!put_typename(out, type)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void put_offsets(std::string &out, const std::vector<int> &offsets) {
+    put<uint32_t>(out, offsets.size());
+
+    for (int offset : offsets) {
+        put<int32_t>(out, offset);
+    }
+}
+
+static bool put_typename(std::string &out, const Typename * type) {
+    int kind = type->get_kind();
+
+    if (kind == TypeIdent::kind) {
+        put<uint8_t>(out, TagTypeIdent);
+        put_loc(out, type->loc);
+        put_str(out, ((TypeIdent *) type)->id);
+        return true;
+    } else if (kind == ParensTypename::kind) {
+        put<uint8_t>(out, TagParens);
+        put_loc(out, type->loc);
+        return put_typename(out, ((ParensTypename *) type)->name);
+    } else if (kind == PtrTypename::kind) {
+        put<uint8_t>(out, TagPtr);
+        put_loc(out, type->loc);
+        return put_typename(out, ((PtrTypename *) type)->name);
+    } else if (kind == MutTypename::kind) {
+        put<uint8_t>(out, TagMut);
+        put_loc(out, type->loc);
+        return put_typename(out, ((MutTypename *) type)->name);
+    } else if (kind == TupleTypename::kind) {
+        const TupleTypename * tuple = (TupleTypename *) type;
+        put<uint8_t>(out, TagTuple);
+        put_loc(out, type->loc);
+        return put_typename_list(out, tuple->type_list);
+    } else if (kind == FuncTypename::kind) {
+        const FuncTypename * func = (FuncTypename *) type;
+        put<uint8_t>(out, TagFunc);
+        put_loc(out, type->loc);
+        put_offsets(out, func->offsets);
+        return put_typename_list(out, func->params) && put_typename(out, func->ret_type);
+    } else if (kind == DynamicArrayTypename::kind) {
+        put<uint8_t>(out, TagDynamicArray);
+        put_loc(out, type->loc);
+        return put_typename(out, ((DynamicArrayTypename *) type)->element_type);
+    } else if (kind == StaticArrayTypename::kind) {
+        const StaticArrayTypename * arr = (StaticArrayTypename *) type;
+        put<uint8_t>(out, TagStaticArray);
+        put_loc(out, type->loc);
+        put_loc(out, arr->size->loc);
+        put<int32_t>(out, arr->size->value);
+        return put_typename(out, arr->element_type);
+    }
+
+    // Struct types have their own scope, which isn't worth storing for the prelude
+    return false;
+}
+
+static bool put_var_decl(std::string &out, const VarDecl * decl) {
+    put_loc(out, decl->loc);
+    put_loc(out, decl->var_name->loc);
+    put_str(out, decl->var_name->id);
+
+    return put_typename(out, decl->type_name);
+}
+
+bool x::serialize_symtable(const SymbolTable * symtable, uint64_t source_hash, std::string &out) {
+    if (symtable->enclosing != nullptr) {
+        return false;
+    }
+
+    // Sorted so the same table always gives the same blob
+    std::vector<std::string> names;
+
+    for (auto &item : symtable->table) {
+        names.push_back(item.first);
+    }
+
+    std::sort(names.begin(), names.end());
+
+    out.append(BLOB_MAGIC, sizeof(BLOB_MAGIC));
+    put<uint32_t>(out, SYMTABLE_BLOB_VERSION);
+    put<uint64_t>(out, source_hash);
+    put<uint32_t>(out, names.size());
+
+    for (auto &name : names) {
+        const Symbol * sym = symtable->table.at(name);
+
+        put<uint8_t>(out, sym->kind);
+        put<uint8_t>(out, sym->initialized);
+        put_str(out, name);
+
+        if (sym->kind == Type) {
+            // Only primitive types, which have no declaration
+            if (sym->decl.typ != nullptr) {
+                return false;
+            }
+        } else if (sym->kind == Var) {
+            if (!put_var_decl(out, sym->decl.var)) {
+                return false;
+            }
+        } else {
+            const FuncDecl * func = sym->decl.func;
+
+            put_loc(out, func->loc);
+            put_loc(out, func->name->loc);
+            put_loc(out, func->params->loc);
+            put<uint32_t>(out, func->params->params.size());
+
+            for (auto &param : func->params->params) {
+                if (!put_var_decl(out, param)) {
+                    return false;
+                }
+            }
+
+            if (!put_typename(out, func->ret_type)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Reads a blob front to back. Every read is bounds checked; once one fails the
+// reader stays failed and returns zeroes
+class BlobReader {
+    public:
+        bool failed;
+
+        BlobReader(const unsigned char * data, size_t size) : failed(false), data(data), end(data + size) {}
+
+        template<typename T>
+        T get() {
+            T value = 0;
+
+            if (!failed && (size_t) (end - data) >= sizeof(T)) {
+                memcpy(&value, data, sizeof(T));
+                data += sizeof(T);
+            } else {
+                failed = true;
+            }
+
+            return value;
+        }
+
+        std::string get_str() {
+            uint32_t size = get<uint32_t>();
+
+            if (failed || (size_t) (end - data) < size) {
+                failed = true;
+                return "";
+            }
+
+            std::string out((const char *) data, size);
+            data += size;
+
+            return out;
+        }
+
+        Location get_loc() {
+            uint32_t begin = get<uint32_t>();
+            uint32_t end = get<uint32_t>();
+
+            return Location(begin, end);
+        }
+
+        bool at_end() const {
+            return data == end;
+        }
+
+    private:
+        const unsigned char * data;
+        const unsigned char * end;
+};
+
+static Typename * get_typename(BlobReader &in);
+
+static TypenameList * get_typename_list(BlobReader &in) {
+    Location loc = in.get_loc();
+    uint32_t count = in.get<uint32_t>();
+    std::vector<Typename *> types;
+
+    for (uint32_t i = 0; i < count && !in.failed; i++) {
+        Typename * type = get_typename(in);
+
+        if (type != nullptr) {
+            types.push_back(type);
+        }
+    }
+
+    TypenameList * out = new TypenameList(loc, types);
+
+    if (in.failed) {
+        delete out;
+        return nullptr;
+    }
+
+    return out;
+}
+
+static std::vector<int> get_offsets(BlobReader &in) {
+    uint32_t count = in.get<uint32_t>();
+    std::vector<int> out;
+
+    for (uint32_t i = 0; i < count && !in.failed; i++) {
+        out.push_back(in.get<int32_t>());
+    }
+
+    return out;
+}
+
+static Typename * get_typename(BlobReader &in) {
+    uint8_t tag = in.get<uint8_t>();
+    Location loc = in.get_loc();
+
+    if (in.failed) {
+        return nullptr;
+    }
+
+    switch (tag) {
+        case TagTypeIdent: {
+            std::string id = in.get_str();
+            return in.failed ? nullptr : new TypeIdent(loc, id.c_str());
+        }
+        case TagParens: {
+            Typename * name = get_typename(in);
+            return name == nullptr ? nullptr : new ParensTypename(loc, name);
+        }
+        case TagPtr: {
+            Typename * name = get_typename(in);
+            return name == nullptr ? nullptr : new PtrTypename(loc, name);
+        }
+        case TagMut: {
+            Typename * name = get_typename(in);
+            return name == nullptr ? nullptr : new MutTypename(loc, name);
+        }
+        case TagTuple: {
+            TypenameList * types = get_typename_list(in);
+            return types == nullptr ? nullptr : new TupleTypename(loc, types);
+        }
+        case TagFunc: {
+            std::vector<int> offsets = get_offsets(in);
+            std::unique_ptr<TypenameList> params(get_typename_list(in));
+            Typename * ret_type = params == nullptr ? nullptr : get_typename(in);
+
+            if (ret_type == nullptr) {
+                return nullptr;
+            }
+
+            return new FuncTypename(loc, params.release(), ret_type, offsets);
+        }
+        case TagDynamicArray: {
+            Typename * element_type = get_typename(in);
+            return element_type == nullptr ? nullptr : new DynamicArrayTypename(loc, element_type);
+        }
+        case TagStaticArray: {
+            Location size_loc = in.get_loc();
+            int size = in.get<int32_t>();
+            Typename * element_type = in.failed ? nullptr : get_typename(in);
+
+            if (element_type == nullptr) {
+                return nullptr;
+            }
+
+            return new StaticArrayTypename(loc, element_type, new IntLiteral(size_loc, size));
+        }
+    }
+
+    in.failed = true;
+    return nullptr;
+}
+
+static VarDecl * get_var_decl(BlobReader &in) {
+    Location loc = in.get_loc();
+    Location name_loc = in.get_loc();
+    std::string name = in.get_str();
+    Typename * type = in.failed ? nullptr : get_typename(in);
+
+    if (type == nullptr) {
+        return nullptr;
+    }
+
+    return new VarDecl(loc, type, new Ident(name_loc, name.c_str()));
+}
+
+static FuncDecl * get_func_decl(BlobReader &in, const std::string &name, SymbolTable * symtable) {
+    Location loc = in.get_loc();
+    Location name_loc = in.get_loc();
+    Location params_loc = in.get_loc();
+    uint32_t count = in.get<uint32_t>();
+    std::unique_ptr<ParamsList> params(new ParamsList(params_loc, {}));
+
+    for (uint32_t i = 0; i < count && !in.failed; i++) {
+        VarDecl * param = get_var_decl(in);
+
+        if (param != nullptr) {
+            params->push_param(param);
+        }
+    }
+
+    Typename * ret_type = in.failed ? nullptr : get_typename(in);
+
+    if (ret_type == nullptr) {
+        return nullptr;
+    }
+
+    // The parameters are the only names in a bodiless function's scope
+    SymbolTable * scope = new SymbolTable(symtable);
+
+    for (auto &param : params->params) {
+        Symbol * sym = new Symbol(Var, { .var=param });
+        sym->initialized = true;
+        scope->put(param->var_name->id, sym);
+    }
+
+    FuncDecl * out = new FuncDecl(loc, new Ident(name_loc, name.c_str()), params.release(), ret_type, nullptr, scope);
+    scope->set_node(out);
+
+    return out;
+}
+
+SymbolTable * x::deserialize_symtable(const unsigned char * data, size_t size, uint64_t source_hash,
+                                      std::vector<ASTNode *> &decls) {
+    if (size < sizeof(BLOB_MAGIC) || memcmp(data, BLOB_MAGIC, sizeof(BLOB_MAGIC)) != 0) {
+        return nullptr;
+    }
+
+    BlobReader in(data + sizeof(BLOB_MAGIC), size - sizeof(BLOB_MAGIC));
+
+    if (in.get<uint32_t>() != SYMTABLE_BLOB_VERSION || in.get<uint64_t>() != source_hash) {
+        return nullptr;
+    }
+
+    uint32_t count = in.get<uint32_t>();
+    SymbolTable * out = new SymbolTable(nullptr);
+    size_t first_decl = decls.size();
+
+    for (uint32_t i = 0; i < count && !in.failed; i++) {
+        uint8_t kind = in.get<uint8_t>();
+        bool initialized = in.get<uint8_t>();
+        std::string name = in.get_str();
+        Decl decl = { .typ=nullptr };
+
+        if (in.failed) {
+            break;
+        }
+
+        if (kind == Var) {
+            decl.var = get_var_decl(in);
+
+            if (decl.var != nullptr) {
+                decls.push_back(decl.var);
+            }
+        } else if (kind == Func) {
+            decl.func = get_func_decl(in, name, out);
+
+            if (decl.func != nullptr) {
+                decls.push_back(decl.func);
+            }
+        } else if (kind != Type) {
+            in.failed = true;
+        }
+
+        Symbol * sym = new Symbol((SymbolKind) kind, decl);
+        sym->initialized = initialized;
+        out->put(name, sym);
+    }
+
+    if (in.failed || !in.at_end()) {
+        for (size_t i = first_decl; i < decls.size(); i++) {
+            delete decls[i];
+        }
+
+        decls.resize(first_decl);
+        delete out;
+
+        return nullptr;
+    }
+
+    return out;
+}
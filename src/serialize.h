@@ -0,0 +1,44 @@
+/**
+ * Compact binary form of a top-level symbol table, used to embed the prelude in the
+ * compiler so it doesn't have to be parsed at startup (see x::prelude_symtable).
+ *
+ * Only what other code can see of a global scope is kept: primitive types, global
+ * variables and function signatures. Function bodies are dropped, so a loaded
+ * FuncDecl has a null body and a scope holding just its parameters.
+ *
+ * A blob starts with a magic number, the format version and a hash of the source it
+ * was made from. Loading fails if any of these don't match, so a stale blob is never
+ * used and the caller can fall back to parsing.
+ */
+#ifndef SRC_SERIALIZE_H
+#define SRC_SERIALIZE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "ast.h"
+#include "symtable.h"
+
+#define SYMTABLE_BLOB_VERSION 2
+
+namespace x {
+    /**
+     * Appends 'symtable' to 'out'. Returns false if the table has something that can't
+     * be stored, such as a struct or type alias, or an enclosing scope.
+     */
+    bool serialize_symtable(const SymbolTable * symtable, uint64_t source_hash, std::string &out);
+
+    /**
+     * Rebuilds a symbol table from a blob. The declarations the symbols point to are
+     * added to 'decls' and are owned by the caller, like the AST of a parsed file.
+     * Returns nullptr if the blob is malformed, from another version, or was made from
+     * a source with a different hash.
+     */
+    SymbolTable * deserialize_symtable(const unsigned char * data, size_t size, uint64_t source_hash,
+                                       std::vector<ASTNode *> &decls);
+}
+
+#endif
@@ -0,0 +1,299 @@
+#include "server.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <system_error>
+#include <thread>
+
+#include "source_buffer.h"
+
+#define REQUEST_STREAMING 1
+#define REQUEST_FAST_LEXER 2
+#define REQUEST_REORDER_FIELDS 4
+
+// Requests bigger than this are refused rather than allocated
+#define MAX_MESSAGE_SIZE (1u << 30)
+
+// A client that sends or takes nothing for this long is hung up on, so it can't hold
+// a pool thread forever
+#define CLIENT_TIMEOUT_SECONDS 30
+
+static bool read_all(int fd, void * data, size_t size) {
+    char * out = (char *) data;
+
+    while (size > 0) {
+        ssize_t n = read(fd, out, size);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return false;
+        }
+
+        out += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static bool write_all(int fd, const void * data, size_t size) {
+    const char * in = (const char *) data;
+
+    while (size > 0) {
+        ssize_t n = write(fd, in, size);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return false;
+        }
+
+        in += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+template<typename T>
+static bool read_value(int fd, T &value) {
+    return read_all(fd, &value, sizeof(T));
+}
+
+template<typename T>
+static bool write_value(int fd, T value) {
+    return write_all(fd, &value, sizeof(T));
+}
+
+static bool read_str(int fd, std::string &str) {
+    uint32_t size;
+
+    if (!read_value(fd, size) || size > MAX_MESSAGE_SIZE) {
+        return false;
+    }
+
+    str.resize(size);
+
+    return read_all(fd, &str[0], size);
+}
+
+static bool write_str(int fd, const std::string &str) {
+    return write_value<uint32_t>(fd, str.size()) && write_all(fd, str.data(), str.size());
+}
+
+// Returns false if the path doesn't fit in a socket address
+static bool socket_address(const std::string &path, sockaddr_un &addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    return true;
+}
+
+// Handles one connection on its own thread and closes it. Only the compile runs on the
+// pool, so a client that is slow to send or read never holds a worker, and a worker
+// helping out in parallel_for can't pick up a connection that is still being read
+static void serve(int fd, ThreadPool &pool) {
+    timeval timeout = { CLIENT_TIMEOUT_SECONDS, 0 };
+
+    // Reads and writes that time out fail like a hangup
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0) {
+        close(fd);
+        return;
+    }
+
+    uint8_t flags;
+    uint8_t has_source;
+    std::string name;
+    std::string text;
+
+    if (!read_value(fd, flags) || !read_str(fd, name) || !read_value(fd, has_source) || !read_str(fd, text)) {
+        close(fd);
+        return;
+    }
+
+    CompileJob job = {};
+    job.input = name;
+    job.streaming = flags & REQUEST_STREAMING;
+    job.fast_lexer = flags & REQUEST_FAST_LEXER;
+    job.reorder_fields = flags & REQUEST_REORDER_FIELDS;
+
+    // Read rather than mapped: the client's editor may truncate the file while it's
+    // being compiled, and a fault in a mapping would take the whole server down
+    int error = 0;
+    SourceBuffer * source = has_source ? SourceBuffer::from_bytes(text.data(), text.size(), &error)
+                                       : SourceBuffer::read_path(text.c_str(), &error);
+    std::ostringstream assembly;
+    CompileResult result;
+
+    if (source == nullptr) {
+        result = { 1, "Error: " + name + ": " + strerror(error) + "\n" };
+    } else {
+        // The promise is shared so the task never touches this frame after waking it
+        auto compiled = std::make_shared<std::promise<CompileResult>>();
+        std::future<CompileResult> done = compiled->get_future();
+
+        pool.submit([&job, source, &assembly, &pool, compiled]() {
+            compiled->set_value(x::compile_buffer(job, source, assembly, &pool));
+        });
+
+        result = done.get();
+    }
+
+    // If the client has gone away there is no one to tell
+    (void) (write_value<int32_t>(fd, result.error) && write_str(fd, result.diagnostics) && write_str(fd, assembly.str()));
+    close(fd);
+}
+
+// Where the server is listening, so it can be removed when the server is stopped
+static char listening_path[sizeof(sockaddr_un::sun_path)];
+
+static void stop_server(int) {
+    unlink(listening_path);
+    _exit(0);
+}
+
+int x::run_server(const std::string &socket_path, ThreadPool &pool) {
+    sockaddr_un addr;
+
+    if (!socket_address(socket_path, addr)) {
+        fprintf(stderr, "Error: socket path is too long: %s\n", socket_path.c_str());
+        return 1;
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (listener < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    // A socket file that nothing answers on was left by a server that didn't exit
+    // cleanly, and can be replaced
+    if (connect(listener, (sockaddr *) &addr, sizeof(addr)) == 0) {
+        fprintf(stderr, "Error: a server is already listening on %s\n", socket_path.c_str());
+        close(listener);
+        return 1;
+    }
+
+    close(listener);
+    unlink(socket_path.c_str());
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (listener < 0 || bind(listener, (sockaddr *) &addr, sizeof(addr)) != 0 || listen(listener, SOMAXCONN) != 0) {
+        fprintf(stderr, "Error: %s: %s\n", socket_path.c_str(), strerror(errno));
+        return 1;
+    }
+
+    memcpy(listening_path, addr.sun_path, sizeof(listening_path));
+    signal(SIGINT, stop_server);
+    signal(SIGTERM, stop_server);
+
+    // A client that hangs up early shouldn't take the server down
+    signal(SIGPIPE, SIG_IGN);
+
+    while (true) {
+        int fd = accept(listener, nullptr, nullptr);
+
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+
+            perror("accept");
+            unlink(listening_path);
+            return 1;
+        }
+
+        try {
+            std::thread(serve, fd, std::ref(pool)).detach();
+        } catch (std::system_error &) {
+            close(fd);
+        }
+    }
+}
+
+CompileResult x::compile_remote(const std::string &socket_path, const CompileJob &job) {
+    sockaddr_un addr;
+
+    if (!socket_address(socket_path, addr)) {
+        return { 1, "Error: socket path is too long: " + socket_path + "\n" };
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0 || connect(fd, (sockaddr *) &addr, sizeof(addr)) != 0) {
+        std::string message = strerror(errno);
+
+        if (fd >= 0) {
+            close(fd);
+        }
+
+        return { 1, "Error: can't connect to " + socket_path + ": " + message + "\n" };
+    }
+
+    uint8_t flags = (job.streaming ? REQUEST_STREAMING : 0) | (job.fast_lexer ? REQUEST_FAST_LEXER : 0) |
+                    (job.reorder_fields ? REQUEST_REORDER_FIELDS : 0);
+    bool has_source = job.input.empty();
+    std::string name = has_source ? "<stdin>" : job.input;
+    std::string text;
+
+    // The server has its own working directory, so it gets an absolute path. Stdin
+    // is sent as it is
+    if (has_source) {
+        std::ostringstream in;
+        in << std::cin.rdbuf();
+        text = in.str();
+    } else {
+        std::error_code error;
+        text = std::filesystem::absolute(job.input, error).string();
+    }
+
+    int32_t error;
+    CompileResult result = {};
+    std::string assembly;
+
+    bool ok = write_value(fd, flags) && write_str(fd, name) && write_value<uint8_t>(fd, has_source) && write_str(fd, text)
+        && read_value(fd, error) && read_str(fd, result.diagnostics) && read_str(fd, assembly);
+
+    close(fd);
+
+    if (!ok) {
+        return { 1, "Error: lost the connection to " + socket_path + "\n" };
+    }
+
+    result.error = error;
+
+    if (result.error == 0) {
+        std::ofstream fs(job.asm_path);
+        fs << assembly;
+        fs.close();
+
+        if (!fs) {
+            return { 1, result.diagnostics + "Error: " + job.asm_path + ": " + strerror(errno) + "\n" };
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,33 @@
+/**
+ * Keeps a compiler resident so that each compile doesn't pay for process startup and
+ * loading the prelude. The server listens on a UNIX domain socket and compiles one
+ * file per connection; the client sends a file (by path, or its contents for stdin)
+ * and gets back the assembly and diagnostics. Each connection is read and answered
+ * on its own thread, and only the compile runs on the shared ThreadPool.
+ *
+ * Messages are a few integers and length-prefixed strings in host byte order, since
+ * both ends are always on the same machine:
+ *   request:  u8 flags, name, u8 has_source, source or path
+ *   response: i32 error, diagnostics, assembly
+ * The name is what diagnostics call the file. Without a source, the server reads
+ * the file at 'path', which the client makes absolute.
+ */
+#ifndef SRC_SERVER_H
+#define SRC_SERVER_H
+
+#include <string>
+
+#include "driver.h"
+#include "thread_pool.h"
+
+namespace x {
+    // Serves requests until the process is interrupted. Returns nonzero if the socket
+    // can't be set up
+    int run_server(const std::string &socket_path, ThreadPool &pool);
+
+    // Compiles a job on the server at 'socket_path' and writes the assembly to the
+    // job's asm path. Dot files and the cache aren't supported remotely
+    CompileResult compile_remote(const std::string &socket_path, const CompileJob &job);
+}
+
+#endif
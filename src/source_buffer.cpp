@@ -0,0 +1,151 @@
+#include "source_buffer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceBuffer::SourceBuffer(char * data, size_t size, size_t mapped_size)
+    : data(data), size(size), line_table(nullptr), mapped_size(mapped_size) {}
+
+SourceBuffer::~SourceBuffer() {
+    if (mapped_size > 0) {
+        munmap(data, mapped_size);
+    } else {
+        free(data);
+    }
+}
+
+const LineTable &SourceBuffer::lines() {
+    if (line_table == nullptr) {
+        line_table = std::make_unique<LineTable>(data, size);
+    }
+
+    return *line_table;
+}
+
+SourceBuffer * SourceBuffer::open_file(const char * path, int * error) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        *error = errno;
+        return nullptr;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0) {
+        *error = errno;
+        close(fd);
+        return nullptr;
+    }
+
+    if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+        FILE * file = fdopen(fd, "r");
+        SourceBuffer * out = SourceBuffer::read_file(file, error);
+        fclose(file);
+
+        return out;
+    }
+
+    size_t size = st.st_size;
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t mapped_size = (size + SOURCE_PADDING + page - 1) / page * page;
+
+    // Reserve room for the file plus padding with zeroed anonymous pages, then map the
+    // file over the start of it. The rest of the file's last page is zero filled too
+    char * data = (char *) mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (data == MAP_FAILED) {
+        *error = errno;
+        close(fd);
+        return nullptr;
+    }
+
+    if (mmap(data, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        *error = errno;
+        munmap(data, mapped_size);
+        close(fd);
+        return nullptr;
+    }
+
+    madvise(data, size, MADV_SEQUENTIAL);
+    close(fd);
+
+    return new SourceBuffer(data, size, mapped_size);
+}
+
+SourceBuffer * SourceBuffer::read_file(FILE * file, int * error) {
+    size_t capacity = 1 << 16;
+    size_t size = 0;
+    char * data = (char *) malloc(capacity + SOURCE_PADDING);
+
+    if (data == nullptr) {
+        *error = ENOMEM;
+        return nullptr;
+    }
+
+    while (true) {
+        size += fread(data + size, 1, capacity - size, file);
+
+        if (size < capacity) {
+            break;
+        }
+
+        capacity *= 2;
+        char * grown = (char *) realloc(data, capacity + SOURCE_PADDING);
+
+        if (grown == nullptr) {
+            *error = ENOMEM;
+            free(data);
+            return nullptr;
+        }
+
+        data = grown;
+    }
+
+    if (ferror(file)) {
+        *error = errno;
+        free(data);
+        return nullptr;
+    }
+
+    memset(data + size, 0, SOURCE_PADDING);
+
+    return new SourceBuffer(data, size, 0);
+}
+
+SourceBuffer * SourceBuffer::read_path(const char * path, int * error) {
+    FILE * file = fopen(path, "rb");
+
+    if (file == nullptr) {
+        *error = errno;
+        return nullptr;
+    }
+
+    SourceBuffer * out = SourceBuffer::read_file(file, error);
+    fclose(file);
+
+    return out;
+}
+
+SourceBuffer * SourceBuffer::from_str(const char * str, int * error) {
+    return SourceBuffer::from_bytes(str, strlen(str), error);
+}
+
+SourceBuffer * SourceBuffer::from_bytes(const char * bytes, size_t size, int * error) {
+    char * data = (char *) malloc(size + SOURCE_PADDING);
+
+    if (data == nullptr) {
+        *error = ENOMEM;
+        return nullptr;
+    }
+
+    memcpy(data, bytes, size);
+    memset(data + size, 0, SOURCE_PADDING);
+
+    return new SourceBuffer(data, size, 0);
+}
@@ -0,0 +1,60 @@
+/**
+ * The full text of a source file in one contiguous, writable buffer, followed by
+ * SOURCE_PADDING zero bytes. Files are mmap'd rather than read, and flex scans the
+ * buffer in place (see yy_scan_buffer), so nothing is copied on the way in and
+ * token text can point straight into the buffer.
+ *
+ * Flex writes a NUL after each token while it is being matched and puts the old
+ * character back afterwards, so the mapping is private and writable. Pages that
+ * flex writes to get copied by the kernel; the file itself is never modified.
+ */
+#ifndef SRC_SOURCE_BUFFER_H
+#define SRC_SOURCE_BUFFER_H
+
+#include <stdio.h>
+
+#include <memory>
+
+#include "line_table.h"
+
+// Number of zero bytes after the end of the source. Flex needs two; scanning code that
+// reads a vector at a time needs enough to never read past the buffer
+#define SOURCE_PADDING 64
+
+class SourceBuffer {
+    public:
+        char * data;
+
+        // Length of the source, not counting the padding
+        size_t size;
+
+        // Maps the file, or reads it if it can't be mapped (pipes, empty files). These
+        // all return nullptr and set 'error' to an errno value on failure
+        static SourceBuffer * open_file(const char * path, int * error);
+
+        static SourceBuffer * read_file(FILE * file, int * error);
+
+        // Reads the file without mapping it. For files that can be truncated while
+        // they're being compiled, which would fault a mapping with SIGBUS
+        static SourceBuffer * read_path(const char * path, int * error);
+
+        static SourceBuffer * from_str(const char * str, int * error);
+
+        // Copies 'size' bytes, which may include NULs
+        static SourceBuffer * from_bytes(const char * bytes, size_t size, int * error);
+
+        ~SourceBuffer();
+
+        // Builds the line table the first time it's called. Not thread safe
+        const LineTable &lines();
+
+    private:
+        std::unique_ptr<LineTable> line_table;
+
+        // Length of the mapping, or 0 if 'data' was malloc'd
+        size_t mapped_size;
+
+        SourceBuffer(char * data, size_t size, size_t mapped_size);
+};
+
+#endif
@@ -1,5 +1,14 @@
 #include "symtable.h"
 
+#include <atomic>
+
+#include "hash.h"
+
+// Starting size of an IdentCache, enough for most files without growing
+#define IDENT_CACHE_SLOTS 1024
+
+static std::atomic<uint32_t> type_versions(1);
+
 Symbol * Symbol::clone() const {
     Symbol * out = new Symbol(kind, decl);
     out->next = next;
@@ -26,9 +35,33 @@ ASTNode * Symbol::decl_upcast() {
 SymbolTable * SymbolTable::clone() const {
     SymbolTable * out = new SymbolTable(enclosing == nullptr ? nullptr : enclosing->clone());
     out->node = node;
+    out->types = types;
 
     for (auto &item : table) {
-        out->table[item.first] = item.second->clone();
+        // Through put, so the copy gets type versions of its own
+        out->put(item.first, item.second->clone());
+    }
+
+    return out;
+}
+
+void SymbolTable::put(std::string name, Symbol * symbol) {
+    table[name] = symbol;
+
+    if (symbol->kind == Type) {
+        type_version = type_versions++;
+    }
+
+    if (idents != nullptr) {
+        idents->forget(name);
+    }
+}
+
+SymbolTable * SymbolTable::type_scope() {
+    SymbolTable * out = this;
+
+    while (out->type_version == 0 && out->enclosing != nullptr) {
+        out = out->enclosing;
     }
 
     return out;
@@ -58,6 +91,7 @@ SymbolTable * x::bare_symtable() {
 
 void x::create_scope(SymbolTable ** table) {
     SymbolTable * next = new SymbolTable(*table);
+    next->idents = (*table)->idents;
     *table = next;
 }
 
@@ -65,5 +99,93 @@ SymbolTable * x::pop_scope(SymbolTable ** table) {
     SymbolTable * out = *table;
     *table = (*table)->enclosing;
 
+    // Names declared here meant something else outside
+    if (out->idents != nullptr) {
+        for (auto &item : out->table) {
+            out->idents->forget(item.first);
+        }
+
+        out->idents = nullptr;
+    }
+
     return out;
 }
+
+IdentCache::IdentCache() : slots(IDENT_CACHE_SLOTS), used(0), names("") {}
+
+IdentCache::Slot * IdentCache::find(std::string_view name, uint64_t hash) {
+    size_t mask = slots.size() - 1;
+
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        Slot &slot = slots[i];
+
+        if (slot.size == 0) {
+            return &slot;
+        }
+
+        if (slot.hash == (uint32_t) hash && slot.size == name.size() &&
+                memcmp(names.data() + slot.name, name.data(), name.size()) == 0) {
+            return &slot;
+        }
+    }
+}
+
+IdentClass IdentCache::classify(std::string_view name, SymbolTable * scope, const Symbol ** sym) {
+    uint64_t hash = x::hash_bytes(name.data(), name.size());
+    Slot * slot = find(name, hash);
+
+    if (slot->size == 0) {
+        if ((used + 1) * 2 > slots.size()) {
+            std::vector<Slot> old(slots.size() * 2);
+            old.swap(slots);
+
+            for (auto &item : old) {
+                if (item.size != 0) {
+                    *find(std::string_view(names.data() + item.name, item.size), item.hash) = item;
+                }
+            }
+
+            slot = find(name, hash);
+        }
+
+        *slot = {(uint32_t) hash, (uint32_t) names.size(), (uint32_t) name.size(), IdentUnknown, nullptr};
+        names.append(name);
+        used++;
+    }
+
+    if (slot->cls == IdentUnknown) {
+        const Symbol * found = scope->get(std::string(name));
+
+        if (found != nullptr) {
+            slot->cls = found->kind == Var ? IdentVar : found->kind == Type ? IdentType : IdentFunc;
+            slot->sym = found;
+        } else if (name.back() == 's') {
+            found = scope->get(std::string(name.substr(0, name.size() - 1)));
+            bool array = found != nullptr && found->kind == Type && found->decl.typ != nullptr;
+
+            slot->cls = array ? IdentArray : IdentUndeclared;
+            slot->sym = array ? found : nullptr;
+        } else {
+            slot->cls = IdentUndeclared;
+            slot->sym = nullptr;
+        }
+    }
+
+    *sym = slot->sym;
+
+    return slot->cls;
+}
+
+void IdentCache::forget(const std::string &name) {
+    forget_one(name);
+    forget_one(name + "s");
+}
+
+void IdentCache::forget_one(std::string_view name) {
+    Slot * slot = find(name, x::hash_bytes(name.data(), name.size()));
+
+    if (slot->size != 0) {
+        slot->cls = IdentUnknown;
+        slot->sym = nullptr;
+    }
+}
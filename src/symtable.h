@@ -1,17 +1,27 @@
 #ifndef SRC_SYMTABLE_H
 #define SRC_SYMTABLE_H
 
+#include <stdint.h>
 #include <string.h>
 
+#include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 enum SymbolKind { Var, Type, Func };
 
+// What the lexer makes of an identifier. IdentArray is a declared type's name with
+// an 's' on the end
+enum IdentClass { IdentUnknown, IdentUndeclared, IdentVar, IdentType, IdentFunc, IdentArray };
+
 class ASTNode;
+class IdentCache;
 class VarDecl;
 class FuncDecl;
 class TypeDecl;
+class TypeInterner;
 
 typedef union {
     VarDecl * var;
@@ -42,9 +52,24 @@ class SymbolTable {
         // AST node that has this scope. The symbol table does not own this node
         ASTNode * node;
 
+        // Where the types of expressions in this scope are kept. Inherited from the
+        // enclosing scope; not owned
+        TypeInterner * types;
+
+        // Set to a new number every time a type is declared in this scope, and zero
+        // if none has been. Type IDs kept on Typename nodes are only good for the
+        // version they were worked out under
+        uint32_t type_version;
+
+        // Told when a name is declared here or this scope is popped, while the parser
+        // has it open. Not owned
+        IdentCache * idents;
+
         // SymbolTable does not take ownership of `enclosing` and enclosing table
         // should not be destroyed when this table is destroyed
-        SymbolTable(SymbolTable * enclosing) : enclosing(enclosing), node(nullptr) {}
+        SymbolTable(SymbolTable * enclosing)
+            : enclosing(enclosing), node(nullptr), types(enclosing == nullptr ? nullptr : enclosing->types),
+              type_version(0), idents(nullptr) {}
 
         SymbolTable * clone() const;
 
@@ -54,19 +79,20 @@ class SymbolTable {
             }
         }
 
-        void put(std::string name, Symbol * symbol) {
-            table[name] = symbol;
-        }
+        void put(std::string name, Symbol * symbol);
 
         /**
          * Walk up the symbol table linked list and look for the symbol. If it is not
          * in this scope, it should be in an enclosing scope.
          */
-        Symbol * get(std::string name) {
+        Symbol * get(const std::string &name) {
             // If `name` is not in the map, then using the [] operator will insert
-            // a null value into the map. There was also no map::contains until C++20 :|
-            if (table.count(name)) {
-                return table[name];
+            // a null value into the map. find() also never writes to the table, so
+            // lookups are safe while other threads are reading the same scope
+            auto item = table.find(name);
+
+            if (item != table.end()) {
+                return item->second;
             } else if (enclosing != nullptr) {
                 return enclosing->get(name);
             }
@@ -74,6 +100,10 @@ class SymbolTable {
             return nullptr;
         }
 
+        // The nearest scope, this one or an enclosing one, that declares a type. Type
+        // names mean the same thing in every scope under it
+        SymbolTable * type_scope();
+
         void set_node(ASTNode * node) {
             this->node = node;
         }
@@ -81,14 +111,62 @@ class SymbolTable {
         void print();
 };
 
+/**
+ * What the lexer decided each identifier was, as seen from the innermost open
+ * scope. Identifiers are kept in an open addressing table the first time they're
+ * seen, with their class in the same slot, so seeing one again costs a hash of its
+ * text and a slot load instead of a lookup in every enclosing scope. A name is
+ * forgotten when it is declared and when the scope declaring it is popped; a new
+ * scope declares nothing, so creating one changes nothing. Only used by the thread
+ * doing the parsing.
+ */
+class IdentCache {
+    public:
+        IdentCache();
+
+        // The class of 'name' in 'scope', which has to be the innermost open scope. For
+        // IdentArray, 'sym' is set to the element type's symbol
+        IdentClass classify(std::string_view name, SymbolTable * scope, const Symbol ** sym);
+
+        // Forgets the class of 'name', and of 'name' with an 's' on the end
+        void forget(const std::string &name);
+
+    private:
+        struct Slot {
+            uint32_t hash;
+
+            // Where the name is in 'names'. Names are never empty, so a size of zero
+            // is a free slot
+            uint32_t name;
+            uint32_t size;
+
+            IdentClass cls;
+            const Symbol * sym;
+        };
+
+        // A power of two in size, and never more than half full
+        std::vector<Slot> slots;
+        uint32_t used;
+
+        // Every name seen, end to end
+        std::string names;
+
+        // The slot holding 'name', or the free slot it would go in
+        Slot * find(std::string_view name, uint64_t hash);
+
+        void forget_one(std::string_view name);
+};
+
 namespace x {
     const char * const symbol_kind_names[] = {"Var", "Type", "Func"};
 
-    // Creates a new scope and returns the corresponding symtable
+    // Creates a new scope and returns the corresponding symtable. It shares the
+    // enclosing scope's IdentCache
     void create_scope(SymbolTable ** table);
 
     // Pops the current scope and returns it. It is the caller's responsibility to
-    // free this memory
+    // free this memory. Its names are forgotten by its IdentCache, and it no longer
+    // has one
     SymbolTable * pop_scope(SymbolTable ** table);
 
     // Creates a bare top-level symbol table with symbols for primitive types only.
@@ -1,409 +1,499 @@
 #include "tac.h"
 #include "asm_utils.h"
+#include "errors.h"
 
 #include <iostream>
 #include <iomanip>
 
-BasicBlock *x::bblock = nullptr;
+LogicalOp x::logical_op(const std::string &op) {
+    for (size_t i = 0; i < NELEM(x::logical_op_names); i++) {
+        if (op == x::logical_op_names[i]) {
+            return (LogicalOp) i;
+        }
+    }
 
-std::string next_l() {
-    static int i = 0;
-    return ".L" + std::to_string(i++);
+    throw CompilerError(x::NULL_LOC, "Unknown operator " + op, Error);
 }
 
-std::string next_t() {
-    static int i = 0;
-    return "_t" + std::to_string(i++);
-}
+TacBuffer::TacBuffer(CompilationContext * ctx) :
+    ctx(ctx), ops({}), subops({}), dsts({}), args_a({}), args_b({}), values({}), value_ids({}),
+    labels({}), label_ids({}), float_literals({}), str_literals({}) {}
 
-std::string next_p() {
-    static int i = 0;
-    return "_p" + std::to_string(i++);
-}
+TacId TacBuffer::value(const std::string &name) {
+    auto item = value_ids.find(name);
 
-template<>
-void Value<bool>::print() const {
-    std::cout << id << " = " << std::boolalpha << value;
-}
+    if (item != value_ids.end()) {
+        return item->second;
+    }
 
-template <>
-void Value<char>::print() const {
-    std::cout << id << " = ";
-    switch (value) {
-        case '\n':
-            printf("\\n");
-            break;
+    TacId id = values.size();
+    values.push_back(name);
+    value_ids[name] = id;
 
-        case '\t':
-            printf("\\t");
-            break;
+    return id;
+}
 
-        case '\0':
-            printf("\\0");
-            break;
+TacLabel TacBuffer::label(const std::string &name) {
+    auto item = label_ids.find(name);
 
-        case '\e':
-            printf("\\e");
-            break;
+    if (item != label_ids.end()) {
+        return item->second;
+    }
 
-        case '\r':
-            printf("\\r");
-            break;
+    TacLabel id = labels.size();
+    labels.push_back(name);
+    label_ids[name] = id;
 
-        default:
-            printf("'%c'", value);
-    }
+    return id;
 }
 
-void BasicBlock::add_block(std::string name)
-{
-    BasicBlock *new_block = new BasicBlock();
-    new_block->name = name;
-    new_block->prev = this;
-    x::bblock = new_block;
-}
+const std::string &TacBuffer::name(TacId id) const {
+    static const std::string retval_name = "<retval>";
+    static const std::string none_name = "<none>";
 
-void Quad::print() const {}
+    if (id == TAC_RETVAL_ID) {
+        return retval_name;
+    }
 
-void CallTAC::print() const {
-    std::cout << "call " << fun;
-}
+    if (id == TAC_NONE) {
+        return none_name;
+    }
 
-void RetvalTAC::print() const {
-    std::cout << id << " = __retval";
+    return values[id];
 }
 
-void ArgTAC::print() const {
-    std::cout << id << " = __arg(" << arg << ")";
+void TacBuffer::emit(TacOp op, TacId dst, uint32_t a, uint32_t b, uint8_t subop) {
+    ops.push_back(op);
+    subops.push_back(subop);
+    dsts.push_back(dst);
+    args_a.push_back(a);
+    args_b.push_back(b);
 }
 
-void VoidReturnTAC::print() const {
-    std::cout << "ret";
+void TacBuffer::emit_int(TacId dst, int value) {
+    emit(TAC_INT, dst, (uint32_t) value, 0, 0);
 }
 
-void ReturnTAC::print() const {
-    std::cout << "ret " << id;
+void TacBuffer::emit_float(TacId dst, double value) {
+    emit(TAC_FLOAT, dst, float_literals.size(), 0, 0);
+    float_literals.push_back(value);
 }
 
-void CmpLiteralTAC::print() const {
-    std::cout << "cmp " << id << ", " << literal;
+void TacBuffer::emit_bool(TacId dst, bool value) {
+    emit(TAC_BOOL, dst, value, 0, 0);
 }
 
-void JneTAC::print() const {
-    std::cout << "jne " << label;
+void TacBuffer::emit_char(TacId dst, char value) {
+    emit(TAC_CHAR, dst, (uint8_t) value, 0, 0);
 }
 
-void LogicalTAC::print() const {
-    std::cout << id << " = " << left << " " << op << " " << right;
+void TacBuffer::emit_str(TacId dst, const std::string &value) {
+    emit(TAC_STR, dst, str_literals.size(), 0, 0);
+    str_literals.push_back(value);
 }
 
-void MathTAC::print() const {
-    std::cout << id << " = " << left << " " << op << " " << right;
+void TacBuffer::emit_assign(TacId dst, TacId rhs) {
+    emit(TAC_ASSIGN, dst, rhs, 0, 0);
 }
 
-void AssignTAC::print() const
-{
-    std::cout << id << " = " << rhs;
+void TacBuffer::emit_delete(TacId id) {
+    emit(TAC_DELETE, id, 0, 0, 0);
 }
 
-void DeleteTAC::print() const {
-    std::cout << "del " << id;
+void TacBuffer::emit_cmp_literal(TacId id, int literal) {
+    emit(TAC_CMP_LITERAL, id, (uint32_t) literal, 0, 0);
 }
 
-void LabelTAC::print() const {
-    std::cout << label << ":";
+void TacBuffer::emit_jne(TacLabel label) {
+    emit(TAC_JNE, TAC_NONE, label, 0, 0);
 }
 
-void SetupStackTAC::print() const {
-    std::cout << "setup_stack";
+void TacBuffer::emit_logical(TacId dst, LogicalOp op, TacId left, TacId right) {
+    emit(TAC_LOGICAL, dst, left, right, op);
 }
 
-void BasicBlock::print() const
-{
-    std::cout << name << ":" << '\n';
-
-    int i = 0;
-    for (auto trip : trips)
-    {
-        std::cout << i++ << ": ";
-        trip->print();
-        std::cout << '\n';
-    }
-    std::cout << i++  << ": ret" << '\n' << '\n';
-    if (this->prev)
-    {
-        this->prev->print();
-    }
+void TacBuffer::emit_math(TacId dst, char op, TacId left, TacId right) {
+    emit(TAC_MATH, dst, left, right, op);
 }
 
-std::string CharTAC(const char c, std::vector<Quad *> instrs) {
-    std::string temp = next_t();
-    Value<char> *value = new Value<char>(temp, c);
-    instrs.push_back(value);
-    return temp;
+void TacBuffer::emit_label(TacLabel label) {
+    emit(TAC_LABEL, TAC_NONE, label, 0, 0);
 }
 
-std::string FloatLitTAC(const float val, std::vector<Quad *> instrs, SymbolTable * global_symtable)
-{
-    std::string temp = next_t() ;
-    std::cout << temp << " = " << val ;
-    Value<float> *value = new Value<float>(temp, val);
-    instrs.push_back(value) ;
-    // wait for joe symbol table thing
-    // global_symtable->put(temp, val) ;
-    return temp ;
+void TacBuffer::emit_push(TacId id) {
+    emit(TAC_PUSH, id, 0, 0, 0);
 }
 
-std::string IntLitTAC(const int val, std::vector<Quad *> instrs, SymbolTable * global_symtable)
-{
-    std::string temp = next_t() ;
-    std::cout << temp << " = " << val;
-    Value<int> *value = new Value<int>(temp, val);
-    instrs.push_back(value) ;
-    // wait for joe symbol table thing
-    // global_symtable->put(temp, val) ;
-    return temp ;
-    
+void TacBuffer::emit_setup_stack() {
+    emit(TAC_SETUP_STACK, TAC_NONE, 0, 0, 0);
 }
 
-std::string BoolLitTAC(const bool b, std::vector<Quad *> instrs, SymbolTable * global_symtable)
-{
-    std::string temp = next_t() ;
-    std::cout << temp << " = " << b;
-    Value<bool> *value = new Value<bool>(temp, b);
-    instrs.push_back(value) ;
-    // wait for joe symbol table thing
-    // global_symtable->put(temp, val) ;
-    return temp ;
+void TacBuffer::emit_call(TacId func) {
+    emit(TAC_CALL, func, 0, 0, 0);
 }
 
-std::string StringLitTAC(const std::string s, std::vector<Quad *> instrs, SymbolTable * global_symtable)
-{
-    std::string temp = next_t() ;
-    std::cout << temp << " = " << s;
-    Value<std::string> *value = new Value<std::string>(temp, s);
-    instrs.push_back(value) ;
-    // wait for joe symbol table thing
-    // global_symtable->put(temp, val) ;
-    return temp;
+void TacBuffer::emit_retval(TacId id) {
+    emit(TAC_RETVAL, id, 0, 0, 0);
 }
 
-template <>
-void Value<int>::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    const GeneralReg reg = state.free_reg(code);
-    state.regs[reg].used = true;
-    state.regs[reg].var = id;
-    code << "movq $" << value << ", %" << REG_NAMES[reg] << "\n";
+void TacBuffer::emit_arg(TacId id, int arg, TacId func) {
+    emit(TAC_ARG, id, arg, func, 0);
 }
 
-template<>
-void Value<float>::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    // TODO: fill in
+void TacBuffer::emit_void_return() {
+    emit(TAC_VOID_RETURN, TAC_NONE, 0, 0, 0);
 }
 
-template<>
-void Value<bool>::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    // TODO: fill in
+void TacBuffer::emit_return(TacId id) {
+    emit(TAC_RETURN, id, 0, 0, 0);
 }
 
-template<>
-void Value<char>::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    // TODO: fill in
-}
+static void print_char(std::ostream &out, char value) {
+    switch (value) {
+        case '\n':
+            out << "\\n";
+            break;
 
-template<>
-void Value<std::string>::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    // TODO: fill in
-}
+        case '\t':
+            out << "\\t";
+            break;
 
-void AssignTAC::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    std::optional<VarLoc> id_loc = state.find_var(id);
-    GeneralReg rhs_reg = state.move_into_reg(rhs, code, 0);
+        case '\0':
+            out << "\\0";
+            break;
 
-    if (!id_loc) {
-        GeneralReg reg = state.free_reg(code);
-        state.regs[reg].used = true;
-        state.regs[reg].var = id;
-        code << "movq %" << REG_NAMES[rhs_reg] << ", %" << REG_NAMES[reg] << "\n";
-        return;
-    }
+        case '\e':
+            out << "\\e";
+            break;
 
-    VarLoc loc = *id_loc;
+        case '\r':
+            out << "\\r";
+            break;
 
-    if (loc.loc_type == Reg) {
-        GeneralReg reg = loc.loc.reg;
-        state.regs[reg].used = true;
-        state.regs[reg].var = id;
-        code << "movq %" << REG_NAMES[rhs_reg] << ", %" << REG_NAMES[reg] << "\n";
-        return;
+        default:
+            out << "'" << value << "'";
     }
-
-    StackVarLoc stack_loc = loc.loc.stack;
-    code << "movq %" << REG_NAMES[rhs_reg] << ", -" << stack_loc.offset << "(%rsp)\n";
 }
 
-void DeleteTAC::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    state.clear_var(id);
-}
+void TacBuffer::print_instr(std::ostream &out, size_t i) const {
+    const std::string &dst = name(dsts[i]);
+    const uint32_t a = args_a[i];
+    const uint32_t b = args_b[i];
+
+    switch (ops[i]) {
+        case TAC_INT:
+            out << dst << " = " << (int) a;
+            break;
+
+        case TAC_FLOAT:
+            out << dst << " = " << float_literals[a];
+            break;
+
+        case TAC_BOOL:
+            out << dst << " = " << std::boolalpha << (bool) a;
+            break;
+
+        case TAC_CHAR:
+            out << dst << " = ";
+            print_char(out, (char) a);
+            break;
+
+        case TAC_STR:
+            out << dst << " = " << str_literals[a];
+            break;
+
+        case TAC_ASSIGN:
+            out << dst << " = " << name(a);
+            break;
+
+        case TAC_DELETE:
+            out << "del " << dst;
+            break;
 
-void CmpLiteralTAC::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    GeneralReg reg = state.move_into_reg(id, code, 0);
+        case TAC_CMP_LITERAL:
+            out << "cmp " << dst << ", " << (int) a;
+            break;
+
+        case TAC_JNE:
+            out << "jne " << labels[a];
+            break;
+
+        case TAC_LOGICAL:
+            out << dst << " = " << name(a) << " " << x::logical_op_names[subops[i]] << " " << name(b);
+            break;
+
+        case TAC_MATH:
+            out << dst << " = " << name(a) << " " << (char) subops[i] << " " << name(b);
+            break;
+
+        case TAC_LABEL:
+            out << labels[a] << ":";
+            break;
+
+        case TAC_PUSH:
+            out << "push " << dst;
+            break;
+
+        case TAC_SETUP_STACK:
+            out << "setup_stack";
+            break;
+
+        case TAC_CALL:
+            out << "call " << dst;
+            break;
+
+        case TAC_RETVAL:
+            out << dst << " = __retval";
+            break;
+
+        case TAC_ARG:
+            out << dst << " = __arg(" << a << ")";
+            break;
 
-    code << "cmp %" << REG_NAMES[reg] << ", $" << literal << "\n";
+        case TAC_VOID_RETURN:
+            out << "ret";
+            break;
+
+        case TAC_RETURN:
+            out << "ret " << dst;
+            break;
+    }
 }
 
-void JneTAC::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    code << "jne " << label << "\n";
+void TacBuffer::print(std::ostream &out) const {
+    for (size_t i = 0; i < size(); i++) {
+        out << i << ": ";
+        print_instr(out, i);
+        out << '\n';
+    }
 }
 
-void LogicalTAC::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
+static void logical_to_asm(std::ostream &code, const TacBuffer &tac, size_t i, AsmState &state) {
     state.clear_reg(GeneralReg::Rax, code);
     state.regs[GeneralReg::Rax].used = true;
-    state.regs[GeneralReg::Rax].var = id;
-    
-    GeneralReg lhs = state.move_into_reg(left, code, GeneralReg::Rax + 1);
-    GeneralReg rhs = state.move_into_reg(right, code, GeneralReg::Rax + 1);
-    std::string true_label = next_l();
-    std::string false_label = next_l();
-
-    if (op == "==") {
-        code << "cmp %" << REG_NAMES[lhs] << ", %" << REG_NAMES[rhs] << "\n";
-        code << "jne " << false_label << "\n";
-        code << "movq %rax, $1\n";
-        code << false_label << ":\n";
-        code << "movq %rax, $0\n";
-        code << true_label << ":\n";
-    } else if (op == "!=") {
-        code << "cmp %" << REG_NAMES[lhs] << ", %" << REG_NAMES[rhs] << "\n";
-        code << "je " << false_label << "\n";
-        code << "movq %rax, $1\n";
-        code << false_label << ":\n";
-        code << "movq %rax, $0\n";
-        code << true_label << ":\n";
-    } else if (op == ">") {
-        code << "cmp %" << REG_NAMES[lhs] << ", %" << REG_NAMES[rhs] << "\n";
-        code << "jle " << false_label << "\n";
-        code << "movq %rax, $1\n";
-        code << false_label << ":\n";
-        code << "movq %rax, $0\n";
-        code << true_label << ":\n";
-    } else if (op == "<") {
-        code << "cmp %" << REG_NAMES[lhs] << ", %" << REG_NAMES[rhs] << "\n";
-        code << "jge " << false_label << "\n";
-        code << "movq %rax, $1\n";
-        code << false_label << ":\n";
-        code << "movq %rax, $0\n";
-        code << true_label << ":\n";
-    } else if (op == ">=") {
-        code << "cmp %" << REG_NAMES[lhs] << ", %" << REG_NAMES[rhs] << "\n";
-        code << "jl " << false_label << "\n";
-        code << "movq %rax, $1\n";
-        code << false_label << ":\n";
-        code << "movq %rax, $0\n";
-        code << true_label << ":\n";
-    } else if (op == "<=") {
-        code << "cmp %" << REG_NAMES[lhs] << ", %" << REG_NAMES[rhs] << "\n";
-        code << "jg " << false_label << "\n";
-        code << "movq %rax, $1\n";
-        code << false_label << ":\n";
-        code << "movq %rax, $0\n";
-        code << true_label << ":\n";
-    } else if (op == "in") {
-        fprintf(stderr, "in kw not supported\n");
-        exit(1);
-    } else if (op == "not in") {
-        fprintf(stderr, "not in kw not supported\n");
-        exit(1);
+    state.regs[GeneralReg::Rax].var = tac.dsts[i];
+
+    GeneralReg lhs = state.move_into_reg(tac.args_a[i], code, GeneralReg::Rax + 1);
+    GeneralReg rhs = state.move_into_reg(tac.args_b[i], code, GeneralReg::Rax + 1);
+    std::string true_label = tac.ctx->next_l();
+    std::string false_label = tac.ctx->next_l();
+    const char * jump = nullptr;
+
+    switch ((LogicalOp) tac.subops[i]) {
+        case LogicalEq:
+            jump = "jne";
+            break;
+
+        case LogicalNeq:
+            jump = "je";
+            break;
+
+        case LogicalGtr:
+            jump = "jle";
+            break;
+
+        case LogicalLes:
+            jump = "jge";
+            break;
+
+        case LogicalGeq:
+            jump = "jl";
+            break;
+
+        case LogicalLeq:
+            jump = "jg";
+            break;
+
+        case LogicalIn:
+            throw CompilerError(x::NULL_LOC, "'in' is not supported yet", Error);
+
+        case LogicalNotIn:
+            throw CompilerError(x::NULL_LOC, "'not in' is not supported yet", Error);
     }
+
+    code << "cmp %" << REG_NAMES[lhs] << ", %" << REG_NAMES[rhs] << "\n";
+    code << jump << " " << false_label << "\n";
+    code << "movq %rax, $1\n";
+    code << false_label << ":\n";
+    code << "movq %rax, $0\n";
+    code << true_label << ":\n";
 }
 
-void MathTAC::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
+static void math_to_asm(std::ostream &code, const TacBuffer &tac, size_t i, AsmState &state) {
     state.clear_reg(GeneralReg::Rax, code);
     state.regs[GeneralReg::Rax].used = true;
-    state.regs[GeneralReg::Rax].var = id;
-    GeneralReg lhs = state.move_into_reg(left, code, GeneralReg::Rax + 1);
-    GeneralReg rhs = state.move_into_reg(right, code, GeneralReg::Rax + 1);
-    std::string true_label = next_l();
-    std::string false_label = next_l();
-
-    if (op == '+') {
-        code << "movq %" << REG_NAMES[rhs] << ", %rax\n";
-        code << "addq %" << REG_NAMES[lhs] << ", %rax\n";
-    } else if (op == '-') {
-        code << "movq %" << REG_NAMES[rhs] << ", %rax\n";
-        code << "subq %" << REG_NAMES[lhs] << ", %rax\n";
-    } else if (op == '*') {
-        code << "movq %" << REG_NAMES[rhs] << ", %rax\n";
-        code << "imul %rax, %" << REG_NAMES[lhs] << "\n";
-    } else if (op == '/') {
-        code << "movq %" << REG_NAMES[lhs] << ", %rax\n";
-        code << "idiv %" << REG_NAMES[rhs] << "\n";
-    } else if (op == '%') {
-        code << "movq %" << REG_NAMES[lhs] << ", %rax\n";
-        code << "idiv %" << REG_NAMES[rhs] << "\n";
-        code << "movq %rdx, %rax\n";
-    }
-}
+    state.regs[GeneralReg::Rax].var = tac.dsts[i];
+    GeneralReg lhs = state.move_into_reg(tac.args_a[i], code, GeneralReg::Rax + 1);
+    GeneralReg rhs = state.move_into_reg(tac.args_b[i], code, GeneralReg::Rax + 1);
+
+    switch ((char) tac.subops[i]) {
+        case '+':
+            code << "movq %" << REG_NAMES[rhs] << ", %rax\n";
+            code << "addq %" << REG_NAMES[lhs] << ", %rax\n";
+            break;
 
-void LabelTAC::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    code << label << ":\n";
-}
+        case '-':
+            code << "movq %" << REG_NAMES[rhs] << ", %rax\n";
+            code << "subq %" << REG_NAMES[lhs] << ", %rax\n";
+            break;
 
-void PushTAC::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    GeneralReg reg = state.move_into_reg(id, code, 0);
-    code << "pushq %" << REG_NAMES[reg] << "\n";
-    state.stack_offset += 8;
-    state.regs[reg].used = false;
-    StackVar stack_var = {
-        .size = 8,
-        .id = state.regs[reg].var
-    };
-    state.stack.push_back(stack_var);
-}
+        case '*':
+            code << "movq %" << REG_NAMES[rhs] << ", %rax\n";
+            code << "imul %rax, %" << REG_NAMES[lhs] << "\n";
+            break;
 
-void SetupStackTAC::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    code << "pushq %rbp\n";
-    code << "movq %rsp, %rbp\n";
-}
+        case '/':
+            code << "movq %" << REG_NAMES[lhs] << ", %rax\n";
+            code << "idiv %" << REG_NAMES[rhs] << "\n";
+            break;
 
-void CallTAC::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    code << "call " << fun << "\n";
-    state.pop_frame();
-    code << "movq %rbp, %rsp\n";
+        case '%':
+            code << "movq %" << REG_NAMES[lhs] << ", %rax\n";
+            code << "idiv %" << REG_NAMES[rhs] << "\n";
+            code << "movq %rdx, %rax\n";
+            break;
+    }
 }
 
-void RetvalTAC::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    GeneralReg reg = state.move_into_reg(id, code, 0);
+static void assign_to_asm(std::ostream &code, const TacBuffer &tac, size_t i, AsmState &state) {
+    const TacId id = tac.dsts[i];
+    std::optional<VarLoc> id_loc = state.find_var(id);
+    GeneralReg rhs_reg = state.move_into_reg(tac.args_a[i], code, 0);
 
-    if (reg == GeneralReg::Rax) {
+    if (!id_loc) {
+        GeneralReg reg = state.free_reg(code);
+        state.regs[reg].used = true;
+        state.regs[reg].var = id;
+        code << "movq %" << REG_NAMES[rhs_reg] << ", %" << REG_NAMES[reg] << "\n";
         return;
     }
 
-    code << "movq %" << REG_NAMES[reg] << ", %rax #retval\n";
-    state.regs[GeneralReg::Rax].used = true;
-    state.regs[GeneralReg::Rax].var = "<retval>";
-}
+    VarLoc loc = *id_loc;
 
-void ArgTAC::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    GeneralReg reg = state.free_reg(code);
-    int offset = type_table->arg_offset(this);
-    code << "movq -" << offset << "(%rsp), %" << REG_NAMES[reg] << " # arg: " << arg << "\n";
-    state.regs[reg].used = true;
-    state.regs[reg].var = id;
-}
+    if (loc.loc_type == Reg) {
+        GeneralReg reg = loc.loc.reg;
+        state.regs[reg].used = true;
+        state.regs[reg].var = id;
+        code << "movq %" << REG_NAMES[rhs_reg] << ", %" << REG_NAMES[reg] << "\n";
+        return;
+    }
 
-void VoidReturnTAC::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    code << "leave\n";
-    code << "ret\n";
+    StackVarLoc stack_loc = loc.loc.stack;
+    code << "movq %" << REG_NAMES[rhs_reg] << ", -" << stack_loc.offset << "(%rsp)\n";
 }
 
-void ReturnTAC::to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const {
-    state.clear_reg(GeneralReg::Rax, code);
-    GeneralReg reg = state.move_into_reg(id, code, GeneralReg::Rax + 1);
-
-    code << "movq %" << REG_NAMES[reg] << ", %rax # prepare return value\n";
-    code << "leave\n";
-    code << "ret\n";
-    state.regs[GeneralReg::Rax].used = true;
-    state.regs[GeneralReg::Rax].var = id;
+void x::tac_to_asm(std::ostream &code, const TacBuffer &tac, TypeTable * type_table, AsmState &state) {
+    for (size_t i = 0; i < tac.size(); i++) {
+        const TacId dst = tac.dsts[i];
+
+        switch (tac.ops[i]) {
+            case TAC_INT: {
+                const GeneralReg reg = state.free_reg(code);
+                state.regs[reg].used = true;
+                state.regs[reg].var = dst;
+                code << "movq $" << (int) tac.args_a[i] << ", %" << REG_NAMES[reg] << "\n";
+                break;
+            }
+
+            case TAC_FLOAT:
+            case TAC_BOOL:
+            case TAC_CHAR:
+            case TAC_STR:
+                // TODO: fill in
+                break;
+
+            case TAC_ASSIGN:
+                assign_to_asm(code, tac, i, state);
+                break;
+
+            case TAC_DELETE:
+                state.clear_var(dst);
+                break;
+
+            case TAC_CMP_LITERAL: {
+                GeneralReg reg = state.move_into_reg(dst, code, 0);
+                code << "cmp %" << REG_NAMES[reg] << ", $" << (int) tac.args_a[i] << "\n";
+                break;
+            }
+
+            case TAC_JNE:
+                code << "jne " << tac.labels[tac.args_a[i]] << "\n";
+                break;
+
+            case TAC_LOGICAL:
+                logical_to_asm(code, tac, i, state);
+                break;
+
+            case TAC_MATH:
+                math_to_asm(code, tac, i, state);
+                break;
+
+            case TAC_LABEL:
+                code << tac.labels[tac.args_a[i]] << ":\n";
+                break;
+
+            case TAC_PUSH: {
+                GeneralReg reg = state.move_into_reg(dst, code, 0);
+                code << "pushq %" << REG_NAMES[reg] << "\n";
+                state.stack_offset += 8;
+                state.regs[reg].used = false;
+                StackVar stack_var = {
+                    .size = 8,
+                    .id = state.regs[reg].var
+                };
+                state.stack.push_back(stack_var);
+                break;
+            }
+
+            case TAC_SETUP_STACK:
+                code << "pushq %rbp\n";
+                code << "movq %rsp, %rbp\n";
+                break;
+
+            case TAC_CALL:
+                code << "call " << tac.name(dst) << "\n";
+                state.pop_frame();
+                code << "movq %rbp, %rsp\n";
+                break;
+
+            case TAC_RETVAL: {
+                GeneralReg reg = state.move_into_reg(dst, code, 0);
+
+                if (reg == GeneralReg::Rax) {
+                    break;
+                }
+
+                code << "movq %" << REG_NAMES[reg] << ", %rax #retval\n";
+                state.regs[GeneralReg::Rax].used = true;
+                state.regs[GeneralReg::Rax].var = TAC_RETVAL_ID;
+                break;
+            }
+
+            case TAC_ARG: {
+                GeneralReg reg = state.free_reg(code);
+                int offset = type_table->arg_offset(tac.args_b[i], tac.args_a[i]);
+                code << "movq -" << offset << "(%rsp), %" << REG_NAMES[reg] << " # arg: " << tac.args_a[i] << "\n";
+                state.regs[reg].used = true;
+                state.regs[reg].var = dst;
+                break;
+            }
+
+            case TAC_VOID_RETURN:
+                code << "leave\n";
+                code << "ret\n";
+                break;
+
+            case TAC_RETURN: {
+                state.clear_reg(GeneralReg::Rax, code);
+                GeneralReg reg = state.move_into_reg(dst, code, GeneralReg::Rax + 1);
+
+                code << "movq %" << REG_NAMES[reg] << ", %rax # prepare return value\n";
+                code << "leave\n";
+                code << "ret\n";
+                state.regs[GeneralReg::Rax].used = true;
+                state.regs[GeneralReg::Rax].var = dst;
+                break;
+            }
+        }
+    }
 }
@@ -1,207 +1,162 @@
+/**
+ * Three address code. A function (or a whole program) is lowered into a TacBuffer,
+ * which stores instructions as a struct of arrays: one opcode array and parallel
+ * arrays of 32-bit operands. Operands that name a variable, temporary or function
+ * are ids into the buffer's value table, where every name is interned once. Labels
+ * and literals that don't fit in an operand live in their own side tables.
+ *
+ * Passes over the TAC (printing, asm generation) walk the opcode array and switch on
+ * the opcode instead of making a virtual call per instruction. Everything is owned by
+ * the buffer and lives in contiguous vectors, so freeing the buffer frees the TAC.
+ */
 #ifndef SRC_TAC_H
 #define SRC_TAC_H
 
 #include <cstdint>
 #include <iostream>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
-#include "asm.h"
+#include "context.h"
 #include "symtable.h"
 
-std::string next_t();
-std::string next_l();
-std::string next_p();
-
 class TypeTable;
-class NamesToNames;
-
-class Quad
-{
-public:
-  virtual void print() const;
-  virtual void to_asm(std::ostream &out, TypeTable * type_table, NamesToNames &names, AsmState &state) const = 0;
-
-protected:
-  virtual ~Quad() = default;
-};
-
-template <typename T>
-class Value : public Quad
-{
-public:
-  std::string id;
-  T value;
-  void print() const { std::cout << id << " = " << value; };
-  Value(std::string id, T v) : id(id), value(v) {}
-  virtual void to_asm(std::ostream &out, TypeTable * type_table, NamesToNames &names, AsmState &state) const;
-};
-
-class AssignTAC : public Quad
-{
-public:
-  std::string id;
-  std::string rhs;
-  AssignTAC(std::string id, std::string rhs)
-      : id(id), rhs(rhs) {}
-  void print() const;
-  virtual void to_asm(std::ostream &out, TypeTable * type_table, NamesToNames &names, AsmState &state) const;
-};
-
-// artificial instruction that tells assembler that we can clean up this variable
-class DeleteTAC : public Quad {
-  public:
-    std::string id;
-    DeleteTAC(std::string id) : id(id) {};
-    void print() const;
-    virtual void to_asm(std::ostream &out, TypeTable * type_table, NamesToNames &names, AsmState &state) const;
+struct AsmState;
+
+// Id of a value (variable, temporary or function name) in a TacBuffer's value table
+typedef uint32_t TacId;
+
+// Id of a label in a TacBuffer's label table
+typedef uint32_t TacLabel;
+
+// Returned by gen_tac for nodes that don't produce a value, like statements
+const TacId TAC_NONE = UINT32_MAX;
+
+// Pseudo-value for the return value of the last call. The asm stage puts it in rax
+const TacId TAC_RETVAL_ID = UINT32_MAX - 1;
+
+enum TacOp : uint8_t {
+    // dst = (int) a
+    TAC_INT,
+    // dst = float_literals[a]
+    TAC_FLOAT,
+    // dst = (bool) a
+    TAC_BOOL,
+    // dst = (char) a
+    TAC_CHAR,
+    // dst = str_literals[a]
+    TAC_STR,
+    // dst = a
+    TAC_ASSIGN,
+    // Artificial instruction that tells the assembler that we can clean up dst
+    TAC_DELETE,
+    // cmp dst, (int) a
+    TAC_CMP_LITERAL,
+    // jne labels[a]
+    TAC_JNE,
+    // dst = a <subop> b, subop is a LogicalOp
+    TAC_LOGICAL,
+    // dst = a <subop> b, subop is the operator char
+    TAC_MATH,
+    // labels[a]:
+    TAC_LABEL,
+    // push dst
+    TAC_PUSH,
+    TAC_SETUP_STACK,
+    // call dst
+    TAC_CALL,
+    // dst = __retval
+    TAC_RETVAL,
+    // dst = __arg(a) of function b
+    TAC_ARG,
+    TAC_VOID_RETURN,
+    // ret dst
+    TAC_RETURN
+};
+
+enum LogicalOp : uint8_t {
+    LogicalEq,
+    LogicalNeq,
+    LogicalGtr,
+    LogicalLes,
+    LogicalGeq,
+    LogicalLeq,
+    LogicalIn,
+    LogicalNotIn
 };
 
-class CmpLiteralTAC : public Quad {
-  public:
-    std::string id;
-    int literal;
-    CmpLiteralTAC(std::string id, int literal) : id(id), literal(literal) {}
-    void print() const;
-    virtual void to_asm(std::ostream &out, TypeTable * type_table, NamesToNames &names, AsmState &state) const;
-};
-
-class JneTAC : public Quad {
-  public:
-    std::string label;
-    JneTAC(std::string label) : label(label) {}
-    void print() const;
-    virtual void to_asm(std::ostream &out, TypeTable * type_table, NamesToNames &names, AsmState &state) const;
-};
-
-class LogicalTAC : public Quad {
-  public:
-    std::string id;
-    std::string op;
-    std::string left;
-    std::string right;
-
-    LogicalTAC(std::string id, std::string op, std::string left, std::string right) : id(id), op(op), left(left), right(right) {}
-    void print() const;
-    virtual void to_asm(std::ostream &out, TypeTable * type_table, NamesToNames &names, AsmState &state) const;
-};
-
-class MathTAC : public Quad {
-  public:
-    std::string id;
-    char op;
-    std::string left;
-    std::string right;
-
-    MathTAC(std::string id, char op, std::string left, std::string right) :
-      id(id), op(op), left(left), right(right) {}
-    void print() const;
-    virtual void to_asm(std::ostream &out, TypeTable * type_table, NamesToNames &names, AsmState &state) const;
-};
-
-class LabelTAC : public Quad {
-  public:
-    std::string label;
-
-    LabelTAC(std::string label) : label(label) {};
-    void print() const;
-    virtual void to_asm(std::ostream &out, TypeTable * type_table, NamesToNames &names, AsmState &state) const;
-};
-
-class PushTAC : public Quad {
-  public:
-    std::string id; 
-    PushTAC(std::string i) : id(i) { }
-    void print() const { std::cout << "push " << id; }
-    virtual void to_asm(std::ostream &out, TypeTable * type_table, NamesToNames &names, AsmState &state) const;
-};
-
-class SetupStackTAC : public Quad {
-  public:
-    SetupStackTAC() {};
-    void print() const;
-    virtual void to_asm(std::ostream &code, TypeTable * type_table, NamesToNames &names, AsmState &state) const;
-};
-
-class CallTAC : public Quad
-{
-public:
-  std::string fun;
-  CallTAC(std::string f) : fun(f) {}
-  void print() const;
-  virtual void to_asm(std::ostream &out, TypeTable * type_table, NamesToNames &names, AsmState &state) const;
-};
-
-// t0 = __retval. asm stage will replace with rax
-class RetvalTAC : public Quad {
-  public:
-    std::string id;
-    RetvalTAC(std::string id) : id(id) {}
-    void print() const;
-    virtual void to_asm(std::ostream &out, TypeTable * type_table, NamesToNames &names, AsmState &state) const;
-};
+namespace x {
+    const char * const logical_op_names[] = {"==", "!=", ">", "<", ">=", "<=", "in", "not in"};
 
-// arg x
-class ArgTAC : public Quad
-{
-public:
-  std::string id;
-  int arg;
-  std::string func;
-  ArgTAC(std::string id, int a, std::string func) : id(id), arg(a), func(func) {}
-  void print() const;
-  virtual void to_asm(std::ostream &out, TypeTable * type_table, NamesToNames &names, AsmState &state) const;
-};
+    LogicalOp logical_op(const std::string &op);
+}
 
-class VoidReturnTAC : public Quad {
-  public:
-    VoidReturnTAC() {}
-    void print() const;
-    virtual void to_asm(std::ostream &out, TypeTable * type_table, NamesToNames &names, AsmState &state) const;
-};
+class TacBuffer {
+    public:
+        // Context that temporaries and labels are named from. Not owned
+        CompilationContext * ctx;
 
-// mov(suffix) %eax
-// ret
-class ReturnTAC : public Quad
-{
-public:
-  std::string id;
+        // Instructions, one entry per instruction in each array
+        std::vector<TacOp> ops;
+        std::vector<uint8_t> subops;
+        std::vector<TacId> dsts;
+        std::vector<uint32_t> args_a;
+        std::vector<uint32_t> args_b;
 
-  ReturnTAC(std::string id) : id(id) {}
-  void print() const;
-  virtual void to_asm(std::ostream &out, TypeTable * type_table, NamesToNames &names, AsmState &state) const;
-};
+        // Value table and the reverse mapping used to intern names
+        std::vector<std::string> values;
+        std::unordered_map<std::string, TacId> value_ids;
 
-class BasicBlock
-{
-public:
-  std::vector<Quad *> trips = std::vector<Quad *>();
+        // Side tables
+        std::vector<std::string> labels;
+        std::unordered_map<std::string, TacLabel> label_ids;
+        std::vector<double> float_literals;
+        std::vector<std::string> str_literals;
 
-  std::string name;
+        TacBuffer(CompilationContext * ctx);
 
-  int n_instructions = 0;
+        size_t size() const {
+            return ops.size();
+        }
 
-  void add_block(std::string name);
+        // Interns the name and returns its id
+        TacId value(const std::string &name);
 
-  void add_instruction(Quad *trip)
-  {
-    trips.push_back(trip);
-    ++n_instructions;
-  }
+        TacLabel label(const std::string &name);
 
-  int last_instruction() const { return n_instructions - 1; }
+        const std::string &name(TacId id) const;
 
-  int next_instruction() const { return n_instructions; }
+        void emit(TacOp op, TacId dst, uint32_t a, uint32_t b, uint8_t subop);
 
-  void print() const;
-  BasicBlock() = default;
+        void emit_int(TacId dst, int value);
+        void emit_float(TacId dst, double value);
+        void emit_bool(TacId dst, bool value);
+        void emit_char(TacId dst, char value);
+        void emit_str(TacId dst, const std::string &value);
+        void emit_assign(TacId dst, TacId rhs);
+        void emit_delete(TacId id);
+        void emit_cmp_literal(TacId id, int literal);
+        void emit_jne(TacLabel label);
+        void emit_logical(TacId dst, LogicalOp op, TacId left, TacId right);
+        void emit_math(TacId dst, char op, TacId left, TacId right);
+        void emit_label(TacLabel label);
+        void emit_push(TacId id);
+        void emit_setup_stack();
+        void emit_call(TacId func);
+        void emit_retval(TacId id);
+        void emit_arg(TacId id, int arg, TacId func);
+        void emit_void_return();
+        void emit_return(TacId id);
 
-  BasicBlock(std::string str) : name(str) {}
+        void print_instr(std::ostream &out, size_t i) const;
 
-  BasicBlock *prev = nullptr;
+        void print(std::ostream &out) const;
 };
 
 namespace x {
-  extern BasicBlock *bblock;
+    // Generates asm for every instruction in the buffer
+    void tac_to_asm(std::ostream &code, const TacBuffer &tac, TypeTable * type_table, AsmState &state);
 }
 
 #endif
@@ -0,0 +1,152 @@
+#include "thread_pool.h"
+
+// Pool and worker index of the current thread, if it is a worker
+static thread_local ThreadPool * current_pool = nullptr;
+static thread_local size_t current_index = 0;
+
+ThreadPool::ThreadPool(size_t num_threads)
+    :   workers(),
+        threads(),
+        lock(),
+        work_available(),
+        queued(0),
+        next_worker(0),
+        stopping(false)
+{
+    if (num_threads == 0) {
+        num_threads = 1;
+    }
+
+    for (size_t i = 0; i < num_threads; i++) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+
+    for (size_t i = 0; i < num_threads; i++) {
+        threads.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+
+    work_available.notify_all();
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    size_t index = current_pool == this ? current_index : next_worker++ % workers.size();
+
+    {
+        std::lock_guard<std::mutex> guard(workers[index]->lock);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+
+    // Count the task while holding the lock so that a worker can't check for work
+    // and go to sleep in between
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queued++;
+    }
+
+    work_available.notify_one();
+}
+
+bool ThreadPool::take(size_t index, Task &task) {
+    {
+        Worker &own = *workers[index];
+        std::lock_guard<std::mutex> guard(own.lock);
+
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued--;
+
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < workers.size(); i++) {
+        Worker &victim = *workers[(index + i) % workers.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued--;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::run(size_t index) {
+    current_pool = this;
+    current_index = index;
+
+    Task task;
+
+    while (true) {
+        if (take(index, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(lock);
+        work_available.wait(guard, [this]() {
+            return stopping || queued > 0;
+        });
+
+        if (stopping && queued == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::parallel_for(size_t n, const std::function<void(size_t)> &func) {
+    std::atomic<size_t> remaining(n);
+    std::mutex done_lock;
+    std::condition_variable done;
+
+    for (size_t i = 0; i < n; i++) {
+        submit([&func, &remaining, &done_lock, &done, i]() {
+            func(i);
+
+            // Counted under the lock, so parallel_for can't return and free it before
+            // the last task is done with it
+            std::lock_guard<std::mutex> guard(done_lock);
+
+            if (--remaining == 0) {
+                done.notify_one();
+            }
+        });
+    }
+
+    size_t index = current_pool == this ? current_index : 0;
+    Task task;
+
+    while (remaining > 0 && take(index, task)) {
+        task();
+        task = nullptr;
+    }
+
+    // Nothing is queued, so the tasks left are running on other threads
+    std::unique_lock<std::mutex> guard(done_lock);
+    done.wait(guard, [&remaining]() {
+        return remaining == 0;
+    });
+}
+
+size_t x::num_cores() {
+    unsigned int cores = std::thread::hardware_concurrency();
+
+    return cores == 0 ? 1 : cores;
+}
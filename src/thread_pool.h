@@ -0,0 +1,75 @@
+/**
+ * Fixed size pool of worker threads with work stealing. Every worker has its own
+ * deque of tasks. A worker runs tasks from the back of its own deque (newest first,
+ * which keeps related work on the same core) and, when that is empty, steals the
+ * oldest task from the front of another worker's deque. Tasks submitted from inside
+ * the pool go on the submitting worker's deque; tasks submitted from outside are
+ * spread round robin.
+ *
+ * Tasks must not throw.
+ */
+#ifndef SRC_THREAD_POOL_H
+#define SRC_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+    public:
+        typedef std::function<void()> Task;
+
+        ThreadPool(size_t num_threads);
+
+        // Waits for queued tasks to finish, then joins the workers
+        ~ThreadPool();
+
+        size_t size() const {
+            return threads.size();
+        }
+
+        void submit(Task task);
+
+        /**
+         * Runs func(0) ... func(n - 1) on the pool and returns when all of them are
+         * done. The calling thread runs queued tasks too, so this can be called from
+         * inside a task without tying up a worker. Once nothing is left to take it
+         * sleeps until the last task finishes.
+         */
+        void parallel_for(size_t n, const std::function<void(size_t)> &func);
+
+    private:
+        struct Worker {
+            std::mutex lock;
+            std::deque<Task> tasks;
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<std::thread> threads;
+
+        // Guards sleeping and waking workers
+        std::mutex lock;
+        std::condition_variable work_available;
+
+        std::atomic<size_t> queued;
+        std::atomic<size_t> next_worker;
+        bool stopping;
+
+        void run(size_t index);
+
+        // Takes a task from worker 'index', or steals one. Returns false if every
+        // deque is empty
+        bool take(size_t index, Task &task);
+};
+
+namespace x {
+    // Number of hardware threads, at least 1
+    size_t num_cores();
+}
+
+#endif
@@ -0,0 +1,444 @@
+#include "type_interner.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+// Primitives that typechecking asks for all the time
+static const char * const BUILTIN_NAMES[] = {"int", "float", "bool", "char", "void", "Please"};
+
+struct PrimitiveSize {
+    const char * name;
+    int size;
+};
+
+// Primitives not listed here take up a word
+static const PrimitiveSize PRIMITIVE_SIZES[] = {
+    {"int", 8},
+    {"float", 8},
+    {"bool", 1},
+    {"char", 1},
+    {"void", 0},
+    {"Please", 0},
+};
+
+uint64_t x::type_hash(const Typename * typ) {
+    return typ->hash();
+}
+
+static void put_int(std::string &out, uint32_t value) {
+    out.append((const char *) &value, sizeof(value));
+}
+
+TypeInterner::TypeInterner() : reorder_fields(false), types({}), added({}), builtins({}), ids({}), casts({}), layouts({}) {
+    for (const char * name : BUILTIN_NAMES) {
+        builtins.push_back(get(TypeIdent(x::NULL_LOC, name)));
+    }
+}
+
+TypeInterner::~TypeInterner() {
+    // Newest first, so a type is gone before the shared types it points to
+    for (auto item = added.rbegin(); item != added.rend(); item++) {
+        delete *item;
+    }
+}
+
+const Typename * TypeInterner::find(const Typename &typ, uint64_t hash) {
+    auto range = types.equal_range(hash);
+
+    for (auto item = range.first; item != range.second; item++) {
+        if (*item->second == typ) {
+            return item->second;
+        }
+    }
+
+    return nullptr;
+}
+
+const Typename * TypeInterner::intern(Typename * typ) {
+    if (typ->is_shared()) {
+        return typ;
+    }
+
+    uint64_t hash = x::type_hash(typ);
+    std::lock_guard<std::mutex> guard(lock);
+    const Typename * found = find(*typ, hash);
+
+    if (found != nullptr) {
+        delete typ;
+        return found;
+    }
+
+    typ->shared = true;
+    types.emplace(hash, typ);
+    added.push_back(typ);
+
+    return typ;
+}
+
+// Stops at anything that isn't shared already and holds data that depends on where
+// it was declared
+class UnshareableFinder : public TreeVisitor {
+    public:
+        bool found;
+
+        UnshareableFinder() : found(false) {}
+
+        virtual WalkAction pre(ASTNode * node) {
+            if (node->is_shared()) {
+                return WalkSkip;
+            }
+
+            // A struct owns its scope, and a function type keeps argument offsets worked
+            // out in the scope it was declared in
+            if (node->get_kind() == StructTypename::kind || node->get_kind() == FuncTypename::kind) {
+                found = true;
+                return WalkStop;
+            }
+
+            return WalkContinue;
+        }
+};
+
+Typename * TypeInterner::share(Typename * typ) {
+    UnshareableFinder finder;
+    x::walk(typ, finder);
+
+    if (finder.found) {
+        return typ;
+    }
+
+    return (Typename *) intern(typ);
+}
+
+const Typename * TypeInterner::get(const Typename &typ) {
+    uint64_t hash = x::type_hash(&typ);
+    std::lock_guard<std::mutex> guard(lock);
+    const Typename * found = find(typ, hash);
+
+    if (found != nullptr) {
+        return found;
+    }
+
+    Typename * copy = typ.clone();
+    copy->shared = true;
+    types.emplace(hash, copy);
+    added.push_back(copy);
+
+    return copy;
+}
+
+const Typename * TypeInterner::primitive(const char * name) {
+    for (size_t i = 0; i < builtins.size(); i++) {
+        if (strcmp(BUILTIN_NAMES[i], name) == 0) {
+            return builtins[i];
+        }
+    }
+
+    return get(TypeIdent(x::NULL_LOC, name));
+}
+
+size_t TypeInterner::size() {
+    std::lock_guard<std::mutex> guard(lock);
+
+    return types.size();
+}
+
+TypeId TypeInterner::id(const Typename * typ, SymbolTable * symtable) {
+    std::vector<const StructTypename *> open;
+    size_t outer;
+
+    return resolve(typ, symtable, open, &outer);
+}
+
+TypeId TypeInterner::resolve(const Typename * typ, SymbolTable * symtable, std::vector<const StructTypename *> &open,
+                             size_t * outer) {
+    uint64_t version = symtable->type_scope()->type_version;
+    uint64_t cached = typ->type_id.load(std::memory_order_relaxed);
+    size_t depth = open.size();
+
+    *outer = depth;
+
+    if (cached != 0 && (cached >> 32) == version) {
+        return (TypeId) cached;
+    }
+
+    // Made of the IDs of the parts, so each node is only ever looked at once.
+    // Aliases, parens and struct names take the ID of what they stand for
+    std::string form;
+    size_t child_outer;
+    TypeId out = 0;
+    int kind = typ->get_kind();
+
+    auto part = [&](const Typename * t) {
+        put_int(form, resolve(t, symtable, open, &child_outer));
+        *outer = std::min(*outer, child_outer);
+    };
+
+    if (kind == ParensTypename::kind) {
+        out = resolve(((ParensTypename *) typ)->name, symtable, open, outer);
+    } else if (kind == TypeIdent::kind) {
+        const TypeIdent * ident = (TypeIdent *) typ;
+        const Symbol * symbol = symtable->get(ident->id);
+        const TypeDecl * decl = (symbol != nullptr && symbol->kind == Type) ? symbol->decl.typ : nullptr;
+
+        if (decl != nullptr && decl->get_kind() == TypeAlias::kind) {
+            out = resolve(((TypeAlias *) decl)->type_expr, symtable, open, outer);
+        } else if (decl != nullptr && decl->get_kind() == StructDecl::kind) {
+            out = resolve(((StructDecl *) decl)->defn, symtable, open, outer);
+        } else {
+            // Primitive type
+            form += 'P';
+            form += ident->id;
+        }
+    } else if (kind == PtrTypename::kind) {
+        form += 'p';
+        part(((PtrTypename *) typ)->name);
+    } else if (kind == MutTypename::kind) {
+        form += 'm';
+        part(((MutTypename *) typ)->name);
+    } else if (kind == DynamicArrayTypename::kind) {
+        form += 'd';
+        part(((DynamicArrayTypename *) typ)->element_type);
+    } else if (kind == StaticArrayTypename::kind) {
+        const StaticArrayTypename * array = (StaticArrayTypename *) typ;
+
+        form += 's';
+        put_int(form, array->size->value);
+        part(array->element_type);
+    } else if (kind == TupleTypename::kind) {
+        form += 't';
+
+        for (auto &t : ((TupleTypename *) typ)->type_list->types) {
+            part(t);
+        }
+    } else if (kind == FuncTypename::kind) {
+        const FuncTypename * func = (FuncTypename *) typ;
+
+        form += 'f';
+        part(func->ret_type);
+
+        for (auto &t : func->params->types) {
+            part(t);
+        }
+    } else if (kind == StructTypename::kind) {
+        const StructTypename * strukt = (StructTypename *) typ;
+
+        // A struct that contains a pointer to itself refers back to itself by how
+        // far out it is, instead of going on forever
+        for (size_t i = 0; i < depth; i++) {
+            if (open[i] == strukt) {
+                *outer = i;
+                form += 'r';
+                put_int(form, depth - i);
+
+                return intern_form(form);
+            }
+        }
+
+        open.push_back(strukt);
+        form += strukt->packed ? 'Q' : 'S';
+
+        // Member names and their order are part of the type, and so is being packed
+        for (auto &decl : strukt->members->decls) {
+            form += decl->var_name->id;
+            form += '\0';
+            part(decl->type_name);
+        }
+
+        open.pop_back();
+    } else {
+        __builtin_unreachable();
+    }
+
+    if (out == 0) {
+        out = intern_form(form);
+    }
+
+    // An ID that refers back to a struct further out only means something inside
+    // that struct, so it isn't kept
+    if (*outer >= depth) {
+        typ->type_id.store((version << 32) | out, std::memory_order_relaxed);
+    }
+
+    return out;
+}
+
+TypeId TypeInterner::intern_form(const std::string &form) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    return ids.emplace(form, ids.size() + 1).first->second;
+}
+
+bool TypeInterner::find_cast(TypeId from, TypeId to, bool * allowed) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto item = casts.find(((uint64_t) from << 32) | to);
+
+    if (item == casts.end()) {
+        return false;
+    }
+
+    *allowed = item->second;
+
+    return true;
+}
+
+void TypeInterner::add_cast(TypeId from, TypeId to, bool allowed) {
+    std::lock_guard<std::mutex> guard(lock);
+    casts[((uint64_t) from << 32) | to] = allowed;
+}
+
+// What a type name stands for, with parens, aliases and struct names looked through
+static const Typename * definition(const Typename * typ, SymbolTable * symtable) {
+    while (true) {
+        if (typ->get_kind() == ParensTypename::kind) {
+            typ = ((ParensTypename *) typ)->name;
+            continue;
+        }
+
+        if (typ->get_kind() != TypeIdent::kind) {
+            return typ;
+        }
+
+        const Symbol * symbol = symtable->get(((TypeIdent *) typ)->id);
+        const TypeDecl * decl = (symbol != nullptr && symbol->kind == Type) ? symbol->decl.typ : nullptr;
+
+        if (decl != nullptr && decl->get_kind() == TypeAlias::kind) {
+            typ = ((TypeAlias *) decl)->type_expr;
+        } else if (decl != nullptr && decl->get_kind() == StructDecl::kind) {
+            typ = ((StructDecl *) decl)->defn;
+        } else {
+            return typ;
+        }
+    }
+}
+
+static int align_up(int offset, int align) {
+    return (offset + align - 1) / align * align;
+}
+
+// Places members one after another in the order given by 'order', which indexes
+// 'members', and sets the size and alignment of the whole
+static void place_members(const std::vector<const Layout *> &members, const std::vector<size_t> &order, bool packed,
+                          Layout &out) {
+    int size = 0;
+
+    out.align = 1;
+    out.offsets.assign(members.size(), 0);
+
+    for (size_t i : order) {
+        int align = packed ? 1 : members[i]->align;
+
+        size = align_up(size, align);
+        out.offsets[i] = size;
+        out.align = std::max(out.align, align);
+        size += members[i]->size;
+    }
+
+    out.size = align_up(size, out.align);
+}
+
+const Layout * TypeInterner::layout(const Typename * typ, SymbolTable * symtable) {
+    std::vector<const StructTypename *> open;
+
+    return lay_out(typ, symtable, open);
+}
+
+const Layout * TypeInterner::lay_out(const Typename * typ, SymbolTable * symtable,
+                                     std::vector<const StructTypename *> &open) {
+    TypeId key = id(typ, symtable);
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto item = layouts.find(key);
+
+        if (item != layouts.end()) {
+            return &item->second;
+        }
+    }
+
+    const Typename * defn = definition(typ, symtable);
+    int kind = defn->get_kind();
+    // Pointers, functions and dynamic arrays take up a word
+    Layout out = { ADDRESS_WIDTH, ADDRESS_WIDTH, {} };
+    std::vector<const Layout *> members;
+
+    // Worked out without the lock, since it asks for the layouts of the parts
+    auto member = [&](const Typename * t) {
+        const Layout * part = lay_out(t, symtable, open);
+
+        if (part != nullptr) {
+            members.push_back(part);
+        }
+
+        return part != nullptr;
+    };
+
+    if (kind == TypeIdent::kind) {
+        const std::string &name = ((TypeIdent *) defn)->id;
+
+        for (auto &primitive : PRIMITIVE_SIZES) {
+            if (name == primitive.name) {
+                out.size = primitive.size;
+                out.align = std::max(primitive.size, 1);
+            }
+        }
+    } else if (kind == MutTypename::kind) {
+        return lay_out(((MutTypename *) defn)->name, symtable, open);
+    } else if (kind == StaticArrayTypename::kind) {
+        const StaticArrayTypename * array = (StaticArrayTypename *) defn;
+
+        if (!member(array->element_type)) {
+            return nullptr;
+        }
+
+        out.size = members[0]->size * array->size->value;
+        out.align = members[0]->align;
+    } else if (kind == TupleTypename::kind) {
+        const std::vector<Typename *> &types = ((TupleTypename *) defn)->type_list->types;
+        std::vector<size_t> order;
+
+        for (size_t i = 0; i < types.size(); i++) {
+            if (!member(types[i])) {
+                return nullptr;
+            }
+
+            order.push_back(i);
+        }
+
+        place_members(members, order, false, out);
+    } else if (kind == StructTypename::kind) {
+        const StructTypename * strukt = (StructTypename *) defn;
+        std::vector<size_t> order;
+
+        if (std::find(open.begin(), open.end(), strukt) != open.end()) {
+            return nullptr;
+        }
+
+        open.push_back(strukt);
+
+        for (size_t i = 0; i < strukt->members->decls.size(); i++) {
+            if (!member(strukt->members->decls[i]->type_name)) {
+                open.pop_back();
+                return nullptr;
+            }
+
+            order.push_back(i);
+        }
+
+        open.pop_back();
+
+        if (reorder_fields && !strukt->packed) {
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return members[a]->align > members[b]->align;
+            });
+        }
+
+        place_members(members, order, strukt->packed, out);
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    return &layouts.emplace(key, std::move(out)).first->second;
+}
@@ -0,0 +1,145 @@
+/**
+ * One shared copy of each type that typechecking works out. Expr::type_of keeps the
+ * type of every expression on the node, and the types all live here, so an expression
+ * type is never freed or cloned by the code that asks for it.
+ *
+ * Two types are the same entry if they are equal as ASTNodes (same structure and
+ * names, locations ignored), so interned types can be compared by pointer. Equal
+ * pointers always mean equal types; different pointers can still be equal types
+ * through an alias, which is what type_equals is for. Interned types are marked
+ * shared (see ASTNode::is_shared), so they can be children of parsed trees too,
+ * and they are only freed with the interner.
+ *
+ * Each type also gets a canonical TypeId, which is the same for two types exactly
+ * when type_equals would say so: aliases, parens and struct names are looked
+ * through, so 'type X = int.' gives X and int the same ID. A type's ID is worked out
+ * once per scope it's used in and kept on the node, which makes type_equals an
+ * integer compare. Whether one type can be cast to another only depends on their
+ * IDs, so casts are looked up in a table after the first time.
+ *
+ * The memory layout of a type also only depends on its ID, so it's worked out once
+ * and kept by ID too. Every type is aligned to its size, up to ADDRESS_WIDTH, and
+ * structs and tuples put padding between members to keep each one aligned. A struct
+ * marked 'packed' has no padding and an alignment of 1. With reorder_fields set,
+ * the members of a struct that isn't packed are laid out from the most aligned to
+ * the least, which leaves the least padding; their offsets are still given in the
+ * order they were declared.
+ *
+ * Each compilation has one (see CompilationContext::types), reached from any of its
+ * scopes through SymbolTable::types. Safe to use from several threads.
+ */
+#ifndef SRC_TYPE_INTERNER_H
+#define SRC_TYPE_INTERNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.h"
+
+typedef uint32_t TypeId;
+
+struct Layout {
+    int size;
+    int align;
+
+    // Offset of each member of a struct or tuple, in declaration order. Empty for
+    // other types
+    std::vector<int> offsets;
+};
+
+typedef struct Layout Layout;
+
+class TypeInterner {
+    public:
+        // Lay struct members out by alignment rather than in declaration order. Must
+        // be set before the first layout is asked for
+        bool reorder_fields;
+
+        TypeInterner();
+
+        ~TypeInterner();
+
+        // Takes ownership of 'typ' and returns the interned type equal to it. 'typ' is
+        // freed if there already was one
+        const Typename * intern(Typename * typ);
+
+        // Returns the interned type equal to 'typ', adding a copy if there isn't one
+        const Typename * get(const Typename &typ);
+
+        /**
+         * Like intern(), for types written in the source: the parser puts every
+         * type name through this, so each distinct one is kept once and shared by
+         * all the declarations that use it. Types that have a struct or function
+         * type in them are returned as they are, since those aren't the same in
+         * every scope.
+         */
+        Typename * share(Typename * typ);
+
+        // A primitive type such as "int"
+        const Typename * primitive(const char * name);
+
+        size_t size();
+
+        // The canonical ID of 'typ', with its names looked up in 'symtable'
+        TypeId id(const Typename * typ, SymbolTable * symtable);
+
+        // Sets 'allowed' and returns true if a cast between these types has been
+        // checked before
+        bool find_cast(TypeId from, TypeId to, bool * allowed);
+
+        void add_cast(TypeId from, TypeId to, bool allowed);
+
+        // Size, alignment and member offsets of 'typ'. Returns nullptr if the type has
+        // no size because a struct contains itself
+        const Layout * layout(const Typename * typ, SymbolTable * symtable);
+
+    private:
+        std::mutex lock;
+
+        // By a hash of the structure, since several types can have the same hash
+        std::unordered_multimap<uint64_t, const Typename *> types;
+
+        // The same types in the order they were added. A type can only have ones
+        // added before it as shared children
+        std::vector<const Typename *> added;
+
+        // Interned in the constructor and never changed, so primitive() can return
+        // them without taking the lock
+        std::vector<const Typename *> builtins;
+
+        // IDs by canonical form: the kind of type and the IDs of its parts
+        std::unordered_map<std::string, TypeId> ids;
+
+        // Casts that have been checked, by 'from' in the high half and 'to' in the low
+        std::unordered_map<uint64_t, bool> casts;
+
+        // Layouts that have been worked out, by ID. Elements of an unordered_map
+        // don't move, so layout() can hand out pointers to them
+        std::unordered_map<TypeId, Layout> layouts;
+
+        // Must be called with the lock held. Returns nullptr if there isn't one
+        const Typename * find(const Typename &typ, uint64_t hash);
+
+        // Works out an ID for id(). 'open' has the structs being resolved, and
+        // 'outer' is set to the outermost of them that the ID refers back to
+        TypeId resolve(const Typename * typ, SymbolTable * symtable, std::vector<const StructTypename *> &open,
+                       size_t * outer);
+
+        TypeId intern_form(const std::string &form);
+
+        // Does the work of layout(). 'open' has the structs being laid out, so a
+        // struct that contains itself is noticed
+        const Layout * lay_out(const Typename * typ, SymbolTable * symtable, std::vector<const StructTypename *> &open);
+};
+
+namespace x {
+    // Hash of a type's structure (see ASTNode::hash)
+    uint64_t type_hash(const Typename * typ);
+}
+
+#endif
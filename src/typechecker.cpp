@@ -6,6 +6,16 @@
 #include "ast.h"
 #include "errors.h"
 #include "symtable.h"
+#include "thread_pool.h"
+#include "type_interner.h"
+
+// Symbol tables made outside of a compilation, as in some tests, have no interner of
+// their own, so their types go here
+static TypeInterner * interner(SymbolTable * symtable) {
+    static TypeInterner shared;
+
+    return symtable->types != nullptr ? symtable->types : &shared;
+}
 
 /**
  * Returns a type which is semantically equivalent to typ, but is not an alias or a
@@ -62,118 +72,31 @@ static const Typename * base_type(const Typename * typ, SymbolTable * symtable)
     return typ;
 }
 
-bool ParensTypename::type_equals(const Typename * t, SymbolTable * symtable) const {
-    const Typename * name_unalias = unaliased(name, symtable);
-
-    return name_unalias->type_equals(unaliased(t, symtable), symtable);
-}
-
-bool TypeIdent::type_equals(const Typename * t, SymbolTable * symtable) const {
-    const Typename * this_unalias = unaliased(this, symtable);
-
-    if (this_unalias != this) {
-        return this_unalias->type_equals(unaliased(t, symtable), symtable);
-    }
-
-    return *this == *(unaliased(t, symtable));
-}
-
-bool PtrTypename::type_equals(const Typename * t, SymbolTable * symtable) const {
-    const Typename * t_unalias = unaliased(t, symtable);
-
-    if (t_unalias->get_kind() != PtrTypename::kind) {
-        return false;
-    }
-
-    const PtrTypename * t_ptr = (PtrTypename *) t_unalias;
-
-    return name->type_equals(t_ptr->name, symtable);
-}
-
-bool MutTypename::type_equals(const Typename * t, SymbolTable * symtable) const {
-    const Typename * t_unalias = unaliased(t, symtable);
-
-    if (t_unalias->get_kind() != MutTypename::kind) {
-        return false;
-    }
-
-    const MutTypename * t_mut = (MutTypename *) t_unalias;
-
-    return name->type_equals(t_mut->name, symtable);
-}
-
-bool TupleTypename::type_equals(const Typename * t, SymbolTable * symtable) const {
-    const Typename * t_unalias = unaliased(t, symtable);
-
-    if (t_unalias->get_kind() != TupleTypename::kind) {
-        return false;
-    }
-
-    const TupleTypename * t_tuple = (TupleTypename *) t_unalias;
-
-    if (type_list->types.size() != t_tuple->type_list->types.size()) {
-        return false;
-    }
-
-    for (size_t i = 0; i < type_list->types.size(); i++) {
-        if (!type_list->types[i]->type_equals(t_tuple->type_list->types[i], symtable)) {
-            return false;
-        }
-    }
-
-    return true;
-}
-
-bool FuncTypename::type_equals(const Typename * t, SymbolTable * symtable) const {
-    const Typename * t_unalias = unaliased(t, symtable);
-
-    if (t_unalias->get_kind() != FuncTypename::kind) {
-        return false;
-    }
-
-    const FuncTypename * t_func = (FuncTypename *) t_unalias;
-
-    if (!ret_type->type_equals(t_func->ret_type, symtable)) {
-        return false;
-    }
-
-    if (params->types.size() != t_func->params->types.size()) {
-        return false;
+bool Typename::type_equals(const Typename * t, SymbolTable * symtable) const {
+    if (t == this) {
+        return true;
     }
 
-    for (size_t i = 0; i < params->types.size(); i++) {
-        if (!params->types[i]->type_equals(t_func->params->types[i], symtable)) {
-            return false;
-        }
-    }
+    TypeInterner * types = interner(symtable);
 
-    return true;
+    return types->id(this, symtable) == types->id(t, symtable);
 }
 
-bool StaticArrayTypename::type_equals(const Typename * t, SymbolTable * symtable) const {
-    const Typename * t_unalias = unaliased(t, symtable);
+bool Typename::can_cast_to(const Typename * t, SymbolTable * symtable) const {
+    TypeInterner * types = interner(symtable);
+    TypeId from = types->id(this, symtable);
+    TypeId to = types->id(t, symtable);
+    bool allowed;
 
-    if (t_unalias->get_kind() != StaticArrayTypename::kind) {
-        return false;
+    if (!types->find_cast(from, to, &allowed)) {
+        allowed = compute_cast(t, symtable);
+        types->add_cast(from, to, allowed);
     }
 
-    const StaticArrayTypename * t_array = (StaticArrayTypename *) t_unalias;
-
-    return (element_type->type_equals(t_array->element_type, symtable) && *size == *(t_array->size));
+    return allowed;
 }
 
-bool DynamicArrayTypename::type_equals(const Typename * t, SymbolTable * symtable) const {
-    const Typename * t_unalias = unaliased(t, symtable);
-    if (t_unalias->get_kind() != DynamicArrayTypename::kind) {
-        return false;
-    }
-
-    const DynamicArrayTypename * t_array = (DynamicArrayTypename *) t_unalias;
-
-    return (element_type->type_equals(t_array->element_type, symtable));
-}
-
-bool DynamicArrayTypename::can_cast_to(const Typename * t, SymbolTable * symtable) const {
+bool DynamicArrayTypename::compute_cast(const Typename * t, SymbolTable * symtable) const {
     const Typename * t_unalias = unaliased(t, symtable);
     if(t_unalias->get_kind() == PtrTypename::kind) {
         PtrTypename *t_ptr = (PtrTypename *) t_unalias;
@@ -182,51 +105,14 @@ bool DynamicArrayTypename::can_cast_to(const Typename * t, SymbolTable * symtabl
     return false;
 }
 
-int DynamicArrayTypename::type_size(SymbolTable * symtable) const {
-    return ADDRESS_WIDTH;
-}
-
-bool StructTypename::type_equals(const Typename * t, SymbolTable * symtable) const {
-    const Typename * t_unalias = unaliased(t, symtable);
-
-    if (t_unalias->get_kind() != StructTypename::kind) {
-        return false;
-    }
-
-    const StructTypename * t_struct = (StructTypename *) t_unalias;
-
-    if (members->decls.size() != t_struct->members->decls.size()) {
-        return false;
-    }
-
-    for (size_t i = 0; i < members->decls.size(); i++) {
-        const VarDecl * this_decl = members->decls[i];
-        const VarDecl * t_decl = t_struct->members->decls[i];
-        const Typename * this_decl_type = unaliased(this_decl->type_name, symtable);
-        const Typename * t_decl_type = unaliased(t_decl->type_name, symtable);
-
-        // Order of the members matters because it affects the padding. We probably
-        // won't pad structs in this compiler but we should keep the option open
-        if (*(this_decl->var_name) != *(t_decl->var_name)) {
-            return false;
-        }
-
-        if (!this_decl_type->type_equals(t_decl_type, symtable)) {
-            return false;
-        }
-    }
-
-    return true;
-}
-
-bool ParensTypename::can_cast_to(const Typename * t, SymbolTable * symtable) const {
+bool ParensTypename::compute_cast(const Typename * t, SymbolTable * symtable) const {
     const Typename * this_unalias = unaliased(name, symtable);
     const Typename * t_unalias = unaliased(t, symtable);
 
     return this_unalias->can_cast_to(t_unalias, symtable);
 }
 
-bool TypeIdent::can_cast_to(const Typename * t, SymbolTable * symtable) const {
+bool TypeIdent::compute_cast(const Typename * t, SymbolTable * symtable) const {
     const Typename * this_unalias = unaliased(this, symtable);
     const Typename * t_unalias = unaliased(t, symtable);
 
@@ -234,11 +120,11 @@ bool TypeIdent::can_cast_to(const Typename * t, SymbolTable * symtable) const {
         return this_unalias->can_cast_to(t_unalias, symtable);
     }
 
-    TypeIdent int_type(x::NULL_LOC, "int");
-    TypeIdent float_type(x::NULL_LOC, "float");
+    const Typename * int_type = interner(symtable)->primitive("int");
+    const Typename * float_type = interner(symtable)->primitive("float");
 
     // An int can be cast to a ptr to anything
-    if (t_unalias->get_kind() == PtrTypename::kind && this->type_equals(&int_type, symtable)) {
+    if (t_unalias->get_kind() == PtrTypename::kind && this->type_equals(int_type, symtable)) {
         return true;
     }
 
@@ -253,19 +139,19 @@ bool TypeIdent::can_cast_to(const Typename * t, SymbolTable * symtable) const {
         return true;
     }
 
-    return (this->type_equals(&int_type, symtable) && t_unalias->type_equals(&float_type, symtable));
+    return (this->type_equals(int_type, symtable) && t_unalias->type_equals(float_type, symtable));
 }
 
-bool PtrTypename::can_cast_to(const Typename * t, SymbolTable * symtable) const {
+bool PtrTypename::compute_cast(const Typename * t, SymbolTable * symtable) const {
     const Typename * t_unalias = unaliased(t, symtable);
 
     if (name->type_equals(t_unalias, symtable)) {
         return true;
     }
 
-    TypeIdent int_type(x::NULL_LOC, "int");
+    const Typename * int_type = interner(symtable)->primitive("int");
 
-    if (t_unalias->type_equals(&int_type, symtable)) {
+    if (t_unalias->type_equals(int_type, symtable)) {
         return true;
     }
 
@@ -278,7 +164,7 @@ bool PtrTypename::can_cast_to(const Typename * t, SymbolTable * symtable) const
     return (name->type_equals(t_ptr->name, symtable));
 }
 
-bool MutTypename::can_cast_to(const Typename * t, SymbolTable * symtable) const {
+bool MutTypename::compute_cast(const Typename * t, SymbolTable * symtable) const {
     const Typename * t_unalias = unaliased(t, symtable);
 
     if (t_unalias->get_kind() != MutTypename::kind) {
@@ -290,7 +176,7 @@ bool MutTypename::can_cast_to(const Typename * t, SymbolTable * symtable) const
     return name->can_cast_to(t_mut->name, symtable);
 }
 
-bool TupleTypename::can_cast_to(const Typename * t, SymbolTable * symtable) const {
+bool TupleTypename::compute_cast(const Typename * t, SymbolTable * symtable) const {
     const Typename * t_unalias = unaliased(t, symtable);
 
     // [int] can cast to int
@@ -317,11 +203,11 @@ bool TupleTypename::can_cast_to(const Typename * t, SymbolTable * symtable) cons
     return true;
 }
 
-bool FuncTypename::can_cast_to(const Typename * t, SymbolTable * symtable) const {
+bool FuncTypename::compute_cast(const Typename * t, SymbolTable * symtable) const {
     return this->type_equals(t, symtable);
 }
 
-bool StaticArrayTypename::can_cast_to(const Typename * t, SymbolTable * symtable) const {
+bool StaticArrayTypename::compute_cast(const Typename * t, SymbolTable * symtable) const {
     const Typename * t_unalias = unaliased(t, symtable);
 
     // int[1] can cast to int
@@ -338,57 +224,163 @@ bool StaticArrayTypename::can_cast_to(const Typename * t, SymbolTable * symtable
     return (*size == *(t_array->size) && element_type->can_cast_to(t_array->element_type, symtable));
 }
 
-bool StructTypename::can_cast_to(const Typename * t, SymbolTable * symtable) const {
+bool StructTypename::compute_cast(const Typename * t, SymbolTable * symtable) const {
     return this->type_equals(t, symtable);
 }
 
-Typename * ParensExpr::type_of(SymbolTable * symtable) const {
+// How many type_of calls can be nested on the native stack. Past this, the rest of
+// an expression is typed bottom up first, so each further call returns at once
+#define TYPE_OF_MAX_DEPTH 256
+
+static thread_local int type_of_depth = 0;
+
+struct TypeOfDepth {
+    TypeOfDepth() {
+        type_of_depth++;
+    }
+
+    ~TypeOfDepth() {
+        type_of_depth--;
+    }
+};
+
+const Typename * Expr::type_of(SymbolTable * symtable) const {
+    // Nothing is kept if this throws, so an ill-typed expression reports its error
+    // every time it's asked
+    if (cached_type == nullptr) {
+        if (type_of_depth >= TYPE_OF_MAX_DEPTH) {
+            type_subexprs(symtable);
+        }
+
+        TypeOfDepth depth;
+        cached_type = compute_type(symtable);
+    }
+
+    return cached_type;
+}
+
+static const Expr * as_expr(ASTNode * node) {
+    return x::dispatch(node, [](auto * leaf) -> const Expr * {
+        if constexpr (std::is_base_of_v<Expr, std::remove_pointer_t<decltype(leaf)>>) {
+            return leaf;
+        } else {
+            return nullptr;
+        }
+    });
+}
+
+static bool is_typename(ASTNode * node) {
+    return x::dispatch(node, [](auto * leaf) {
+        return std::is_base_of_v<Typename, std::remove_pointer_t<decltype(leaf)>>;
+    });
+}
+
+// Children that an expression's type is worked out from. Member names are left out,
+// since they aren't looked up in the expression's scope
+static bool each_typed_child(ASTNode * node, ChildFunc f) {
+    if (node->get_kind() == StructDeref::kind) {
+        return f((ASTNode *) ((StructDeref *) node)->strukt);
+    } else if (node->get_kind() == MemberInitializer::kind) {
+        return f((ASTNode *) ((MemberInitializer *) node)->expr);
+    }
+
+    return node->each_child(f);
+}
+
+void Expr::type_subexprs(SymbolTable * symtable) const {
+    struct Frame {
+        ASTNode * node;
+        bool expanded;
+    };
+
+    std::vector<Frame> stack = {{(ASTNode *) this, false}};
+
+    while (!stack.empty()) {
+        Frame frame = stack.back();
+
+        if (frame.expanded) {
+            stack.pop_back();
+
+            // Children are done, so this doesn't recurse. An error ends the whole
+            // thing, as it would have from the recursion
+            const Expr * expr = as_expr(frame.node);
+
+            if (expr != nullptr && expr != this) {
+                expr->type_of(symtable);
+            }
+
+            continue;
+        }
+
+        stack.back().expanded = true;
+        size_t first = stack.size();
+
+        each_typed_child(frame.node, [&stack](ASTNode * child) {
+            if (child == nullptr || is_typename(child)) {
+                return true;
+            }
+
+            const Expr * expr = as_expr(child);
+
+            if (expr == nullptr || expr->cached_type == nullptr) {
+                stack.push_back({child, false});
+            }
+
+            return true;
+        });
+
+        // The first child is typed first, as compute_type would
+        std::reverse(stack.begin() + first, stack.end());
+    }
+}
+
+const Typename * ParensExpr::compute_type(SymbolTable * symtable) const {
     return expr->type_of(symtable);
 }
 
-Typename * IntLiteral::type_of(SymbolTable * symtable) const {
-    return new TypeIdent(x::NULL_LOC, "int");
+const Typename * IntLiteral::compute_type(SymbolTable * symtable) const {
+    return interner(symtable)->primitive("int");
 }
 
-Typename * FloatLiteral::type_of(SymbolTable * symtable) const {
-    return new TypeIdent(x::NULL_LOC, "float");
+const Typename * FloatLiteral::compute_type(SymbolTable * symtable) const {
+    return interner(symtable)->primitive("float");
 }
 
-Typename * TernaryExpr::type_of(SymbolTable * symtable) const {
-    std::unique_ptr<Typename> cond_type(cond->type_of(symtable));
-    std::unique_ptr<Typename> tru_type(tru->type_of(symtable));
-    std::unique_ptr<Typename> fals_type(fals->type_of(symtable));
+const Typename * TernaryExpr::compute_type(SymbolTable * symtable) const {
+    const Typename * cond_type = cond->type_of(symtable);
+    const Typename * tru_type = tru->type_of(symtable);
+    const Typename * fals_type = fals->type_of(symtable);
 
-    TypeIdent bool_type(x::NULL_LOC, "bool");
+    const Typename * bool_type = interner(symtable)->primitive("bool");
 
-    if (!cond_type->type_equals(&bool_type, symtable)) {
+    if (!cond_type->type_equals(bool_type, symtable)) {
         // TODO: Print type
         throw CompilerError(cond->loc, "Condition in ternary expression must have bool type", Error);
     }
 
     // TODO: Implicit cast if possible
-    if (!tru_type->type_equals(fals_type.get(), symtable)) {
+    if (!tru_type->type_equals(fals_type, symtable)) {
         // TODO: Print type
         throw CompilerError(Location(tru->loc, fals->loc), "Both sides of ternary expression must have the same type", Error);
     }
 
-    return tru_type.release();
+    return tru_type;
 }
 
-Typename * BoolLiteral::type_of(SymbolTable * symtable) const {
-    return new TypeIdent(x::NULL_LOC, "bool");
+const Typename * BoolLiteral::compute_type(SymbolTable * symtable) const {
+    return interner(symtable)->primitive("bool");
 }
 
-Typename * CharLiteral::type_of(SymbolTable * symtable) const {
-    return new TypeIdent(x::NULL_LOC, "char");
+const Typename * CharLiteral::compute_type(SymbolTable * symtable) const {
+    return interner(symtable)->primitive("char");
 }
 
-Typename * StringLiteral::type_of(SymbolTable * symtable) const {
+const Typename * StringLiteral::compute_type(SymbolTable * symtable) const {
     // Same as in C, a string literal has type "char *"
-    return new PtrTypename(x::NULL_LOC, new TypeIdent(x::NULL_LOC, "char"));
+    return interner(symtable)->intern(new PtrTypename(x::NULL_LOC, new TypeIdent(x::NULL_LOC, "char")));
 }
 
-Typename * Ident::type_of(SymbolTable * symtable) const {
+const Typename * Ident::compute_type(SymbolTable * symtable) const {
     Symbol * symbol = symtable->get(id);
 
     if (symbol->kind == Type) {
@@ -398,7 +390,7 @@ Typename * Ident::type_of(SymbolTable * symtable) const {
     if (symbol->kind == Var) {
         VarDecl * decl = symbol->decl.var;
 
-        return unaliased(decl->type_name, symtable)->clone();
+        return interner(symtable)->get(*unaliased(decl->type_name, symtable));
     }
 
     FuncDecl * decl = symbol->decl.func;
@@ -411,26 +403,27 @@ Typename * Ident::type_of(SymbolTable * symtable) const {
         params_clone.push_back(type_name);
     }
 
-    return new FuncTypename(x::NULL_LOC, new TypenameList(x::NULL_LOC, params_clone), decl->ret_type->clone(), symtable);
+    return interner(symtable)->intern(new FuncTypename(x::NULL_LOC, new TypenameList(x::NULL_LOC, params_clone),
+                                                       decl->ret_type->clone(), symtable));
 }
 
-Typename * MathExpr::type_of(SymbolTable * symtable) const {
-    std::unique_ptr<Typename> lhs_type(left->type_of(symtable));
-    std::unique_ptr<Typename> rhs_type(right->type_of(symtable));
+const Typename * MathExpr::compute_type(SymbolTable * symtable) const {
+    const Typename * lhs_type = left->type_of(symtable);
+    const Typename * rhs_type = right->type_of(symtable);
 
     // TODO: Make these constant and reference them throughout the program
-    const TypeIdent int_type(x::NULL_LOC, "int");
-    const TypeIdent float_type(x::NULL_LOC, "float");
+    const Typename * int_type = interner(symtable)->primitive("int");
+    const Typename * float_type = interner(symtable)->primitive("float");
 
-    const Typename * lhs_base = base_type(lhs_type.get(), symtable);
-    const Typename * rhs_base = base_type(rhs_type.get(), symtable);
+    const Typename * lhs_base = base_type(lhs_type, symtable);
+    const Typename * rhs_base = base_type(rhs_type, symtable);
 
     // TODO: Use '==' overload here, these can only be simple TypeIdents
     // TODO: More sophisticated typechecking here when we add different sizes of ints and floats
-    const bool l_is_int = lhs_base->type_equals(&int_type, symtable);
-    const bool l_is_float = lhs_base->type_equals(&float_type, symtable);
-    const bool r_is_int = rhs_base->type_equals(&int_type, symtable);
-    const bool r_is_float = rhs_base->type_equals(&float_type, symtable);
+    const bool l_is_int = lhs_base->type_equals(int_type, symtable);
+    const bool l_is_float = lhs_base->type_equals(float_type, symtable);
+    const bool r_is_int = rhs_base->type_equals(int_type, symtable);
+    const bool r_is_float = rhs_base->type_equals(float_type, symtable);
 
     if (!(l_is_int || l_is_float)) {
         throw CompilerError(left->loc, "Expected int or float", Error);
@@ -445,43 +438,43 @@ Typename * MathExpr::type_of(SymbolTable * symtable) const {
     }
 
     if (l_is_int && r_is_int) {
-        return new TypeIdent(x::NULL_LOC, "int");
+        return interner(symtable)->primitive("int");
     }
 
     // Implicitly promote ints to floats? As of right now this doesn't break our type system
     // principle of casting because we go from a 32 bit int to a 64 bit float, and a 64 bit
     // float can represent every 32 bit int because the fraction is 52 bits
-    return new TypeIdent(x::NULL_LOC, "float");
+    return interner(symtable)->primitive("float");
 }
 
-Typename * BoolExpr::type_of(SymbolTable * symtable) const {
-    std::unique_ptr<Typename> lhs_type(left->type_of(symtable));
-    std::unique_ptr<Typename> rhs_type(right->type_of(symtable));
+const Typename * BoolExpr::compute_type(SymbolTable * symtable) const {
+    const Typename * lhs_type = left->type_of(symtable);
+    const Typename * rhs_type = right->type_of(symtable);
 
-    const TypeIdent bool_type(x::NULL_LOC, "bool");
+    const Typename * bool_type = interner(symtable)->primitive("bool");
 
-    const Typename * lhs_base = base_type(lhs_type.get(), symtable);
-    const Typename * rhs_base = base_type(rhs_type.get(), symtable);
+    const Typename * lhs_base = base_type(lhs_type, symtable);
+    const Typename * rhs_base = base_type(rhs_type, symtable);
 
-    if (!lhs_base->type_equals(&bool_type, symtable)) {
+    if (!lhs_base->type_equals(bool_type, symtable)) {
         throw CompilerError(left->loc, "Expected bool", Error);
     }
 
-    if (!rhs_base->type_equals(&bool_type, symtable)) {
+    if (!rhs_base->type_equals(bool_type, symtable)) {
         throw CompilerError(right->loc, "Expected bool", Error);
     }
 
-    return new TypeIdent(x::NULL_LOC, "bool");
+    return interner(symtable)->primitive("bool");
 }
 
-Typename * FunctionCallExpr::type_of(SymbolTable * symtable) const {
-    std::unique_ptr<Typename> caller_type(func->type_of(symtable));
+const Typename * FunctionCallExpr::compute_type(SymbolTable * symtable) const {
+    const Typename * caller_type = func->type_of(symtable);
 
     if (caller_type->get_kind() != FuncTypename::kind) {
         throw CompilerError(func->loc, "Expression is not callable", Error);
     }
 
-    const FuncTypename * caller_func = (FuncTypename *) caller_type.get();
+    const FuncTypename * caller_func = (FuncTypename *) caller_type;
 
     if (args->exprs.size() != caller_func->params->types.size()) {
         std::ostringstream stream;
@@ -490,96 +483,92 @@ Typename * FunctionCallExpr::type_of(SymbolTable * symtable) const {
     }
 
     for (size_t i = 0; i < args->exprs.size(); i++) {
-        const std::unique_ptr<Typename> actual_type(args->exprs[i]->type_of(symtable));
+        const Typename * actual_type = args->exprs[i]->type_of(symtable);
         const Typename * expected_type = caller_func->params->types[i];
-        const Typename * actual_base = base_type(actual_type.get(), symtable);
+        const Typename * actual_base = base_type(actual_type, symtable);
 
         if (!actual_base->type_equals(expected_type, symtable)) {
             throw CompilerError(args->exprs[i]->loc, "Type mismatch", Error);
         }
     }
 
-    return caller_func->ret_type->clone();
+    return interner(symtable)->get(*caller_func->ret_type);
 }
 
-Typename * TupleExpr::type_of(SymbolTable * symtable) const {
-    std::vector<std::unique_ptr<Typename>> tuple_types(expr_list->exprs.size());
-    std::vector<Typename *> raw_tuple_types = {};
+const Typename * TupleExpr::compute_type(SymbolTable * symtable) const {
+    std::vector<Typename *> tuple_types = {};
 
-    for (size_t i = 0; i < expr_list->exprs.size(); i++) {
-        tuple_types[i] = std::unique_ptr<Typename>(expr_list->exprs[i]->type_of(symtable));
+    // The tuple owns its element types, so they have to be copies
+    for (auto &expr : expr_list->exprs) {
+        tuple_types.push_back(expr->type_of(symtable)->clone());
     }
 
-    std::transform(tuple_types.begin(), tuple_types.end(), std::back_inserter(raw_tuple_types),
-    [](auto &item) {
-        return item.release();
-    });
-
-    return new TupleTypename(x::NULL_LOC, new TypenameList(x::NULL_LOC, raw_tuple_types), symtable);
+    return interner(symtable)->intern(new TupleTypename(x::NULL_LOC, new TypenameList(x::NULL_LOC, tuple_types)));
 }
 
-Typename * ArrayLiteral::type_of(SymbolTable * symtable) const {
+const Typename * ArrayLiteral::compute_type(SymbolTable * symtable) const {
     if (items->exprs.size() == 0) {
         throw CompilerError(loc, "Empty array literals are not allowed", Error);
     }
 
-    std::unique_ptr<Typename> out(items->exprs[0]->type_of(symtable));
+    const Typename * out = items->exprs[0]->type_of(symtable);
 
     for (size_t i = 1; i < items->exprs.size(); i++) {
-        std::unique_ptr<Typename> expr_type(items->exprs[i]->type_of(symtable));
+        const Typename * expr_type = items->exprs[i]->type_of(symtable);
 
-        if (!out->type_equals(expr_type.get(), symtable)) {
+        if (!out->type_equals(expr_type, symtable)) {
             throw CompilerError(items->exprs[i]->loc, "All exprs in array literal must have the same type", Error);
         }
     }
 
-    return new StaticArrayTypename(x::NULL_LOC, out.release(), new IntLiteral(x::NULL_LOC, items->exprs.size()));
+    return interner(symtable)->intern(new StaticArrayTypename(x::NULL_LOC, out->clone(),
+                                                              new IntLiteral(x::NULL_LOC, items->exprs.size())));
 }
 
 // TODO: rvalue references
-Typename * AddrOf::type_of(SymbolTable * symtable) const {
-    return new PtrTypename(x::NULL_LOC, expr->type_of(symtable));
+const Typename * AddrOf::compute_type(SymbolTable * symtable) const {
+    return interner(symtable)->intern(new PtrTypename(x::NULL_LOC, expr->type_of(symtable)->clone()));
 }
 
-Typename * Deref::type_of(SymbolTable * symtable) const {
-    std::unique_ptr<Typename> expr_type(expr->type_of(symtable));
+const Typename * Deref::compute_type(SymbolTable * symtable) const {
+    const Typename * expr_type = expr->type_of(symtable);
 
     if (expr_type->get_kind() != PtrTypename::kind) {
         throw CompilerError(expr->loc, "Cannot dereference a non-pointer type", Error);
     }
 
-    const PtrTypename * ptr_type = (PtrTypename *) expr_type.get();
+    const PtrTypename * ptr_type = (PtrTypename *) expr_type;
     const Typename * base_type = unaliased(ptr_type->name, symtable);
 
-    return base_type->clone();
+    return interner(symtable)->get(*base_type);
 }
 
-Typename * CastExpr::type_of(SymbolTable * symtable) const {
-    std::unique_ptr<Typename> expr_type(expr->type_of(symtable));
+const Typename * CastExpr::compute_type(SymbolTable * symtable) const {
+    const Typename * expr_type = expr->type_of(symtable);
 
     if (!expr_type->can_cast_to(dest_type, symtable)) {
         throw CompilerError(loc, "Cast is invalid: expr type cannot be cast to destination type", Error);
     }
 
-    return dest_type->clone();
+    return interner(symtable)->get(*dest_type);
 }
 
-Typename * LogicalExpr::type_of(SymbolTable * symtable) const {
-    std::unique_ptr<Typename> lhs_type(left->type_of(symtable));
-    std::unique_ptr<Typename> rhs_type(right->type_of(symtable));
+const Typename * LogicalExpr::compute_type(SymbolTable * symtable) const {
+    const Typename * lhs_type = left->type_of(symtable);
+    const Typename * rhs_type = right->type_of(symtable);
 
-    TypeIdent int_type(x::NULL_LOC, "int");
-    TypeIdent float_type(x::NULL_LOC, "float");
+    const Typename * int_type = interner(symtable)->primitive("int");
+    const Typename * float_type = interner(symtable)->primitive("float");
 
-    const Typename * lhs_base = base_type(lhs_type.get(), symtable);
-    const Typename * rhs_base = base_type(rhs_type.get(), symtable);
+    const Typename * lhs_base = base_type(lhs_type, symtable);
+    const Typename * rhs_base = base_type(rhs_type, symtable);
 
     if (op == std::string("==") || op == std::string("!=")) {
         if (!lhs_base->type_equals(rhs_base, symtable)) {
             throw CompilerError(loc, "Both sides of equality comparison must have the same type", Error);
         }
 
-        return new TypeIdent(x::NULL_LOC, "bool");
+        return interner(symtable)->primitive("bool");
     }
 
     if (op == std::string("in") || op == std::string("not in")) {
@@ -587,20 +576,20 @@ Typename * LogicalExpr::type_of(SymbolTable * symtable) const {
             throw CompilerError(right->loc, "'in' and 'not in' can only be used to check for presence in an array", Error);
         }
 
-        std::unique_ptr<StaticArrayTypename> rhs_array((StaticArrayTypename *) rhs_type.release());
+        const StaticArrayTypename * rhs_array = (StaticArrayTypename *) rhs_type;
 
         if (!lhs_base->type_equals(rhs_array->element_type, symtable)) {
             throw CompilerError(left->loc, "Type mismatch: left hand side is not an element of right hand side", Error);
         }
 
-        return new TypeIdent(x::NULL_LOC, "bool");
+        return interner(symtable)->primitive("bool");
     }
 
     // Now the operation can only be one of the relational numeric operators, so the operands
     // must be numeric
 
-    const bool lhs_is_num = lhs_base->type_equals(&int_type, symtable) || lhs_base->type_equals(&float_type, symtable);
-    const bool rhs_is_num = rhs_base->type_equals(&int_type, symtable) || rhs_base->type_equals(&float_type, symtable);
+    const bool lhs_is_num = lhs_base->type_equals(int_type, symtable) || lhs_base->type_equals(float_type, symtable);
+    const bool rhs_is_num = rhs_base->type_equals(int_type, symtable) || rhs_base->type_equals(float_type, symtable);
 
     if (!lhs_is_num) {
         throw CompilerError(left->loc, "Left hand side must be numeric type", Error);
@@ -610,7 +599,7 @@ Typename * LogicalExpr::type_of(SymbolTable * symtable) const {
         throw CompilerError(right->loc, "Right hand side must be numeric type", Error);
     }
 
-    return new TypeIdent(x::NULL_LOC, "bool");
+    return interner(symtable)->primitive("bool");
 }
 
 Typename * FuncDecl::type_of(SymbolTable * symtable) const {
@@ -623,62 +612,62 @@ Typename * FuncDecl::type_of(SymbolTable * symtable) const {
     return new FuncTypename(x::NULL_LOC, new TypenameList(x::NULL_LOC, param_types), ret_type->clone(), symtable);
 }
 
-Typename * BangExpr::type_of(SymbolTable * symtable) const {
-    std::unique_ptr<Typename> expr_type(expr->type_of(symtable));
+const Typename * BangExpr::compute_type(SymbolTable * symtable) const {
+    const Typename * expr_type = expr->type_of(symtable);
 
-    TypeIdent bool_type(x::NULL_LOC, "bool");
+    const Typename * bool_type = interner(symtable)->primitive("bool");
 
-    if (!expr_type->type_equals(&bool_type, symtable)) {
+    if (!expr_type->type_equals(bool_type, symtable)) {
         throw CompilerError(loc, "Bang can only be used on bool expr", Error);
     }
 
-    return new TypeIdent(x::NULL_LOC, "bool");
+    return interner(symtable)->primitive("bool");
 }
 
-Typename * NotExpr::type_of(SymbolTable * symtable) const {
-    std::unique_ptr<Typename> expr_type(expr->type_of(symtable));
+const Typename * NotExpr::compute_type(SymbolTable * symtable) const {
+    const Typename * expr_type = expr->type_of(symtable);
 
-    TypeIdent bool_type(x::NULL_LOC, "bool");
+    const Typename * bool_type = interner(symtable)->primitive("bool");
 
-    if (!expr_type->type_equals(&bool_type, symtable)) {
+    if (!expr_type->type_equals(bool_type, symtable)) {
         throw CompilerError(loc, "'not' can only be used on bool expr", Error);
     }
 
-    return new TypeIdent(x::NULL_LOC, "bool");
+    return interner(symtable)->primitive("bool");
 }
 
-Typename * PostExpr::type_of(SymbolTable * symtable) const {
-    std::unique_ptr<Typename> expr_type(expr->type_of(symtable));
+const Typename * PostExpr::compute_type(SymbolTable * symtable) const {
+    const Typename * expr_type = expr->type_of(symtable);
 
-    TypeIdent int_type(x::NULL_LOC, "int");
+    const Typename * int_type = interner(symtable)->primitive("int");
 
-    if (!expr_type->type_equals(&int_type, symtable)) {
+    if (!expr_type->type_equals(int_type, symtable)) {
         throw CompilerError(loc, "Post expr can only be used on int expr", Error);
     }
 
-    return new TypeIdent(x::NULL_LOC, "int");
+    return interner(symtable)->primitive("int");
 }
 
-Typename * PreExpr::type_of(SymbolTable * symtable) const {
-    std::unique_ptr<Typename> expr_type(expr->type_of(symtable));
+const Typename * PreExpr::compute_type(SymbolTable * symtable) const {
+    const Typename * expr_type = expr->type_of(symtable);
 
-    TypeIdent int_type(x::NULL_LOC, "int");
+    const Typename * int_type = interner(symtable)->primitive("int");
 
-    if (!expr_type->type_equals(&int_type, symtable)) {
+    if (!expr_type->type_equals(int_type, symtable)) {
         throw CompilerError(loc, "Pre expr can only be used on int expr", Error);
     }
 
-    return new TypeIdent(x::NULL_LOC, "int");
+    return interner(symtable)->primitive("int");
 }
 
-Typename * StructDeref::type_of(SymbolTable * symtable) const {
-    std::unique_ptr<Typename> strukt_type(strukt->type_of(symtable));
+const Typename * StructDeref::compute_type(SymbolTable * symtable) const {
+    const Typename * strukt_type = strukt->type_of(symtable);
 
     if (strukt_type->get_kind() != StructTypename::kind) {
         throw CompilerError(strukt->loc, "Left hand side must be a struct type", Error);
     }
 
-    const StructTypename * strukt_struct = (StructTypename *) strukt_type.get();
+    const StructTypename * strukt_struct = (StructTypename *) strukt_type;
     SymbolTable * strukt_scope = strukt_struct->scope;
 
     const Symbol * sym = strukt_scope->get(member->id);
@@ -693,16 +682,15 @@ Typename * StructDeref::type_of(SymbolTable * symtable) const {
 
     const VarDecl * decl = sym->decl.var;
 
-    return decl->type_name->clone();
+    return interner(symtable)->get(*decl->type_name);
 }
 
-Typename * StructLiteral::type_of(SymbolTable * symtable) const {
+const Typename * StructLiteral::compute_type(SymbolTable * symtable) const {
     std::vector<std::unique_ptr<VarDecl>> var_decls = {};
     std::unique_ptr<SymbolTable> scope(new SymbolTable(symtable));
 
     for (auto &member : members->members) {
-        std::unique_ptr<Typename> expr_type(member->expr->type_of(symtable));
-        const Typename * var_type = expr_type.release();
+        const Typename * var_type = member->expr->type_of(symtable)->clone();
         const Ident * var_name = new Ident(x::NULL_LOC, member->member->id.c_str());
         VarDecl * var_decl = new VarDecl(x::NULL_LOC, var_type, var_name);
 
@@ -719,48 +707,92 @@ Typename * StructLiteral::type_of(SymbolTable * symtable) const {
     }
 
     const VarDeclList * decl_list = new VarDeclList(x::NULL_LOC, var_decls_raw);
-    return new StructTypename(x::NULL_LOC, decl_list, scope.release());
+    return interner(symtable)->intern(new StructTypename(x::NULL_LOC, decl_list, scope.release()));
 }
 
-Typename * ArrayIndexExpr::type_of(SymbolTable * symtable) const {
-    std::unique_ptr<Typename> arr_type(arr->type_of(symtable));
-    std::unique_ptr<Typename> index_type(index->type_of(symtable));
-    const Typename * index_base = base_type(unaliased(index_type.get(), symtable), symtable);
+const Typename * ArrayIndexExpr::compute_type(SymbolTable * symtable) const {
+    const Typename * arr_type = arr->type_of(symtable);
+    const Typename * index_type = index->type_of(symtable);
+    const Typename * index_base = base_type(unaliased(index_type, symtable), symtable);
 
     if (arr_type->get_kind() != StaticArrayTypename::kind) {
         throw CompilerError(x::NULL_LOC, "Left hand side of array index expr is not array", Error);
     }
 
-    TypeIdent int_type(x::NULL_LOC, "int");
+    const Typename * int_type = interner(symtable)->primitive("int");
 
-    if (!index_base->type_equals(&int_type, symtable)) {
+    if (!index_base->type_equals(int_type, symtable)) {
         throw CompilerError(x::NULL_LOC, "Array index type must be int", Error);
     }
 
-    const StaticArrayTypename * static_arr_type = (StaticArrayTypename *) arr_type.get();
+    const StaticArrayTypename * static_arr_type = (StaticArrayTypename *) arr_type;
 
-    return static_arr_type->element_type->clone();
+    return interner(symtable)->get(*static_arr_type->element_type);
 }
 
-void ProgramSource::typecheck(SymbolTable * symtable, SourceErrors &errors) const {
-    for (auto &node : nodes) {
-        try {
-            if (node->get_kind() == VarDecl::kind) {
-                const VarDecl * decl = (VarDecl *) node;
+void ProgramSource::typecheck(SymbolTable * symtable, SourceErrors &errors, ThreadPool * pool) const {
+    if (pool == nullptr) {
+        for (auto &node : nodes) {
+            ProgramSource::typecheck_decl(node, symtable, errors);
+        }
 
-                decl->typecheck(symtable, errors);
-            } else if (node->get_kind() == VarDeclInit::kind) {
-                const VarDeclInit * decl = (VarDeclInit *) node;
+        return;
+    }
 
-                decl->typecheck(symtable, errors);
-            } else if (node->get_kind() == FuncDecl::kind) {
-                const FuncDecl * decl = (FuncDecl *) node;
+    std::vector<SourceErrors> node_errors(nodes.size());
+    ProgramSource::typecheck_decls(nodes, symtable, node_errors, pool);
 
-                decl->typecheck(symtable, errors);
-            }
-        } catch (CompilerError error) {
-            errors.type_errors.push_back(error);
+    for (auto &item : node_errors) {
+        errors.type_errors.insert(errors.type_errors.end(), item.type_errors.begin(), item.type_errors.end());
+    }
+}
+
+void ProgramSource::typecheck_decls(const std::vector<ASTNode *> &decls, SymbolTable * symtable,
+                                    std::vector<SourceErrors> &errors, ThreadPool * pool) {
+    std::vector<size_t> funcs;
+
+    for (size_t i = 0; i < decls.size(); i++) {
+        if (decls[i]->get_kind() == FuncDecl::kind) {
+            funcs.push_back(i);
+        } else {
+            ProgramSource::typecheck_decl(decls[i], symtable, errors[i]);
+        }
+    }
+
+    auto check_func = [&](size_t k) {
+        ProgramSource::typecheck_decl(decls[funcs[k]], symtable, errors[funcs[k]]);
+    };
+
+    if (pool != nullptr) {
+        pool->parallel_for(funcs.size(), check_func);
+    } else {
+        for (size_t k = 0; k < funcs.size(); k++) {
+            check_func(k);
+        }
+    }
+}
+
+void ProgramSource::typecheck_decl(const ASTNode * node, SymbolTable * symtable, SourceErrors &errors) {
+    try {
+        if (node->get_kind() == VarDecl::kind) {
+            const VarDecl * decl = (VarDecl *) node;
+
+            decl->typecheck(symtable, errors);
+        } else if (node->get_kind() == VarDeclInit::kind) {
+            const VarDeclInit * decl = (VarDeclInit *) node;
+
+            decl->typecheck(symtable, errors);
+        } else if (node->get_kind() == FuncDecl::kind) {
+            const FuncDecl * decl = (FuncDecl *) node;
+
+            decl->typecheck(symtable, errors);
+        } else if (node->get_kind() == StructDecl::kind) {
+            const StructDecl * decl = (StructDecl *) node;
+
+            decl->typecheck(symtable, errors);
         }
+    } catch (CompilerError error) {
+        errors.type_errors.push_back(error);
     }
 }
 
@@ -784,7 +816,7 @@ void StatementList::typecheck(SymbolTable * symtable, SourceErrors &errors) cons
 }
 
 void VarDecl::typecheck(SymbolTable * symtable, SourceErrors &errors) const {
-    std::unique_ptr<Typename> expr_type(var_name->type_of(symtable));
+    const Typename * expr_type = var_name->type_of(symtable);
 
     if (!expr_type->type_equals(type_name, symtable)) {
         throw CompilerError(loc, "Type mismatch: left hand side type must match right hand side type", Error);
@@ -792,13 +824,13 @@ void VarDecl::typecheck(SymbolTable * symtable, SourceErrors &errors) const {
 }
 
 void FunctionCallStmt::typecheck(SymbolTable * symtable, SourceErrors &errors) const {
-    std::unique_ptr<Typename> caller_type(func->type_of(symtable));
+    const Typename * caller_type = func->type_of(symtable);
 
     if (caller_type->get_kind() != FuncTypename::kind) {
         throw CompilerError(func->loc, "Expression is not callable", Error);
     }
 
-    const FuncTypename * caller_func = (FuncTypename *) caller_type.get();
+    const FuncTypename * caller_func = (FuncTypename *) caller_type;
 
     if (args->exprs.size() != caller_func->params->types.size()) {
         std::ostringstream stream;
@@ -807,8 +839,8 @@ void FunctionCallStmt::typecheck(SymbolTable * symtable, SourceErrors &errors) c
     }
 
     for (size_t i = 0; i < args->exprs.size(); i++) {
-        const std::unique_ptr<Typename> actual_type(args->exprs[i]->type_of(symtable));
-        const Typename * actual_base = base_type(actual_type.get(), symtable);
+        const Typename * actual_type = args->exprs[i]->type_of(symtable);
+        const Typename * actual_base = base_type(actual_type, symtable);
         const Typename * expected_type = caller_func->params->types[i];
 
         // You can pass a mut x where a regular x is expected
@@ -823,13 +855,15 @@ void TypeAlias::typecheck(SymbolTable * symtable, SourceErrors &errors) const {
 }
 
 void StructDecl::typecheck(SymbolTable * symtable, SourceErrors &errors) const {
-
+    if (interner(symtable)->layout(defn, symtable) == nullptr) {
+        throw CompilerError(loc, "Struct contains itself", Error);
+    }
 }
 
 void VarDeclInit::typecheck(SymbolTable * symtable, SourceErrors &errors) const {
-    std::unique_ptr<Typename> init_type(init->type_of(symtable));
+    const Typename * init_type = init->type_of(symtable);
 
-    const Typename * init_base = base_type(init_type.get(), symtable);
+    const Typename * init_base = base_type(init_type, symtable);
     const Typename * decl_base = base_type(decl->type_name, symtable);
 
     if (!init_base->type_equals(decl_base, symtable)) {
@@ -838,11 +872,11 @@ void VarDeclInit::typecheck(SymbolTable * symtable, SourceErrors &errors) const
 }
 
 void IfStmt::typecheck(SymbolTable * symtable, SourceErrors &errors) const {
-    std::unique_ptr<Typename> cond_type(cond->type_of(symtable));
+    const Typename * cond_type = cond->type_of(symtable);
 
-    TypeIdent bool_type(x::NULL_LOC, "bool");
+    const Typename * bool_type = interner(symtable)->primitive("bool");
 
-    if (!cond_type->type_equals(&bool_type, symtable)) {
+    if (!cond_type->type_equals(bool_type, symtable)) {
         CompilerError err(cond->loc, "Condition type must be bool", Error);
         errors.type_errors.push_back(err);
     }
@@ -856,11 +890,11 @@ void IfElseStmt::typecheck(SymbolTable * symtable, SourceErrors &errors) const {
 }
 
 void WhileStmt::typecheck(SymbolTable * symtable, SourceErrors &errors) const {
-    std::unique_ptr<Typename> cond_type(cond->type_of(symtable));
+    const Typename * cond_type = cond->type_of(symtable);
 
-    TypeIdent bool_type(x::NULL_LOC, "bool");
+    const Typename * bool_type = interner(symtable)->primitive("bool");
 
-    if (!cond_type->type_equals(&bool_type, symtable)) {
+    if (!cond_type->type_equals(bool_type, symtable)) {
         CompilerError err(cond->loc, "Condition type must be bool", Error);
         errors.type_errors.push_back(err);
     }
@@ -871,11 +905,11 @@ void WhileStmt::typecheck(SymbolTable * symtable, SourceErrors &errors) const {
 void ForStmt::typecheck(SymbolTable * symtable, SourceErrors &errors) const {
     init->typecheck(scope, errors);
 
-    std::unique_ptr<Typename> cond_type(condition->type_of(symtable));
+    const Typename * cond_type = condition->type_of(symtable);
 
-    TypeIdent bool_type(x::NULL_LOC, "bool");
+    const Typename * bool_type = interner(symtable)->primitive("bool");
 
-    if (!cond_type->type_equals(&bool_type, symtable)) {
+    if (!cond_type->type_equals(bool_type, symtable)) {
         CompilerError err(condition->loc, "Condition type must be bool", Error);
         errors.type_errors.push_back(err);
     }
@@ -904,13 +938,13 @@ void FuncDecl::typecheck(SymbolTable * symtable, SourceErrors &errors) const {
         }
     }
 
-    TypeIdent void_type(x::NULL_LOC, "void");
-    TypeIdent Please_type(x::NULL_LOC, "Please");
+    const Typename * void_type = interner(symtable)->primitive("void");
+    const Typename * Please_type = interner(symtable)->primitive("Please");
 
     const size_t num_stmts = body->statements.size();
     const bool ends_with_ret = num_stmts > 0 && body->statements[num_stmts - 1]->get_kind() == ReturnStatement::kind;
 
-    if (!ends_with_ret && (!ret_type->type_equals(&Please_type, symtable) && !ret_type->type_equals(&void_type, symtable))) {
+    if (!ends_with_ret && (!ret_type->type_equals(Please_type, symtable) && !ret_type->type_equals(void_type, symtable))) {
         CompilerError error(x::NULL_LOC, "Missing return statement at end of non-Please/void function", Error);
         errors.type_errors.push_back(error);
     }
@@ -939,8 +973,9 @@ void ReturnStatement::typecheck(SymbolTable * symtable, SourceErrors &errors) co
         CompilerError err(loc, "Return statement must be in function", Error);
         errors.type_errors.push_back(err);
 
+        // Still typed, so errors inside the value are reported too
         try {
-            std::unique_ptr<Typename> val_type(val->type_of(symtable));
+            val->type_of(symtable);
         } catch (CompilerError error) {
             errors.type_errors.push_back(error);
         }
@@ -949,7 +984,7 @@ void ReturnStatement::typecheck(SymbolTable * symtable, SourceErrors &errors) co
     }
 
     try {
-        std::unique_ptr<Typename> val_type(val->type_of(symtable));
+        const Typename * val_type = val->type_of(symtable);
         const Typename * ret_type = enclosing_func->ret_type;
 
         if (!val_type->type_equals(ret_type, symtable)) {
@@ -962,21 +997,21 @@ void ReturnStatement::typecheck(SymbolTable * symtable, SourceErrors &errors) co
 }
 
 void Assignment::typecheck(SymbolTable * symtable, SourceErrors &errors) const {
-    std::unique_ptr<Typename> lhs_type(lhs->type_of(symtable));
-    std::unique_ptr<Typename> rhs_type(rhs->type_of(symtable));
+    const Typename * lhs_type = lhs->type_of(symtable);
+    const Typename * rhs_type = rhs->type_of(symtable);
 
     if (lhs_type->get_kind() != MutTypename::kind) {
         throw CompilerError(lhs->loc, "Cannot assign to immutable", Error);
     }
 
     if (rhs_type->get_kind() == MutTypename::kind) {
-        if (!lhs_type->type_equals(rhs_type.get(), symtable)) {
+        if (!lhs_type->type_equals(rhs_type, symtable)) {
             throw CompilerError(loc, "Left hand side and right hand side types must match", Error);
         }
     } else {
-        const MutTypename * lhs_mut = (MutTypename *) lhs_type.get();
+        const MutTypename * lhs_mut = (MutTypename *) lhs_type;
 
-        if (!lhs_mut->name->type_equals(rhs_type.get(), symtable)) {
+        if (!lhs_mut->name->type_equals(rhs_type, symtable)) {
             throw CompilerError(loc, "Left hand side and right hand side types must match", Error);
         }
     }
@@ -1007,9 +1042,9 @@ void VoidReturnStmt::typecheck(SymbolTable * symtable, SourceErrors &errors) con
         return;
     }
 
-    TypeIdent void_type(x::NULL_LOC, "void");
+    const Typename * void_type = interner(symtable)->primitive("void");
 
-    if (!enclosing_func->ret_type->type_equals(&void_type, symtable)) {
+    if (!enclosing_func->ret_type->type_equals(void_type, symtable)) {
         CompilerError err(loc, "Cannot return void from non-Please/void function", Error);
         errors.type_errors.push_back(err);
     }
@@ -1040,9 +1075,9 @@ void PleaseReturnStmt::typecheck(SymbolTable * symtable, SourceErrors &errors) c
         return;
     }
 
-    TypeIdent Please_type(x::NULL_LOC, "Please");
+    const Typename * Please_type = interner(symtable)->primitive("Please");
 
-    if (!enclosing_func->ret_type->type_equals(&Please_type, symtable)) {
+    if (!enclosing_func->ret_type->type_equals(Please_type, symtable)) {
         CompilerError err(loc, "Cannot return void from non-Please/void function", Error);
         errors.type_errors.push_back(err);
     }
@@ -1094,46 +1129,9 @@ void BreakStmt::typecheck(SymbolTable * symtable, SourceErrors &errors) const {
     errors.type_errors.push_back(error);
 }
 
-int ParensTypename::type_size(SymbolTable * symtable) const {
-    return name->type_size(symtable);
-}
-
-int TypeIdent::type_size(SymbolTable * symtable) const {
-    return unaliased(this, symtable)->type_size(symtable);
-}
-
-int PtrTypename::type_size(SymbolTable * symtable) const {
-    return ADDRESS_WIDTH;
-}
-
-int MutTypename::type_size(SymbolTable * symtable) const {
-    return name->type_size(symtable);
-}
-
-int TupleTypename::type_size(SymbolTable * symtable) const {
-    int size = 0;
-
-    for (auto &item : type_list->types) {
-        size += item->type_size(symtable);
-    }
-
-    return size;
-}
-
-int FuncTypename::type_size(SymbolTable * symtable) const {
-    return ADDRESS_WIDTH;
-}
-
-int StaticArrayTypename::type_size(SymbolTable * symtable) const {
-    return element_type->type_size(symtable) * size->value;
-}
-
-int StructTypename::type_size(SymbolTable * symtable) const {
-    int size = 0;
-
-    for (auto &decl : members->decls) {
-        size += decl->type_name->type_size(symtable);
-    }
+int Typename::type_size(SymbolTable * symtable) const {
+    const Layout * layout = interner(symtable)->layout(this, symtable);
 
-    return size;
+    // A struct that contains itself is reported by StructDecl::typecheck
+    return layout != nullptr ? layout->size : 0;
 }
@@ -0,0 +1,251 @@
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "utils.h"
+#include "../src/ast.h"
+#include "../src/parseutils.h"
+
+// Writes down the kinds it sees, and stops or skips at a given kind
+class KindRecorder : public TreeVisitor {
+    public:
+        std::vector<int> pre_kinds;
+        std::vector<int> post_kinds;
+        int stop_at;
+        int skip_at;
+
+        KindRecorder(int stop_at, int skip_at) : pre_kinds({}), post_kinds({}), stop_at(stop_at), skip_at(skip_at) {}
+
+        virtual WalkAction pre(ASTNode * node) {
+            pre_kinds.push_back(node->get_kind());
+
+            if (node->get_kind() == stop_at) {
+                return WalkStop;
+            }
+
+            return node->get_kind() == skip_at ? WalkSkip : WalkContinue;
+        }
+
+        virtual WalkAction post(ASTNode * node) {
+            post_kinds.push_back(node->get_kind());
+
+            return WalkContinue;
+        }
+};
+
+void ast_tests() {
+    xtest::tests["walk runs hooks in order"] = []() {
+        const char * code = R"(
+            int a = 1 + 2.
+            int b = 3.
+        )";
+
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
+        ProgramSource * top = result.parser_state->top;
+
+        KindRecorder all(-1, -1);
+        expect(x::walk(top, all));
+        expect(all.pre_kinds.size() == all.post_kinds.size());
+        expect(all.pre_kinds.front() == ProgramSource::kind);
+        expect(all.post_kinds.back() == ProgramSource::kind);
+
+        // The first literal is 1, which is seen after the math expression that holds
+        // it and left before it
+        KindRecorder stop(IntLiteral::kind, -1);
+        expect(!x::walk(top, stop));
+        expect(stop.pre_kinds.back() == IntLiteral::kind);
+        expect(stop.pre_kinds[stop.pre_kinds.size() - 2] == MathExpr::kind);
+
+        KindRecorder skip(-1, MathExpr::kind);
+        expect(x::walk(top, skip));
+        expect(skip.pre_kinds.size() == all.pre_kinds.size() - 2);
+        expect(skip.post_kinds.size() == skip.pre_kinds.size());
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["each_child matches children"] = []() {
+        const char * code = R"(
+            int f(int x) {
+                return x + 1.
+            }.
+        )";
+
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
+        ASTNode * func = result.parser_state->top->nodes[0];
+        std::vector<ASTNode *> seen;
+
+        expect(func->each_child([&seen](ASTNode * child) {
+            seen.push_back(child);
+            return true;
+        }));
+        expect(seen == func->children());
+
+        // Stops at the first child
+        seen.clear();
+        expect(!func->each_child([&seen](ASTNode * child) {
+            seen.push_back(child);
+            return false;
+        }));
+        expect(seen.size() == 1);
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["dispatch casts to the leaf class"] = []() {
+        Location loc(0, 0);
+        IntLiteral one(loc, 1);
+        Ident ident(loc, "a");
+        TypeIdent type(loc, "int");
+        std::vector<ASTNode *> nodes = {&one, &ident, &type};
+
+        for (auto &node : nodes) {
+            int kind = x::dispatch(node, [](auto * leaf) {
+                return std::remove_pointer_t<decltype(leaf)>::kind;
+            });
+
+            expect(kind == node->get_kind());
+        }
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["equal trees hash the same"] = []() {
+        const char * code = R"(
+            int a = 1 + 2 * 3.
+            int b = 1 + 2 * 3.
+            int c = 1 + 3 * 2.
+            float d = 0.0.
+            float e = -0.0.
+        )";
+
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
+        std::vector<ASTNode *> &nodes = result.parser_state->top->nodes;
+        std::vector<const Expr *> inits;
+
+        for (auto &node : nodes) {
+            inits.push_back(((VarDeclInit *) node)->init);
+        }
+
+        // Locations don't count
+        expect(inits[0]->hash() == inits[1]->hash());
+        expect(*inits[0] == *inits[1]);
+
+        expect(inits[0]->hash() != inits[2]->hash());
+        expect(*inits[0] != *inits[2]);
+
+        expect(inits[3]->hash() == inits[4]->hash());
+        expect(*inits[3] == *inits[4]);
+
+        // Whole declarations differ by name
+        expect(nodes[0]->hash() != nodes[1]->hash());
+        expect(*nodes[0] != *nodes[1]);
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["deep trees don't use the native stack"] = []() {
+        Location loc(0, 0);
+        Expr * a = new IntLiteral(loc, 1);
+        Expr * b = new IntLiteral(loc, 1);
+
+        // Deep enough to run out of stack if anything recursed per level
+        for (int i = 0; i < 200000; i++) {
+            a = new MathExpr(loc, '+', a, new IntLiteral(loc, 1));
+            b = new MathExpr(loc, '+', b, new IntLiteral(loc, i == 0 ? 2 : 1));
+        }
+
+        KindRecorder all(-1, -1);
+        expect(x::walk(a, all));
+        expect(all.pre_kinds.size() == 400001);
+        expect(all.pre_kinds.back() == IntLiteral::kind);
+        expect(*a != *b);
+        expect(*a == *a);
+
+        CompilationContext ctx;
+        SymbolTable * symtable = ctx.default_symtable();
+        TypeIdent int_type(loc, "int");
+        expect(a->type_of(symtable)->type_equals(&int_type, symtable));
+
+        delete symtable;
+        delete a;
+        delete b;
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["dump_tree writes a subtree to a depth"] = []() {
+        const char * code = R"(
+            int a = 1.
+            int f(int x) {
+                return x + 1.
+            }.
+        )";
+
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
+        ProgramSource * top = result.parser_state->top;
+        ASTNode * func = top->nodes[1];
+
+        expect(x::declared_name(func)->id == "f");
+
+        std::ostringstream all;
+        x::tree_dotfile(all, top);
+
+        KindRecorder counter(-1, -1);
+        x::walk(top, counter);
+
+        std::string dot = all.str();
+        size_t labels = 0;
+
+        for (size_t i = dot.find("[label="); i != std::string::npos; i = dot.find("[label=", i + 1)) {
+            labels++;
+        }
+
+        expect(dot.rfind("digraph ExpressionTree {\n", 0) == 0);
+        expect(labels == counter.pre_kinds.size());
+
+        // Just the function and its direct children
+        std::ostringstream json;
+        x::dump_tree(json, func, TreeJson, 1);
+
+        std::string expected = "{\"kind\":\"func_decl\",\"label\":\"func_decl\"";
+        expect(json.str().rfind(expected, 0) == 0);
+        expect(json.str().find("\"label\":\"f\"") != std::string::npos);
+        expect(json.str().find("return_statement") == std::string::npos);
+        expect(json.str().find("\"label\":\"a\"") == std::string::npos);
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["lexer forgets names when scopes close"] = []() {
+        // Each name changes meaning after it is first seen, so a stale token class would
+        // be a syntax error
+        const char * code = R"(
+            int f(int n) {
+                int x = n.
+                return x.
+            }.
+            int x = f(1).
+            int n = x.
+            type Num = int.
+            Num y = n.
+        )";
+
+        for (bool fast : {false, true}) {
+            CompilationContext ctx;
+            ctx.use_fast_lexer = fast;
+            ParseResult result = x::parse_str(ctx, code);
+
+            expect(result.error == 0);
+            expect(result.parser_state->top->nodes.size() == 5);
+            expect(result.parser_state->symtable->get("n")->kind == Var);
+        }
+
+        return TEST_SUCCESS;
+    };
+}
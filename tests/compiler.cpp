@@ -0,0 +1,149 @@
+#include <sstream>
+#include <string>
+
+#include "utils.h"
+#include "../src/compiler.h"
+#include "../src/driver.h"
+#include "../src/thread_pool.h"
+
+void compiler_tests() {
+    xtest::tests["compile_string reuses a context"] = []() {
+        const char * code = R"(
+            int main() {
+                mut int x = 0.
+                x = 2.
+
+                int out = x.
+
+                return out.
+            }.
+        )";
+
+        CompilationContext ctx;
+        CompileOptions options = { "reuse", false };
+
+        CompileOutput first = x::compile_string(ctx, code, options);
+        CompileOutput second = x::compile_string(ctx, code, options);
+
+        expect(first.error == 0);
+        expect(first.diagnostics.empty());
+        expect(!first.assembly.empty());
+
+        // Names start over, so the output doesn't depend on earlier calls
+        expect(second.error == 0);
+        expect(second.assembly == first.assembly);
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["compile_string reports type errors with lines"] = []() {
+        std::string code = "int main() {\n"
+                           "    int x = 0.\n"
+                           "    x = 2.\n"
+                           "    return x.\n"
+                           "}.\n";
+
+        CompilationContext ctx;
+        CompileOptions options = { "errors", false };
+        CompileOutput output = x::compile_string(ctx, code, options);
+
+        expect(output.diagnostics.size() == 1);
+
+        Diagnostic &diag = output.diagnostics[0];
+
+        expect(diag.level == Error);
+        expect(diag.line == 3);
+        expect(diag.col == 5);
+        expect(code.compare(diag.loc.begin, 1, "x") == 0);
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["compile_string keeps going after syntax errors"] = []() {
+        std::string code = "int f() {\n"
+                           "    int x = 1 +.\n"
+                           "    return 0.\n"
+                           "}.\n"
+                           "int y = = 2.\n"
+                           "int z = 3.\n"
+                           "int w = (1.\n";
+
+        CompilationContext ctx;
+        CompileOptions options = { "syntax", false };
+        CompileOutput output = x::compile_string(ctx, code, options);
+
+        expect(output.error == 1);
+        expect(output.diagnostics.size() == 3);
+        expect(output.diagnostics[0].line == 2);
+        expect(output.diagnostics[1].line == 5);
+        expect(output.diagnostics[2].line == 7);
+
+        // Nothing is left behind in the context
+        CompileOutput next = x::compile_string(ctx, "int main() {\n    return 0.\n}.\n", options);
+
+        expect(next.error == 0);
+        expect(next.diagnostics.empty());
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["compile_string reports code it can't generate"] = []() {
+        // examples/hello.x, which the backend can't lower yet. This used to exit
+        std::string code = "void main() {\n"
+                           "    print(\"hello world\").\n"
+                           "}.\n";
+
+        CompilationContext ctx;
+        CompileOptions options = { "hello", false };
+        CompileOutput output = x::compile_string(ctx, code, options);
+
+        expect(output.error == 1);
+        expect(output.assembly.empty());
+        expect(output.diagnostics.size() == 1);
+        expect(output.diagnostics[0].level == Error);
+        expect(output.diagnostics[0].line == 1);
+
+        // Still usable afterwards
+        CompileOutput next = x::compile_string(ctx, "int main() {\n    return 0.\n}.\n", options);
+
+        expect(next.error == 0);
+        expect(!next.assembly.empty());
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["--stream generates the same asm as a full compile"] = []() {
+        std::string code = "int g = 5.\n"
+                           "\n"
+                           "Please f() {\n"
+                           "    int y = 1.\n"
+                           "    mut int z = y.\n"
+                           "    z = 3.\n"
+                           "}.\n"
+                           "\n"
+                           "int main() {\n"
+                           "    mut int x = 1.\n"
+                           "    while (x < 3) {\n"
+                           "        x = x + 1.\n"
+                           "    }.\n"
+                           "    return 0.\n"
+                           "}.\n";
+
+        CompileJob job = {};
+        job.input = "same";
+
+        ThreadPool pool(4);
+        int error = 0;
+        std::ostringstream full;
+        expect(x::compile_buffer(job, SourceBuffer::from_bytes(code.data(), code.size(), &error), full, &pool).error == 0);
+
+        job.streaming = true;
+        std::ostringstream streamed;
+        expect(x::compile_buffer(job, SourceBuffer::from_bytes(code.data(), code.size(), &error), streamed).error == 0);
+
+        expect(!full.str().empty());
+        expect(streamed.str() == full.str());
+
+        return TEST_SUCCESS;
+    };
+}
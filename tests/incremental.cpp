@@ -0,0 +1,66 @@
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "utils.h"
+#include "../src/incremental.h"
+
+static void write_file(const std::string &path, const std::string &text) {
+    std::ofstream fs(path);
+    fs << text;
+}
+
+static std::string read_file(const std::string &path) {
+    std::ifstream fs(path);
+    std::ostringstream out;
+    out << fs.rdbuf();
+
+    return out.str();
+}
+
+void incremental_tests() {
+    xtest::tests["incremental compile redoes only changed declarations"] = []() {
+        char dir[] = "/tmp/xc_incremental_XXXXXX";
+        expect(mkdtemp(dir) != nullptr);
+
+        std::string input = std::string(dir) + "/in.x";
+        std::string output = std::string(dir) + "/in.s";
+        std::string fresh = std::string(dir) + "/fresh.s";
+
+        std::string code = "Please f() {\n"
+                           "    int y = 1.\n"
+                           "}.\n"
+                           "\n"
+                           "int main() {\n"
+                           "    int x = 1.\n"
+                           "    return 0.\n"
+                           "}.\n";
+
+        CompileJob job = { input, output, "" };
+        IncrementalCompiler compiler(job);
+
+        write_file(input, code);
+        expect(compiler.compile().error == 0);
+        expect(compiler.units == 2 && compiler.reused == 0);
+
+        code.replace(code.find("y = 1"), 5, "y = 2");
+        write_file(input, code);
+        expect(compiler.compile().error == 0);
+        expect(compiler.units == 2 && compiler.reused == 1);
+
+        // Has to match what a full compile makes
+        CompileJob full = { input, fresh, "" };
+        expect(x::compile(full).error == 0);
+        expect(read_file(output) == read_file(fresh));
+
+        unlink(input.c_str());
+        unlink(output.c_str());
+        unlink(fresh.c_str());
+        rmdir(dir);
+
+        return TEST_SUCCESS;
+    };
+}
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "utils.h"
 #include "../src/ast.h"
@@ -15,12 +16,13 @@ void parser_tests() {
             }.
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         ProgramSource * output = result.parser_state->top;
 
         // This symbol table is not accurate; we are only testing syntax here though
-        SymbolTable * test_symtable = x::default_symtable();
-        Location loc(0, 0, 0, 0);
+        SymbolTable * test_symtable = ctx.default_symtable();
+        Location loc(0, 0);
         Ident * Point = new Ident(loc, "Point");
         VarDecl * x = new VarDecl(loc, new TypeIdent(loc, "int"), new Ident(loc, "x"));
         VarDecl * y = new VarDecl(loc, new TypeIdent(loc, "int"), new Ident(loc, "y"));
@@ -43,23 +45,27 @@ void parser_tests() {
 
     xtest::tests["string literal declaration"] = []() {
         const char * code = R"(
-            string a = "abc\n" + "".
-            string b = "^$&Q*!)LL ".
+            char* a = "abc\n" + "".
+            char* b = "^$&Q*!)LL ".
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         ProgramSource * output = result.parser_state->top;
-        Location loc(0, 0, 0, 0);
+        Location loc(0, 0);
 
-        StringLiteral *stringA = new StringLiteral(loc, std::string("abc\n" + std::string("")).c_str());
+        expect(result.error == 0);
+        expect(output->nodes.size() == 2);
+
+        // Escapes are kept as they were written
+        StringLiteral *stringA = new StringLiteral(loc, "abc\\n");
         StringLiteral *stringB = new StringLiteral(loc, "^$&Q*!)LL ");
         StringLiteral *parsed_stringA = (StringLiteral *)output->find([](const ASTNode * node) {
             return node->get_kind() == StringLiteral::kind;
         });
-        StringLiteral *parsed_stringB = (StringLiteral *)output->find([](const ASTNode * node) {
-            return node->get_kind() == StringLiteral::kind;
-        });
+        const Expr *parsed_stringB = ((VarDeclInit *) output->nodes[1])->init;
 
+        expect(parsed_stringB->get_kind() == StringLiteral::kind);
         expect(*stringA == *parsed_stringA);
         expect(*stringB == *parsed_stringB);
 
@@ -71,93 +77,97 @@ void parser_tests() {
 
     xtest::tests["New Struct"] = []() {
         const char * code = R"(
-            struct dimension {
+            struct Dimension {
                 float width.
                 float height.
-            };
+            }.
             struct Shape {
-                struct dimension area.
-                string type.
-            };
-
-            int main(int argc) {
-                mut struct Shape circle = new struct Shape.
-                circle.type = "circle".
-                circle.dimension.width = 5.
-            }
+                Dimension area.
+                char* name.
+            }.
+
+            int main() {
+                mut Shape circle = {area: {width: 5.0, height: 5.0}, name: "circle"}.
+                circle.name = "square".
+                return 0.
+            }.
         )";
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         ProgramSource * output = result.parser_state->top;
 
-        //expect
+        expect(result.error == 0);
+        expect(output->nodes.size() == 3);
+        expect(output->find([](const ASTNode * node) {
+            return node->get_kind() == StructLiteral::kind;
+        }) != nullptr);
+        expect(output->find([](const ASTNode * node) {
+            return node->get_kind() == StructDeref::kind;
+        }) != nullptr);
+
         return TEST_SUCCESS;
     };
 
     xtest::tests["Nested While"] = []() {
         const char * code = R"(
             int main() {
-                mut int a.
-                mut int b.
-                mut int res.
-                a = 1.
-                b = 1.
-                res = 0.
-                while(a<15) {
-                    while(b<15) {
+                mut int a = 1.
+                mut int b = 1.
+                mut int res = 0.
+                while (a < 15) {
+                    while (b < 15) {
                         res = res + b.
-                        b = b+1.
-                    }
-                    a = a+1.
-                }
-            }
+                        b = b + 1.
+                    }.
+                    a = a + 1.
+                }.
+                return res.
+            }.
         )";
 
-        /*ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         ProgramSource * output = result.parser_state->top;
 
-        const std::string expected_parse = R"(
-            int main() {
-                    mut int a.
-                    mut int b.
-                    mut int res.
-                    a = 1.
-                    b = 1.
-                    res = 0.
-                    while (a < 15) {
-                            while (b < 15) {
-                                    res = res + b.
-                                    b = b + 1.
-                            }
-                            a = a + 1.
-                    }
-            }
-        )";
-        expect(output == expected_parse);*/
+        expect(result.error == 0);
+
+        const FuncDecl * main = (FuncDecl *) output->nodes[0];
+        const Statement * outer = main->body->statements[3];
+        expect(outer->get_kind() == WhileStmt::kind);
+
+        const StatementList * outer_body = ((WhileStmt *) outer)->body;
+        expect(outer_body->statements.size() == 2);
+        expect(outer_body->statements[0]->get_kind() == WhileStmt::kind);
+        expect(((WhileStmt *) outer_body->statements[0])->body->statements.size() == 2);
 
         return TEST_SUCCESS;
     };
 
-    xtest::tests["(Expected fail) No return, immutable variable"] = []() {
+    xtest::tests["(Expected fail) immutable variable"] = []() {
         const char * code = R"(
             int main() {
                 int x = 0.
                 x = 2.
-            }
+                return x.
+            }.
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         ProgramSource * output = result.parser_state->top;
-        SourceErrors &errors = report.sources[output];
-        CompilerError err = errors[0];
-        CompilerError err2 = errors[1];
+        SourceErrors &errors = result.parser_state->errors.sources[output];
+
+        expect(result.error == 0);
+        output->typecheck(result.parser_state->symtable, errors);
 
         expect(errors.has_errors());
         expect(errors.error_count() == 1);
-        expect(errors.type_errors.size() == 2);
+        expect(errors.type_errors.size() == 1);
+
+        CompilerError err = errors.type_errors[0];
+
         expect(err.level == Error);
-        expect(err2.level == Error);
         expect(err.message == "Cannot assign to immutable");
-        expect(err2.message = "No return");
 
         return TEST_SUCCESS;
     };
@@ -167,49 +177,50 @@ void parser_tests() {
             int main() {
                 mut int x = 0.
                 x = x + 1.
-                if (!x) {
+                if (x == 1) {
                     return 1.
                 return 0.
-            }
+            }.
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         ProgramSource * output = result.parser_state->top;
-        SourceErrors &errors = report.sources[output];
-        CompilerError err = errors[0];
+        SourceErrors &errors = result.parser_state->errors.sources[output];
 
-        expect(errors.has_errors());
-        expect(errors.error_count() == 1);
-        expect(errors.type_errors.size() == 1);
-        expect(err.level == Error);
-        expect(err.message == "Missing curly brace");
+        // The last brace closes the if, so the function runs into the end of the file
+        expect(result.error != 0);
+        expect(errors.parse_errors.size() == 1);
+        expect(errors.parse_errors[0].level == Error);
+        expect(errors.parse_errors[0].loc.begin > strstr(code, "}.") - code);
+
+        return TEST_SUCCESS;
     };
 
     xtest::tests["(Expected Fail) Missing comma"] = []() {
         const char * code = R"(
             int difference(int lower int upper) {
-                    return upper - lower.
-            }
+                return upper - lower.
+            }.
 
             int main() {
-                int lower = 5.
-                int upper = 10.
-                int diff = difference.
-                print(diff).
                 return 0.
-            }
+            }.
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         ProgramSource * output = result.parser_state->top;
-        SourceErrors &errors = report.sources[output];
-        CompilerError err = errors[0];
+        SourceErrors &errors = result.parser_state->errors.sources[output];
 
-        expect(errors.has_errors());
-        expect(errors.error_count() == 1);
-        expect(errors.type_errors.size() == 1);
-        expect(err.level == Error);
-        expect(err.message == "Missing comma");
+        // Recovery skips to the end of the first statement, so the function's closing
+        // brace is an error too
+        expect(result.error != 0);
+        expect(errors.parse_errors.size() == 2);
+        expect(errors.parse_errors[0].level == Error);
+        expect(strncmp(code + errors.parse_errors[0].loc.begin, "int upper", 9) == 0);
+
+        return TEST_SUCCESS;
     };
 
     xtest::tests["(Expected Fail) Missing parenthesis"] = []() {
@@ -217,76 +228,51 @@ void parser_tests() {
             int main() {
                 print("Hello World").
                 int x = 5 * (4 + 6.
-                print(x).
                 return 0.
-            }
+            }.
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         ProgramSource * output = result.parser_state->top;
-        SourceErrors &errors = report.sources[output];
-        CompilerError err = errors[0];
+        SourceErrors &errors = result.parser_state->errors.sources[output];
 
-        expect(errors.has_errors());
-        expect(errors.error_count() == 1);
-        expect(errors.type_errors.size() == 1);
-        expect(err.level == Error);
-        expect(err.message == "Missing parenthesis");
-   `};
+        expect(result.error != 0);
+        expect(errors.parse_errors.size() == 1);
+        expect(errors.parse_errors[0].level == Error);
+        expect(strncmp(code + errors.parse_errors[0].loc.begin, ".\n", 2) == 0);
+
+        return TEST_SUCCESS;
+    };
 
     xtest::tests["Array test"] = []() {
         const char * code = R"(
             int main() {
-                mut int [5] arr = {0, 1, 2, 3, 4}.
-                int x = arr[2].
+                mut int[5] arr = {0, 1, 2, 3, 4}.
+                int x = arr[3].
                 arr[2] = 3.
-                return 0.
-            }
+                return x.
+            }.
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         ProgramSource * output = result.parser_state->top;
-        SourceErrors &errors = report.sources[output];
-        SymbolTable * test_symtable = x::default_symtable();
-
-        for (auto& out : output->children()) {
-            if (out->get_kind() == VarDeclInit::kind) {
-                VarDeclInit * vardecl = (VarDeclInit*) out;
-                ArrayIndexExpr * rhs = (ArrayIndexExpr *) vardecl->init;
-                const Expr * index = rhs->index;
-                IntLiteral * index_as_int = (IntLiteral *) index;
-                expect(index_as_int->value == 3);
-                expect(rhs->type_equals(new TypeIdent(x::NULL_LOC, "float"));
-            }
-            if (out->get_kind() == Assignment::kind) {
-                Assignment * assign = (Assignment*) out;
-                ArrayIndexExpr * lhs = (ArrayIndexExpr *) assign->init;
-                const Expr * index = lhs->index;
-                IntLiteral * index_as_int = (IntLiteral *) index;
-                expect(index_as_int->value == 2);
-                expect(assign->type_check(test_symtable, &errors));
-            }
-        }
-    };
 
-    xtest::tests["Arrays test"] = []() {
-        const char * code = R"(
-            int main() {
-                mut ints arr.
-                arr[2] = 3.
-            }
-        )";
-        /*ParseResult result = x::parse_str(code);
-        ProgramSource * output = result.parser_state->top;
+        expect(result.error == 0);
 
-        const std::string expected_parse = R"(
-            int main() {
-                    mut ints arr.
-                    arr[2] = 3.
-            }
-        )";
+        const FuncDecl * main = (FuncDecl *) output->nodes[0];
+        const std::vector<Statement *> &statements = main->body->statements;
+
+        expect(statements[1]->get_kind() == VarDeclInit::kind);
+        const Expr * rhs = ((VarDeclInit *) statements[1])->init;
+        expect(rhs->get_kind() == ArrayIndexExpr::kind);
+        expect(((IntLiteral *) ((ArrayIndexExpr *) rhs)->index)->value == 3);
 
-        expect(huh == expected_parse);*/
+        expect(statements[2]->get_kind() == Assignment::kind);
+        const Expr * lhs = ((Assignment *) statements[2])->lhs;
+        expect(lhs->get_kind() == ArrayIndexExpr::kind);
+        expect(((IntLiteral *) ((ArrayIndexExpr *) lhs)->index)->value == 2);
 
         return TEST_SUCCESS;
     };
@@ -295,31 +281,29 @@ void parser_tests() {
         const char * code = R"(
             int main() {
                 mut int count = 0.
-                for (int i = 1. i < 6. i++) {
-                    for int j = 1. j < 5. j++) {
-                        if (j % 2 == 0) {
-                            continue.
-                        }
-                        count++.
-                    }
+                for (mut int i = 1; i < 6; i = i + 1) {
                     if (i % 3 == 0) {
                         continue.
-                    }
-                    count++.
-                }
-                return 0.
-            }
+                    }.
+                    count = count + 1.
+                }.
+                return count.
+            }.
         )";
-        ParseResult result = x::parse_str(code);
-        for (auto& out : output->children()) {
-            if (out->get_kind() == VarDeclInit::kind) {
-                VarDeclInit * vardecl = (VarDeclInit*) out;
-                ArrayIndexExpr * rhs = (ArrayIndexExpr *) vardecl->init;
-                const Expr * index = rhs->index;
-                IntLiteral * index_as_int = (IntLiteral *) index;
-                expect(index_as_int->value == 3);
-            }
-        }
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
+        ProgramSource * output = result.parser_state->top;
+
+        expect(result.error == 0);
+
+        const FuncDecl * main = (FuncDecl *) output->nodes[0];
+        const Statement * loop = main->body->statements[1];
+        expect(loop->get_kind() == ForStmt::kind);
+
+        const Statement * branch = ((ForStmt *) loop)->body->statements[0];
+        expect(branch->get_kind() == IfStmt::kind);
+        expect(((IfStmt *) branch)->then->statements[0]->get_kind() == ContinueStmt::kind);
+
         return TEST_SUCCESS;
     };
 }
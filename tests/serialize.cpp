@@ -0,0 +1,172 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "utils.h"
+#include "../src/ast_file.h"
+#include "../src/parseutils.h"
+#include "../src/serialize.h"
+
+void serialize_tests() {
+    xtest::tests["prelude blob round trip"] = []() {
+        CompilationContext ctx(x::bare_symtable());
+        ParseResult result = x::parse_builtins(ctx);
+        SymbolTable * parsed = result.parser_state->symtable;
+        std::string blob;
+
+        expect(x::serialize_symtable(parsed, 42, blob));
+
+        std::vector<ASTNode *> decls;
+        SymbolTable * loaded = x::deserialize_symtable((const unsigned char *) blob.data(), blob.size(), 42, decls);
+
+        expect(loaded != nullptr);
+        expect(loaded->table.size() == parsed->table.size());
+
+        for (auto &item : parsed->table) {
+            Symbol * sym = loaded->get(item.first);
+
+            expect(sym != nullptr);
+            expect(sym->kind == item.second->kind);
+
+            if (sym->kind == Func) {
+                const FuncDecl * expected = item.second->decl.func;
+                const FuncDecl * actual = sym->decl.func;
+
+                expect(*actual->name == *expected->name);
+                expect(*actual->params == *expected->params);
+                expect(*actual->ret_type == *expected->ret_type);
+                expect(actual->loc.begin == expected->loc.begin && actual->loc.end == expected->loc.end);
+            }
+        }
+
+        for (auto &decl : decls) {
+            delete decl;
+        }
+
+        delete loaded;
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["stale or damaged prelude blob is rejected"] = []() {
+        CompilationContext ctx(x::bare_symtable());
+        ParseResult result = x::parse_builtins(ctx);
+        std::string blob;
+        std::vector<ASTNode *> decls;
+
+        expect(x::serialize_symtable(result.parser_state->symtable, 42, blob));
+
+        const unsigned char * data = (const unsigned char *) blob.data();
+
+        expect(x::deserialize_symtable(data, blob.size(), 43, decls) == nullptr);
+        expect(x::deserialize_symtable(data, blob.size() - 1, 42, decls) == nullptr);
+        expect(decls.empty());
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["AST file round trip"] = []() {
+        const char * code = R"(
+            int f(int x) {
+                return x + 1.
+            }.
+            int a = f(2).
+            char * s = "hi".
+        )";
+
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
+        ProgramSource * top = result.parser_state->top;
+        SourceErrors errors;
+
+        top->typecheck(result.parser_state->symtable, errors);
+        expect(errors.type_errors.empty());
+
+        std::string bytes;
+        x::write_ast(top, 42, bytes);
+
+        int error = 0;
+        AstFile * file = AstFile::from_bytes((const unsigned char *) bytes.data(), bytes.size(), &error);
+
+        expect(file != nullptr);
+        expect(file->header().source_hash == 42);
+        expect(file->node(file->root()).kind == ProgramSource::kind);
+        expect(file->node(file->root()).child_count == top->nodes.size());
+
+        std::unordered_set<std::string_view> idents;
+        bool typed = false;
+
+        for (uint32_t i = 0; i < file->size(); i++) {
+            const AstFileNode &node = file->node(i);
+
+            if (node.kind == Ident::kind) {
+                idents.insert(file->text(i));
+            } else if (node.kind == StringLiteral::kind) {
+                expect(file->text(i) == "hi");
+            } else if (node.kind == MathExpr::kind) {
+                expect(node.value == '+');
+                expect(node.type != AST_FILE_NONE);
+                expect(file->node(node.type).kind == TypeIdent::kind);
+                expect(file->text(node.type) == "int");
+                typed = true;
+            }
+        }
+
+        expect(typed);
+        expect(idents.count("f") == 1 && idents.count("x") == 1 && idents.count("a") == 1);
+
+        delete file;
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["damaged AST file is rejected"] = []() {
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, "int a = 1 + 2.\n");
+        std::string bytes;
+        int error = 0;
+
+        x::write_ast(result.parser_state->top, 0, bytes);
+
+        char dir[] = "/tmp/xc_ast_file_XXXXXX";
+        expect(mkdtemp(dir) != nullptr);
+        std::string path = std::string(dir) + "/prog.ast";
+
+        std::ofstream(path, std::ios::binary) << bytes;
+        AstFile * file = AstFile::open(path.c_str(), &error);
+        expect(file != nullptr);
+        expect(file->node(file->root()).kind == ProgramSource::kind);
+        delete file;
+
+        // Cut short
+        std::ofstream(path, std::ios::binary) << bytes.substr(0, bytes.size() - 1);
+        expect(AstFile::open(path.c_str(), &error) == nullptr);
+        expect(error == EINVAL);
+
+        unlink(path.c_str());
+        rmdir(dir);
+
+        expect(AstFile::open(path.c_str(), &error) == nullptr);
+        expect(error == ENOENT);
+
+        // A child that points forward, which could make a cycle
+        AstFileHeader head;
+        memcpy(&head, bytes.data(), sizeof(head));
+        size_t children = sizeof(AstFileHeader) + head.node_count * sizeof(AstFileNode);
+        std::string damaged = bytes;
+        uint32_t forward = head.root;
+        memcpy(&damaged[children], &forward, sizeof(forward));
+
+        error = 0;
+        expect(AstFile::from_bytes((const unsigned char *) damaged.data(), damaged.size(), &error) == nullptr);
+        expect(error == EINVAL);
+
+        return TEST_SUCCESS;
+    };
+}
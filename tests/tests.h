@@ -1,14 +1,24 @@
 #ifndef TESTS_TESTS_H
 #define TESTS_TESTS_H
 
-#define NUM_THREADS 1 
+#define NUM_THREADS 4
 
 void parser_tests();
 void typechecker_tests();
+void thread_pool_tests();
+void serialize_tests();
+void compiler_tests();
+void incremental_tests();
+void ast_tests();
 
 void setup_tests() {
     parser_tests();
     typechecker_tests();
+    thread_pool_tests();
+    serialize_tests();
+    compiler_tests();
+    incremental_tests();
+    ast_tests();
 }
 
 #endif
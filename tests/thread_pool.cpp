@@ -0,0 +1,69 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "utils.h"
+#include "../src/bounded_queue.h"
+#include "../src/thread_pool.h"
+
+void thread_pool_tests() {
+    xtest::tests["parallel_for runs every index once"] = []() {
+        ThreadPool pool(4);
+        std::vector<std::atomic<int>> counts(1000);
+
+        pool.parallel_for(counts.size(), [&counts](size_t i) {
+            counts[i]++;
+        });
+
+        for (auto &count : counts) {
+            expect(count == 1);
+        }
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["nested parallel_for"] = []() {
+        ThreadPool pool(2);
+        std::atomic<int> total(0);
+
+        // Every worker ends up waiting inside a task, which only works if waiting
+        // threads run tasks themselves
+        pool.parallel_for(8, [&pool, &total](size_t i) {
+            pool.parallel_for(8, [&total](size_t j) {
+                total++;
+            });
+        });
+
+        expect(total == 64);
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["bounded queue keeps order"] = []() {
+        BoundedQueue<int> queue(2);
+
+        std::thread producer([&queue]() {
+            for (int i = 0; i < 100; i++) {
+                queue.push(i);
+            }
+
+            queue.close();
+        });
+
+        std::vector<int> items;
+        int item;
+
+        while (queue.pop(item)) {
+            items.push_back(item);
+        }
+
+        producer.join();
+        expect(items.size() == 100);
+
+        for (int i = 0; i < 100; i++) {
+            expect(items[i] == i);
+        }
+
+        return TEST_SUCCESS;
+    };
+}
@@ -5,6 +5,8 @@
 #include "../src/errors.h"
 #include "../src/parseutils.h"
 #include "../src/symtable.h"
+#include "../src/thread_pool.h"
+#include "../src/type_interner.h"
 
 void typechecker_tests() {
     xtest::tests["simple type alias equality"] = []() {
@@ -16,9 +18,10 @@ void typechecker_tests() {
             type W = float.
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         SymbolTable * symtable = result.parser_state->symtable;
-        Location loc(0, 0, 0, 0);
+        Location loc(0, 0);
 
         TypeIdent x(loc, "X");
         TypeIdent y(loc, "Y");
@@ -58,9 +61,10 @@ void typechecker_tests() {
             type Func3 = [int, int, float] -> float.
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         SymbolTable * symtable = result.parser_state->symtable;
-        Location loc(0, 0, 0, 0);
+        Location loc(0, 0);
 
         TypeIdent arr1(loc, "Arr1");
         TypeIdent arr2(loc, "Arr2");
@@ -108,9 +112,10 @@ void typechecker_tests() {
             }.
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         SymbolTable * symtable = result.parser_state->symtable;
-        Location loc(0, 0, 0, 0);
+        Location loc(0, 0);
 
         TypeIdent strukt1(loc, "Strukt1");
         TypeIdent strukt2(loc, "Strukt2");
@@ -135,9 +140,10 @@ void typechecker_tests() {
             type Y = mut int*.
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         SymbolTable * symtable = result.parser_state->symtable;
-        Location loc(0, 0, 0, 0);
+        Location loc(0, 0);
 
         PtrTypename * x = new PtrTypename(loc, new MutTypename(loc, new TypeIdent(loc, "int")));
         MutTypename * y = new MutTypename(loc, new PtrTypename(loc, new TypeIdent(loc, "int")));
@@ -179,7 +185,8 @@ void typechecker_tests() {
             int[5] y = {1, 2, 3 + 4, r, 6 % 7}. @4
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         SymbolTable * symtable = result.parser_state->symtable;
         VarDeclInit * r_decl = (VarDeclInit *) result.parser_state->debug_stmts[1];
         VarDeclInit * w_decl = (VarDeclInit *) result.parser_state->debug_stmts[2];
@@ -191,13 +198,13 @@ void typechecker_tests() {
         TypeIdent bool_type(x::NULL_LOC, "bool");
 
         try {
-            std::unique_ptr<Typename> r_type(r_decl->init->type_of(symtable));
-            std::unique_ptr<Typename> w_type(w_decl->init->type_of(symtable));
+            const Typename * r_type = r_decl->init->type_of(symtable);
+            const Typename * w_type = w_decl->init->type_of(symtable);
 
             expect(r_type->type_equals(&int_type, symtable));
             expect(w_type->type_equals(&float_type, symtable));
-            expect(int_type.type_equals(r_type.get(), symtable));
-            expect(float_type.type_equals(w_type.get(), symtable));
+            expect(int_type.type_equals(r_type, symtable));
+            expect(float_type.type_equals(w_type, symtable));
 
             expect(!r_type->type_equals(&float_type, symtable));
             expect(!w_type->type_equals(&int_type, symtable));
@@ -207,10 +214,10 @@ void typechecker_tests() {
         }
 
         try {
-            std::unique_ptr<Typename> x_type(x_decl->init->type_of(symtable));
+            const Typename * x_type = x_decl->init->type_of(symtable);
 
             expect(x_type->type_equals(&bool_type, symtable));
-            expect(bool_type.type_equals(x_type.get(), symtable));
+            expect(bool_type.type_equals(x_type, symtable));
 
             expect(!x_type->type_equals(&int_type, symtable));
             expect(!x_type->type_equals(&float_type, symtable));
@@ -220,7 +227,7 @@ void typechecker_tests() {
         }
 
         try {
-            std::unique_ptr<Typename> y_type(y_decl->init->type_of(symtable));
+            const Typename * y_type = y_decl->init->type_of(symtable);
             std::unique_ptr<StaticArrayTypename> y_decl_type(new StaticArrayTypename(x::NULL_LOC, new TypeIdent(x::NULL_LOC, "int"),
                     new IntLiteral(x::NULL_LOC, 5)));
 
@@ -250,7 +257,8 @@ void typechecker_tests() {
             (mut int)* v = 0 as (mut int)*.     @7
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         SymbolTable * symtable = result.parser_state->symtable;
         VarDeclInit * p_decl = (VarDeclInit *) result.parser_state->debug_stmts[1];
         VarDeclInit * q_decl = (VarDeclInit *) result.parser_state->debug_stmts[2];
@@ -261,13 +269,13 @@ void typechecker_tests() {
         VarDeclInit * v_decl = (VarDeclInit *) result.parser_state->debug_stmts[7];
 
         try {
-            std::unique_ptr<Typename> p_type(p_decl->init->type_of(symtable));
-            std::unique_ptr<Typename> q_type(q_decl->init->type_of(symtable));
-            std::unique_ptr<Typename> r_type(r_decl->init->type_of(symtable));
-            std::unique_ptr<Typename> s_type(s_decl->init->type_of(symtable));
-            std::unique_ptr<Typename> t_type(t_decl->init->type_of(symtable));
-            std::unique_ptr<Typename> u_type(u_decl->init->type_of(symtable));
-            std::unique_ptr<Typename> v_type(v_decl->init->type_of(symtable));
+            const Typename * p_type = p_decl->init->type_of(symtable);
+            const Typename * q_type = q_decl->init->type_of(symtable);
+            const Typename * r_type = r_decl->init->type_of(symtable);
+            const Typename * s_type = s_decl->init->type_of(symtable);
+            const Typename * t_type = t_decl->init->type_of(symtable);
+            const Typename * u_type = u_decl->init->type_of(symtable);
+            const Typename * v_type = v_decl->init->type_of(symtable);
 
             expect(p_type->type_equals(p_decl->decl->type_name, symtable));
             expect(q_type->type_equals(q_decl->decl->type_name, symtable));
@@ -299,7 +307,8 @@ void typechecker_tests() {
             [int] -> float s = func1 as [int] -> float.     @4
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         SymbolTable * symtable = result.parser_state->symtable;
         VarDeclInit * p_decl = (VarDeclInit *) result.parser_state->debug_stmts[1];
         VarDeclInit * q_decl = (VarDeclInit *) result.parser_state->debug_stmts[2];
@@ -307,7 +316,7 @@ void typechecker_tests() {
         VarDeclInit * s_decl = (VarDeclInit *) result.parser_state->debug_stmts[4];
 
         try {
-            std::unique_ptr<Typename> p_type(p_decl->init->type_of(symtable));
+            p_decl->init->type_of(symtable);
 
             fail_test();
         } catch (CompilerError error) {
@@ -315,7 +324,7 @@ void typechecker_tests() {
         }
 
         try {
-            std::unique_ptr<Typename> q_type(q_decl->init->type_of(symtable));
+            q_decl->init->type_of(symtable);
 
             fail_test();
         } catch (CompilerError error) {
@@ -323,7 +332,7 @@ void typechecker_tests() {
         }
 
         try {
-            std::unique_ptr<Typename> r_type(r_decl->init->type_of(symtable));
+            r_decl->init->type_of(symtable);
 
             fail_test();
         } catch (CompilerError error) {
@@ -331,7 +340,7 @@ void typechecker_tests() {
         }
 
         try {
-            std::unique_ptr<Typename> s_type(s_decl->init->type_of(symtable));
+            s_decl->init->type_of(symtable);
 
             fail_test()
         } catch (CompilerError error) {
@@ -387,7 +396,8 @@ void typechecker_tests() {
             }.
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         SymbolTable * symtable = result.parser_state->symtable;
         ProgramSource * top = result.parser_state->top;
         ErrorReport &report = result.parser_state->errors;
@@ -414,7 +424,8 @@ void typechecker_tests() {
             }.
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         SymbolTable * symtable = result.parser_state->symtable;
         ProgramSource * top = result.parser_state->top;
         ErrorReport &report = result.parser_state->errors;
@@ -447,7 +458,8 @@ void typechecker_tests() {
             }.
         )";
 
-        ParseResult result = x::parse_str(code);
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
         SymbolTable * symtable = result.parser_state->symtable;
         ProgramSource * top = result.parser_state->top;
         ErrorReport &report = result.parser_state->errors;
@@ -459,4 +471,266 @@ void typechecker_tests() {
 
         return TEST_SUCCESS;
     };
+
+    xtest::tests["expression types are interned"] = []() {
+        const char * code = R"(
+            int a = (1 + 2).
+            int b = a.
+            float c = 1.5.
+        )";
+
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
+        SymbolTable * symtable = result.parser_state->symtable;
+        std::vector<ASTNode *> &nodes = result.parser_state->top->nodes;
+
+        expect(nodes.size() == 3);
+
+        const Expr * a_init = ((VarDeclInit *) nodes[0])->init;
+        const Expr * b_init = ((VarDeclInit *) nodes[1])->init;
+        const Expr * c_init = ((VarDeclInit *) nodes[2])->init;
+
+        try {
+            const Typename * a_type = a_init->type_of(symtable);
+
+            // Kept on the node, and shared by every expression of the same type
+            expect(a_init->type_of(symtable) == a_type);
+            expect(b_init->type_of(symtable) == a_type);
+            expect(c_init->type_of(symtable) != a_type);
+            expect(ctx.types->primitive("int") == a_type);
+        } catch (CompilerError error) {
+            error.print(stderr);
+            fail_test();
+        }
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["type names in the source are shared"] = []() {
+        const char * code = R"(
+            int * a.
+            int * b.
+            int c.
+            struct S {
+                int * d.
+            }.
+        )";
+
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
+        std::vector<ASTNode *> &nodes = result.parser_state->top->nodes;
+
+        expect(nodes.size() == 4);
+
+        const Typename * a_type = ((VarDecl *) nodes[0])->type_name;
+        const Typename * b_type = ((VarDecl *) nodes[1])->type_name;
+        const Typename * c_type = ((VarDecl *) nodes[2])->type_name;
+        const StructTypename * s_type = ((StructDecl *) nodes[3])->defn;
+
+        // One copy of 'int *', which is built on the same 'int' as the rest
+        expect(a_type->is_shared());
+        expect(a_type == b_type);
+        expect(((PtrTypename *) a_type)->name == c_type);
+        expect(s_type->members->decls[0]->type_name == a_type);
+        expect(ctx.types->primitive("int") == c_type);
+
+        // Structs own their scope, so they are never shared
+        expect(!s_type->is_shared());
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["aliases share canonical type ids"] = []() {
+        const char * code = R"(
+            type X = int.
+            type P = X*.
+            type Q = (P)*.
+        )";
+
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
+        SymbolTable * symtable = result.parser_state->symtable;
+        TypeInterner * types = ctx.types.get();
+        Location loc(0, 0);
+
+        TypeIdent x(loc, "X");
+        TypeIdent i(loc, "int");
+        TypeIdent r(loc, "Q");
+        TypeIdent f(loc, "float");
+        PtrTypename p(loc, new TypeIdent(loc, "P"));
+        PtrTypename q(loc, new PtrTypename(loc, new TypeIdent(loc, "int")));
+        MutTypename m(loc, new TypeIdent(loc, "int"));
+
+        expect(types->id(&x, symtable) == types->id(&i, symtable));
+        expect(types->id(&p, symtable) == types->id(&q, symtable));
+        expect(types->id(&r, symtable) == types->id(&p, symtable));
+        expect(types->id(&m, symtable) != types->id(&i, symtable));
+        expect(types->id(&f, symtable) != types->id(&i, symtable));
+
+        // Casts are kept by ID, so the alias gets the answer worked out for int
+        bool allowed = false;
+
+        expect(i.can_cast_to(&f, symtable));
+        expect(types->find_cast(types->id(&x, symtable), types->id(&f, symtable), &allowed));
+        expect(allowed);
+        expect(!f.can_cast_to(&x, symtable));
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["struct layouts are aligned"] = []() {
+        const char * code = R"(
+            struct S {
+                bool a.
+                int b.
+                char c.
+            }.
+            struct T packed {
+                bool a.
+                int b.
+                char c.
+            }.
+            type U = S.
+        )";
+
+        CompilationContext plain_ctx;
+        CompilationContext reorder_ctx;
+        reorder_ctx.set_reorder_fields(true);
+
+        ParseResult plain = x::parse_str(plain_ctx, code);
+        ParseResult reorder = x::parse_str(reorder_ctx, code);
+        SymbolTable * plain_symtable = plain.parser_state->symtable;
+        SymbolTable * reorder_symtable = reorder.parser_state->symtable;
+        Location loc(0, 0);
+
+        TypeIdent s(loc, "S");
+        TypeIdent t(loc, "T");
+        TypeIdent u(loc, "U");
+        TupleTypename tuple(loc, new TypenameList(loc, {new TypeIdent(loc, "char"), new TypeIdent(loc, "int")}));
+
+        const Layout * layout = plain_ctx.types->layout(&s, plain_symtable);
+        expect(layout->size == 24 && layout->align == 8);
+        expect(layout->offsets == std::vector<int>({0, 8, 16}));
+
+        // Kept by canonical ID, so the alias gets the same one
+        expect(plain_ctx.types->layout(&u, plain_symtable) == layout);
+        expect(!s.type_equals(&t, plain_symtable));
+
+        layout = plain_ctx.types->layout(&t, plain_symtable);
+        expect(layout->size == 10 && layout->align == 1);
+        expect(layout->offsets == std::vector<int>({0, 1, 9}));
+
+        layout = plain_ctx.types->layout(&tuple, plain_symtable);
+        expect(layout->size == 16 && layout->offsets == std::vector<int>({0, 8}));
+
+        // The int goes first, and the offsets stay in declaration order
+        layout = reorder_ctx.types->layout(&s, reorder_symtable);
+        expect(layout->size == 16 && layout->align == 8);
+        expect(layout->offsets == std::vector<int>({8, 0, 9}));
+
+        layout = reorder_ctx.types->layout(&t, reorder_symtable);
+        expect(layout->size == 10);
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["packed is still a name outside struct declarations"] = []() {
+        const char * code = R"(
+            struct P {
+                int packed.
+            }.
+            int packed = 1.
+            struct S packed {
+                bool a.
+                int b.
+            }.
+            int f() {
+                return packed.
+            }.
+        )";
+
+        for (bool fast : {false, true}) {
+            CompilationContext ctx;
+            ctx.use_fast_lexer = fast;
+
+            ParseResult result = x::parse_str(ctx, code);
+            expect(result.error == 0);
+
+            TypeIdent s(x::NULL_LOC, "S");
+            const Layout * layout = ctx.types->layout(&s, result.parser_state->symtable);
+            expect(layout->size == 9 && layout->align == 1);
+        }
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["struct that contains itself is an error"] = []() {
+        const char * code = R"(
+            struct A {
+                int x.
+                A a.
+            }.
+            struct Node {
+                int value.
+                Node * next.
+            }.
+        )";
+
+        CompilationContext ctx;
+        ParseResult result = x::parse_str(ctx, code);
+        ProgramSource * top = result.parser_state->top;
+        SourceErrors errors;
+
+        top->typecheck(result.parser_state->symtable, errors);
+
+        expect(errors.type_errors.size() == 1);
+        expect(errors.type_errors[0].message == "Struct contains itself");
+
+        TypeIdent node(Location(0, 0), "Node");
+        expect(node.type_size(result.parser_state->symtable) == 16);
+
+        return TEST_SUCCESS;
+    };
+
+    xtest::tests["parallel typechecking keeps error order"] = []() {
+        std::string code = "type X = int.\n";
+
+        for (int i = 0; i < 40; i++) {
+            std::string n = std::to_string(i);
+
+            code += "int f" + n + "() {\n";
+            code += "    X a = " + n + ".\n";
+            code += (i % 3 == 0) ? "    bool b = a.\n" : "    int b = a.\n";
+            code += "    return a.\n";
+            code += "}.\n";
+
+            if (i % 5 == 0) {
+                code += "float g" + n + " = 1.\n";
+            }
+        }
+
+        CompilationContext serial_ctx;
+        CompilationContext parallel_ctx;
+        ParseResult serial = x::parse_str(serial_ctx, code.c_str());
+        ParseResult parallel = x::parse_str(parallel_ctx, code.c_str());
+        SourceErrors serial_errors;
+        SourceErrors parallel_errors;
+        ThreadPool pool(4);
+
+        serial.parser_state->top->typecheck(serial.parser_state->symtable, serial_errors);
+        parallel.parser_state->top->typecheck(parallel.parser_state->symtable, parallel_errors, &pool);
+
+        expect(serial_errors.type_errors.size() > 14);
+        expect(serial_errors.type_errors.size() == parallel_errors.type_errors.size());
+
+        for (size_t i = 0; i < serial_errors.type_errors.size(); i++) {
+            const CompilerError &a = serial_errors.type_errors[i];
+            const CompilerError &b = parallel_errors.type_errors[i];
+
+            expect(a.loc.begin == b.loc.begin && a.loc.end == b.loc.end);
+            expect(a.message == b.message);
+        }
+
+        return TEST_SUCCESS;
+    };
 }
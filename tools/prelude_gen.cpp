@@ -0,0 +1,60 @@
+/**
+ * Writes src/prelude_blob.cpp: the prelude's symbol table, parsed from
+ * BUILTIN_DECLS and serialized into PRELUDE_BLOB. Run by the makefile with the path
+ * to write to.
+ *
+ * Only the signatures are kept. The bodies are placeholders, and every type name in a
+ * signature has already been resolved by the parser, which only accepts declared types.
+ */
+#include <stdio.h>
+
+#include <string>
+
+#include "../src/parseutils.h"
+#include "../src/serialize.h"
+
+int main(int argc, char ** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s output.cpp\n", argv[0]);
+        return 1;
+    }
+
+    CompilationContext ctx(x::bare_symtable());
+    ParseResult result = x::parse_builtins(ctx);
+
+    if (result.error || result.parser_state == nullptr) {
+        fprintf(stderr, "Error: couldn't parse the builtin declarations\n");
+        return 1;
+    }
+
+    SymbolTable * symtable = result.parser_state->symtable;
+
+    std::string blob;
+
+    if (!x::serialize_symtable(symtable, x::builtins_hash(), blob)) {
+        fprintf(stderr, "Error: the builtin declarations can't be serialized\n");
+        return 1;
+    }
+
+    FILE * out = fopen(argv[1], "w");
+
+    if (out == nullptr) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    fprintf(out, "// Generated by tools/prelude_gen.cpp from BUILTIN_DECLS. Do not edit\n");
+    fprintf(out, "#include <stddef.h>\n\n");
+    fprintf(out, "extern const unsigned char PRELUDE_BLOB[] = {");
+
+    for (size_t i = 0; i < blob.size(); i++) {
+        fputs(i % 16 == 0 ? "\n    " : " ", out);
+        fprintf(out, "0x%02x,", (unsigned char) blob[i]);
+    }
+
+    fprintf(out, "\n};\n\n");
+    fprintf(out, "extern const size_t PRELUDE_BLOB_SIZE = %zu;\n", blob.size());
+    fclose(out);
+
+    return 0;
+}